@@ -0,0 +1,544 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_ACTOR_HPP_INCLUDED
+#define CPPCORO_ACTOR_HPP_INCLUDED
+
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/detail/manual_lifetime.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace cppcoro
+{
+	/// What an actor should do after its message handler has failed.
+	enum class actor_directive
+	{
+		/// Carry on with the next message. The supervisor may have reset the
+		/// state first, to restart the actor.
+		resume,
+
+		/// Stop handling messages. Queued and later messages are discarded,
+		/// and senders waiting for room in the mailbox fail.
+		stop
+	};
+
+	namespace detail
+	{
+		/// Coroutine type of an actor's message loop.
+		///
+		/// Starts suspended and never completes; the actor resumes it when a
+		/// message arrives while it is idle and destroys it along with the actor.
+		class actor_loop_task
+		{
+		public:
+
+			struct promise_type
+			{
+				actor_loop_task get_return_object() noexcept
+				{
+					return actor_loop_task{
+						std::coroutine_handle<promise_type>::from_promise(*this) };
+				}
+
+				std::suspend_always initial_suspend() noexcept { return {}; }
+				std::suspend_always final_suspend() noexcept { return {}; }
+				void unhandled_exception() noexcept { std::terminate(); }
+				void return_void() noexcept {}
+			};
+
+			explicit actor_loop_task(std::coroutine_handle<promise_type> coroutine) noexcept
+				: m_coroutine(coroutine)
+			{}
+
+			std::coroutine_handle<promise_type> m_coroutine;
+
+		};
+	}
+
+	/// \brief
+	/// An actor owns some state that is only ever accessed by its message
+	/// handler, which handles the messages sent to the actor one at a time,
+	/// in the order they were queued, on a static_thread_pool.
+	///
+	/// Messages are queued in a bounded lock-free ring buffer. try_send()
+	/// fails if it is full, while 'co_await send(msg)' suspends the sender
+	/// until there is room.
+	///
+	/// An idle actor doesn't occupy a thread or have anything queued on the
+	/// thread pool; it is just its state, its mailbox and the suspended frame
+	/// of its message loop. The send that finds it idle schedules the loop
+	/// onto the thread pool. Each time the loop is scheduled it handles at
+	/// most \c quantum messages and is then scheduled again behind any other
+	/// work, so that a busy actor can't starve the other actors sharing the
+	/// thread pool.
+	///
+	/// If the handler throws, the supervisor is called with the state and
+	/// the exception and decides whether the actor carries on or stops.
+	/// Without a supervisor, the actor stops.
+	///
+	/// Activation uses a single count of messages that are queued, or waiting
+	/// to be queued by a suspended sender, but not yet handled. The sender
+	/// that increments it from zero activates the actor, and the loop goes
+	/// idle when it subtracts the messages of its last quantum and gets zero.
+	template<typename STATE, typename MESSAGE>
+	class actor
+	{
+	public:
+
+		/// Called with each message. Runs to completion before the next
+		/// message is handled, including anything it co_awaits.
+		using handler_type = task<> (*)(STATE& state, MESSAGE message);
+
+		/// Called if the handler throws.
+		using supervisor_type = actor_directive (*)(STATE& state, std::exception_ptr error);
+
+		class send_operation
+		{
+		public:
+
+			send_operation(actor& a, MESSAGE&& message)
+				: m_actor(a)
+				, m_message(std::move(message))
+				, m_schedule(a.m_threadPool.schedule())
+			{}
+
+			bool await_ready() noexcept
+			{
+				if (m_actor.is_stopped())
+				{
+					m_sent = false;
+					return true;
+				}
+
+				m_sent = m_actor.try_push(m_message);
+				if (m_sent)
+				{
+					m_actor.on_message_queued();
+				}
+				return m_sent;
+			}
+
+			void await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+			{
+				m_awaiter = awaitingCoroutine;
+
+				// Once pushed, the actor may queue the message and resume this
+				// coroutine at any time, so only the actor may be used after.
+				actor& a = m_actor;
+				send_operation* head = a.m_blockedSenders.load(std::memory_order_relaxed);
+				do
+				{
+					m_next = head;
+				} while (!a.m_blockedSenders.compare_exchange_weak(
+					head, this, std::memory_order_release, std::memory_order_relaxed));
+
+				a.on_message_queued();
+			}
+
+			/// Returns true if the message was queued, or false if the actor
+			/// has stopped.
+			bool await_resume() const noexcept { return m_sent; }
+
+		private:
+
+			friend class actor;
+
+			actor& m_actor;
+			MESSAGE m_message;
+			static_thread_pool::schedule_operation m_schedule;
+			send_operation* m_next = nullptr;
+			std::coroutine_handle<> m_awaiter;
+			bool m_sent = false;
+
+		};
+
+		/// Construct an idle actor.
+		///
+		/// \param threadPool
+		/// The thread pool that messages are handled on. Must outlive the actor.
+		///
+		/// \param state
+		/// The initial state, passed by reference to each call to \p handler.
+		///
+		/// \param handler
+		/// Handles one message.
+		///
+		/// \param supervisor
+		/// Decides what to do if \p handler throws. If null, the actor stops.
+		///
+		/// \param mailboxCapacity
+		/// The maximum number of queued messages, rounded up to a power of two.
+		///
+		/// \param quantum
+		/// The maximum number of messages handled per scheduling of the actor.
+		actor(
+			static_thread_pool& threadPool,
+			STATE state,
+			handler_type handler,
+			supervisor_type supervisor = nullptr,
+			std::size_t mailboxCapacity = 64,
+			std::size_t quantum = 16)
+			: m_threadPool(threadPool)
+			, m_handler(handler)
+			, m_supervisor(supervisor)
+			, m_quantum(std::max<std::size_t>(quantum, 1))
+			, m_mask(std::bit_ceil(std::max<std::size_t>(mailboxCapacity, 2)) - 1)
+			, m_cells(std::make_unique<cell[]>(m_mask + 1))
+			, m_state(std::move(state))
+			, m_loop(run(*this).m_coroutine)
+		{
+			for (std::size_t i = 0; i <= m_mask; ++i)
+			{
+				m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		/// Destroys the actor.
+		///
+		/// Waits for the messages already sent to be handled, or discarded
+		/// if the actor has stopped, so must not be called from the message
+		/// handler, while messages may still be sent, or from a thread that
+		/// the thread pool needs to make progress.
+		~actor()
+		{
+			while (m_unhandledCount.load(std::memory_order_acquire) != 0)
+			{
+				std::this_thread::yield();
+			}
+
+			m_loop.destroy();
+		}
+
+		actor(const actor&) = delete;
+		actor& operator=(const actor&) = delete;
+
+		/// Queue a message without waiting.
+		///
+		/// \return
+		/// false if the mailbox is full or the actor has stopped, in which
+		/// case the message is discarded.
+		bool try_send(MESSAGE message)
+		{
+			if (is_stopped() || !try_push(message))
+			{
+				return false;
+			}
+
+			on_message_queued();
+			return true;
+		}
+
+		/// Queue a message, waiting for room in the mailbox if it is full.
+		///
+		/// \return
+		/// An operation that must be co_awaited. The result of the co_await
+		/// is true if the message was queued, or false if the actor stopped.
+		[[nodiscard]]
+		send_operation send(MESSAGE message)
+		{
+			return send_operation{ *this, std::move(message) };
+		}
+
+		/// Query if the supervisor has stopped the actor.
+		bool is_stopped() const noexcept
+		{
+			return m_stopped.load(std::memory_order_acquire);
+		}
+
+	private:
+
+		struct cell
+		{
+			std::atomic<std::size_t> m_sequence;
+			detail::manual_lifetime<MESSAGE> m_message;
+		};
+
+		class end_quantum_operation
+		{
+		public:
+
+			end_quantum_operation(actor& a, std::size_t handledCount) noexcept
+				: m_actor(a)
+				, m_handledCount(handledCount)
+			{}
+
+			bool await_ready() const noexcept { return false; }
+
+			bool await_suspend(std::coroutine_handle<>) noexcept
+			{
+				// If this brings the count to zero then the next sender to
+				// queue a message will resume the loop, possibly before this
+				// returns, so this must be the last access to the actor.
+				return m_actor.m_unhandledCount.fetch_sub(
+					m_handledCount, std::memory_order_acq_rel) == m_handledCount;
+			}
+
+			void await_resume() const noexcept {}
+
+		private:
+
+			actor& m_actor;
+			std::size_t m_handledCount;
+
+		};
+
+		/// Moves from \p message only if there is room.
+		///
+		/// A bounded multi-producer queue where each cell's sequence number
+		/// says whether it's free for the producer at that position, or holds
+		/// a message for the consumer.
+		bool try_push(MESSAGE& message)
+		{
+			std::size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+			while (true)
+			{
+				cell& c = m_cells[position & m_mask];
+				const std::size_t sequence = c.m_sequence.load(std::memory_order_acquire);
+				const auto difference =
+					static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+				if (difference == 0)
+				{
+					if (m_enqueuePosition.compare_exchange_weak(
+						position, position + 1, std::memory_order_relaxed))
+					{
+						c.m_message.construct(std::move(message));
+						c.m_sequence.store(position + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (difference < 0)
+				{
+					// The consumer hasn't freed this cell from the previous lap.
+					return false;
+				}
+				else
+				{
+					position = m_enqueuePosition.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/// Returns nullptr if the next message hasn't been published yet.
+		cell* front() noexcept
+		{
+			cell& c = m_cells[m_dequeuePosition & m_mask];
+			if (c.m_sequence.load(std::memory_order_acquire) != m_dequeuePosition + 1)
+			{
+				return nullptr;
+			}
+			return &c;
+		}
+
+		void pop_front(cell& c) noexcept
+		{
+			c.m_message.destruct();
+			c.m_sequence.store(m_dequeuePosition + m_mask + 1, std::memory_order_release);
+			++m_dequeuePosition;
+		}
+
+		bool try_pop_and_destroy() noexcept
+		{
+			cell* c = front();
+			if (c == nullptr)
+			{
+				return false;
+			}
+			pop_front(*c);
+			return true;
+		}
+
+		/// Wait for the next message to be published.
+		///
+		/// Only called when a message has been counted, so the sender that
+		/// claimed the next position is still in the middle of writing it.
+		cell& wait_for_front() noexcept
+		{
+			cell* c;
+			while ((c = front()) == nullptr)
+			{
+				std::this_thread::yield();
+			}
+			return *c;
+		}
+
+		void on_message_queued() noexcept
+		{
+			if (m_unhandledCount.fetch_add(1, std::memory_order_acq_rel) == 0)
+			{
+				// The loop is suspended, waiting for work. It immediately
+				// schedules itself onto the thread pool.
+				m_loop.resume();
+			}
+		}
+
+		/// Move newly suspended senders onto the FIFO list of blocked senders.
+		void collect_blocked_senders() noexcept
+		{
+			send_operation* newSenders =
+				m_blockedSenders.exchange(nullptr, std::memory_order_acquire);
+			if (newSenders == nullptr)
+			{
+				return;
+			}
+
+			// Reverse them, so that they're queued in the order they arrived.
+			send_operation* head = nullptr;
+			send_operation* tail = newSenders;
+			do
+			{
+				auto* next = newSenders->m_next;
+				newSenders->m_next = head;
+				head = newSenders;
+				newSenders = next;
+			} while (newSenders != nullptr);
+
+			if (m_blockedTail == nullptr)
+			{
+				m_blockedHead = head;
+			}
+			else
+			{
+				m_blockedTail->m_next = head;
+			}
+			m_blockedTail = tail;
+		}
+
+		send_operation* pop_blocked_sender() noexcept
+		{
+			send_operation* sender = m_blockedHead;
+			if (sender != nullptr)
+			{
+				m_blockedHead = sender->m_next;
+				if (m_blockedHead == nullptr)
+				{
+					m_blockedTail = nullptr;
+				}
+			}
+			return sender;
+		}
+
+		/// Queue messages of blocked senders while there is room, and
+		/// schedule the senders to resume.
+		void admit_blocked_senders() noexcept
+		{
+			collect_blocked_senders();
+			while (m_blockedHead != nullptr && try_push(m_blockedHead->m_message))
+			{
+				send_operation* sender = pop_blocked_sender();
+				sender->m_sent = true;
+				sender->m_schedule.await_suspend(sender->m_awaiter);
+			}
+		}
+
+		/// Consume one unit of the unhandled count without handling a message.
+		void discard_one() noexcept
+		{
+			collect_blocked_senders();
+			if (send_operation* sender = pop_blocked_sender())
+			{
+				sender->m_sent = false;
+				sender->m_schedule.await_suspend(sender->m_awaiter);
+				return;
+			}
+
+			pop_front(wait_for_front());
+		}
+
+		static detail::actor_loop_task run(actor& a)
+		{
+			while (true)
+			{
+				co_await a.m_threadPool.schedule();
+
+				// Every counted message is either published in the mailbox or
+				// held by a blocked sender, so there are at least this many
+				// to handle.
+				const std::size_t handledCount = std::min(
+					a.m_quantum, a.m_unhandledCount.load(std::memory_order_acquire));
+				assert(handledCount > 0);
+
+				for (std::size_t i = 0; i < handledCount; ++i)
+				{
+					if (a.is_stopped())
+					{
+						a.discard_one();
+						continue;
+					}
+
+					a.admit_blocked_senders();
+
+					cell& c = a.wait_for_front();
+					MESSAGE message = std::move(*c.m_message);
+					a.pop_front(c);
+
+					std::exception_ptr error;
+					try
+					{
+						co_await a.m_handler(a.m_state, std::move(message));
+					}
+					catch (...)
+					{
+						error = std::current_exception();
+					}
+
+					if (error)
+					{
+						const actor_directive directive = a.m_supervisor != nullptr
+							? a.m_supervisor(a.m_state, std::move(error))
+							: actor_directive::stop;
+						if (directive == actor_directive::stop)
+						{
+							a.m_stopped.store(true, std::memory_order_release);
+						}
+					}
+				}
+
+				// Let senders blocked on a full mailbox in, now there is room.
+				if (!a.is_stopped())
+				{
+					a.admit_blocked_senders();
+				}
+
+				// Suspends if the actor is now idle. Either way, goes back to
+				// the thread pool before handling any more messages.
+				co_await end_quantum_operation{ a, handledCount };
+			}
+		}
+
+		static_thread_pool& m_threadPool;
+		const handler_type m_handler;
+		const supervisor_type m_supervisor;
+		const std::size_t m_quantum;
+		const std::size_t m_mask;
+		const std::unique_ptr<cell[]> m_cells;
+
+		// Only accessed by the message loop.
+		STATE m_state;
+		std::size_t m_dequeuePosition = 0;
+		send_operation* m_blockedHead = nullptr;
+		send_operation* m_blockedTail = nullptr;
+
+		std::atomic<std::size_t> m_enqueuePosition{ 0 };
+		std::atomic<std::size_t> m_unhandledCount{ 0 };
+		std::atomic<send_operation*> m_blockedSenders{ nullptr };
+		std::atomic<bool> m_stopped{ false };
+
+		std::coroutine_handle<> m_loop;
+
+	};
+}
+
+#endif
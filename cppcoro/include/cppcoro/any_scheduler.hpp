@@ -0,0 +1,310 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_ANY_SCHEDULER_HPP_INCLUDED
+#define CPPCORO_ANY_SCHEDULER_HPP_INCLUDED
+
+#include <cppcoro/config.hpp>
+#include <cppcoro/inline_scheduler.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+
+#if CPPCORO_OS_WINNT || CPPCORO_OS_LINUX
+# include <cppcoro/io_service.hpp>
+# define CPPCORO_ANY_SCHEDULER_HAS_IO_SERVICE 1
+#else
+# define CPPCORO_ANY_SCHEDULER_HAS_IO_SERVICE 0
+#endif
+
+#include <cppcoro/detail/is_awaiter.hpp>
+
+#include <coroutine>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace cppcoro
+{
+	/// \brief
+	/// A type-erased reference to a scheduler.
+	///
+	/// Lets code accept any scheduler without being a template. Neither
+	/// constructing an any_scheduler nor scheduling through it allocates:
+	/// the scheduler's own schedule operation is constructed inside the
+	/// fixed-size operation returned by schedule().
+	///
+	/// static_thread_pool, io_service and inline_scheduler are called
+	/// directly. Other schedulers are called through a small table of
+	/// function pointers, and their schedule() must return an awaiter of at
+	/// most \c operation_storage_size bytes.
+	///
+	/// An any_scheduler doesn't own the scheduler it refers to, which must
+	/// outlive it.
+	class any_scheduler
+	{
+	public:
+
+		class schedule_operation;
+
+		/// The largest schedule operation of another type of scheduler that
+		/// an any_scheduler can hold.
+		static constexpr std::size_t operation_storage_size = 4 * sizeof(void*);
+
+		any_scheduler(inline_scheduler) noexcept
+			: m_scheduler(nullptr)
+			, m_vtable(nullptr)
+			, m_kind(kind::inline_scheduler)
+		{}
+
+		any_scheduler(static_thread_pool& threadPool) noexcept
+			: m_scheduler(std::addressof(threadPool))
+			, m_vtable(nullptr)
+			, m_kind(kind::static_thread_pool)
+		{}
+
+#if CPPCORO_ANY_SCHEDULER_HAS_IO_SERVICE
+		any_scheduler(io_service& ioService) noexcept
+			: m_scheduler(std::addressof(ioService))
+			, m_vtable(nullptr)
+			, m_kind(kind::io_service)
+		{}
+#endif
+
+		template<
+			typename SCHEDULER,
+			std::enable_if_t<!std::is_same_v<std::remove_cv_t<SCHEDULER>, any_scheduler>, int> = 0>
+		any_scheduler(SCHEDULER& scheduler) noexcept
+			: m_scheduler(const_cast<void*>(static_cast<const void*>(std::addressof(scheduler))))
+			, m_vtable(&vtable_for<SCHEDULER>)
+			, m_kind(kind::other)
+		{}
+
+		/// Returns an operation that, when awaited, resumes the awaiting
+		/// coroutine however the underlying scheduler's schedule() would.
+		[[nodiscard]]
+		schedule_operation schedule() const;
+
+		bool operator==(const any_scheduler& other) const noexcept
+		{
+			return m_kind == other.m_kind && m_scheduler == other.m_scheduler;
+		}
+
+		bool operator!=(const any_scheduler& other) const noexcept
+		{
+			return !(*this == other);
+		}
+
+	private:
+
+		enum class kind : unsigned char
+		{
+			inline_scheduler,
+			static_thread_pool,
+			io_service,
+			other,
+		};
+
+		struct vtable
+		{
+			void(*construct)(void* scheduler, void* storage);
+			void(*destroy)(void* storage) noexcept;
+			bool(*await_ready)(void* storage);
+			bool(*await_suspend)(void* storage, std::coroutine_handle<> awaitingCoroutine);
+			void(*await_resume)(void* storage);
+		};
+
+		template<typename SCHEDULER>
+		struct erased
+		{
+			using operation_t = decltype(std::declval<SCHEDULER&>().schedule());
+
+			static_assert(
+				detail::is_awaiter<operation_t&>::value,
+				"any_scheduler requires schedule() to return an awaiter");
+			static_assert(
+				sizeof(operation_t) <= operation_storage_size &&
+				alignof(operation_t) <= alignof(std::max_align_t),
+				"the scheduler's schedule operation is too big for any_scheduler");
+
+			static operation_t& get(void* storage) noexcept
+			{
+				return *std::launder(static_cast<operation_t*>(storage));
+			}
+
+			static void construct(void* scheduler, void* storage)
+			{
+				::new (storage) operation_t(static_cast<SCHEDULER*>(scheduler)->schedule());
+			}
+
+			static void destroy(void* storage) noexcept
+			{
+				get(storage).~operation_t();
+			}
+
+			static bool await_ready(void* storage)
+			{
+				return static_cast<bool>(get(storage).await_ready());
+			}
+
+			static bool await_suspend(void* storage, std::coroutine_handle<> awaitingCoroutine)
+			{
+				using await_suspend_result_t = decltype(get(storage).await_suspend(awaitingCoroutine));
+				if constexpr (std::is_void_v<await_suspend_result_t>)
+				{
+					get(storage).await_suspend(awaitingCoroutine);
+					return true;
+				}
+				else if constexpr (std::is_same_v<await_suspend_result_t, bool>)
+				{
+					return get(storage).await_suspend(awaitingCoroutine);
+				}
+				else
+				{
+					get(storage).await_suspend(awaitingCoroutine).resume();
+					return true;
+				}
+			}
+
+			static void await_resume(void* storage)
+			{
+				(void)get(storage).await_resume();
+			}
+		};
+
+		template<typename SCHEDULER>
+		static constexpr vtable vtable_for = {
+			&erased<SCHEDULER>::construct,
+			&erased<SCHEDULER>::destroy,
+			&erased<SCHEDULER>::await_ready,
+			&erased<SCHEDULER>::await_suspend,
+			&erased<SCHEDULER>::await_resume,
+		};
+
+		void* m_scheduler;
+		const vtable* m_vtable;
+		kind m_kind;
+
+	};
+
+	class any_scheduler::schedule_operation
+	{
+	public:
+
+		~schedule_operation()
+		{
+			switch (m_kind)
+			{
+			case kind::inline_scheduler:
+				break;
+			case kind::static_thread_pool:
+				get<thread_pool_operation>().~thread_pool_operation();
+				break;
+#if CPPCORO_ANY_SCHEDULER_HAS_IO_SERVICE
+			case kind::io_service:
+				get<io_service_operation>().~io_service_operation();
+				break;
+#endif
+			default:
+				m_vtable->destroy(m_storage);
+				break;
+			}
+		}
+
+		schedule_operation(const schedule_operation&) = delete;
+		schedule_operation& operator=(const schedule_operation&) = delete;
+
+		bool await_ready()
+		{
+			switch (m_kind)
+			{
+			case kind::inline_scheduler:
+				return true;
+			case kind::static_thread_pool:
+#if CPPCORO_ANY_SCHEDULER_HAS_IO_SERVICE
+			case kind::io_service:
+#endif
+				return false;
+			default:
+				return m_vtable->await_ready(m_storage);
+			}
+		}
+
+		bool await_suspend(std::coroutine_handle<> awaitingCoroutine)
+		{
+			switch (m_kind)
+			{
+			case kind::static_thread_pool:
+				get<thread_pool_operation>().await_suspend(awaitingCoroutine);
+				return true;
+#if CPPCORO_ANY_SCHEDULER_HAS_IO_SERVICE
+			case kind::io_service:
+				get<io_service_operation>().await_suspend(awaitingCoroutine);
+				return true;
+#endif
+			default:
+				return m_vtable->await_suspend(m_storage, awaitingCoroutine);
+			}
+		}
+
+		void await_resume()
+		{
+			if (m_kind == kind::other)
+			{
+				m_vtable->await_resume(m_storage);
+			}
+		}
+
+	private:
+
+		friend class any_scheduler;
+
+		using thread_pool_operation = static_thread_pool::schedule_operation;
+#if CPPCORO_ANY_SCHEDULER_HAS_IO_SERVICE
+		using io_service_operation = io_service::schedule_operation;
+#endif
+
+		explicit schedule_operation(const any_scheduler& scheduler)
+			: m_vtable(scheduler.m_vtable)
+			, m_kind(scheduler.m_kind)
+		{
+			switch (m_kind)
+			{
+			case kind::inline_scheduler:
+				break;
+			case kind::static_thread_pool:
+				::new (static_cast<void*>(m_storage)) thread_pool_operation(
+					static_cast<static_thread_pool*>(scheduler.m_scheduler)->schedule());
+				break;
+#if CPPCORO_ANY_SCHEDULER_HAS_IO_SERVICE
+			case kind::io_service:
+				::new (static_cast<void*>(m_storage)) io_service_operation(
+					static_cast<io_service*>(scheduler.m_scheduler)->schedule());
+				break;
+#endif
+			default:
+				m_vtable->construct(scheduler.m_scheduler, m_storage);
+				break;
+			}
+		}
+
+		template<typename OPERATION>
+		OPERATION& get() noexcept
+		{
+			static_assert(sizeof(OPERATION) <= operation_storage_size);
+			return *std::launder(reinterpret_cast<OPERATION*>(m_storage));
+		}
+
+		alignas(std::max_align_t) std::byte m_storage[operation_storage_size];
+		const vtable* m_vtable;
+		kind m_kind;
+
+	};
+
+	inline any_scheduler::schedule_operation any_scheduler::schedule() const
+	{
+		return schedule_operation{ *this };
+	}
+}
+
+#endif
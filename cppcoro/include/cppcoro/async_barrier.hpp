@@ -0,0 +1,324 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_ASYNC_BARRIER_HPP_INCLUDED
+#define CPPCORO_ASYNC_BARRIER_HPP_INCLUDED
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <coroutine>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace cppcoro
+{
+	namespace detail
+	{
+		struct async_barrier_noop_completion
+		{
+			void operator()() const noexcept {}
+		};
+
+		/// Index of the leaf that arrivals from the current thread try first.
+		///
+		/// Threads are handed out consecutive starting points so that threads
+		/// arriving concurrently tend to count on different cache lines.
+		inline std::size_t& async_barrier_leaf_hint() noexcept
+		{
+			static std::atomic<std::size_t> nextHint{ 0 };
+			static thread_local std::size_t hint =
+				nextHint.fetch_add(1, std::memory_order_relaxed);
+			return hint;
+		}
+	}
+
+	template<typename COMPLETION_FUNCTION>
+	class async_barrier_arrive_operation;
+
+	/// A reusable barrier for a fixed set of coroutines that proceed in phases.
+	///
+	/// This is the coroutine equivalent of std::barrier. Each phase completes
+	/// once every participant has called either arrive_and_wait() or
+	/// arrive_and_drop(). The completion function is then run once, by the
+	/// last participant to arrive, before the coroutines waiting on the phase
+	/// are resumed and the next phase begins.
+	///
+	/// Arrivals are counted on a two-level combining tree rather than on a
+	/// single counter. Participants are split across leaves of at most
+	/// \c leaf_capacity arrivals, each on its own cache line with its own
+	/// list of waiting coroutines. An arrival only touches its leaf, except
+	/// for the arrival that fills the leaf, which counts the whole leaf
+	/// towards the root. Arrivals from different threads start at different
+	/// leaves and move on to the next leaf once one is full.
+	///
+	/// The last arriver resumes all of the waiting coroutines of the phase
+	/// inline, one after the other, then continues itself without suspending.
+	/// Coroutines that need to run their next phase in parallel should
+	/// reschedule themselves onto a thread pool after the barrier.
+	template<typename COMPLETION_FUNCTION = detail::async_barrier_noop_completion>
+	class async_barrier
+	{
+		static_assert(
+			std::is_nothrow_invocable_v<COMPLETION_FUNCTION&>,
+			"the completion function of an async_barrier must be noexcept invocable with no arguments");
+
+	public:
+
+		/// Maximum number of arrivals counted on a single leaf.
+		static constexpr std::uint32_t leaf_capacity = 16;
+
+		/// Construct a barrier for the specified number of participants.
+		///
+		/// \param participantCount
+		/// The number of arrivals that complete the first phase.
+		///
+		/// \param completion
+		/// Invoked once at the end of each phase, before any of the
+		/// participants waiting on the phase are resumed.
+		explicit async_barrier(
+			std::ptrdiff_t participantCount,
+			COMPLETION_FUNCTION completion = COMPLETION_FUNCTION{})
+			: m_completion(std::move(completion))
+			, m_leafCount(participantCount > 0 ? (static_cast<std::size_t>(participantCount) + leaf_capacity - 1) / leaf_capacity : 1)
+			, m_leaves(std::make_unique<leaf[]>(m_leafCount))
+			, m_participantCount(participantCount > 0 ? static_cast<std::size_t>(participantCount) : 0)
+		{
+			reset_phase();
+		}
+
+		async_barrier(const async_barrier&) = delete;
+		async_barrier& operator=(const async_barrier&) = delete;
+
+		/// Arrive at the barrier and suspend until the current phase completes.
+		///
+		/// If this is the last arrival of the phase then the completion
+		/// function is run and the other waiting coroutines are resumed inside
+		/// this call, and the awaiting coroutine continues without suspending.
+		async_barrier_arrive_operation<COMPLETION_FUNCTION> arrive_and_wait() noexcept;
+
+		/// Arrive at the barrier and leave the set of participants.
+		///
+		/// Counts as an arrival for the current phase, and reduces the number
+		/// of arrivals expected by the following phases by one.
+		///
+		/// If this is the last arrival of the phase then the completion
+		/// function is run and the waiting coroutines are resumed inside this
+		/// call.
+		void arrive_and_drop() noexcept
+		{
+			m_pendingDropCount.fetch_add(1, std::memory_order_relaxed);
+			arrive(nullptr);
+		}
+
+		/// The number of phases that have completed so far.
+		///
+		/// Only a snapshot if queried while participants may be arriving.
+		std::uint64_t completed_phase_count() const noexcept
+		{
+			return m_completedPhaseCount.load(std::memory_order_acquire);
+		}
+
+	private:
+
+		friend class async_barrier_arrive_operation<COMPLETION_FUNCTION>;
+
+		using operation = async_barrier_arrive_operation<COMPLETION_FUNCTION>;
+
+		struct alignas(64) leaf
+		{
+			// Number of arrivals of the current phase that have claimed a slot
+			// on this leaf. Never exceeds m_capacity.
+			std::atomic<std::uint32_t> m_claimedCount{ 0 };
+
+			// Number of claimed arrivals that have finished adding themselves
+			// to m_waiters. The arrival that brings this up to m_capacity
+			// completes the leaf.
+			std::atomic<std::uint32_t> m_arrivedCount{ 0 };
+
+			// Stack of the operations waiting on this leaf.
+			std::atomic<operation*> m_waiters{ nullptr };
+
+			// Number of arrivals that complete this leaf in the current phase.
+			// Only written by the last arriver of a phase, before any arrivals
+			// of the next phase.
+			std::uint32_t m_capacity = 0;
+		};
+
+		/// Returns true if the operation has been queued and will be resumed
+		/// later, or false if it completed the phase.
+		bool arrive(operation* waiter) noexcept
+		{
+			auto& hint = detail::async_barrier_leaf_hint();
+			std::size_t index = hint % m_activeLeafCount;
+
+			// Claim a slot on the first leaf with room, starting from the hint.
+			// The capacities of the leaves add up to the participant count, so
+			// as long as nobody arrives twice in one phase there is always room
+			// on one of them.
+			leaf* l;
+			std::uint32_t capacity;
+			while (true)
+			{
+				l = &m_leaves[index];
+				capacity = l->m_capacity;
+				std::uint32_t claimed = l->m_claimedCount.load(std::memory_order_relaxed);
+				while (claimed < capacity &&
+					!l->m_claimedCount.compare_exchange_weak(
+						claimed, claimed + 1, std::memory_order_relaxed))
+				{}
+				if (claimed < capacity)
+				{
+					break;
+				}
+
+				index = index + 1 < m_activeLeafCount ? index + 1 : 0;
+			}
+			hint = index;
+
+			if (waiter != nullptr)
+			{
+				operation* head = l->m_waiters.load(std::memory_order_relaxed);
+				do
+				{
+					waiter->m_next = head;
+				} while (!l->m_waiters.compare_exchange_weak(
+					head, waiter, std::memory_order_release, std::memory_order_relaxed));
+			}
+
+			// Once counted, the waiter may be resumed and the leaf reset for the
+			// next phase by another thread, so neither may be touched again
+			// unless this arrival completes the phase.
+			if (l->m_arrivedCount.fetch_add(1, std::memory_order_acq_rel) + 1 != capacity)
+			{
+				return true;
+			}
+
+			if (m_remainingLeafCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			{
+				return true;
+			}
+
+			complete_phase(waiter);
+			return false;
+		}
+
+		void complete_phase(operation* self) noexcept
+		{
+			operation* waiters = nullptr;
+			for (std::size_t i = 0; i < m_activeLeafCount; ++i)
+			{
+				operation* head = m_leaves[i].m_waiters.load(std::memory_order_acquire);
+				while (head != nullptr)
+				{
+					operation* next = head->m_next;
+					if (head != self)
+					{
+						head->m_next = waiters;
+						waiters = head;
+					}
+					head = next;
+				}
+			}
+
+			m_participantCount -= m_pendingDropCount.exchange(0, std::memory_order_relaxed);
+			reset_phase();
+
+			m_completion();
+			m_completedPhaseCount.fetch_add(1, std::memory_order_release);
+
+			while (waiters != nullptr)
+			{
+				// Read next before resuming, as resuming the coroutine may
+				// destroy the operation.
+				operation* next = waiters->m_next;
+				waiters->m_awaiter.resume();
+				waiters = next;
+			}
+		}
+
+		/// Spread the participants of the next phase evenly over as few leaves
+		/// as will hold them.
+		void reset_phase() noexcept
+		{
+			const std::size_t participantCount = m_participantCount;
+			m_activeLeafCount = participantCount > 0
+				? (participantCount + leaf_capacity - 1) / leaf_capacity
+				: 1;
+			assert(m_activeLeafCount <= m_leafCount);
+
+			const std::size_t perLeaf = participantCount / m_activeLeafCount;
+			const std::size_t remainder = participantCount % m_activeLeafCount;
+			for (std::size_t i = 0; i < m_leafCount; ++i)
+			{
+				leaf& l = m_leaves[i];
+				l.m_capacity = i < m_activeLeafCount
+					? static_cast<std::uint32_t>(perLeaf + (i < remainder ? 1 : 0))
+					: 0;
+				l.m_claimedCount.store(0, std::memory_order_relaxed);
+				l.m_arrivedCount.store(0, std::memory_order_relaxed);
+				l.m_waiters.store(nullptr, std::memory_order_relaxed);
+			}
+
+			m_remainingLeafCount.store(m_activeLeafCount, std::memory_order_relaxed);
+		}
+
+		COMPLETION_FUNCTION m_completion;
+		const std::size_t m_leafCount;
+		std::unique_ptr<leaf[]> m_leaves;
+
+		// Only accessed by the last arriver of a phase, apart from
+		// m_activeLeafCount which arrivals read.
+		std::size_t m_participantCount;
+		std::size_t m_activeLeafCount = 1;
+
+		alignas(64) std::atomic<std::size_t> m_remainingLeafCount{ 0 };
+		std::atomic<std::size_t> m_pendingDropCount{ 0 };
+		std::atomic<std::uint64_t> m_completedPhaseCount{ 0 };
+
+	};
+
+	template<typename COMPLETION_FUNCTION>
+	async_barrier(std::ptrdiff_t, COMPLETION_FUNCTION) -> async_barrier<COMPLETION_FUNCTION>;
+
+	template<typename COMPLETION_FUNCTION>
+	class async_barrier_arrive_operation
+	{
+	public:
+
+		explicit async_barrier_arrive_operation(async_barrier<COMPLETION_FUNCTION>& barrier) noexcept
+			: m_barrier(barrier)
+		{}
+
+		bool await_ready() const noexcept { return false; }
+
+		bool await_suspend(std::coroutine_handle<> awaiter) noexcept
+		{
+			m_awaiter = awaiter;
+			return m_barrier.arrive(this);
+		}
+
+		void await_resume() const noexcept {}
+
+	private:
+
+		friend class async_barrier<COMPLETION_FUNCTION>;
+
+		async_barrier<COMPLETION_FUNCTION>& m_barrier;
+		async_barrier_arrive_operation* m_next = nullptr;
+		std::coroutine_handle<> m_awaiter;
+
+	};
+
+	template<typename COMPLETION_FUNCTION>
+	async_barrier_arrive_operation<COMPLETION_FUNCTION>
+	async_barrier<COMPLETION_FUNCTION>::arrive_and_wait() noexcept
+	{
+		return async_barrier_arrive_operation<COMPLETION_FUNCTION>{ *this };
+	}
+}
+
+#endif
@@ -0,0 +1,633 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_ASYNC_CONCURRENT_MAP_HPP_INCLUDED
+#define CPPCORO_ASYNC_CONCURRENT_MAP_HPP_INCLUDED
+
+#include <cppcoro/config.hpp>
+
+#include <cppcoro/detail/manual_lifetime.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <climits>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace cppcoro
+{
+	template<typename KEY, typename VALUE, typename HASH, typename EQUAL>
+	class async_concurrent_map_wait_operation;
+
+	/// \brief
+	/// A concurrent hash map that coroutines can wait on for a key to be
+	/// inserted.
+	///
+	/// Keys are spread over a number of stripes, each of which is an open
+	/// addressing table with linear probing, protected by its own mutex and
+	/// grown independently of the others. Threads using keys in different
+	/// stripes don't contend with each other.
+	///
+	/// <tt>co_await map.wait_for(key)</tt> completes with a copy of the key's
+	/// value, immediately if it is already in the map, otherwise once it's
+	/// inserted. Waiting coroutines are kept in intrusive lists, hashed by
+	/// key into a table of buckets per stripe, and are resumed inside the
+	/// call to insert() that inserts their key. An insert only looks at the
+	/// waiters whose keys share its bucket, however many other keys are
+	/// being waited for, and waiting only allocates when the bucket table
+	/// grows.
+	///
+	/// Values are copied out rather than referenced, as another thread may
+	/// erase or replace them at any time. Keys and values must be nothrow
+	/// move constructible, so entries can be moved as the tables grow and
+	/// as entries are erased.
+	template<
+		typename KEY,
+		typename VALUE,
+		typename HASH = std::hash<KEY>,
+		typename EQUAL = std::equal_to<KEY>>
+	class async_concurrent_map
+	{
+		static_assert(
+			std::is_nothrow_move_constructible_v<KEY> && std::is_nothrow_move_constructible_v<VALUE>,
+			"async_concurrent_map requires nothrow move constructible keys and values");
+
+	public:
+
+		using key_type = KEY;
+		using mapped_type = VALUE;
+		using wait_operation = async_concurrent_map_wait_operation<KEY, VALUE, HASH, EQUAL>;
+
+		/// Construct an empty map.
+		///
+		/// \param stripeCount
+		/// The number of independently locked stripes. Rounded up to a power
+		/// of two.
+		explicit async_concurrent_map(
+			std::size_t stripeCount = 64,
+			const HASH& hash = HASH{},
+			const EQUAL& equal = EQUAL{})
+			: m_hash(hash)
+			, m_equal(equal)
+			, m_stripeShift(stripe_shift(stripeCount))
+			, m_stripes(std::make_unique<stripe[]>(std::size_t(1) << (hash_bits - m_stripeShift)))
+		{}
+
+		/// No coroutines may still be waiting on the map.
+		~async_concurrent_map()
+		{
+			for (std::size_t i = 0; i < stripe_count(); ++i)
+			{
+				stripe& s = m_stripes[i];
+				assert(s.m_waiterCount == 0);
+				for (std::size_t j = 0; j < s.capacity(); ++j)
+				{
+					if (s.m_slots[j].m_hash != 0)
+					{
+						s.m_slots[j].m_entry.destruct();
+					}
+				}
+			}
+		}
+
+		async_concurrent_map(const async_concurrent_map&) = delete;
+		async_concurrent_map& operator=(const async_concurrent_map&) = delete;
+
+		/// Insert \p value for \p key if the key isn't already in the map.
+		///
+		/// Coroutines waiting for the key are resumed inside this call, on
+		/// this thread, each with its own copy of the value.
+		///
+		/// \return
+		/// true if the value was inserted, false if the key was already in
+		/// the map.
+		bool insert(const KEY& key, VALUE value)
+		{
+			return insert_impl(key, std::move(value), false);
+		}
+
+		/// Insert \p value for \p key, replacing the existing value if the
+		/// key is already in the map.
+		///
+		/// \return
+		/// true if the key was inserted, false if its value was replaced.
+		bool insert_or_assign(const KEY& key, VALUE value)
+		{
+			return insert_impl(key, std::move(value), true);
+		}
+
+		/// Look up the value for \p key.
+		///
+		/// \return
+		/// A copy of the value, or std::nullopt if the key isn't in the map.
+		std::optional<VALUE> find(const KEY& key) const
+		{
+			const std::size_t hash = hash_of(key);
+			stripe& s = stripe_for(hash);
+			std::scoped_lock lock{ s.m_mutex };
+			if (const slot* existing = find_slot(s, hash, key); existing != nullptr)
+			{
+				return existing->m_entry->second;
+			}
+			return std::nullopt;
+		}
+
+		bool contains(const KEY& key) const
+		{
+			const std::size_t hash = hash_of(key);
+			stripe& s = stripe_for(hash);
+			std::scoped_lock lock{ s.m_mutex };
+			return find_slot(s, hash, key) != nullptr;
+		}
+
+		/// Remove \p key from the map.
+		///
+		/// \return
+		/// true if the key was in the map.
+		bool erase(const KEY& key)
+		{
+			const std::size_t hash = hash_of(key);
+			stripe& s = stripe_for(hash);
+			std::scoped_lock lock{ s.m_mutex };
+			slot* existing = find_slot(s, hash, key);
+			if (existing == nullptr)
+			{
+				return false;
+			}
+
+			erase_slot(s, static_cast<std::size_t>(existing - s.m_slots.get()));
+			return true;
+		}
+
+		/// The number of keys in the map. Only a snapshot if other threads
+		/// are modifying the map.
+		std::size_t size() const noexcept
+		{
+			std::size_t count = 0;
+			for (std::size_t i = 0; i < stripe_count(); ++i)
+			{
+				count += m_stripes[i].m_count.load(std::memory_order_relaxed);
+			}
+			return count;
+		}
+
+		/// \brief
+		/// Wait until \p key is in the map.
+		///
+		/// Awaiting the returned operation produces a copy of the key's value.
+		/// The key is referenced, not copied, so it must outlive the
+		/// operation.
+		///
+		/// A coroutine must not be destroyed while it is suspended here.
+		[[nodiscard]]
+		wait_operation wait_for(const KEY& key) noexcept
+		{
+			return wait_operation{ *this, key };
+		}
+
+	private:
+
+		friend class async_concurrent_map_wait_operation<KEY, VALUE, HASH, EQUAL>;
+
+		static constexpr std::size_t hash_bits = sizeof(std::size_t) * CHAR_BIT;
+
+		// The smallest a stripe's table grows to, once it has any entries.
+		static constexpr std::size_t min_capacity = 8;
+
+		// The smallest a stripe's waiter table grows to, once anyone waits.
+		static constexpr std::size_t min_waiter_buckets = 8;
+
+		struct slot
+		{
+			// Zero for an empty slot. The hashes of keys always have the
+			// lowest bit set.
+			std::size_t m_hash = 0;
+			detail::manual_lifetime<std::pair<KEY, VALUE>> m_entry;
+		};
+
+		struct alignas(CPPCORO_CPU_CACHE_LINE) stripe
+		{
+			std::mutex m_mutex;
+			std::unique_ptr<slot[]> m_slots;
+			std::size_t m_mask = 0;
+
+			// Only written while holding m_mutex, but read by size() without it.
+			std::atomic<std::size_t> m_count{ 0 };
+
+			// Coroutines waiting for keys in this stripe that aren't in the map,
+			// in lists by the low bits of their hash, newest first. Grown to
+			// keep at most one waiter per bucket on average.
+			std::unique_ptr<wait_operation*[]> m_waiterBuckets;
+			std::size_t m_waiterMask = 0;
+			std::size_t m_waiterCount = 0;
+
+			std::size_t capacity() const noexcept
+			{
+				return m_slots ? m_mask + 1 : 0;
+			}
+
+			std::size_t waiter_bucket_count() const noexcept
+			{
+				return m_waiterBuckets ? m_waiterMask + 1 : 0;
+			}
+
+			wait_operation*& waiter_bucket(std::size_t hash) const noexcept
+			{
+				return m_waiterBuckets[(hash >> 1) & m_waiterMask];
+			}
+		};
+
+		static std::size_t stripe_shift(std::size_t stripeCount) noexcept
+		{
+			std::size_t bits = 0;
+			while ((std::size_t(1) << bits) < stripeCount && bits < 16)
+			{
+				++bits;
+			}
+			return hash_bits - bits;
+		}
+
+		std::size_t stripe_count() const noexcept
+		{
+			return std::size_t(1) << (hash_bits - m_stripeShift);
+		}
+
+		std::size_t hash_of(const KEY& key) const
+		{
+			// Mix weak hashes, such as std::hash of integers, with the MurmurHash3
+			// finaliser. A multiply alone leaves the low bits depending only on
+			// the key's low bits, so aligned pointers or keys stepped by a power
+			// of two would share a home slot. The high bits pick the stripe and
+			// the low bits pick the slot.
+			std::size_t hash = static_cast<std::size_t>(m_hash(key));
+			if constexpr (sizeof(std::size_t) == 8)
+			{
+				hash ^= hash >> 33;
+				hash *= static_cast<std::size_t>(0xFF51AFD7ED558CCDULL);
+				hash ^= hash >> 33;
+				hash *= static_cast<std::size_t>(0xC4CEB9FE1A85EC53ULL);
+				hash ^= hash >> 33;
+			}
+			else
+			{
+				hash ^= hash >> 16;
+				hash *= static_cast<std::size_t>(0x85EBCA6BUL);
+				hash ^= hash >> 13;
+				hash *= static_cast<std::size_t>(0xC2B2AE35UL);
+				hash ^= hash >> 16;
+			}
+			return hash | 1;
+		}
+
+		stripe& stripe_for(std::size_t hash) const noexcept
+		{
+			// A shift by the full width is undefined, so one stripe is special.
+			return m_stripes[m_stripeShift == hash_bits ? 0 : hash >> m_stripeShift];
+		}
+
+		static std::size_t home_index(const stripe& s, std::size_t hash) noexcept
+		{
+			return (hash >> 1) & s.m_mask;
+		}
+
+		slot* find_slot(const stripe& s, std::size_t hash, const KEY& key) const
+		{
+			if (!s.m_slots)
+			{
+				return nullptr;
+			}
+
+			for (std::size_t i = home_index(s, hash);; i = (i + 1) & s.m_mask)
+			{
+				slot& candidate = s.m_slots[i];
+				if (candidate.m_hash == 0)
+				{
+					return nullptr;
+				}
+				if (candidate.m_hash == hash && m_equal(candidate.m_entry->first, key))
+				{
+					return &candidate;
+				}
+			}
+		}
+
+		static slot& empty_slot_for(stripe& s, std::size_t hash) noexcept
+		{
+			std::size_t i = home_index(s, hash);
+			while (s.m_slots[i].m_hash != 0)
+			{
+				i = (i + 1) & s.m_mask;
+			}
+			return s.m_slots[i];
+		}
+
+		template<typename V>
+		void emplace(stripe& s, std::size_t hash, const KEY& key, V&& value)
+		{
+			// Keep the load factor at most 3/4.
+			const std::size_t count = s.m_count.load(std::memory_order_relaxed);
+			if ((count + 1) * 4 > s.capacity() * 3)
+			{
+				grow(s);
+			}
+
+			slot& target = empty_slot_for(s, hash);
+			target.m_entry.construct(key, static_cast<V&&>(value));
+			target.m_hash = hash;
+			s.m_count.store(count + 1, std::memory_order_relaxed);
+		}
+
+		static void grow(stripe& s)
+		{
+			const std::size_t oldCapacity = s.capacity();
+			const std::size_t newCapacity = oldCapacity == 0 ? min_capacity : oldCapacity * 2;
+
+			std::unique_ptr<slot[]> oldSlots = std::exchange(s.m_slots, std::make_unique<slot[]>(newCapacity));
+			s.m_mask = newCapacity - 1;
+
+			for (std::size_t i = 0; i < oldCapacity; ++i)
+			{
+				slot& old = oldSlots[i];
+				if (old.m_hash != 0)
+				{
+					slot& target = empty_slot_for(s, old.m_hash);
+					target.m_entry.construct(std::move(*old.m_entry));
+					target.m_hash = old.m_hash;
+					old.m_entry.destruct();
+				}
+			}
+		}
+
+		static void erase_slot(stripe& s, std::size_t index) noexcept
+		{
+			s.m_slots[index].m_entry.destruct();
+
+			// Shift back any entries after it in the same probe sequence, so
+			// that lookups don't need tombstones to find them.
+			std::size_t hole = index;
+			for (std::size_t i = (index + 1) & s.m_mask; s.m_slots[i].m_hash != 0; i = (i + 1) & s.m_mask)
+			{
+				// The entry can move back to the hole unless its home is
+				// (cyclically) after the hole.
+				const std::size_t home = home_index(s, s.m_slots[i].m_hash);
+				const bool homeAfterHole = hole <= i ?
+					(hole < home && home <= i) :
+					(hole < home || home <= i);
+				if (!homeAfterHole)
+				{
+					slot& from = s.m_slots[i];
+					slot& to = s.m_slots[hole];
+					to.m_entry.construct(std::move(*from.m_entry));
+					to.m_hash = from.m_hash;
+					from.m_entry.destruct();
+					hole = i;
+				}
+			}
+
+			s.m_slots[hole].m_hash = 0;
+			s.m_count.store(s.m_count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+		}
+
+		bool insert_impl(const KEY& key, VALUE&& value, bool assign)
+		{
+			const std::size_t hash = hash_of(key);
+			stripe& s = stripe_for(hash);
+
+			wait_operation* waiters;
+			{
+				std::scoped_lock lock{ s.m_mutex };
+				if (slot* existing = find_slot(s, hash, key); existing != nullptr)
+				{
+					// Nobody waits for a key that's in the map.
+					if (assign)
+					{
+						existing->m_entry->second = std::move(value);
+					}
+					return false;
+				}
+
+				waiters = take_waiters(s, hash, key);
+				if (waiters == nullptr)
+				{
+					emplace(s, hash, key, std::move(value));
+					return true;
+				}
+
+				try
+				{
+					emplace(s, hash, key, value);
+				}
+				catch (...)
+				{
+					restore_waiters(s, waiters);
+					throw;
+				}
+			}
+
+			resume_waiters(waiters, value);
+			return true;
+		}
+
+		// Unlink the waiters for a key, in the order they started waiting.
+		wait_operation* take_waiters(stripe& s, std::size_t hash, const KEY& key) const
+		{
+			if (s.m_waiterCount == 0)
+			{
+				return nullptr;
+			}
+
+			wait_operation* taken = nullptr;
+			wait_operation** link = &s.waiter_bucket(hash);
+			while (*link != nullptr)
+			{
+				wait_operation* waiter = *link;
+				if (waiter->m_hash == hash && m_equal(waiter->m_key, key))
+				{
+					*link = waiter->m_next;
+					waiter->m_next = taken;
+					taken = waiter;
+					--s.m_waiterCount;
+				}
+				else
+				{
+					link = &waiter->m_next;
+				}
+			}
+
+			// Waiters are pushed onto the front of the list, so taking them
+			// off it restored the order they started waiting in.
+			return taken;
+		}
+
+		static void restore_waiters(stripe& s, wait_operation* waiters) noexcept
+		{
+			while (waiters != nullptr)
+			{
+				wait_operation* next = waiters->m_next;
+				push_waiter(s, *waiters);
+				waiters = next;
+			}
+		}
+
+		static void push_waiter(stripe& s, wait_operation& waiter) noexcept
+		{
+			wait_operation*& bucket = s.waiter_bucket(waiter.m_hash);
+			waiter.m_next = bucket;
+			bucket = &waiter;
+			++s.m_waiterCount;
+		}
+
+		static void grow_waiters(stripe& s)
+		{
+			const std::size_t oldCount = s.waiter_bucket_count();
+			const std::size_t newCount = oldCount == 0 ? min_waiter_buckets : oldCount * 2;
+
+			std::unique_ptr<wait_operation*[]> oldBuckets =
+				std::exchange(s.m_waiterBuckets, std::make_unique<wait_operation*[]>(newCount));
+			s.m_waiterMask = newCount - 1;
+			s.m_waiterCount = 0;
+
+			for (std::size_t i = 0; i < oldCount; ++i)
+			{
+				// Each new bucket only takes waiters from one old bucket, so
+				// pushing them oldest first keeps the waiters for each key in
+				// the order they started waiting.
+				wait_operation* oldestFirst = nullptr;
+				for (wait_operation* waiter = oldBuckets[i]; waiter != nullptr;)
+				{
+					wait_operation* next = waiter->m_next;
+					waiter->m_next = oldestFirst;
+					oldestFirst = waiter;
+					waiter = next;
+				}
+
+				restore_waiters(s, oldestFirst);
+			}
+		}
+
+		static void resume_waiters(wait_operation* waiters, const VALUE& value) noexcept
+		{
+			while (waiters != nullptr)
+			{
+				// Read before resuming, which may destroy the operation.
+				wait_operation* next = waiters->m_next;
+				waiters->set_value(value);
+				waiters->m_awaitingCoroutine.resume();
+				waiters = next;
+			}
+		}
+
+		// Returns false if the key is already in the map, having copied its
+		// value into the operation.
+		bool try_add_waiter(wait_operation& waiter)
+		{
+			stripe& s = stripe_for(waiter.m_hash);
+			std::scoped_lock lock{ s.m_mutex };
+			if (slot* existing = find_slot(s, waiter.m_hash, waiter.m_key); existing != nullptr)
+			{
+				waiter.set_value(existing->m_entry->second);
+				return false;
+			}
+
+			if (s.m_waiterCount >= s.waiter_bucket_count())
+			{
+				grow_waiters(s);
+			}
+
+			push_waiter(s, waiter);
+			return true;
+		}
+
+		HASH m_hash;
+		EQUAL m_equal;
+		const std::size_t m_stripeShift;
+		const std::unique_ptr<stripe[]> m_stripes;
+
+	};
+
+	template<typename KEY, typename VALUE, typename HASH, typename EQUAL>
+	class async_concurrent_map_wait_operation
+	{
+	public:
+
+		async_concurrent_map_wait_operation(
+			async_concurrent_map<KEY, VALUE, HASH, EQUAL>& map,
+			const KEY& key) noexcept
+			: m_map(map)
+			, m_key(key)
+			, m_hash(0)
+			, m_next(nullptr)
+			, m_hasValue(false)
+		{}
+
+		~async_concurrent_map_wait_operation()
+		{
+			if (m_hasValue)
+			{
+				m_value.destruct();
+			}
+		}
+
+		async_concurrent_map_wait_operation(const async_concurrent_map_wait_operation&) = delete;
+		async_concurrent_map_wait_operation& operator=(const async_concurrent_map_wait_operation&) = delete;
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		bool await_suspend(std::coroutine_handle<> awaitingCoroutine)
+		{
+			m_awaitingCoroutine = awaitingCoroutine;
+			m_hash = m_map.hash_of(m_key);
+			return m_map.try_add_waiter(*this);
+		}
+
+		VALUE await_resume()
+		{
+			if (m_exception)
+			{
+				std::rethrow_exception(m_exception);
+			}
+			return std::move(*m_value);
+		}
+
+	private:
+
+		friend class async_concurrent_map<KEY, VALUE, HASH, EQUAL>;
+
+		void set_value(const VALUE& value) noexcept
+		{
+			try
+			{
+				m_value.construct(value);
+				m_hasValue = true;
+			}
+			catch (...)
+			{
+				m_exception = std::current_exception();
+			}
+		}
+
+		async_concurrent_map<KEY, VALUE, HASH, EQUAL>& m_map;
+		const KEY& m_key;
+		std::size_t m_hash;
+		async_concurrent_map_wait_operation* m_next;
+		std::coroutine_handle<> m_awaitingCoroutine;
+		detail::manual_lifetime<VALUE> m_value;
+		bool m_hasValue;
+		std::exception_ptr m_exception;
+
+	};
+}
+
+#endif
@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_ASYNC_CONDITION_VARIABLE_HPP_INCLUDED
+#define CPPCORO_ASYNC_CONDITION_VARIABLE_HPP_INCLUDED
+
+#include <cppcoro/async_mutex.hpp>
+#include <cppcoro/task.hpp>
+
+#include <coroutine>
+
+namespace cppcoro
+{
+	class async_condition_variable_wait_operation;
+
+	/// \brief
+	/// A condition variable for coroutines that hold a lock on an async_mutex.
+	///
+	/// Waiting releases the mutex and suspends the coroutine until another
+	/// coroutine calls notify_one() or notify_all(). The waiting coroutine is
+	/// resumed with the mutex locked again.
+	///
+	/// Notifying doesn't resume the waiting coroutines. Instead they are
+	/// moved straight onto the front of the mutex's queue of coroutines
+	/// waiting to acquire the lock (wait morphing), using the same intrusive
+	/// async_mutex_lock_operation list, so that each is resumed in turn by
+	/// unlock() already holding the lock rather than being woken only to
+	/// queue for the mutex again.
+	///
+	/// For this to be safe, notify_one() and notify_all() must be called
+	/// while holding the lock on the mutex that the waiters are waiting with,
+	/// and all waiters that are waiting at the same time must use the same
+	/// mutex. Neither operation needs any atomic operations as the waiter
+	/// list is protected by that mutex.
+	class async_condition_variable
+	{
+	public:
+
+		async_condition_variable() noexcept;
+
+		/// Destroys the condition variable.
+		///
+		/// Behaviour is undefined if there are any coroutines still waiting.
+		~async_condition_variable();
+
+		async_condition_variable(const async_condition_variable&) = delete;
+		async_condition_variable& operator=(const async_condition_variable&) = delete;
+
+		/// \brief
+		/// Release the lock and wait until notified.
+		///
+		/// The awaiting coroutine must hold the lock. It is resumed holding
+		/// the lock again, inside the call to unlock() of the coroutine that
+		/// held the lock after it was notified.
+		///
+		/// As with std::condition_variable, the condition being waited for
+		/// may no longer hold by the time the waiter is resumed, eg. if several
+		/// waiters were notified at once, so it should be checked in a loop.
+		///
+		/// \return
+		/// An operation object that must be 'co_await'ed. The result of the
+		/// 'co_await cv.wait(lock)' expression has type 'void'.
+		async_condition_variable_wait_operation wait(async_mutex_lock& lock) noexcept;
+
+		/// \brief
+		/// Release the lock acquired by mutex.lock_async() and wait until notified.
+		async_condition_variable_wait_operation wait(async_mutex& mutex) noexcept;
+
+		/// \brief
+		/// Wait until \p predicate returns true.
+		///
+		/// Equivalent to 'while (!predicate()) co_await cv.wait(lock);'. The
+		/// predicate is only ever called while the lock is held.
+		template<typename PREDICATE>
+		[[nodiscard]]
+		task<> wait(async_mutex_lock& lock, PREDICATE predicate)
+		{
+			while (!predicate())
+			{
+				co_await wait(lock);
+			}
+		}
+
+		/// \brief
+		/// Wait until \p predicate returns true, releasing the lock acquired
+		/// by mutex.lock_async() while suspended.
+		template<typename PREDICATE>
+		[[nodiscard]]
+		task<> wait(async_mutex& mutex, PREDICATE predicate)
+		{
+			while (!predicate())
+			{
+				co_await wait(mutex);
+			}
+		}
+
+		/// \brief
+		/// Transfer the longest waiting coroutine, if any, to the mutex.
+		///
+		/// Must be called while holding the lock on the mutex. The waiter
+		/// will acquire the lock next, once the caller releases it.
+		void notify_one() noexcept;
+
+		/// \brief
+		/// Transfer all of the waiting coroutines to the mutex.
+		///
+		/// Must be called while holding the lock on the mutex. The waiters
+		/// will acquire the lock one after the other, in the order that they
+		/// started waiting, before any coroutine that is already waiting in
+		/// lock_async().
+		void notify_all() noexcept;
+
+	private:
+
+		friend class async_condition_variable_wait_operation;
+
+		void enqueue(
+			async_mutex_lock_operation* operation,
+			std::coroutine_handle<> awaiter) noexcept;
+
+		// FIFO list of waiting operations, linked through
+		// async_mutex_lock_operation::m_next. Only accessed while holding
+		// the lock on the mutex.
+		async_mutex_lock_operation* m_waitersHead;
+		async_mutex_lock_operation* m_waitersTail;
+
+	};
+
+	class async_condition_variable_wait_operation : public async_mutex_lock_operation
+	{
+	public:
+
+		async_condition_variable_wait_operation(
+			async_condition_variable& conditionVariable,
+			async_mutex& mutex) noexcept
+			: async_mutex_lock_operation(mutex)
+			, m_conditionVariable(conditionVariable)
+		{}
+
+		bool await_suspend(std::coroutine_handle<> awaiter) noexcept;
+
+	private:
+
+		async_condition_variable& m_conditionVariable;
+
+	};
+}
+
+#endif
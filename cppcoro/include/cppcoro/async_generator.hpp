@@ -8,6 +8,8 @@
 #include <cppcoro/config.hpp>
 #include <cppcoro/fmap.hpp>
 
+#include <cppcoro/detail/allocator_aware_promise.hpp>
+
 #include <exception>
 #include <atomic>
 #include <iterator>
@@ -30,7 +32,7 @@ namespace cppcoro
 		class async_generator_yield_operation;
 		class async_generator_advance_operation;
 
-		class async_generator_promise_base
+		class async_generator_promise_base : public allocator_aware_promise
 		{
 		public:
 
@@ -435,7 +437,7 @@ namespace cppcoro
 		class async_generator_yield_operation;
 		class async_generator_advance_operation;
 
-		class async_generator_promise_base
+		class async_generator_promise_base : public allocator_aware_promise
 		{
 		public:
 
@@ -15,6 +15,7 @@ namespace cppcoro
 	class async_mutex_lock;
 	class async_mutex_lock_operation;
 	class async_mutex_scoped_lock_operation;
+	class async_condition_variable;
 
 	/// \brief
 	/// A mutex that can be locked asynchronously using 'co_await'.
@@ -92,6 +93,7 @@ namespace cppcoro
 	private:
 
 		friend class async_mutex_lock_operation;
+		friend class async_condition_variable;
 
 		static constexpr std::uintptr_t not_locked = 1;
 
@@ -153,6 +155,8 @@ namespace cppcoro
 
 	private:
 
+		friend class async_condition_variable;
+
 		async_mutex* m_mutex;
 
 	};
@@ -172,6 +176,7 @@ namespace cppcoro
 	protected:
 
 		friend class async_mutex;
+		friend class async_condition_variable;
 
 		async_mutex& m_mutex;
 
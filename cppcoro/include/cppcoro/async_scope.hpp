@@ -6,6 +6,7 @@
 #define CPPCORO_ASYNC_SCOPE_HPP_INCLUDED
 
 #include <cppcoro/on_scope_exit.hpp>
+#include <cppcoro/detail/recycling_frame_allocator.hpp>
 
 #include <atomic>
 #include <coroutine>
@@ -85,8 +86,18 @@ namespace cppcoro
 		{
 			struct promise_type
 			{
-				std::suspend_never initial_suspend() { return {}; }
-				std::suspend_never final_suspend() { return {}; }
+				static void* operator new(std::size_t size)
+				{
+					return detail::recycling_frame_allocator::allocate(size);
+				}
+
+				static void operator delete(void* frame, std::size_t size) noexcept
+				{
+					detail::recycling_frame_allocator::deallocate(frame, size);
+				}
+
+				std::suspend_never initial_suspend() noexcept { return {}; }
+				std::suspend_never final_suspend() noexcept { return {}; }
 				void unhandled_exception() { std::terminate(); }
 				oneway_task get_return_object() { return {}; }
 				void return_void() {}
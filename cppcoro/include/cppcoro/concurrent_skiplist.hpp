@@ -0,0 +1,393 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_CONCURRENT_SKIPLIST_HPP_INCLUDED
+#define CPPCORO_CONCURRENT_SKIPLIST_HPP_INCLUDED
+
+#include <cppcoro/config.hpp>
+#include <cppcoro/async_generator.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <new>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace cppcoro
+{
+	/// \brief
+	/// An ordered map that any number of threads can insert into and scan
+	/// at the same time, without locks.
+	///
+	/// Entries are kept in a skiplist whose links are only ever added, with
+	/// compare-and-swap. Entries can't be erased or modified once inserted,
+	/// and are freed when the skiplist is destroyed, so a reader never has
+	/// to worry about an entry being freed under it.
+	///
+	/// scan() returns an async_generator that yields the entries in a range
+	/// in batches, so a consumer can suspend between batches (to write them
+	/// out, say) without holding anything that blocks writers. Each scan
+	/// sees a snapshot of the skiplist taken when scan() was called: every
+	/// entry inserted before then and none inserted after, however long the
+	/// scan takes.
+	template<
+		typename KEY,
+		typename VALUE,
+		typename COMPARE = std::less<KEY>>
+	class concurrent_skiplist
+	{
+	public:
+
+		using key_type = KEY;
+		using mapped_type = VALUE;
+		using value_type = std::pair<const KEY, VALUE>;
+
+		/// The number of entries scan() yields at a time by default.
+		static constexpr std::size_t default_batch_size = 64;
+
+		explicit concurrent_skiplist(const COMPARE& compare = COMPARE{})
+			: m_compare(compare)
+			, m_head{}
+			, m_levels(1)
+			, m_size(0)
+			, m_clock(0)
+		{}
+
+		/// No scans may still be in progress.
+		~concurrent_skiplist()
+		{
+			node* n = m_head[0].load(std::memory_order_relaxed);
+			while (n != nullptr)
+			{
+				node* next = n->next()[0].load(std::memory_order_relaxed);
+				destroy_node(n);
+				n = next;
+			}
+		}
+
+		concurrent_skiplist(const concurrent_skiplist&) = delete;
+		concurrent_skiplist& operator=(const concurrent_skiplist&) = delete;
+
+		/// Insert \p value for \p key if the key isn't already in the
+		/// skiplist.
+		///
+		/// \return
+		/// true if the entry was inserted, false if the key was already in
+		/// the skiplist.
+		bool insert(KEY key, VALUE value)
+		{
+			node* preds[max_level];
+			node* succs[max_level];
+
+			if (node* existing = find_position(key, preds, succs); existing != nullptr)
+			{
+				stamp(*existing);
+				return false;
+			}
+
+			const std::uint32_t height = random_height();
+			node* newNode = create_node(height, std::move(key), std::move(value));
+			const KEY& newKey = newNode->m_value.first;
+
+			raise_levels(height);
+
+			// Linking the node at the bottom level inserts it. The levels
+			// above are only there to speed up searches.
+			while (true)
+			{
+				for (std::uint32_t level = 0; level < height; ++level)
+				{
+					newNode->next()[level].store(succs[level], std::memory_order_relaxed);
+				}
+
+				node* expected = succs[0];
+				if (link_at(preds[0], 0).compare_exchange_strong(
+					expected, newNode, std::memory_order_release, std::memory_order_relaxed))
+				{
+					break;
+				}
+
+				// Another thread linked something in the way. If it was the
+				// same key then that thread won.
+				if (node* existing = find_position(newKey, preds, succs); existing != nullptr)
+				{
+					destroy_node(newNode);
+					stamp(*existing);
+					return false;
+				}
+			}
+
+			m_size.fetch_add(1, std::memory_order_relaxed);
+			stamp(*newNode);
+
+			for (std::uint32_t level = 1; level < height; ++level)
+			{
+				while (true)
+				{
+					node* expected = succs[level];
+					if (link_at(preds[level], level).compare_exchange_strong(
+						expected, newNode, std::memory_order_release, std::memory_order_relaxed))
+					{
+						break;
+					}
+
+					// Not yet linked at this level, so nobody else reads this
+					// node's link at this level.
+					find_position(newKey, preds, succs);
+					newNode->next()[level].store(succs[level], std::memory_order_relaxed);
+				}
+			}
+
+			return true;
+		}
+
+		/// Look up the value for \p key.
+		///
+		/// \return
+		/// A pointer to the value, which stays valid for as long as the
+		/// skiplist does, or nullptr if the key isn't in the skiplist.
+		const VALUE* find(const KEY& key) const
+		{
+			node* preds[max_level];
+			node* succs[max_level];
+			if (node* existing = find_position(key, preds, succs); existing != nullptr)
+			{
+				// Once found, later scans must include it.
+				stamp(*existing);
+				return &existing->m_value.second;
+			}
+			return nullptr;
+		}
+
+		bool contains(const KEY& key) const
+		{
+			return find(key) != nullptr;
+		}
+
+		/// The number of entries. Only a snapshot if other threads are
+		/// inserting.
+		std::size_t size() const noexcept
+		{
+			return m_size.load(std::memory_order_relaxed);
+		}
+
+		/// \brief
+		/// Scan the entries with keys in [\p from, \p to), in order.
+		///
+		/// The returned generator yields spans of up to \p batchSize copies
+		/// of the entries. A span is only valid until the generator is next
+		/// advanced.
+		///
+		/// The scan sees the skiplist as it was when scan() was called,
+		/// even though the entries are read as the generator is advanced.
+		/// Inserts made since then are skipped.
+		async_generator<std::span<const value_type>> scan(
+			KEY from, KEY to, std::size_t batchSize = default_batch_size) const
+		{
+			return scan_snapshot(
+				std::move(from),
+				std::move(to),
+				std::max<std::size_t>(batchSize, 1),
+				m_clock.fetch_add(1, std::memory_order_seq_cst));
+		}
+
+	private:
+
+		static constexpr std::uint32_t max_level = 16;
+
+		// The version of an entry that hasn't been stamped yet.
+		static constexpr std::uint64_t unstamped = std::numeric_limits<std::uint64_t>::max();
+
+		// A node is allocated with an array of its height's worth of links
+		// straight after it.
+		struct node
+		{
+			template<typename K, typename V>
+			node(std::uint32_t height, K&& key, V&& value)
+				: m_value(static_cast<K&&>(key), static_cast<V&&>(value))
+				, m_version(unstamped)
+			{
+				for (std::uint32_t level = 0; level < height; ++level)
+				{
+					::new (static_cast<void*>(next() + level)) std::atomic<node*>(nullptr);
+				}
+			}
+
+			std::atomic<node*>* next() noexcept
+			{
+				return reinterpret_cast<std::atomic<node*>*>(this + 1);
+			}
+
+			value_type m_value;
+
+			// The clock value that decides which scans see this entry.
+			std::atomic<std::uint64_t> m_version;
+		};
+
+		static_assert(alignof(node) >= alignof(std::atomic<node*>));
+
+		template<typename K, typename V>
+		static node* create_node(std::uint32_t height, K&& key, V&& value)
+		{
+			void* memory = ::operator new(sizeof(node) + height * sizeof(std::atomic<node*>));
+			try
+			{
+				return ::new (memory) node(height, static_cast<K&&>(key), static_cast<V&&>(value));
+			}
+			catch (...)
+			{
+				::operator delete(memory);
+				throw;
+			}
+		}
+
+		static void destroy_node(node* n) noexcept
+		{
+			n->~node();
+			::operator delete(static_cast<void*>(n));
+		}
+
+		static std::uint32_t random_height() noexcept
+		{
+			// Each level holds about a quarter of the nodes of the level
+			// below it.
+			thread_local std::uint64_t state =
+				reinterpret_cast<std::uintptr_t>(&state) * 0x9E3779B97F4A7C15ULL | 1;
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			const auto height = 1 + static_cast<std::uint32_t>(std::countr_zero(state)) / 2;
+			return std::min(height, max_level);
+		}
+
+		void raise_levels(std::uint32_t height) noexcept
+		{
+			std::uint32_t levels = m_levels.load(std::memory_order_relaxed);
+			while (levels < height &&
+				!m_levels.compare_exchange_weak(levels, height, std::memory_order_relaxed))
+			{
+			}
+		}
+
+		std::atomic<node*>& link_at(node* pred, std::uint32_t level) const noexcept
+		{
+			return pred == nullptr ? m_head[level] : pred->next()[level];
+		}
+
+		// Fill in the nodes either side of where \p key goes at each level,
+		// with nullptr for the head or the end. Returns the node with
+		// \p key if there is one.
+		node* find_position(const KEY& key, node** preds, node** succs) const
+		{
+			// Searching from too low a level, if another thread has just
+			// raised it, is only slower.
+			const std::uint32_t levels = m_levels.load(std::memory_order_relaxed);
+			for (std::uint32_t level = levels; level < max_level; ++level)
+			{
+				preds[level] = nullptr;
+				succs[level] = nullptr;
+			}
+
+			node* pred = nullptr;
+			for (std::uint32_t level = levels; level-- > 0;)
+			{
+				node* succ = link_at(pred, level).load(std::memory_order_acquire);
+				while (succ != nullptr && m_compare(succ->m_value.first, key))
+				{
+					pred = succ;
+					succ = succ->next()[level].load(std::memory_order_acquire);
+				}
+				preds[level] = pred;
+				succs[level] = succ;
+			}
+
+			node* candidate = succs[0];
+			return candidate != nullptr && !m_compare(key, candidate->m_value.first) ?
+				candidate : nullptr;
+		}
+
+		// The first node with a key not less than \p key.
+		node* lower_bound(const KEY& key) const
+		{
+			node* pred = nullptr;
+			node* succ = nullptr;
+			for (std::uint32_t level = m_levels.load(std::memory_order_relaxed); level-- > 0;)
+			{
+				succ = link_at(pred, level).load(std::memory_order_acquire);
+				while (succ != nullptr && m_compare(succ->m_value.first, key))
+				{
+					pred = succ;
+					succ = succ->next()[level].load(std::memory_order_acquire);
+				}
+			}
+			return succ;
+		}
+
+		// Decide the version of an entry, which is the clock value when it
+		// was first seen after being linked in. Scans taken at or after
+		// that value see it, earlier ones don't.
+		std::uint64_t stamp(node& n) const noexcept
+		{
+			std::uint64_t version = n.m_version.load(std::memory_order_acquire);
+			if (version == unstamped)
+			{
+				const std::uint64_t now = m_clock.load(std::memory_order_seq_cst);
+				if (n.m_version.compare_exchange_strong(
+					version, now, std::memory_order_acq_rel, std::memory_order_acquire))
+				{
+					version = now;
+				}
+			}
+			return version;
+		}
+
+		async_generator<std::span<const value_type>> scan_snapshot(
+			KEY from, KEY to, std::size_t batchSize, std::uint64_t snapshot) const
+		{
+			std::vector<value_type> batch;
+			batch.reserve(batchSize);
+
+			// Nodes are never freed, so it's safe to hold on to one while
+			// suspended.
+			for (node* n = lower_bound(from);
+				n != nullptr && m_compare(n->m_value.first, to);
+				n = n->next()[0].load(std::memory_order_acquire))
+			{
+				if (stamp(*n) > snapshot)
+				{
+					continue;
+				}
+
+				batch.push_back(n->m_value);
+				if (batch.size() == batchSize)
+				{
+					co_yield std::span<const value_type>{ batch };
+					batch.clear();
+				}
+			}
+
+			if (!batch.empty())
+			{
+				co_yield std::span<const value_type>{ batch };
+			}
+		}
+
+		COMPARE m_compare;
+		mutable std::atomic<node*> m_head[max_level];
+		std::atomic<std::uint32_t> m_levels;
+		std::atomic<std::size_t> m_size;
+
+		// Advanced by each scan, to take its snapshot.
+		mutable std::atomic<std::uint64_t> m_clock;
+
+	};
+}
+
+#endif
@@ -43,6 +43,21 @@
 # define CPPCORO_COMPILER_SUPPORTS_SYMMETRIC_TRANSFER 0
 #endif
 
+/// \def CPPCORO_USE_FRAMELESS_CONTINUATIONS
+/// Define to 1 before including cppcoro to let a coroutine_handle<> refer
+/// to a plain object that starts with a resume and a destroy function
+/// pointer, so that a library type can be resumed as if it were a coroutine
+/// without allocating a frame. This relies on how Clang and GCC happen to
+/// lay out the start of a coroutine frame, which is not part of their
+/// documented ABI, so it is off by default and ignored on other compilers.
+#ifndef CPPCORO_USE_FRAMELESS_CONTINUATIONS
+# define CPPCORO_USE_FRAMELESS_CONTINUATIONS 0
+#endif
+#if CPPCORO_USE_FRAMELESS_CONTINUATIONS && !(CPPCORO_COMPILER_CLANG || CPPCORO_COMPILER_GCC)
+# undef CPPCORO_USE_FRAMELESS_CONTINUATIONS
+# define CPPCORO_USE_FRAMELESS_CONTINUATIONS 0
+#endif
+
 #if CPPCORO_COMPILER_MSVC
 # define CPPCORO_ASSUME(X) __assume(X)
 #else
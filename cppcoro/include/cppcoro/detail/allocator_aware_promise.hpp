@@ -0,0 +1,193 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_DETAIL_ALLOCATOR_AWARE_PROMISE_HPP_INCLUDED
+#define CPPCORO_DETAIL_ALLOCATOR_AWARE_PROMISE_HPP_INCLUDED
+
+#include <cppcoro/config.hpp>
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace cppcoro
+{
+	namespace detail
+	{
+		/// \brief
+		/// Base class for promises whose coroutines can choose the allocator
+		/// their frame comes from.
+		///
+		/// A coroutine uses an allocator by taking \c std::allocator_arg
+		/// followed by the allocator as its first parameters (after the object
+		/// parameter, if it is a member function or lambda). Otherwise its
+		/// frame comes from the global heap.
+		///
+		/// The frame is freed by a function whose address is stored just past
+		/// the end of the frame, followed by a copy of the allocator, unless
+		/// the allocator is stateless.
+		class allocator_aware_promise
+		{
+		public:
+
+			// The allocation and deallocation functions GCC can see are kept
+			// out of line and aren't templates, otherwise it reports frames
+			// as freed by a function that doesn't match the one that
+			// allocated them (-Wmismatched-new-delete). The templated
+			// overloads are inlined into their caller and forward to
+			// allocate_with(), which GCC doesn't treat as an allocation
+			// function.
+
+			CPPCORO_NOINLINE
+			static void* operator new(std::size_t size)
+			{
+				void* frame = ::operator new(deallocator_offset(size) + sizeof(deallocator_t));
+				store_deallocator(frame, size, nullptr);
+				return frame;
+			}
+
+			template<typename ALLOCATOR, typename... ARGS>
+			CPPCORO_FORCE_INLINE
+			static void* operator new(
+				std::size_t size, std::allocator_arg_t, ALLOCATOR& allocator, ARGS&...)
+			{
+				return allocate_with(size, allocator);
+			}
+
+			template<typename CLASS, typename ALLOCATOR, typename... ARGS>
+			CPPCORO_FORCE_INLINE
+			static void* operator new(
+				std::size_t size, CLASS&, std::allocator_arg_t, ALLOCATOR& allocator, ARGS&...)
+			{
+				return allocate_with(size, allocator);
+			}
+
+			CPPCORO_NOINLINE
+			static void operator delete(void* frame, std::size_t size) noexcept
+			{
+				deallocator_t deallocator;
+				std::memcpy(
+					&deallocator,
+					static_cast<std::byte*>(frame) + deallocator_offset(size),
+					sizeof(deallocator));
+
+				if (deallocator == nullptr)
+				{
+					::operator delete(frame, deallocator_offset(size) + sizeof(deallocator_t));
+				}
+				else
+				{
+					deallocator(frame, size);
+				}
+			}
+
+		private:
+
+			using deallocator_t = void(*)(void* frame, std::size_t size) noexcept;
+
+			// Frames are allocated in units of this, so that they're as aligned
+			// as they would be if they came from the global heap.
+			struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) frame_block
+			{
+				std::byte m_bytes[__STDCPP_DEFAULT_NEW_ALIGNMENT__];
+			};
+
+			template<typename ALLOCATOR>
+			using block_allocator_t =
+				typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<frame_block>;
+
+			// Stateless allocators aren't stored, just default-constructed again
+			// to free the frame.
+			template<typename BLOCK_ALLOCATOR>
+			static constexpr bool is_stateless_v =
+				std::allocator_traits<BLOCK_ALLOCATOR>::is_always_equal::value &&
+				std::is_default_constructible_v<BLOCK_ALLOCATOR>;
+
+			static constexpr std::size_t align_up(std::size_t size, std::size_t alignment) noexcept
+			{
+				return (size + alignment - 1) & ~(alignment - 1);
+			}
+
+			static constexpr std::size_t deallocator_offset(std::size_t size) noexcept
+			{
+				return align_up(size, alignof(deallocator_t));
+			}
+
+			template<typename BLOCK_ALLOCATOR>
+			static constexpr std::size_t allocator_offset(std::size_t size) noexcept
+			{
+				return align_up(deallocator_offset(size) + sizeof(deallocator_t), alignof(BLOCK_ALLOCATOR));
+			}
+
+			template<typename BLOCK_ALLOCATOR>
+			static constexpr std::size_t block_count(std::size_t size) noexcept
+			{
+				const std::size_t allocationSize = is_stateless_v<BLOCK_ALLOCATOR> ?
+					deallocator_offset(size) + sizeof(deallocator_t) :
+					allocator_offset<BLOCK_ALLOCATOR>(size) + sizeof(BLOCK_ALLOCATOR);
+				return (allocationSize + sizeof(frame_block) - 1) / sizeof(frame_block);
+			}
+
+			static void store_deallocator(void* frame, std::size_t size, deallocator_t deallocator) noexcept
+			{
+				std::memcpy(
+					static_cast<std::byte*>(frame) + deallocator_offset(size),
+					&deallocator,
+					sizeof(deallocator));
+			}
+
+			template<typename ALLOCATOR>
+			CPPCORO_NOINLINE
+			static void* allocate_with(std::size_t size, const ALLOCATOR& allocator)
+			{
+				using block_allocator = block_allocator_t<ALLOCATOR>;
+				using traits = std::allocator_traits<block_allocator>;
+
+				static_assert(
+					alignof(block_allocator) <= alignof(frame_block),
+					"over-aligned allocators are not supported");
+
+				block_allocator blockAllocator(allocator);
+				void* frame = std::to_address(traits::allocate(blockAllocator, block_count<block_allocator>(size)));
+
+				store_deallocator(frame, size, &deallocate_with<block_allocator>);
+				if constexpr (!is_stateless_v<block_allocator>)
+				{
+					::new (static_cast<std::byte*>(frame) + allocator_offset<block_allocator>(size))
+						block_allocator(std::move(blockAllocator));
+				}
+
+				return frame;
+			}
+
+			template<typename BLOCK_ALLOCATOR>
+			static void deallocate_with(void* frame, std::size_t size) noexcept
+			{
+				using traits = std::allocator_traits<BLOCK_ALLOCATOR>;
+
+				auto* blocks = static_cast<frame_block*>(frame);
+				if constexpr (is_stateless_v<BLOCK_ALLOCATOR>)
+				{
+					BLOCK_ALLOCATOR blockAllocator;
+					traits::deallocate(blockAllocator, blocks, block_count<BLOCK_ALLOCATOR>(size));
+				}
+				else
+				{
+					// Move the allocator out of the memory it's about to free.
+					auto* stored = std::launder(reinterpret_cast<BLOCK_ALLOCATOR*>(
+						static_cast<std::byte*>(frame) + allocator_offset<BLOCK_ALLOCATOR>(size)));
+					BLOCK_ALLOCATOR blockAllocator(std::move(*stored));
+					stored->~BLOCK_ALLOCATOR();
+					traits::deallocate(blockAllocator, blocks, block_count<BLOCK_ALLOCATOR>(size));
+				}
+			}
+
+		};
+	}
+}
+
+#endif
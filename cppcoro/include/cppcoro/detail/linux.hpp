@@ -0,0 +1,341 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_DETAIL_LINUX_HPP_INCLUDED
+#define CPPCORO_DETAIL_LINUX_HPP_INCLUDED
+
+#include <cppcoro/config.hpp>
+
+#if !CPPCORO_OS_LINUX
+# error <cppcoro/detail/linux.hpp> is only supported on the Linux platform.
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace cppcoro
+{
+	namespace detail
+	{
+		// NOTE: Can't call this namespace 'linux' as that name is a
+		// predefined macro when compiling with GNU extensions enabled.
+		namespace lnx
+		{
+			using fd_t = int;
+
+			/// An operation that is waiting for an event to be dispatched
+			/// by an io_service event loop.
+			///
+			/// This is the Linux equivalent of win32::io_state. Instances are
+			/// queued to an io_service either when the file descriptor they are
+			/// waiting on becomes ready or when the wait is aborted.
+			struct io_state
+			{
+				/// \param state
+				/// The io_state that was dispatched.
+				///
+				/// \param errorCode
+				/// Zero if the file descriptor became ready and the operation
+				/// should be retried, otherwise the errno value that the
+				/// operation should complete with (eg. ECANCELED).
+				using callback_type = void(io_state* state, int errorCode);
+
+				io_state(callback_type* callback = nullptr) noexcept
+					: m_callback(callback)
+					, m_next(nullptr)
+					, m_pendingErrorCode(0)
+				{}
+
+				callback_type* m_callback;
+
+				// Used by the io_service to queue the io_state for dispatch.
+				io_state* m_next;
+				int m_pendingErrorCode;
+			};
+
+			/// Tracks readiness of one direction (receive or send) of a
+			/// non-blocking file descriptor that is registered with an
+			/// io_service in edge-triggered mode.
+			///
+			/// Holds at most one operation waiting for that direction to
+			/// become ready. An operation that tries to wait while another
+			/// one is already waiting is refused rather than displacing it.
+			/// Readiness notifications that arrive while no operation is
+			/// waiting are remembered so that an operation that is about to
+			/// wait retries its system call instead of missing the edge.
+			class io_readiness
+			{
+			public:
+
+				enum class park_result
+				{
+					/// The operation is now waiting and will be dispatched
+					/// by the io_service once the descriptor becomes ready.
+					parked,
+
+					/// A readiness notification arrived since the last attempt,
+					/// the operation should retry its system call now.
+					ready,
+
+					/// Cancellation of the operation was requested while it
+					/// was not waiting, it should complete with ECANCELED.
+					cancelled,
+
+					/// Another operation is already waiting for this direction,
+					/// the operation should complete with EBUSY.
+					busy
+				};
+
+				io_readiness() noexcept
+					: m_state(empty)
+				{}
+
+				io_readiness(const io_readiness&) = delete;
+				io_readiness& operator=(const io_readiness&) = delete;
+
+				/// Discard readiness and cancellation state left behind by
+				/// previous operations.
+				///
+				/// Must only be called by a newly started operation before its
+				/// first attempt.
+				///
+				/// \return
+				/// false if another operation is already waiting, which is
+				/// left waiting. The new operation should complete with EBUSY.
+				bool reset() noexcept
+				{
+					std::uintptr_t oldState = m_state.load(std::memory_order_acquire);
+					while (oldState == ready || oldState == cancel_requested)
+					{
+						if (m_state.compare_exchange_weak(
+							oldState,
+							empty,
+							std::memory_order_acq_rel,
+							std::memory_order_acquire))
+						{
+							return true;
+						}
+					}
+
+					return oldState == empty;
+				}
+
+				/// Attempt to register \p waiter as the operation waiting for
+				/// this direction to become ready.
+				park_result park(io_state* waiter) noexcept
+				{
+					std::uintptr_t oldState = empty;
+					if (m_state.compare_exchange_strong(
+						oldState,
+						reinterpret_cast<std::uintptr_t>(waiter),
+						std::memory_order_acq_rel,
+						std::memory_order_acquire))
+					{
+						return park_result::parked;
+					}
+
+					if (oldState == ready)
+					{
+						// If this fails then cancellation was requested concurrently
+						// and the next call to park() will report it.
+						(void)m_state.compare_exchange_strong(
+							oldState,
+							empty,
+							std::memory_order_acquire,
+							std::memory_order_relaxed);
+						return park_result::ready;
+					}
+
+					if (oldState != cancel_requested)
+					{
+						return park_result::busy;
+					}
+
+					m_state.store(empty, std::memory_order_relaxed);
+					return park_result::cancelled;
+				}
+
+				/// Record that this direction has become ready.
+				///
+				/// \return
+				/// The waiting operation, if any, which the caller is now
+				/// responsible for dispatching. Otherwise nullptr.
+				io_state* notify() noexcept
+				{
+					std::uintptr_t oldState = m_state.load(std::memory_order_acquire);
+					while (true)
+					{
+						if (oldState == ready || oldState == cancel_requested)
+						{
+							return nullptr;
+						}
+
+						const std::uintptr_t newState = oldState == empty ? ready : empty;
+						if (m_state.compare_exchange_weak(
+							oldState,
+							newState,
+							std::memory_order_acq_rel,
+							std::memory_order_acquire))
+						{
+							return oldState == empty ? nullptr : reinterpret_cast<io_state*>(oldState);
+						}
+					}
+				}
+
+				/// Request cancellation of \p waiter.
+				///
+				/// \return
+				/// true if \p waiter was waiting and has been removed, in which
+				/// case the caller is responsible for dispatching it. false if
+				/// it was not waiting, in which case it will observe the
+				/// cancellation request the next time it tries to park().
+				bool cancel(io_state* waiter) noexcept
+				{
+					const auto waiterState = reinterpret_cast<std::uintptr_t>(waiter);
+					std::uintptr_t oldState = m_state.load(std::memory_order_acquire);
+					while (true)
+					{
+						if (oldState == cancel_requested)
+						{
+							return false;
+						}
+
+						if (oldState != empty && oldState != ready && oldState != waiterState)
+						{
+							// Some other operation is waiting, so the operation we
+							// were asked to cancel must have already completed.
+							return false;
+						}
+
+						const std::uintptr_t newState =
+							oldState == waiterState ? empty : cancel_requested;
+						if (m_state.compare_exchange_weak(
+							oldState,
+							newState,
+							std::memory_order_acq_rel,
+							std::memory_order_acquire))
+						{
+							return oldState == waiterState;
+						}
+					}
+				}
+
+				/// Return this direction to its initial state, for when the
+				/// descriptor is unregistered.
+				///
+				/// \return
+				/// The operation that was waiting, if any, which the caller is
+				/// now responsible for completing (eg. with ECANCELED).
+				/// Otherwise nullptr.
+				io_state* close() noexcept
+				{
+					const std::uintptr_t oldState =
+						m_state.exchange(empty, std::memory_order_acq_rel);
+					if (oldState == empty || oldState == ready || oldState == cancel_requested)
+					{
+						return nullptr;
+					}
+
+					return reinterpret_cast<io_state*>(oldState);
+				}
+
+			private:
+
+				// Values that can never be the address of an io_state.
+				static constexpr std::uintptr_t empty = 0;
+				static constexpr std::uintptr_t ready = 1;
+				static constexpr std::uintptr_t cancel_requested = 2;
+
+				std::atomic<std::uintptr_t> m_state;
+
+			};
+
+			/// Per-descriptor state registered with an io_service's epoll
+			/// instance.
+			///
+			/// Registrations are owned and recycled by the io_service rather
+			/// than freed when the descriptor is closed, as an event for the
+			/// descriptor may already have been dequeued by another I/O thread.
+			/// Operations still waiting are completed with ECANCELED when the
+			/// descriptor is unregistered, so such stale events only ever
+			/// result in a spurious retry.
+			struct io_registration
+			{
+				io_readiness m_recv;
+				io_readiness m_send;
+				io_registration* m_nextFree = nullptr;
+			};
+
+			class safe_fd
+			{
+			public:
+
+				safe_fd()
+					: m_fd(-1)
+				{}
+
+				explicit safe_fd(fd_t fd)
+					: m_fd(fd)
+				{}
+
+				safe_fd(const safe_fd& other) = delete;
+
+				safe_fd(safe_fd&& other) noexcept
+					: m_fd(other.m_fd)
+				{
+					other.m_fd = -1;
+				}
+
+				~safe_fd()
+				{
+					close();
+				}
+
+				safe_fd& operator=(safe_fd fd) noexcept
+				{
+					swap(fd);
+					return *this;
+				}
+
+				constexpr fd_t fd() const { return m_fd; }
+
+				/// Calls close() and sets the fd to -1.
+				void close() noexcept;
+
+				void swap(safe_fd& other) noexcept
+				{
+					std::swap(m_fd, other.m_fd);
+				}
+
+				bool operator==(const safe_fd& other) const
+				{
+					return m_fd == other.m_fd;
+				}
+
+				bool operator!=(const safe_fd& other) const
+				{
+					return m_fd != other.m_fd;
+				}
+
+				bool operator==(fd_t fd) const
+				{
+					return m_fd == fd;
+				}
+
+				bool operator!=(fd_t fd) const
+				{
+					return m_fd != fd;
+				}
+
+			private:
+
+				fd_t m_fd;
+
+			};
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,368 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_DETAIL_LINUX_ASYNC_OPERATION_HPP_INCLUDED
+#define CPPCORO_DETAIL_LINUX_ASYNC_OPERATION_HPP_INCLUDED
+
+#include <cppcoro/cancellation_registration.hpp>
+#include <cppcoro/cancellation_token.hpp>
+#include <cppcoro/io_service.hpp>
+#include <cppcoro/operation_cancelled.hpp>
+
+#include <cppcoro/detail/linux.hpp>
+
+#include <optional>
+#include <system_error>
+#include <coroutine>
+#include <cassert>
+#include <cerrno>
+
+namespace cppcoro
+{
+	namespace detail
+	{
+		/// Base class for operations on non-blocking file descriptors.
+		///
+		/// Operations are readiness-based: the system call is attempted
+		/// immediately and, if it would block, the operation waits for the
+		/// io_service to report that the descriptor has become ready before
+		/// attempting it again on an I/O thread.
+		class linux_async_operation_base
+			: protected detail::lnx::io_state
+		{
+		public:
+
+			linux_async_operation_base(
+				detail::lnx::io_state::callback_type* callback) noexcept
+				: detail::lnx::io_state(callback)
+				, m_errorCode(0)
+				, m_numberOfBytesTransferred(0)
+				, m_readiness(nullptr)
+			{}
+
+			std::size_t get_result()
+			{
+				if (m_errorCode != 0)
+				{
+					throw std::system_error{
+						m_errorCode,
+						std::system_category()
+					};
+				}
+
+				return m_numberOfBytesTransferred;
+			}
+
+			/// Attempt the operation until it either completes or would block.
+			///
+			/// \param readiness
+			/// The readiness state of the direction of the file descriptor
+			/// that \p attempt waits on.
+			///
+			/// \param attempt
+			/// Callable that performs the non-blocking system call. Returns
+			/// true if the operation completed, with m_errorCode and
+			/// m_numberOfBytesTransferred updated, or false if it would block.
+			///
+			/// \return
+			/// true if the operation is waiting for the file descriptor to
+			/// become ready and will complete asynchronously, false if it
+			/// has completed synchronously.
+			template<typename ATTEMPT>
+			bool try_complete(detail::lnx::io_readiness& readiness, ATTEMPT&& attempt) noexcept
+			{
+				if (m_readiness == nullptr)
+				{
+					// First attempt of this operation.
+					if (!readiness.reset())
+					{
+						// Only one operation per direction may wait at a time.
+						m_errorCode = EBUSY;
+						return false;
+					}
+					m_readiness = &readiness;
+				}
+
+				while (!attempt())
+				{
+					switch (readiness.park(this))
+					{
+					case detail::lnx::io_readiness::park_result::parked:
+						return true;
+					case detail::lnx::io_readiness::park_result::ready:
+						break;
+					case detail::lnx::io_readiness::park_result::cancelled:
+						m_errorCode = ECANCELED;
+						return false;
+					case detail::lnx::io_readiness::park_result::busy:
+						m_errorCode = EBUSY;
+						return false;
+					}
+				}
+
+				return false;
+			}
+
+			/// Request that an operation waiting in try_complete() stop waiting
+			/// and complete with ECANCELED on an I/O thread of \p ioService.
+			void cancel_wait(io_service& ioService) noexcept
+			{
+				if (m_readiness != nullptr && m_readiness->cancel(this))
+				{
+					ioService.post_completion(this, ECANCELED);
+				}
+			}
+
+			int m_errorCode;
+			std::size_t m_numberOfBytesTransferred;
+
+		private:
+
+			detail::lnx::io_readiness* m_readiness;
+
+		};
+
+		template<typename OPERATION>
+		class linux_async_operation
+			: protected linux_async_operation_base
+		{
+		protected:
+
+			linux_async_operation() noexcept
+				: linux_async_operation_base(
+					&linux_async_operation::on_operation_ready)
+			{}
+
+		public:
+
+			bool await_ready() const noexcept { return false; }
+
+			CPPCORO_NOINLINE
+			bool await_suspend(std::coroutine_handle<> awaitingCoroutine)
+			{
+				static_assert(std::is_base_of_v<linux_async_operation, OPERATION>);
+
+				m_awaitingCoroutine = awaitingCoroutine;
+				return static_cast<OPERATION*>(this)->try_start();
+			}
+
+			decltype(auto) await_resume()
+			{
+				return static_cast<OPERATION*>(this)->get_result();
+			}
+
+		private:
+
+			static void on_operation_ready(
+				detail::lnx::io_state* ioState,
+				int errorCode) noexcept
+			{
+				auto* operation = static_cast<linux_async_operation*>(ioState);
+				if (errorCode != 0)
+				{
+					operation->m_errorCode = errorCode;
+				}
+				else if (static_cast<OPERATION*>(operation)->try_start())
+				{
+					// Spurious readiness notification, still waiting.
+					return;
+				}
+
+				operation->m_awaitingCoroutine.resume();
+			}
+
+			std::coroutine_handle<> m_awaitingCoroutine;
+
+		};
+
+		template<typename OPERATION>
+		class linux_async_operation_cancellable
+			: protected linux_async_operation_base
+		{
+		protected:
+
+			linux_async_operation_cancellable(cancellation_token&& ct) noexcept
+				: linux_async_operation_base(&linux_async_operation_cancellable::on_operation_ready)
+				, m_state(ct.is_cancellation_requested() ? state::completed : state::not_started)
+				, m_cancellationToken(std::move(ct))
+			{
+				m_errorCode = ECANCELED;
+			}
+
+			linux_async_operation_cancellable(
+				linux_async_operation_cancellable&& other) noexcept
+				: linux_async_operation_base(std::move(other))
+				, m_state(other.m_state.load(std::memory_order_relaxed))
+				, m_cancellationToken(std::move(other.m_cancellationToken))
+			{
+				assert(m_errorCode == other.m_errorCode);
+				assert(m_numberOfBytesTransferred == other.m_numberOfBytesTransferred);
+			}
+
+		public:
+
+			bool await_ready() const noexcept
+			{
+				return m_state.load(std::memory_order_relaxed) == state::completed;
+			}
+
+			CPPCORO_NOINLINE
+			bool await_suspend(std::coroutine_handle<> awaitingCoroutine)
+			{
+				static_assert(std::is_base_of_v<linux_async_operation_cancellable, OPERATION>);
+
+				m_awaitingCoroutine = awaitingCoroutine;
+				m_errorCode = 0;
+
+				// See win32_overlapped_operation_cancellable::await_suspend() for
+				// why the callback is registered before starting the operation
+				// and the transition to the 'started' state is deferred.
+				const bool canBeCancelled = m_cancellationToken.can_be_cancelled();
+				if (canBeCancelled)
+				{
+					m_cancellationCallback.emplace(
+						std::move(m_cancellationToken),
+						[this] { this->on_cancellation_requested(); });
+				}
+				else
+				{
+					m_state.store(state::started, std::memory_order_relaxed);
+				}
+
+				const bool willCompleteAsynchronously = static_cast<OPERATION*>(this)->try_start();
+				if (!willCompleteAsynchronously)
+				{
+					// Operation completed synchronously, resume awaiting coroutine immediately.
+					return false;
+				}
+
+				if (canBeCancelled)
+				{
+					state oldState = state::not_started;
+					if (!m_state.compare_exchange_strong(
+						oldState,
+						state::started,
+						std::memory_order_release,
+						std::memory_order_acquire))
+					{
+						if (oldState == state::cancellation_requested)
+						{
+							static_cast<OPERATION*>(this)->cancel();
+
+							if (!m_state.compare_exchange_strong(
+								oldState,
+								state::started,
+								std::memory_order_release,
+								std::memory_order_acquire))
+							{
+								assert(oldState == state::completed);
+								return false;
+							}
+						}
+						else
+						{
+							assert(oldState == state::completed);
+							return false;
+						}
+					}
+				}
+
+				return true;
+			}
+
+			decltype(auto) await_resume()
+			{
+				// Free memory used by the cancellation callback now that the operation
+				// has completed rather than waiting until the operation object destructs.
+				m_cancellationCallback.reset();
+
+				if (m_errorCode == ECANCELED)
+				{
+					throw operation_cancelled{};
+				}
+
+				return static_cast<OPERATION*>(this)->get_result();
+			}
+
+		private:
+
+			enum class state
+			{
+				not_started,
+				started,
+				cancellation_requested,
+				completed
+			};
+
+			void on_cancellation_requested() noexcept
+			{
+				auto oldState = m_state.load(std::memory_order_acquire);
+				if (oldState == state::not_started)
+				{
+					// Racing with await_suspend(), hand responsibility for
+					// requesting cancellation over to that thread.
+					const bool transferredCancelResponsibility =
+						m_state.compare_exchange_strong(
+							oldState,
+							state::cancellation_requested,
+							std::memory_order_release,
+							std::memory_order_acquire);
+					if (transferredCancelResponsibility)
+					{
+						return;
+					}
+				}
+
+				// No point requesting cancellation if the operation has already completed.
+				if (oldState != state::completed)
+				{
+					static_cast<OPERATION*>(this)->cancel();
+				}
+			}
+
+			static void on_operation_ready(
+				detail::lnx::io_state* ioState,
+				int errorCode) noexcept
+			{
+				auto* operation = static_cast<linux_async_operation_cancellable*>(ioState);
+				if (errorCode != 0)
+				{
+					operation->m_errorCode = errorCode;
+				}
+				else if (static_cast<OPERATION*>(operation)->try_start())
+				{
+					// Spurious readiness notification, still waiting.
+					return;
+				}
+
+				auto state = operation->m_state.load(std::memory_order_acquire);
+				if (state == state::started)
+				{
+					operation->m_state.store(state::completed, std::memory_order_relaxed);
+					operation->m_awaitingCoroutine.resume();
+				}
+				else
+				{
+					// Racing with await_suspend(), whichever thread marks the
+					// operation as completed second resumes the coroutine.
+					state = operation->m_state.exchange(
+						state::completed,
+						std::memory_order_acq_rel);
+					if (state == state::started)
+					{
+						operation->m_awaitingCoroutine.resume();
+					}
+				}
+			}
+
+			std::atomic<state> m_state;
+			cppcoro::cancellation_token m_cancellationToken;
+			std::optional<cppcoro::cancellation_registration> m_cancellationCallback;
+			std::coroutine_handle<> m_awaitingCoroutine;
+
+		};
+	}
+}
+
+#endif
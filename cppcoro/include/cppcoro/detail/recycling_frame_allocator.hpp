@@ -0,0 +1,165 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_DETAIL_RECYCLING_FRAME_ALLOCATOR_HPP_INCLUDED
+#define CPPCORO_DETAIL_RECYCLING_FRAME_ALLOCATOR_HPP_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace cppcoro
+{
+	namespace detail
+	{
+		/// \brief
+		/// Allocates the frames of the library's internal coroutines, such as
+		/// when_all's and sync_wait's, which are the same size every time for
+		/// a given instantiation.
+		///
+		/// Each thread keeps a freelist of recently freed frames for each size
+		/// class, and a frame freed on another thread is handed back to the
+		/// thread that allocated it. The freelists are bounded, and frames that
+		/// don't fit, or are too big to be worth recycling, go back to the
+		/// global heap.
+		class recycling_frame_allocator
+		{
+		public:
+
+			static void* allocate(std::size_t size)
+			{
+				if (size <= max_recycled_size)
+				{
+					const std::size_t sizeClass = size_class(size);
+					thread_cache* cache = current_cache();
+					if (cache != nullptr && cache->m_freeLists[sizeClass] != nullptr)
+					{
+						free_frame* frame = cache->m_freeLists[sizeClass];
+						cache->m_freeLists[sizeClass] = frame->m_next;
+						--cache->m_freeCounts[sizeClass];
+						++cache->m_outstanding;
+						return frame_of(frame);
+					}
+
+					return allocate_slow(sizeClass);
+				}
+
+				return ::operator new(size);
+			}
+
+			static void deallocate(void* frame, std::size_t size) noexcept
+			{
+				if (size <= max_recycled_size)
+				{
+					auto* block = block_of(frame);
+					thread_cache* cache = current_cache();
+					if (block->m_owner == cache && cache != nullptr)
+					{
+						const std::size_t sizeClass = block->m_sizeClass;
+						if (cache->m_freeCounts[sizeClass] < max_free_per_class)
+						{
+							block->m_next = cache->m_freeLists[sizeClass];
+							cache->m_freeLists[sizeClass] = block;
+							++cache->m_freeCounts[sizeClass];
+						}
+						else
+						{
+							::operator delete(static_cast<void*>(block), block_size(sizeClass));
+						}
+						--cache->m_outstanding;
+						return;
+					}
+
+					deallocate_slow(block);
+					return;
+				}
+
+				::operator delete(frame, size);
+			}
+
+		private:
+
+			struct thread_cache;
+
+			// Frames are rounded up to a multiple of size_class_granularity.
+			static constexpr std::size_t size_class_granularity = 64;
+			static constexpr std::size_t size_class_count = 16;
+			static constexpr std::size_t max_recycled_size = size_class_granularity * size_class_count;
+
+			// Bounds the memory each thread holds on to at about 256KB.
+			static constexpr std::uint32_t max_free_per_class = 32;
+
+			// Precedes every recycled frame. While the frame is free, it is
+			// also the freelist node.
+			struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) free_frame
+			{
+				// The cache of the thread that allocated the frame, or nullptr
+				// if that thread had already shut down its cache.
+				thread_cache* m_owner;
+				std::uint32_t m_sizeClass;
+				free_frame* m_next;
+			};
+
+			struct thread_cache
+			{
+				free_frame* m_freeLists[size_class_count] = {};
+				std::uint32_t m_freeCounts[size_class_count] = {};
+
+				// The number of frames allocated by this thread that haven't
+				// come back to it yet. Only accessed by the owning thread.
+				std::size_t m_outstanding = 0;
+
+				// Frames freed by other threads, pushed with compare-exchange
+				// and taken all at once by the owning thread. Set to
+				// closed_sentinel() when the owning thread exits.
+				std::atomic<free_frame*> m_remoteFrees{ nullptr };
+
+				// Once the owning thread has exited, counts down the frames
+				// still to be freed by other threads. Whoever frees the last
+				// one deletes the cache.
+				std::atomic<std::int64_t> m_orphanedFrames{ 0 };
+			};
+
+			static std::size_t size_class(std::size_t size) noexcept
+			{
+				return size == 0 ? 0 : (size - 1) / size_class_granularity;
+			}
+
+			static std::size_t block_size(std::size_t sizeClass) noexcept
+			{
+				return sizeof(free_frame) + (sizeClass + 1) * size_class_granularity;
+			}
+
+			static void* frame_of(free_frame* block) noexcept
+			{
+				return block + 1;
+			}
+
+			static free_frame* block_of(void* frame) noexcept
+			{
+				return static_cast<free_frame*>(frame) - 1;
+			}
+
+			static thread_cache*& current_cache() noexcept
+			{
+				static thread_local thread_cache* cache = nullptr;
+				return cache;
+			}
+
+			static free_frame* closed_sentinel() noexcept;
+
+			static void* allocate_slow(std::size_t sizeClass);
+			static void deallocate_slow(free_frame* block) noexcept;
+
+			static bool take_remote_frees(thread_cache& cache) noexcept;
+			static void shut_down(thread_cache* cache) noexcept;
+
+			friend struct thread_cache_owner;
+
+		};
+	}
+}
+
+#endif
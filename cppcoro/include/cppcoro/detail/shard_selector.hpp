@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_DETAIL_SHARD_SELECTOR_HPP_INCLUDED
+#define CPPCORO_DETAIL_SHARD_SELECTOR_HPP_INCLUDED
+
+#include <cppcoro/static_thread_pool.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+namespace cppcoro
+{
+	namespace detail
+	{
+		/// Picks which shard of a sharded_counter or sharded_histogram the
+		/// calling thread updates.
+		///
+		/// Each of a thread pool's threads has a shard of its own, which no
+		/// other thread writes. Other threads share the remaining shards,
+		/// picked by a hash of the thread's id.
+		class shard_selector
+		{
+		public:
+
+			shard_selector(static_thread_pool* threadPool, std::uint32_t sharedShardCount) noexcept
+				: m_threadPool(threadPool)
+				, m_exclusiveShardCount(threadPool != nullptr ? threadPool->thread_count() : 0)
+				, m_sharedShardMask(round_up_to_power_of_two(sharedShardCount) - 1)
+			{}
+
+			std::uint32_t shard_count() const noexcept
+			{
+				return m_exclusiveShardCount + m_sharedShardMask + 1;
+			}
+
+			/// The calling thread's shard.
+			std::uint32_t current_shard() const noexcept
+			{
+				if (m_threadPool != nullptr)
+				{
+					const std::uint32_t index = m_threadPool->current_thread_index();
+					if (index < m_exclusiveShardCount)
+					{
+						return index;
+					}
+				}
+
+				return m_exclusiveShardCount +
+					static_cast<std::uint32_t>(current_thread_hash() & m_sharedShardMask);
+			}
+
+			/// Whether only one thread ever writes to \p shard, so that it
+			/// can be updated without an atomic read-modify-write.
+			bool is_exclusive(std::uint32_t shard) const noexcept
+			{
+				return shard < m_exclusiveShardCount;
+			}
+
+		private:
+
+			static std::uint32_t round_up_to_power_of_two(std::uint32_t value) noexcept
+			{
+				std::uint32_t result = 1;
+				while (result < value)
+				{
+					result <<= 1;
+				}
+				return result;
+			}
+
+			static std::size_t current_thread_hash() noexcept
+			{
+				// The high bits of the product are the best mixed, so use
+				// those for the low bits of the result.
+				thread_local const std::size_t hash = [] {
+					const auto product = static_cast<std::uint64_t>(
+						std::hash<std::thread::id>{}(std::this_thread::get_id())) * 0x9E3779B97F4A7C15ULL;
+					return static_cast<std::size_t>(product >> 32);
+				}();
+				return hash;
+			}
+
+			static_thread_pool* m_threadPool;
+			std::uint32_t m_exclusiveShardCount;
+			std::uint32_t m_sharedShardMask;
+
+		};
+	}
+}
+
+#endif
@@ -8,6 +8,7 @@
 #include <cppcoro/config.hpp>
 #include <cppcoro/awaitable_traits.hpp>
 #include <cppcoro/detail/lightweight_manual_reset_event.hpp>
+#include <cppcoro/detail/recycling_frame_allocator.hpp>
 
 #include <coroutine>
 #include <cassert>
@@ -33,6 +34,16 @@ namespace cppcoro
 			sync_wait_task_promise() noexcept
 			{}
 
+			static void* operator new(std::size_t size)
+			{
+				return recycling_frame_allocator::allocate(size);
+			}
+
+			static void operator delete(void* frame, std::size_t size) noexcept
+			{
+				recycling_frame_allocator::deallocate(frame, size);
+			}
+
 			void start(detail::lightweight_manual_reset_event& event)
 			{
 				m_event = &event;
@@ -147,6 +158,16 @@ namespace cppcoro
 			sync_wait_task_promise() noexcept
 			{}
 
+			static void* operator new(std::size_t size)
+			{
+				return recycling_frame_allocator::allocate(size);
+			}
+
+			static void operator delete(void* frame, std::size_t size) noexcept
+			{
+				recycling_frame_allocator::deallocate(frame, size);
+			}
+
 			void start(detail::lightweight_manual_reset_event& event)
 			{
 				m_event = &event;
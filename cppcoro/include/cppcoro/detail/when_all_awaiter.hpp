@@ -0,0 +1,305 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_DETAIL_WHEN_ALL_AWAITER_HPP_INCLUDED
+#define CPPCORO_DETAIL_WHEN_ALL_AWAITER_HPP_INCLUDED
+
+#include <cppcoro/config.hpp>
+#include <cppcoro/awaitable_traits.hpp>
+
+#include <cppcoro/detail/manual_lifetime.hpp>
+#include <cppcoro/detail/void_value.hpp>
+#include <cppcoro/detail/when_all_counter.hpp>
+#include <cppcoro/detail/when_all_task.hpp>
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace cppcoro
+{
+	namespace detail
+	{
+		/// \brief
+		/// Stands in for a coroutine frame, so that an awaiter can be given a
+		/// coroutine_handle<> that calls back into an ordinary object.
+		///
+		/// Only the resume and destroy function pointers at the start of the
+		/// frame are ever looked at through a coroutine_handle<> that isn't
+		/// typed with a promise.
+		struct frameless_continuation
+		{
+			using function_t = void(*)(frameless_continuation*) noexcept;
+
+			function_t m_resume;
+			function_t m_destroy;
+
+			std::coroutine_handle<> handle() noexcept
+			{
+				return std::coroutine_handle<>::from_address(this);
+			}
+		};
+
+		/// \brief
+		/// A when_all_ready() child that drives a plain awaiter directly,
+		/// rather than from a when_all_task coroutine.
+		///
+		/// Presents the same interface as when_all_task, so the two can be
+		/// mixed in the same when_all_ready_awaitable.
+		template<typename AWAITER>
+		class when_all_awaiter final : private frameless_continuation
+		{
+		public:
+
+			using result_type = decltype(std::declval<AWAITER&>().await_resume());
+
+			template<typename ARG>
+			explicit when_all_awaiter(ARG&& awaiter)
+				noexcept(std::is_nothrow_constructible_v<AWAITER, ARG&&>)
+				: frameless_continuation{ &when_all_awaiter::on_resume, &when_all_awaiter::on_destroy }
+				, m_awaiter(static_cast<ARG&&>(awaiter))
+				, m_counter(nullptr)
+				, m_result()
+				, m_hasResult(false)
+			{}
+
+			// Must not be moved while the awaiter is suspended.
+			when_all_awaiter(when_all_awaiter&& other)
+				noexcept(
+					std::is_nothrow_move_constructible_v<AWAITER> &&
+					(std::is_void_v<result_type> ||
+					 std::is_reference_v<result_type> ||
+					 std::is_nothrow_move_constructible_v<result_type>))
+				: frameless_continuation{ &when_all_awaiter::on_resume, &when_all_awaiter::on_destroy }
+				, m_awaiter(std::move(other.m_awaiter))
+				, m_counter(nullptr)
+				, m_exception(std::move(other.m_exception))
+				, m_result()
+				, m_hasResult(other.m_hasResult)
+			{
+				if constexpr (std::is_reference_v<result_type>)
+				{
+					m_result = other.m_result;
+				}
+				else if constexpr (!std::is_void_v<result_type>)
+				{
+					if (m_hasResult)
+					{
+						m_result.construct(std::move(*other.m_result));
+					}
+				}
+			}
+
+			~when_all_awaiter()
+			{
+				if constexpr (!std::is_void_v<result_type> && !std::is_reference_v<result_type>)
+				{
+					if (m_hasResult)
+					{
+						m_result.destruct();
+					}
+				}
+			}
+
+			when_all_awaiter(const when_all_awaiter&) = delete;
+			when_all_awaiter& operator=(const when_all_awaiter&) = delete;
+
+			decltype(auto) result() &
+			{
+				rethrow_if_exception();
+				if constexpr (std::is_void_v<result_type>)
+				{
+					return;
+				}
+				else
+				{
+					return static_cast<std::remove_reference_t<result_type>&>(*m_result);
+				}
+			}
+
+			decltype(auto) result() &&
+			{
+				rethrow_if_exception();
+				if constexpr (std::is_void_v<result_type>)
+				{
+					return;
+				}
+				else
+				{
+					return static_cast<result_type&&>(*m_result);
+				}
+			}
+
+			decltype(auto) non_void_result() &
+			{
+				if constexpr (std::is_void_v<result_type>)
+				{
+					this->result();
+					return void_value{};
+				}
+				else
+				{
+					return this->result();
+				}
+			}
+
+			decltype(auto) non_void_result() &&
+			{
+				if constexpr (std::is_void_v<result_type>)
+				{
+					std::move(*this).result();
+					return void_value{};
+				}
+				else
+				{
+					return std::move(*this).result();
+				}
+			}
+
+		private:
+
+			template<typename TASK_CONTAINER>
+			friend class when_all_ready_awaitable;
+
+			void start(when_all_counter& counter) noexcept
+			{
+				m_counter = &counter;
+
+				try
+				{
+					if (!m_awaiter.await_ready())
+					{
+						using await_suspend_result_t = decltype(m_awaiter.await_suspend(handle()));
+						if constexpr (std::is_void_v<await_suspend_result_t>)
+						{
+							m_awaiter.await_suspend(handle());
+							return;
+						}
+						else if constexpr (std::is_same_v<await_suspend_result_t, bool>)
+						{
+							if (m_awaiter.await_suspend(handle()))
+							{
+								return;
+							}
+						}
+						else
+						{
+							m_awaiter.await_suspend(handle()).resume();
+							return;
+						}
+					}
+				}
+				catch (...)
+				{
+					m_exception = std::current_exception();
+					m_counter->notify_awaitable_completed();
+					return;
+				}
+
+				complete();
+			}
+
+			void complete() noexcept
+			{
+				try
+				{
+					if constexpr (std::is_void_v<result_type>)
+					{
+						m_awaiter.await_resume();
+					}
+					else if constexpr (std::is_reference_v<result_type>)
+					{
+						m_result = std::addressof(m_awaiter.await_resume());
+						m_hasResult = true;
+					}
+					else
+					{
+						m_result.construct(m_awaiter.await_resume());
+						m_hasResult = true;
+					}
+				}
+				catch (...)
+				{
+					m_exception = std::current_exception();
+				}
+
+				m_counter->notify_awaitable_completed();
+			}
+
+			void rethrow_if_exception()
+			{
+				if (m_exception)
+				{
+					std::rethrow_exception(m_exception);
+				}
+			}
+
+			static void on_resume(frameless_continuation* continuation) noexcept
+			{
+				static_cast<when_all_awaiter*>(continuation)->complete();
+			}
+
+			static void on_destroy(frameless_continuation*) noexcept
+			{
+				// Owned by the when_all_ready_awaitable, not by whoever holds
+				// the coroutine_handle.
+			}
+
+			using result_storage_t = std::conditional_t<
+				std::is_void_v<result_type>,
+				void_value,
+				std::conditional_t<
+					std::is_reference_v<result_type>,
+					std::add_pointer_t<result_type>,
+					manual_lifetime<result_type>>>;
+
+			AWAITER m_awaiter;
+			when_all_counter* m_counter;
+			std::exception_ptr m_exception;
+			result_storage_t m_result;
+			bool m_hasResult;
+
+		};
+
+		/// Whether when_all_ready() can drive an argument of type \p AWAITABLE
+		/// with a when_all_awaiter, rather than from a when_all_task.
+		///
+		/// Only rvalue arguments qualify. Lvalue arguments keep going through
+		/// a when_all_task, so opting in never changes how an existing
+		/// caller's awaiter is held.
+		template<typename AWAITABLE, typename = void>
+		struct is_frameless_when_all_child : std::false_type {};
+
+		template<typename AWAITABLE>
+		struct is_frameless_when_all_child<AWAITABLE, std::void_t<
+			typename awaitable_traits<std::remove_cv_t<std::remove_reference_t<AWAITABLE>>&>::awaiter_t>>
+			: std::bool_constant<
+				CPPCORO_USE_FRAMELESS_CONTINUATIONS &&
+				!std::is_lvalue_reference_v<AWAITABLE> &&
+				// Only plain awaiters, which are their own awaiter.
+				std::is_same_v<
+					typename awaitable_traits<std::remove_cv_t<std::remove_reference_t<AWAITABLE>>&>::awaiter_t,
+					std::remove_cv_t<std::remove_reference_t<AWAITABLE>>&> &&
+				std::is_constructible_v<std::remove_cv_t<std::remove_reference_t<AWAITABLE>>, AWAITABLE&&>>
+		{};
+
+		template<typename AWAITABLE>
+		auto make_when_all_child(AWAITABLE&& awaitable)
+		{
+			if constexpr (is_frameless_when_all_child<AWAITABLE>::value)
+			{
+				return when_all_awaiter<std::remove_cv_t<std::remove_reference_t<AWAITABLE>>>(
+					static_cast<AWAITABLE&&>(awaitable));
+			}
+			else
+			{
+				return make_when_all_task(static_cast<AWAITABLE&&>(awaitable));
+			}
+		}
+	}
+}
+
+#endif
@@ -6,7 +6,9 @@
 #define CPPCORO_DETAIL_WHEN_ALL_TASK_HPP_INCLUDED
 
 #include <cppcoro/awaitable_traits.hpp>
+#include <cppcoro/frame_arena.hpp>
 
+#include <cppcoro/detail/recycling_frame_allocator.hpp>
 #include <cppcoro/detail/when_all_counter.hpp>
 #include <cppcoro/detail/void_value.hpp>
 
@@ -33,6 +35,16 @@ namespace cppcoro
 			when_all_task_promise() noexcept
 			{}
 
+			static void* operator new(std::size_t size)
+			{
+				return detail::allocate_frame<recycling_frame_allocator>(size, frame_arena::current_arena());
+			}
+
+			static void operator delete(void* frame, std::size_t size) noexcept
+			{
+				detail::deallocate_frame<recycling_frame_allocator>(frame, size);
+			}
+
 			auto get_return_object() noexcept
 			{
 				return coroutine_handle_t::from_promise(*this);
@@ -160,6 +172,16 @@ namespace cppcoro
 			when_all_task_promise() noexcept
 			{}
 
+			static void* operator new(std::size_t size)
+			{
+				return detail::allocate_frame<recycling_frame_allocator>(size, frame_arena::current_arena());
+			}
+
+			static void operator delete(void* frame, std::size_t size) noexcept
+			{
+				detail::deallocate_frame<recycling_frame_allocator>(frame, size);
+			}
+
 			auto get_return_object() noexcept
 			{
 				return coroutine_handle_t::from_promise(*this);
@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_EPOCH_DOMAIN_HPP_INCLUDED
+#define CPPCORO_EPOCH_DOMAIN_HPP_INCLUDED
+
+#include <cppcoro/config.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace cppcoro
+{
+	/// \brief
+	/// Epoch-based reclamation of memory that lock-free readers may still be
+	/// looking at.
+	///
+	/// Each thread that reads or retires shared objects registers as a
+	/// participant of the domain. Readers pin the domain while they hold
+	/// pointers to shared objects. An object that has been unlinked, so that
+	/// no new reader can reach it, is retired rather than deleted, and its
+	/// deleter is only called once every participant that was pinned when it
+	/// was retired has unpinned.
+	///
+	/// The domain's epoch advances once every pinned participant has seen
+	/// the current epoch. Objects retired in epoch E are freed once the epoch
+	/// reaches E + 2. Each participant collects its own retired objects, a
+	/// batch at a time, as it retires more.
+	class epoch_domain
+	{
+	public:
+
+		class participant;
+		class guard;
+
+		/// Frees a retired object. Must not throw.
+		using deleter_t = void(*)(void*) noexcept;
+
+		epoch_domain() noexcept;
+
+		/// Calls the deleters of everything still retired.
+		///
+		/// All participants must have been destroyed first.
+		~epoch_domain();
+
+		epoch_domain(const epoch_domain&) = delete;
+		epoch_domain& operator=(const epoch_domain&) = delete;
+
+		/// The current epoch. Only useful for diagnostics.
+		std::uint64_t epoch() const noexcept
+		{
+			return m_epoch.load(std::memory_order_relaxed);
+		}
+
+	private:
+
+		struct retired_object
+		{
+			void* m_pointer;
+			deleter_t m_deleter;
+		};
+
+		struct retired_bag
+		{
+			std::uint64_t m_epoch = 0;
+			std::vector<retired_object> m_objects;
+		};
+
+		// Retired objects are kept in one bag per epoch, and there are only
+		// ever three epochs whose objects might not be freeable yet.
+		static constexpr std::size_t bag_count = 3;
+
+		struct alignas(CPPCORO_CPU_CACHE_LINE) record
+		{
+			// Zero while not pinned, otherwise (epoch << 1) | 1 for the epoch
+			// that was current when the participant pinned.
+			std::atomic<std::uint64_t> m_state{ 0 };
+
+			std::atomic<bool> m_inUse{ true };
+
+			// Records are never removed from the list, only reused.
+			record* m_next = nullptr;
+
+			// Only accessed by the participant that owns the record.
+			std::uint32_t m_pinCount = 0;
+			std::uint32_t m_retiredSinceCollect = 0;
+			retired_bag m_bags[bag_count];
+		};
+
+		record* acquire_record();
+		void release_record(record* r) noexcept;
+
+		bool try_advance() noexcept;
+		void collect(record& r) noexcept;
+		void collect_orphans() noexcept;
+
+		static void free_bag(retired_bag& bag) noexcept;
+
+		std::atomic<std::uint64_t> m_epoch;
+		std::atomic<record*> m_records;
+
+		// Objects retired by participants that were destroyed before they
+		// could be freed.
+		std::mutex m_orphanMutex;
+		std::vector<retired_bag> m_orphans;
+
+	};
+
+	/// \brief
+	/// A thread's registration with an epoch_domain.
+	///
+	/// A participant must only be used by one thread at a time, and must be
+	/// destroyed before the domain.
+	class epoch_domain::participant
+	{
+	public:
+
+		explicit participant(epoch_domain& domain);
+
+		/// Hands anything that can't be freed yet over to the domain.
+		~participant();
+
+		participant(const participant&) = delete;
+		participant& operator=(const participant&) = delete;
+
+		/// Pin the domain until the returned guard is destroyed.
+		///
+		/// Pointers to shared objects must only be loaded and dereferenced
+		/// while pinned. Pins nest.
+		[[nodiscard]] guard pin() noexcept;
+
+		/// Whether this participant currently holds a pin.
+		bool is_pinned() const noexcept
+		{
+			return m_record->m_pinCount != 0;
+		}
+
+		/// \brief
+		/// Call \p deleter with \p pointer once no participant can still be
+		/// reading it.
+		///
+		/// The object must already be unreachable by new readers.
+		///
+		/// \throw std::bad_alloc
+		/// If there is no memory to record the object. It has not been
+		/// retired in that case.
+		void retire(void* pointer, deleter_t deleter);
+
+		/// Delete \p pointer once no participant can still be reading it.
+		template<typename T>
+		void retire(T* pointer)
+		{
+			retire(
+				static_cast<void*>(pointer),
+				[](void* p) noexcept { delete static_cast<T*>(p); });
+		}
+
+		/// Try to advance the epoch and free whatever this participant has
+		/// retired that is now safe to free.
+		///
+		/// This happens automatically every so often from retire().
+		void collect() noexcept;
+
+	private:
+
+		friend class guard;
+
+		void unpin() noexcept
+		{
+			if (--m_record->m_pinCount == 0)
+			{
+				m_record->m_state.store(0, std::memory_order_release);
+			}
+		}
+
+		epoch_domain& m_domain;
+		record* m_record;
+
+	};
+
+	/// Keeps a participant pinned for as long as it's alive.
+	class epoch_domain::guard
+	{
+	public:
+
+		guard(guard&& other) noexcept
+			: m_participant(other.m_participant)
+		{
+			other.m_participant = nullptr;
+		}
+
+		~guard()
+		{
+			if (m_participant != nullptr)
+			{
+				m_participant->unpin();
+			}
+		}
+
+		guard(const guard&) = delete;
+		guard& operator=(const guard&) = delete;
+		guard& operator=(guard&&) = delete;
+
+	private:
+
+		friend class participant;
+
+		explicit guard(participant& p) noexcept
+			: m_participant(&p)
+		{}
+
+		participant* m_participant;
+
+	};
+
+	inline epoch_domain::guard epoch_domain::participant::pin() noexcept
+	{
+		if (m_record->m_pinCount++ == 0)
+		{
+			const std::uint64_t epoch = m_domain.m_epoch.load(std::memory_order_relaxed);
+			m_record->m_state.store((epoch << 1) | 1, std::memory_order_relaxed);
+
+			// Make the pin visible before loading any shared pointers, so that
+			// either the thread advancing the epoch sees it, or we see the
+			// unlinking of anything it's about to free.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+		}
+
+		return guard{ *this };
+	}
+}
+
+#endif
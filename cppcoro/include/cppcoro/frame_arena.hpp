@@ -0,0 +1,205 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_FRAME_ARENA_HPP_INCLUDED
+#define CPPCORO_FRAME_ARENA_HPP_INCLUDED
+
+#include <cppcoro/on_scope_exit.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace cppcoro
+{
+	/// \brief
+	/// A monotonic arena for the coroutine frames of one request.
+	///
+	/// A task created while an arena is current allocates its frame from the
+	/// arena and remembers it. Whenever that task's body is running, the arena
+	/// is made current again, so the tasks it creates, and the tasks they
+	/// create in turn, are all allocated from the same arena, whichever thread
+	/// they happen to run on. Freeing a frame is a no-op; all of the memory is
+	/// released at once when the arena is destroyed, which must not happen
+	/// until every frame allocated from it has been destroyed.
+	///
+	/// Make an arena current for the top-level task either by creating it in
+	/// a call to invoke(), or by passing \c std::allocator_arg followed by the
+	/// arena as the first parameters of the coroutine (after the object
+	/// parameter, if it is a member function or lambda).
+	///
+	/// Only task and when_all's internal coroutines look for the current
+	/// arena. Other coroutine types allocate from the global heap, and don't
+	/// change the current arena while they run, so coroutines they create are
+	/// allocated from the arena of whichever task resumed them.
+	///
+	/// Allocation is thread-safe, as tasks of the same request can create
+	/// child tasks on several threads at once.
+	class frame_arena
+	{
+	public:
+
+		/// Construct an arena that allocates memory from the global heap in
+		/// blocks of at least \p initialBlockSize bytes, doubling each time.
+		explicit frame_arena(std::size_t initialBlockSize = 16 * 1024) noexcept;
+
+		/// Frees all of the memory allocated from the arena.
+		~frame_arena();
+
+		frame_arena(const frame_arena&) = delete;
+		frame_arena& operator=(const frame_arena&) = delete;
+
+		/// Allocate \p size bytes aligned for any fundamental type.
+		///
+		/// \throw std::bad_alloc
+		/// If a new block is needed and can't be allocated.
+		void* allocate(std::size_t size)
+		{
+			size = (size + alignment - 1) & ~(alignment - 1);
+
+			block* current = m_currentBlock.load(std::memory_order_acquire);
+			if (current != nullptr)
+			{
+				const std::size_t offset = current->m_used.fetch_add(size, std::memory_order_relaxed);
+				if (offset + size <= current->m_size)
+				{
+					return current->data() + offset;
+				}
+			}
+
+			return allocate_slow(size);
+		}
+
+		/// The number of bytes handed out by allocate() so far, including
+		/// padding.
+		std::size_t bytes_allocated() const noexcept;
+
+		/// \brief
+		/// Call \p func with this arena as the current arena.
+		///
+		/// Any task that \p func creates, typically the top-level task of a
+		/// request, is allocated from the arena.
+		template<typename FUNC>
+		decltype(auto) invoke(FUNC&& func)
+		{
+			frame_arena*& current = current_arena();
+			auto restoreArena = on_scope_exit(
+				[&current, previous = std::exchange(current, this)]() noexcept
+				{
+					current = previous;
+				});
+			return static_cast<FUNC&&>(func)();
+		}
+
+		/// The arena that new task frames are currently allocated from on
+		/// this thread, or nullptr if they are allocated from the global heap.
+		static frame_arena*& current_arena() noexcept
+		{
+			static thread_local frame_arena* current = nullptr;
+			return current;
+		}
+
+	private:
+
+		static constexpr std::size_t alignment = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+		struct block
+		{
+			block* m_next;
+			std::size_t m_size;
+			std::atomic<std::size_t> m_used;
+
+			std::byte* data() noexcept
+			{
+				return reinterpret_cast<std::byte*>(this) + header_size;
+			}
+		};
+
+		static constexpr std::size_t header_size = (sizeof(block) + alignment - 1) & ~(alignment - 1);
+
+		void* allocate_slow(std::size_t size);
+
+		std::atomic<block*> m_currentBlock;
+
+		// Protects replacing the current block.
+		mutable std::mutex m_mutex;
+		block* m_blocks;
+		std::size_t m_nextBlockSize;
+
+	};
+
+	namespace detail
+	{
+		/// Find the arena to allocate a task's frame from, given the
+		/// parameters of the coroutine.
+		template<typename... ARGS>
+		frame_arena* find_frame_arena(std::allocator_arg_t, frame_arena& arena, ARGS&...) noexcept
+		{
+			return &arena;
+		}
+
+		template<typename CLASS, typename... ARGS>
+		frame_arena* find_frame_arena(CLASS&, std::allocator_arg_t, frame_arena& arena, ARGS&...) noexcept
+		{
+			return &arena;
+		}
+
+		template<typename... ARGS>
+		frame_arena* find_frame_arena(ARGS&...) noexcept
+		{
+			return frame_arena::current_arena();
+		}
+
+		/// Allocates frames that don't come from an arena.
+		struct global_frame_allocator
+		{
+			static void* allocate(std::size_t size)
+			{
+				return ::operator new(size);
+			}
+
+			static void deallocate(void* frame, std::size_t size) noexcept
+			{
+				::operator delete(frame, size);
+			}
+		};
+
+		// Frames record the arena they came from just past their end, where
+		// operator delete can find it given the size of the frame.
+		inline std::size_t frame_arena_offset(std::size_t size) noexcept
+		{
+			return (size + alignof(frame_arena*) - 1) & ~(alignof(frame_arena*) - 1);
+		}
+
+		template<typename FALLBACK_ALLOCATOR = global_frame_allocator>
+		void* allocate_frame(std::size_t size, frame_arena* arena)
+		{
+			const std::size_t offset = frame_arena_offset(size);
+			const std::size_t allocationSize = offset + sizeof(frame_arena*);
+			void* frame = arena != nullptr ?
+				arena->allocate(allocationSize) :
+				FALLBACK_ALLOCATOR::allocate(allocationSize);
+			std::memcpy(static_cast<std::byte*>(frame) + offset, &arena, sizeof(arena));
+			return frame;
+		}
+
+		template<typename FALLBACK_ALLOCATOR = global_frame_allocator>
+		void deallocate_frame(void* frame, std::size_t size) noexcept
+		{
+			const std::size_t offset = frame_arena_offset(size);
+			frame_arena* arena;
+			std::memcpy(&arena, static_cast<std::byte*>(frame) + offset, sizeof(arena));
+			if (arena == nullptr)
+			{
+				FALLBACK_ALLOCATOR::deallocate(frame, offset + sizeof(frame_arena*));
+			}
+		}
+	}
+}
+
+#endif
@@ -5,6 +5,8 @@
 #ifndef CPPCORO_GENERATOR_HPP_INCLUDED
 #define CPPCORO_GENERATOR_HPP_INCLUDED
 
+#include <cppcoro/detail/allocator_aware_promise.hpp>
+
 #include <coroutine>
 #include <type_traits>
 #include <utility>
@@ -20,7 +22,7 @@ namespace cppcoro
 	namespace detail
 	{
 		template<typename T>
-		class generator_promise
+		class generator_promise : public allocator_aware_promise
 		{
 		public:
 
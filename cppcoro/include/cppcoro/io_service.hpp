@@ -11,6 +11,8 @@
 
 #if CPPCORO_OS_WINNT
 # include <cppcoro/detail/win32.hpp>
+#elif CPPCORO_OS_LINUX
+# include <cppcoro/detail/linux.hpp>
 #endif
 
 #include <optional>
@@ -135,6 +137,29 @@ namespace cppcoro
 #if CPPCORO_OS_WINNT
 		detail::win32::handle_t native_iocp_handle() noexcept;
 		void ensure_winsock_initialised();
+#elif CPPCORO_OS_LINUX
+		detail::lnx::fd_t native_epoll_handle() noexcept;
+
+		/// Register a non-blocking file descriptor with the epoll instance.
+		///
+		/// \return
+		/// The registration that will receive readiness notifications for
+		/// \p fd. Must be returned with unregister_fd() before \p fd is closed.
+		///
+		/// \throws std::system_error
+		/// If the file descriptor could not be registered.
+		detail::lnx::io_registration* register_fd(detail::lnx::fd_t fd);
+
+		/// Unregister \p fd and recycle \p registration.
+		///
+		/// Any operation still waiting on the registration is completed
+		/// with ECANCELED on an I/O thread.
+		void unregister_fd(
+			detail::lnx::fd_t fd,
+			detail::lnx::io_registration* registration) noexcept;
+
+		/// Queue \p state to be dispatched on an I/O thread with \p errorCode.
+		void post_completion(detail::lnx::io_state* state, int errorCode) noexcept;
 #endif
 
 	private:
@@ -156,6 +181,14 @@ namespace cppcoro
 
 		void post_wake_up_event() noexcept;
 
+#if CPPCORO_OS_LINUX
+		void queue_completions(
+			detail::lnx::io_state* head,
+			detail::lnx::io_state* tail) noexcept;
+
+		void drain_wake_up_event() noexcept;
+#endif
+
 		timer_thread_state* ensure_timer_thread_started();
 
 		static constexpr std::uint32_t stop_requested_flag = 1;
@@ -172,6 +205,24 @@ namespace cppcoro
 
 		std::atomic<bool> m_winsockInitialised;
 		std::mutex m_winsockInitialisationMutex;
+#elif CPPCORO_OS_LINUX
+		detail::lnx::safe_fd m_epollFd;
+
+		// eventfd used to wake up threads blocked in epoll_wait().
+		// Left signalled while stop is requested so that every thread wakes.
+		detail::lnx::safe_fd m_wakeUpFd;
+
+		// FIFO queues of work that is ready to be dispatched, as there is no
+		// kernel completion queue to post them to.
+		std::mutex m_readyMutex;
+		schedule_operation* m_readyScheduleHead;
+		schedule_operation* m_readyScheduleTail;
+		detail::lnx::io_state* m_readyCompletionHead;
+		detail::lnx::io_state* m_readyCompletionTail;
+		std::uint32_t m_waitingThreadCount;
+
+		std::mutex m_registrationMutex;
+		detail::lnx::io_registration* m_freeRegistrations;
 #endif
 
 		// Head of a linked-list of schedule operations that are
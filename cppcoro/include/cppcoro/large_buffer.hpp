@@ -0,0 +1,200 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_LARGE_BUFFER_HPP_INCLUDED
+#define CPPCORO_LARGE_BUFFER_HPP_INCLUDED
+
+#include <cppcoro/config.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace cppcoro
+{
+	/// How the memory of a large_buffer is backed.
+	enum class large_buffer_backing
+	{
+		/// Allocated from the heap, because it was too small to be worth
+		/// mapping separately.
+		heap,
+
+		/// Mapped with the system's normal page size.
+		standard_pages,
+
+		/// Mapped with normal pages, and the kernel asked to back it with
+		/// transparent huge pages where it can.
+		transparent_huge_pages,
+
+		/// Mapped with explicit huge (large) pages.
+		huge_pages,
+	};
+
+	/// Passed as the NUMA node of a large_buffer to leave page placement to
+	/// the system.
+	inline constexpr int any_numa_node = -1;
+
+	namespace detail
+	{
+		struct large_buffer_memory
+		{
+			void* m_data = nullptr;
+
+			// The number of bytes actually allocated, which may be more than
+			// were asked for.
+			std::size_t m_size = 0;
+
+			large_buffer_backing m_backing = large_buffer_backing::heap;
+
+			// The node the pages are preferred to come from, or
+			// any_numa_node if there is no preference.
+			int m_numaNode = any_numa_node;
+		};
+
+		/// Allocate room for \p count elements of \p elementSize bytes.
+		///
+		/// \throw std::bad_alloc
+		large_buffer_memory allocate_large_buffer(
+			std::size_t count, std::size_t elementSize, int numaNode);
+
+		void free_large_buffer(const large_buffer_memory& memory) noexcept;
+	}
+
+	/// \brief
+	/// A fixed-size array for big, randomly accessed buffers such as ring
+	/// buffers and work queues.
+	///
+	/// Buffers of at least a huge page are mapped with explicit huge pages
+	/// where the system has some reserved, falling back to asking for
+	/// transparent huge pages, so that random slot accesses take fewer TLB
+	/// misses. Buffers that are mapped separately can prefer a NUMA node
+	/// for their pages, rather than ending up on whichever node first
+	/// touches them. Small buffers are allocated from the heap.
+	///
+	/// Elements are value-initialised.
+	template<typename T>
+	class large_buffer
+	{
+		static_assert(
+			std::is_nothrow_default_constructible_v<T>,
+			"large_buffer elements must be nothrow default constructible");
+		static_assert(
+			alignof(T) <= CPPCORO_CPU_CACHE_LINE,
+			"large_buffer elements can't be aligned to more than a cache line");
+
+	public:
+
+		large_buffer() noexcept
+			: m_memory()
+			, m_count(0)
+		{}
+
+		/// Allocate a buffer of \p count elements.
+		///
+		/// \param numaNode
+		/// The NUMA node to allocate the buffer's pages from, or
+		/// any_numa_node. This is only a preference: pages come from other
+		/// nodes once this one runs out of memory, and the buffer is still
+		/// allocated if the system doesn't support NUMA policies or the
+		/// node doesn't exist.
+		///
+		/// \throw std::bad_alloc
+		explicit large_buffer(std::size_t count, int numaNode = any_numa_node)
+			: m_memory(detail::allocate_large_buffer(count, sizeof(T), numaNode))
+			, m_count(count)
+		{
+			T* elements = data();
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				::new (static_cast<void*>(elements + i)) T();
+			}
+		}
+
+		large_buffer(large_buffer&& other) noexcept
+			: m_memory(std::exchange(other.m_memory, detail::large_buffer_memory{}))
+			, m_count(std::exchange(other.m_count, 0))
+		{}
+
+		~large_buffer()
+		{
+			reset();
+		}
+
+		large_buffer& operator=(large_buffer&& other) noexcept
+		{
+			if (this != &other)
+			{
+				reset();
+				m_memory = std::exchange(other.m_memory, detail::large_buffer_memory{});
+				m_count = std::exchange(other.m_count, 0);
+			}
+
+			return *this;
+		}
+
+		large_buffer(const large_buffer&) = delete;
+		large_buffer& operator=(const large_buffer&) = delete;
+
+		T* data() noexcept { return static_cast<T*>(m_memory.m_data); }
+		const T* data() const noexcept { return static_cast<const T*>(m_memory.m_data); }
+
+		std::size_t size() const noexcept { return m_count; }
+
+		T& operator[](std::size_t index) noexcept
+		{
+			assert(index < m_count);
+			return data()[index];
+		}
+
+		const T& operator[](std::size_t index) const noexcept
+		{
+			assert(index < m_count);
+			return data()[index];
+		}
+
+		T* begin() noexcept { return data(); }
+		T* end() noexcept { return data() + m_count; }
+		const T* begin() const noexcept { return data(); }
+		const T* end() const noexcept { return data() + m_count; }
+
+		/// How the buffer's memory ended up being backed.
+		large_buffer_backing backing() const noexcept { return m_memory.m_backing; }
+
+		/// The NUMA node the buffer's pages are preferred to come from, or
+		/// any_numa_node.
+		int numa_node() const noexcept { return m_memory.m_numaNode; }
+
+	private:
+
+		void reset() noexcept
+		{
+			if (m_memory.m_data != nullptr)
+			{
+				if constexpr (!std::is_trivially_destructible_v<T>)
+				{
+					for (std::size_t i = 0; i < m_count; ++i)
+					{
+						data()[i].~T();
+					}
+				}
+
+				detail::free_large_buffer(m_memory);
+				m_memory = detail::large_buffer_memory{};
+				m_count = 0;
+			}
+		}
+
+		detail::large_buffer_memory m_memory;
+		std::size_t m_count;
+
+	};
+
+	/// The NUMA node of the processor the calling thread is running on, or
+	/// any_numa_node if it can't be determined.
+	int current_numa_node() noexcept;
+}
+
+#endif
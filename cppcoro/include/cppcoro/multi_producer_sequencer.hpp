@@ -6,6 +6,7 @@
 #define CPPCORO_MULTI_PRODUCER_SEQUENCER_HPP_INCLUDED
 
 #include <cppcoro/config.hpp>
+#include <cppcoro/large_buffer.hpp>
 #include <cppcoro/sequence_barrier.hpp>
 #include <cppcoro/sequence_range.hpp>
 #include <cppcoro/sequence_traits.hpp>
@@ -60,10 +61,14 @@ namespace cppcoro
 	{
 	public:
 
+		/// \param numaNode
+		/// The NUMA node to keep the sequencer's per-slot state on. This should
+		/// usually be the node that the ring buffer itself is on.
 		multi_producer_sequencer(
 			const sequence_barrier<SEQUENCE, TRAITS>& consumerBarrier,
 			std::size_t bufferSize,
-			SEQUENCE initialSequence = TRAITS::initial_sequence);
+			SEQUENCE initialSequence = TRAITS::initial_sequence,
+			int numaNode = any_numa_node);
 
 		/// The size of the circular buffer. This will be a power-of-two.
 		std::size_t buffer_size() const noexcept { return m_sequenceMask + 1; }
@@ -161,7 +166,7 @@ namespace cppcoro
 
 		const sequence_barrier<SEQUENCE, TRAITS>& m_consumerBarrier;
 		const std::size_t m_sequenceMask;
-		const std::unique_ptr<std::atomic<SEQUENCE>[]> m_published;
+		large_buffer<std::atomic<SEQUENCE>> m_published;
 
 		alignas(CPPCORO_CPU_CACHE_LINE)
 		std::atomic<SEQUENCE> m_nextToClaim;
@@ -493,10 +498,11 @@ namespace cppcoro
 	multi_producer_sequencer<SEQUENCE, TRAITS>::multi_producer_sequencer(
 		const sequence_barrier<SEQUENCE, TRAITS>& consumerBarrier,
 		std::size_t bufferSize,
-		SEQUENCE initialSequence)
+		SEQUENCE initialSequence,
+		int numaNode)
 		: m_consumerBarrier(consumerBarrier)
 		, m_sequenceMask(bufferSize - 1)
-		, m_published(std::make_unique<std::atomic<SEQUENCE>[]>(bufferSize))
+		, m_published(bufferSize, numaNode)
 		, m_nextToClaim(initialSequence + 1)
 		, m_awaiters(nullptr)
 	{
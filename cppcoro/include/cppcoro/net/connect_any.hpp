@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_NET_CONNECT_ANY_HPP_INCLUDED
+#define CPPCORO_NET_CONNECT_ANY_HPP_INCLUDED
+
+#include <cppcoro/config.hpp>
+#include <cppcoro/cancellation_token.hpp>
+#include <cppcoro/io_service.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/net/endpoint_health_cache.hpp>
+#include <cppcoro/net/ip_endpoint.hpp>
+#include <cppcoro/net/socket.hpp>
+
+#include <chrono>
+#include <span>
+
+namespace cppcoro
+{
+	namespace net
+	{
+		/// The delay between starting connection attempts recommended by RFC 8305.
+		inline constexpr std::chrono::milliseconds default_connection_attempt_delay{ 250 };
+
+		/// \brief
+		/// Establish a TCP connection to whichever of \p endPoints answers first,
+		/// racing staggered connection attempts ("Happy Eyeballs", RFC 8305).
+		///
+		/// End-points are tried in the order given, interleaving IPv6 and IPv4
+		/// addresses starting with the family of the first end-point. The next
+		/// attempt is started once the previous one fails or has been running
+		/// for \p stagger, whichever happens first, so a dead or unreachable
+		/// end-point delays the connection by at most \p stagger. Once one
+		/// attempt succeeds the other attempts are cancelled and their sockets
+		/// closed.
+		///
+		/// \param ioService
+		/// The I/O service used to create sockets and time attempts.
+		///
+		/// \param endPoints
+		/// The end-points to try. Must remain valid until the returned task
+		/// completes.
+		///
+		/// \param stagger
+		/// How long to wait for an attempt before starting the next one.
+		///
+		/// \param ct
+		/// Cancels all outstanding attempts.
+		///
+		/// \return
+		/// A task that completes with the connected socket. Use its
+		/// remote_endpoint() to find which end-point was connected to.
+		/// Fails with operation_cancelled if cancellation was requested before
+		/// a connection was established, otherwise fails with the error of
+		/// the last failed attempt if all attempts failed, or with a
+		/// std::system_error if \p endPoints is empty.
+		task<socket> connect_any(
+			io_service& ioService,
+			std::span<const ip_endpoint> endPoints,
+			std::chrono::milliseconds stagger = default_connection_attempt_delay,
+			cancellation_token ct = {});
+
+		/// \brief
+		/// As above, but end-points are first ordered by \p healthCache and the
+		/// outcome of each attempt is recorded in it.
+		///
+		/// End-points that recently failed are tried last and the end-point
+		/// with the lowest connect latency first, so once the cache has warmed
+		/// up most connections succeed on the first attempt without waiting for
+		/// the stagger delay. Attempts that were cancelled are not recorded.
+		task<socket> connect_any(
+			io_service& ioService,
+			std::span<const ip_endpoint> endPoints,
+			endpoint_health_cache& healthCache,
+			std::chrono::milliseconds stagger = default_connection_attempt_delay,
+			cancellation_token ct = {});
+	}
+}
+
+#endif
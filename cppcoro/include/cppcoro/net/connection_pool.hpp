@@ -0,0 +1,238 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_NET_CONNECTION_POOL_HPP_INCLUDED
+#define CPPCORO_NET_CONNECTION_POOL_HPP_INCLUDED
+
+#include <cppcoro/config.hpp>
+#include <cppcoro/io_service.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/net/ip_endpoint.hpp>
+#include <cppcoro/net/socket.hpp>
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace cppcoro
+{
+	namespace net
+	{
+		class connection_pool;
+
+		/// \brief
+		/// Exclusive use of a connected socket checked out from a connection_pool.
+		///
+		/// The socket is returned to the pool as an idle connection when the
+		/// lease is destroyed, unless discard() was called, eg. because an
+		/// error left the connection in an unknown protocol state.
+		class connection_lease
+		{
+		public:
+
+			connection_lease() noexcept;
+
+			connection_lease(connection_lease&& other) noexcept;
+
+			connection_lease& operator=(connection_lease&& other) noexcept;
+
+			~connection_lease();
+
+			/// Query if this lease currently holds a connection.
+			explicit operator bool() const noexcept { return m_socket.has_value(); }
+
+			/// The leased socket.
+			///
+			/// Behaviour is undefined if the lease does not hold a connection.
+			net::socket& socket() noexcept { return *m_socket; }
+
+			net::socket* operator->() noexcept { return &*m_socket; }
+
+			/// Close the connection instead of returning it to the pool.
+			///
+			/// This frees up the connection's slot in the pool so that a
+			/// waiting or subsequent acquire() will establish a new connection.
+			void discard() noexcept;
+
+			/// Return the connection to the pool now rather than when the
+			/// lease is destroyed.
+			void release() noexcept;
+
+		private:
+
+			friend class connection_pool;
+
+			connection_lease(connection_pool& pool, net::socket&& socket) noexcept;
+
+			connection_pool* m_pool;
+			std::optional<net::socket> m_socket;
+
+		};
+
+		/// \brief
+		/// A pool of TCP connections to a single remote end-point that
+		/// can be checked out asynchronously using 'co_await pool.acquire()'.
+		///
+		/// At most maxConnections connections are open at any one time,
+		/// counting both idle connections and those checked out. Coroutines
+		/// that call acquire() while all connections are checked out are
+		/// suspended and served in FIFO order as connections are returned.
+		///
+		/// Idle connections are reused most-recently-used first so that the
+		/// least-recently-used ones age out. Connections that have been idle
+		/// for longer than the idle timeout are closed by the next call to
+		/// acquire(), by returning a connection or by calling evict_idle().
+		///
+		/// Each idle connection is checked before being handed out. If the
+		/// peer has closed it or sent unsolicited data then it is replaced
+		/// with a new connection.
+		class connection_pool
+		{
+		public:
+
+			using clock = std::chrono::steady_clock;
+
+			/// Construct a pool of connections to \p remoteEndPoint.
+			///
+			/// No connections are established until acquire() is called.
+			///
+			/// \param ioService
+			/// The I/O service used to create and connect sockets.
+			///
+			/// \param remoteEndPoint
+			/// The end-point to connect to.
+			///
+			/// \param maxConnections
+			/// The maximum number of connections that may be open at once.
+			/// Must be at least 1.
+			///
+			/// \param idleTimeout
+			/// How long a connection may be left idle in the pool before it
+			/// is closed.
+			connection_pool(
+				io_service& ioService,
+				const ip_endpoint& remoteEndPoint,
+				std::size_t maxConnections,
+				clock::duration idleTimeout = std::chrono::seconds(60));
+
+			/// Closes all idle connections.
+			///
+			/// Behaviour is undefined if there are any outstanding leases or
+			/// coroutines still waiting in acquire().
+			~connection_pool();
+
+			connection_pool(const connection_pool&) = delete;
+			connection_pool& operator=(const connection_pool&) = delete;
+
+			/// \brief
+			/// Check out a connection from the pool.
+			///
+			/// Reuses an idle connection if there is one, otherwise
+			/// establishes a new connection if fewer than maxConnections are
+			/// open, otherwise waits until another lease returns a connection.
+			///
+			/// If the coroutine needs to wait then it is resumed inside the
+			/// call that returns or discards a connection.
+			///
+			/// \return
+			/// A task that completes with a lease holding a connected socket.
+			/// Fails with std::system_error if a new connection could not be
+			/// established, in which case its slot is freed again.
+			task<connection_lease> acquire();
+
+			/// Close idle connections that have exceeded the idle timeout.
+			///
+			/// \return
+			/// The number of connections that were closed.
+			std::size_t evict_idle();
+
+			/// The end-point that connections are established to.
+			const ip_endpoint& remote_endpoint() const noexcept { return m_remoteEndPoint; }
+
+			/// The maximum number of connections that may be open at once.
+			std::size_t max_connections() const noexcept { return m_maxConnections; }
+
+			/// The number of connections that are currently open, including
+			/// idle connections and connections being established.
+			std::size_t connection_count() const noexcept;
+
+			/// The number of idle connections currently held by the pool.
+			std::size_t idle_count() const noexcept;
+
+		private:
+
+			friend class connection_lease;
+
+			class acquire_slot_operation
+			{
+			public:
+
+				explicit acquire_slot_operation(connection_pool& pool) noexcept
+					: m_pool(pool)
+					, m_next(nullptr)
+				{}
+
+				bool await_ready() const noexcept { return false; }
+				bool await_suspend(std::coroutine_handle<> awaitingCoroutine);
+				std::optional<net::socket> await_resume() noexcept { return std::move(m_socket); }
+
+			private:
+
+				friend class connection_pool;
+
+				connection_pool& m_pool;
+				acquire_slot_operation* m_next;
+				std::coroutine_handle<> m_awaitingCoroutine;
+
+				// Set to the idle connection handed over by the pool, left empty
+				// if the operation was granted a slot to open a new connection.
+				std::optional<net::socket> m_socket;
+
+			};
+
+			struct idle_connection
+			{
+				net::socket m_socket;
+				clock::time_point m_idleSince;
+			};
+
+			/// Return a connection to the pool, or free its slot if
+			/// \p socket is empty.
+			void release(std::optional<net::socket> socket) noexcept;
+
+			/// Remove expired connections from the front of m_idleConnections.
+			///
+			/// Must be called with m_mutex held. The sockets are moved into
+			/// \p expired so that they can be closed after releasing the lock.
+			void take_expired(clock::time_point now, std::deque<idle_connection>& expired) noexcept;
+
+			task<net::socket> connect();
+
+			static bool is_healthy(net::socket& socket) noexcept;
+
+			io_service& m_ioService;
+			const ip_endpoint m_remoteEndPoint;
+			const std::size_t m_maxConnections;
+			const clock::duration m_idleTimeout;
+
+			mutable std::mutex m_mutex;
+
+			// Number of open connections, whether idle, leased or connecting.
+			std::size_t m_connectionCount;
+
+			// Ordered by the time they became idle, oldest at the front.
+			std::deque<idle_connection> m_idleConnections;
+
+			// FIFO list of suspended acquire() calls.
+			acquire_slot_operation* m_waitersHead;
+			acquire_slot_operation* m_waitersTail;
+
+		};
+	}
+}
+
+#endif
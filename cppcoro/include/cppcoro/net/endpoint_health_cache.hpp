@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_NET_ENDPOINT_HEALTH_CACHE_HPP_INCLUDED
+#define CPPCORO_NET_ENDPOINT_HEALTH_CACHE_HPP_INCLUDED
+
+#include <cppcoro/net/ip_endpoint.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <span>
+
+namespace cppcoro
+{
+	namespace net
+	{
+		/// \brief
+		/// Remembers the outcome of recent connection attempts to each end-point
+		/// so that future attempts can try the most promising end-points first.
+		///
+		/// End-points are ordered into three tiers:
+		/// - end-points that were last connected to successfully, fastest first
+		///   by their smoothed connect latency;
+		/// - end-points with no history, or whose failures have been forgiven;
+		/// - end-points that failed recently, least recently failed first.
+		///
+		/// A failed end-point is penalised for the failure penalty, doubling for
+		/// each consecutive failure up to 64 times the penalty, after which it is
+		/// tried again as if it had no history.
+		///
+		/// All methods are thread-safe.
+		class endpoint_health_cache
+		{
+		public:
+
+			using clock = std::chrono::steady_clock;
+
+			/// \param failurePenalty
+			/// How long an end-point that failed once is tried after other
+			/// end-points.
+			explicit endpoint_health_cache(
+				clock::duration failurePenalty = std::chrono::seconds(30));
+
+			endpoint_health_cache(const endpoint_health_cache&) = delete;
+			endpoint_health_cache& operator=(const endpoint_health_cache&) = delete;
+
+			/// Record that a connection to \p endPoint was established after
+			/// \p connectLatency.
+			void record_success(const ip_endpoint& endPoint, clock::duration connectLatency);
+
+			/// Record that a connection attempt to \p endPoint failed.
+			void record_failure(const ip_endpoint& endPoint);
+
+			/// Stable sort \p endPoints so the most promising are first.
+			///
+			/// End-points within the same tier that have no distinguishing
+			/// history keep their relative order.
+			void order(std::span<ip_endpoint> endPoints) const;
+
+			/// The smoothed connect latency of \p endPoint, if it was last
+			/// connected to successfully.
+			std::optional<clock::duration> latency(const ip_endpoint& endPoint) const;
+
+			/// Forget all recorded history.
+			void clear() noexcept;
+
+		private:
+
+			struct entry
+			{
+				// Exponentially weighted moving average of successful connects.
+				clock::duration m_smoothedLatency{};
+				clock::time_point m_lastFailure{};
+				std::uint32_t m_consecutiveFailures = 0;
+				bool m_hasSucceeded = false;
+			};
+
+			const clock::duration m_failurePenalty;
+
+			mutable std::mutex m_mutex;
+			std::map<ip_endpoint, entry> m_entries;
+
+		};
+	}
+}
+
+#endif
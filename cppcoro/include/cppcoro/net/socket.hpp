@@ -20,6 +20,8 @@
 
 #if CPPCORO_OS_WINNT
 # include <cppcoro/detail/win32.hpp>
+#elif CPPCORO_OS_LINUX
+# include <cppcoro/detail/linux.hpp>
 #endif
 
 namespace cppcoro
@@ -104,6 +106,24 @@ namespace cppcoro
 			/// operation completing synchronously or whether it should suspend the coroutine
 			/// and wait until the I/O completion event is dispatched to an I/O thread.
 			bool skip_completion_on_success() noexcept { return m_skipCompletionOnSuccess; }
+#elif CPPCORO_OS_LINUX
+			/// Get the file descriptor associated with this socket.
+			cppcoro::detail::lnx::fd_t native_handle() noexcept { return m_handle; }
+
+			/// Get the I/O service that dispatches readiness notifications for this socket.
+			cppcoro::io_service& service() noexcept { return *m_ioService; }
+
+			/// Readiness state used by operations that wait for the socket to
+			/// become readable (recv, recv_from, accept).
+			///
+			/// Only one such operation may be outstanding at a time.
+			cppcoro::detail::lnx::io_readiness& recv_readiness() noexcept { return m_registration->m_recv; }
+
+			/// Readiness state used by operations that wait for the socket to
+			/// become writable (send, send_to, connect).
+			///
+			/// Only one such operation may be outstanding at a time.
+			cppcoro::detail::lnx::io_readiness& send_readiness() noexcept { return m_registration->m_send; }
 #endif
 
 			/// Get the address and port of the local end-point.
@@ -251,11 +271,22 @@ namespace cppcoro
 			explicit socket(
 				cppcoro::detail::win32::socket_t handle,
 				bool skipCompletionOnSuccess) noexcept;
+#elif CPPCORO_OS_LINUX
+			explicit socket(
+				cppcoro::detail::lnx::fd_t handle,
+				cppcoro::io_service& ioService,
+				cppcoro::detail::lnx::io_registration* registration) noexcept;
+
+			void close() noexcept;
 #endif
 
 #if CPPCORO_OS_WINNT
 			cppcoro::detail::win32::socket_t m_handle;
 			bool m_skipCompletionOnSuccess;
+#elif CPPCORO_OS_LINUX
+			cppcoro::detail::lnx::fd_t m_handle;
+			cppcoro::io_service* m_ioService;
+			cppcoro::detail::lnx::io_registration* m_registration;
 #endif
 
 			ip_endpoint m_localEndPoint;
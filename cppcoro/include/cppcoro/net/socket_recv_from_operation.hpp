@@ -101,6 +101,97 @@ namespace cppcoro::net
 
 }
 
-#endif // CPPCORO_OS_WINNT
+#elif CPPCORO_OS_LINUX
+# include <cppcoro/detail/linux.hpp>
+# include <cppcoro/detail/linux_async_operation.hpp>
+
+namespace cppcoro::net
+{
+	class socket;
+
+	class socket_recv_from_operation_impl
+	{
+	public:
+
+		socket_recv_from_operation_impl(
+			socket& socket,
+			void* buffer,
+			std::size_t byteCount) noexcept
+			: m_socket(socket)
+			, m_buffer(buffer)
+			, m_byteCount(byteCount)
+		{}
+
+		bool try_start(cppcoro::detail::linux_async_operation_base& operation) noexcept;
+		void cancel(cppcoro::detail::linux_async_operation_base& operation) noexcept;
+		std::tuple<std::size_t, ip_endpoint> get_result(
+			cppcoro::detail::linux_async_operation_base& operation);
+
+	private:
+
+		socket& m_socket;
+		void* m_buffer;
+		std::size_t m_byteCount;
+
+		static constexpr std::size_t sockaddrStorageAlignment = 4;
+
+		// Storage suitable for either sockaddr_in or sockaddr_in6
+		alignas(sockaddrStorageAlignment) std::uint8_t m_sourceSockaddrStorage[28];
+		int m_sourceSockaddrLength;
+
+	};
+
+	class socket_recv_from_operation
+		: public cppcoro::detail::linux_async_operation<socket_recv_from_operation>
+	{
+	public:
+
+		socket_recv_from_operation(
+			socket& socket,
+			void* buffer,
+			std::size_t byteCount) noexcept
+			: m_impl(socket, buffer, byteCount)
+		{}
+
+	private:
+
+		friend class cppcoro::detail::linux_async_operation<socket_recv_from_operation>;
+
+		bool try_start() noexcept { return m_impl.try_start(*this); }
+		decltype(auto) get_result() { return m_impl.get_result(*this); }
+
+		socket_recv_from_operation_impl m_impl;
+
+	};
+
+	class socket_recv_from_operation_cancellable
+		: public cppcoro::detail::linux_async_operation_cancellable<socket_recv_from_operation_cancellable>
+	{
+	public:
+
+		socket_recv_from_operation_cancellable(
+			socket& socket,
+			void* buffer,
+			std::size_t byteCount,
+			cancellation_token&& ct) noexcept
+			: cppcoro::detail::linux_async_operation_cancellable<socket_recv_from_operation_cancellable>(std::move(ct))
+			, m_impl(socket, buffer, byteCount)
+		{}
+
+	private:
+
+		friend class cppcoro::detail::linux_async_operation_cancellable<socket_recv_from_operation_cancellable>;
+
+		bool try_start() noexcept { return m_impl.try_start(*this); }
+		void cancel() noexcept { m_impl.cancel(*this); }
+		decltype(auto) get_result() { return m_impl.get_result(*this); }
+
+		socket_recv_from_operation_impl m_impl;
+
+	};
+
+}
+
+#endif
 
 #endif
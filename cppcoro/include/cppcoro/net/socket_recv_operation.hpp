@@ -89,6 +89,87 @@ namespace cppcoro::net
 
 }
 
-#endif // CPPCORO_OS_WINNT
+#elif CPPCORO_OS_LINUX
+# include <cppcoro/detail/linux.hpp>
+# include <cppcoro/detail/linux_async_operation.hpp>
+
+namespace cppcoro::net
+{
+	class socket;
+
+	class socket_recv_operation_impl
+	{
+	public:
+
+		socket_recv_operation_impl(
+			socket& s,
+			void* buffer,
+			std::size_t byteCount) noexcept
+			: m_socket(s)
+			, m_buffer(buffer)
+			, m_byteCount(byteCount)
+		{}
+
+		bool try_start(cppcoro::detail::linux_async_operation_base& operation) noexcept;
+		void cancel(cppcoro::detail::linux_async_operation_base& operation) noexcept;
+
+	private:
+
+		socket& m_socket;
+		void* m_buffer;
+		std::size_t m_byteCount;
+
+	};
+
+	class socket_recv_operation
+		: public cppcoro::detail::linux_async_operation<socket_recv_operation>
+	{
+	public:
+
+		socket_recv_operation(
+			socket& s,
+			void* buffer,
+			std::size_t byteCount) noexcept
+			: m_impl(s, buffer, byteCount)
+		{}
+
+	private:
+
+		friend class cppcoro::detail::linux_async_operation<socket_recv_operation>;
+
+		bool try_start() noexcept { return m_impl.try_start(*this); }
+
+		socket_recv_operation_impl m_impl;
+
+	};
+
+	class socket_recv_operation_cancellable
+		: public cppcoro::detail::linux_async_operation_cancellable<socket_recv_operation_cancellable>
+	{
+	public:
+
+		socket_recv_operation_cancellable(
+			socket& s,
+			void* buffer,
+			std::size_t byteCount,
+			cancellation_token&& ct) noexcept
+			: cppcoro::detail::linux_async_operation_cancellable<socket_recv_operation_cancellable>(std::move(ct))
+			, m_impl(s, buffer, byteCount)
+		{}
+
+	private:
+
+		friend class cppcoro::detail::linux_async_operation_cancellable<socket_recv_operation_cancellable>;
+
+		bool try_start() noexcept { return m_impl.try_start(*this); }
+		void cancel() noexcept { m_impl.cancel(*this); }
+
+		socket_recv_operation_impl m_impl;
+
+	};
+
+}
+
+#endif
 
 #endif
@@ -0,0 +1,219 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_NET_SOCKET_SEND_QUEUE_HPP_INCLUDED
+#define CPPCORO_NET_SOCKET_SEND_QUEUE_HPP_INCLUDED
+
+#include <cppcoro/config.hpp>
+
+#if CPPCORO_OS_LINUX
+
+#include <cppcoro/net/socket.hpp>
+#include <cppcoro/detail/linux.hpp>
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+struct iovec;
+
+namespace cppcoro
+{
+	namespace net
+	{
+		class socket_send_queue_operation;
+
+		/// \brief
+		/// Serialises concurrent sends on a connected stream socket without
+		/// the callers needing to hold a lock.
+		///
+		/// Any number of coroutines may 'co_await queue.send(buffer, size)'
+		/// concurrently. Each buffer is written to the socket contiguously and
+		/// in the order the sends were queued. The buffers of all sends queued
+		/// while a write is in progress are gathered into a single sendmsg()
+		/// call, of up to IOV_MAX buffers, by whichever sender or I/O thread
+		/// is currently flushing the queue.
+		///
+		/// Senders are suspended until all of their data has been accepted by
+		/// the kernel, so the queue never copies the data and while the socket's
+		/// send buffer is full every sender is held back (backpressure).
+		/// Senders are resumed inline on the thread doing the flush, so any
+		/// sends they queue straight away join the next batch. A sender that
+		/// finds the queue idle flushes it itself, but only for a bounded
+		/// number of batches before handing the rest over to an I/O thread,
+		/// so its own send never waits on other senders that keep queueing.
+		///
+		/// The socket must not be used for other send operations while it has
+		/// a send queue, as the queue waits on the socket's send readiness.
+		///
+		/// Only available on Linux.
+		class socket_send_queue
+		{
+		public:
+
+			/// Default limit on the number of bytes gathered into one sendmsg().
+			static constexpr std::size_t default_high_water_mark = 256 * 1024;
+
+			/// Construct a send queue for \p socket.
+			///
+			/// \param socket
+			/// A connected stream socket. Must outlive the queue.
+			///
+			/// \param highWaterMark
+			/// Once this many bytes have been gathered for the next sendmsg()
+			/// call, later sends stay queued until the kernel has accepted
+			/// those bytes.
+			explicit socket_send_queue(
+				socket& socket,
+				std::size_t highWaterMark = default_high_water_mark);
+
+			/// Behaviour is undefined if there are still sends outstanding.
+			~socket_send_queue();
+
+			socket_send_queue(const socket_send_queue&) = delete;
+			socket_send_queue& operator=(const socket_send_queue&) = delete;
+
+			/// \brief
+			/// Queue \p byteCount bytes from \p buffer to be sent.
+			///
+			/// \return
+			/// An operation that must be 'co_await'ed. It completes once all of
+			/// the bytes have been written to the socket and throws a
+			/// std::system_error if the socket failed before then. The buffer
+			/// must remain valid until then.
+			socket_send_queue_operation send(const void* buffer, std::size_t byteCount) noexcept;
+
+			/// The total number of sendmsg() calls that have written data.
+			///
+			/// Useful for measuring how effectively sends are being coalesced.
+			std::uint64_t syscall_count() const noexcept
+			{
+				return m_syscallCount.load(std::memory_order_relaxed);
+			}
+
+		private:
+
+			friend class socket_send_queue_operation;
+
+			struct flush_state : detail::lnx::io_state
+			{
+				explicit flush_state(socket_send_queue& queue) noexcept
+					: detail::lnx::io_state(&socket_send_queue::on_send_ready)
+					, m_queue(queue)
+				{}
+
+				socket_send_queue& m_queue;
+			};
+
+			/// Queue \p operation, flushing the queue if it is idle.
+			///
+			/// \return
+			/// true if the awaiting coroutine should be suspended, false if
+			/// \p operation completed synchronously.
+			bool enqueue(socket_send_queue_operation* operation) noexcept;
+
+			/// Write queued data until the queue is empty, the socket's send
+			/// buffer is full, or max_batches_per_flush batches have been
+			/// written and the rest of the flush has been posted to an I/O
+			/// thread. Must only be called by the current flusher.
+			///
+			/// \param syncOperation
+			/// The operation being queued on the current thread, if any. It
+			/// is not resumed if it completes, instead the return value
+			/// indicates that it completed.
+			bool flush(socket_send_queue_operation* syncOperation) noexcept;
+
+			/// Move operations queued since the last call into the pending list.
+			///
+			/// \return
+			/// false if there were no new operations.
+			bool take_new_operations() noexcept;
+
+			static void on_send_ready(detail::lnx::io_state* state, int errorCode) noexcept;
+
+			static constexpr std::uintptr_t idle = 1;
+
+			// assume == reinterpret_cast<std::uintptr_t>(static_cast<void*>(nullptr))
+			static constexpr std::uintptr_t flushing_no_new_operations = 0;
+
+			socket& m_socket;
+			const std::size_t m_highWaterMark;
+
+			// Either idle, flushing_no_new_operations or a pointer to the head of
+			// a singly linked list of newly queued operations in most-recently
+			// queued order, while a flush is in progress.
+			std::atomic<std::uintptr_t> m_state;
+
+			std::atomic<std::uint64_t> m_syscallCount;
+
+			// The remaining fields are only accessed by the current flusher.
+
+			// Operations in the order their data is to be written.
+			socket_send_queue_operation* m_pendingHead;
+			socket_send_queue_operation* m_pendingTail;
+
+			// Number of bytes of m_pendingHead that have already been written.
+			std::size_t m_headOffset;
+
+			// Error that the socket failed with, all subsequent sends fail with it.
+			int m_errorCode;
+
+			flush_state m_flushState;
+
+			std::unique_ptr<::iovec[]> m_iovecs;
+			std::size_t m_maxIovecs;
+
+		};
+
+		class socket_send_queue_operation
+		{
+		public:
+
+			socket_send_queue_operation(
+				socket_send_queue& queue,
+				const void* buffer,
+				std::size_t byteCount) noexcept
+				: m_queue(queue)
+				, m_buffer(buffer)
+				, m_byteCount(byteCount)
+				, m_errorCode(0)
+				, m_next(nullptr)
+			{}
+
+			bool await_ready() const noexcept { return m_byteCount == 0; }
+
+			bool await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+			{
+				m_awaitingCoroutine = awaitingCoroutine;
+				return m_queue.enqueue(this);
+			}
+
+			void await_resume() const;
+
+		private:
+
+			friend class socket_send_queue;
+
+			socket_send_queue& m_queue;
+			const void* m_buffer;
+			std::size_t m_byteCount;
+			int m_errorCode;
+			socket_send_queue_operation* m_next;
+			std::coroutine_handle<> m_awaitingCoroutine;
+
+		};
+
+		inline socket_send_queue_operation
+		socket_send_queue::send(const void* buffer, std::size_t byteCount) noexcept
+		{
+			return socket_send_queue_operation{ *this, buffer, byteCount };
+		}
+	}
+}
+
+#endif // CPPCORO_OS_LINUX
+
+#endif
@@ -0,0 +1,419 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_NET_UDP_MULTIPLEXER_HPP_INCLUDED
+#define CPPCORO_NET_UDP_MULTIPLEXER_HPP_INCLUDED
+
+#include <cppcoro/config.hpp>
+
+#if CPPCORO_OS_LINUX
+
+#include <cppcoro/cancellation_source.hpp>
+#include <cppcoro/cancellation_token.hpp>
+#include <cppcoro/io_service.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/net/ip_endpoint.hpp>
+#include <cppcoro/net/socket.hpp>
+#include <cppcoro/detail/linux.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cppcoro
+{
+	namespace net
+	{
+		class udp_request_operation;
+
+		/// \brief
+		/// Correlates replies received on a UDP socket with outstanding requests
+		/// so that many coroutines can 'co_await mux.request(...)' concurrently.
+		///
+		/// Each request datagram is sent with a 4-byte request ID, in network
+		/// byte order, in front of its payload. The peer must echo those 4 bytes
+		/// at the start of its reply. A reply is matched to its request through
+		/// a fixed-size table indexed by the ID, without taking any locks, and
+		/// replies to requests that have already completed, or that don't
+		/// match any request, are dropped.
+		///
+		/// A single receive loop, run by run(), reads replies in batches of up
+		/// to receive_batch_size datagrams per recvmmsg() call and resumes the
+		/// matching requests. It also expires requests whose timeout has
+		/// elapsed, using a timer wheel with a resolution of timerResolution
+		/// rather than a timer per request. The wheel is only woken up when
+		/// the earliest outstanding timeout is due, so an idle multiplexer
+		/// does not poll.
+		///
+		/// Requests sent while the socket's send buffer is full wait, in the
+		/// order they were sent, for the socket to become writable again.
+		/// Their timeout keeps running while they wait.
+		///
+		/// The socket must not be used to send or receive datagrams by
+		/// anything else while the multiplexer exists.
+		///
+		/// Only available on Linux.
+		class udp_multiplexer
+		{
+		public:
+
+			using clock = std::chrono::steady_clock;
+
+			/// Default maximum number of requests that may be outstanding at once.
+			static constexpr std::uint32_t default_max_outstanding = 65536;
+
+			/// Default size of the largest reply that can be received, including
+			/// its 4-byte request ID.
+			static constexpr std::size_t default_max_datagram_size = 2048;
+
+			/// Maximum number of datagrams read by one recvmmsg() call.
+			static constexpr std::size_t receive_batch_size = 32;
+
+			/// \param ioService
+			/// The I/O service that timeouts are scheduled on.
+			///
+			/// \param socket
+			/// A UDP socket. Must outlive the multiplexer.
+			///
+			/// \param maxOutstanding
+			/// The maximum number of requests that may be outstanding at once.
+			/// Rounded up to a power of two.
+			///
+			/// \param maxDatagramSize
+			/// The size of the largest reply that can be received. Longer
+			/// replies complete their request with EMSGSIZE.
+			///
+			/// \param timerResolution
+			/// The granularity that request timeouts are rounded up to.
+			udp_multiplexer(
+				io_service& ioService,
+				socket& socket,
+				std::uint32_t maxOutstanding = default_max_outstanding,
+				std::size_t maxDatagramSize = default_max_datagram_size,
+				std::chrono::milliseconds timerResolution = std::chrono::milliseconds(1));
+
+			/// Behaviour is undefined if there are still requests outstanding.
+			~udp_multiplexer();
+
+			udp_multiplexer(const udp_multiplexer&) = delete;
+			udp_multiplexer& operator=(const udp_multiplexer&) = delete;
+
+			/// \brief
+			/// Receive replies and expire timed out requests until cancellation
+			/// is requested.
+			///
+			/// Requests only complete while run() is in progress. Once
+			/// cancellation is requested, any requests that are still
+			/// outstanding complete with operation_cancelled.
+			///
+			/// \return
+			/// A task that completes once cancellation has been requested and
+			/// the outstanding requests have been cancelled. Fails with a
+			/// std::system_error if receiving from the socket fails.
+			task<> run(cancellation_token ct);
+
+			/// \brief
+			/// Send a request datagram and wait for its reply.
+			///
+			/// \param destination
+			/// The end-point to send the request to.
+			///
+			/// \param payload
+			/// The request payload, sent after the request ID.
+			///
+			/// \param replyBuffer
+			/// Buffer to receive the reply payload, excluding the request ID.
+			/// Longer replies are truncated and complete with EMSGSIZE.
+			///
+			/// \param timeout
+			/// How long to wait for the reply.
+			///
+			/// \return
+			/// An operation that must be 'co_await'ed. It completes with the
+			/// size of the reply payload, or throws a std::system_error with
+			/// ETIMEDOUT if no reply arrived in time, with ENOBUFS if
+			/// maxOutstanding requests were already outstanding, or with the
+			/// error from sending the request. Throws operation_cancelled if
+			/// run() was cancelled while the request was outstanding.
+			udp_request_operation request(
+				const ip_endpoint& destination,
+				const void* payload,
+				std::size_t payloadSize,
+				void* replyBuffer,
+				std::size_t replyBufferSize,
+				std::chrono::milliseconds timeout) noexcept;
+
+			/// The number of requests that timed out.
+			std::uint64_t timed_out_count() const noexcept
+			{
+				return m_timedOutCount.load(std::memory_order_relaxed);
+			}
+
+			/// The number of received datagrams that did not match an
+			/// outstanding request, eg. late replies to timed out requests.
+			std::uint64_t unmatched_count() const noexcept
+			{
+				return m_unmatchedCount.load(std::memory_order_relaxed);
+			}
+
+			/// The number of recvmmsg() calls that returned datagrams.
+			std::uint64_t receive_syscall_count() const noexcept
+			{
+				return m_receiveSyscallCount.load(std::memory_order_relaxed);
+			}
+
+			/// The number of datagrams received.
+			std::uint64_t received_count() const noexcept
+			{
+				return m_receivedCount.load(std::memory_order_relaxed);
+			}
+
+		private:
+
+			friend class udp_request_operation;
+
+			static constexpr std::uint32_t no_slot = 0xFFFFFFFFu;
+
+			static constexpr std::uint64_t no_tick = ~std::uint64_t(0);
+
+			enum class send_state : std::uint32_t
+			{
+				idle,
+
+				// The request is being sent by the thread that published its ID.
+				sending,
+
+				// The request was claimed by try_complete() while it was being
+				// sent, so the sending thread frees the slot and resumes it.
+				completed_while_sending
+			};
+
+			enum class send_result
+			{
+				// The request was sent, or was completed by another thread.
+				in_flight,
+
+				// The request completed and its coroutine must be resumed.
+				completed,
+
+				// The socket's send buffer is full, the request was not sent.
+				would_block
+			};
+
+			struct slot
+			{
+				// ID of the request awaiting a reply in this slot, zero if none.
+				// Whoever exchanges it for zero completes the request.
+				std::atomic<std::uint32_t> m_activeId{ 0 };
+
+				std::atomic<send_state> m_sendState{ send_state::idle };
+
+				// Only accessed by the owner of the slot.
+				std::uint32_t m_generation = 0;
+				udp_request_operation* m_operation = nullptr;
+
+				std::atomic<std::uint32_t> m_nextFree{ no_slot };
+			};
+
+			struct timer_entry
+			{
+				std::uint32_t m_id;
+				std::uint64_t m_expiryTick;
+			};
+
+			struct timer_bucket
+			{
+				std::mutex m_mutex;
+				std::vector<timer_entry> m_entries;
+			};
+
+			struct send_ready_state : detail::lnx::io_state
+			{
+				explicit send_ready_state(udp_multiplexer& multiplexer) noexcept
+					: detail::lnx::io_state(&udp_multiplexer::on_send_ready)
+					, m_multiplexer(multiplexer)
+				{}
+
+				udp_multiplexer& m_multiplexer;
+			};
+
+			/// Start \p operation: assign it an ID, send it and arm its timeout.
+			///
+			/// \return
+			/// true if the operation will complete asynchronously, false if it
+			/// completed synchronously.
+			bool start(udp_request_operation* operation) noexcept;
+
+			/// Publish the ID of \p operation, which owns a slot that has not
+			/// been published yet, and send its request datagram.
+			send_result try_send(udp_request_operation* operation) noexcept;
+
+			/// Queue \p operation, whose request could not be sent, until the
+			/// socket becomes writable.
+			///
+			/// \param retry
+			/// true if called by drain_blocked_sends(), in which case the
+			/// operation goes back to the front of the queue.
+			void block(udp_request_operation* operation, bool retry) noexcept;
+
+			/// Send blocked requests until the queue is empty or the socket's
+			/// send buffer is full again.
+			void drain_blocked_sends() noexcept;
+
+			void wait_until_writable() noexcept;
+
+			static void on_send_ready(detail::lnx::io_state* state, int errorCode) noexcept;
+
+			/// Complete blocked requests with \p errorCode, all of them if
+			/// \p now is null, otherwise those whose deadline is not after it.
+			///
+			/// \return
+			/// The number of requests completed.
+			std::size_t complete_blocked(int errorCode, const clock::time_point* now) noexcept;
+
+			/// Complete the request with \p id if it is still outstanding.
+			bool try_complete(
+				std::uint32_t id,
+				int errorCode,
+				const std::byte* reply,
+				std::size_t replySize) noexcept;
+
+			std::uint32_t allocate_slot() noexcept;
+			void free_slot(std::uint32_t index) noexcept;
+
+			std::uint64_t to_tick(clock::time_point time, bool roundUp) const noexcept;
+			void arm_timeout(std::uint32_t id, clock::time_point deadline);
+
+			/// \return
+			/// The earliest tick that a timeout is still armed for, or
+			/// no_tick if there are none.
+			std::uint64_t expire_timeouts(clock::time_point now);
+
+			std::uint64_t find_next_tick(std::uint64_t fromTick);
+
+			task<> receive_loop(cancellation_token ct);
+			task<> timer_loop(cancellation_token ct);
+
+			io_service& m_ioService;
+			socket& m_socket;
+			const std::size_t m_maxDatagramSize;
+			const clock::duration m_timerResolution;
+			const clock::time_point m_epoch;
+
+			std::uint32_t m_indexBits;
+			std::uint32_t m_indexMask;
+			std::unique_ptr<slot[]> m_slots;
+
+			// Head of the free slot list. The low 32 bits are the slot index and
+			// the high 32 bits a tag that is incremented by every push to avoid
+			// the ABA problem.
+			std::atomic<std::uint64_t> m_freeHead;
+
+			std::unique_ptr<timer_bucket[]> m_timerBuckets;
+			std::size_t m_timerBucketMask;
+
+			// Timer ticks up to and including this one have been processed.
+			std::atomic<std::uint64_t> m_lastExpiredTick;
+
+			// The tick that the timer loop is sleeping until, or no_tick.
+			// Arming an earlier timeout cancels m_wakeSource to wake it up.
+			std::atomic<std::uint64_t> m_sleepTick;
+			std::mutex m_wakeMutex;
+			cancellation_source m_wakeSource;
+
+			// Requests waiting for the socket to become writable, oldest first.
+			std::mutex m_blockedMutex;
+			udp_request_operation* m_blockedHead;
+			udp_request_operation* m_blockedTail;
+
+			// Whether a drain_blocked_sends() call is waiting for, or handling,
+			// the socket becoming writable.
+			bool m_drainScheduled;
+
+			send_ready_state m_sendReadyState;
+
+			std::atomic<std::uint64_t> m_timedOutCount;
+			std::atomic<std::uint64_t> m_unmatchedCount;
+			std::atomic<std::uint64_t> m_receiveSyscallCount;
+			std::atomic<std::uint64_t> m_receivedCount;
+
+		};
+
+		class udp_request_operation
+		{
+		public:
+
+			udp_request_operation(
+				udp_multiplexer& multiplexer,
+				const ip_endpoint& destination,
+				const void* payload,
+				std::size_t payloadSize,
+				void* replyBuffer,
+				std::size_t replyBufferSize,
+				std::chrono::milliseconds timeout) noexcept
+				: m_multiplexer(multiplexer)
+				, m_destination(destination)
+				, m_payload(payload)
+				, m_payloadSize(payloadSize)
+				, m_replyBuffer(replyBuffer)
+				, m_replyBufferSize(replyBufferSize)
+				, m_timeout(timeout)
+				, m_errorCode(0)
+				, m_replySize(0)
+				, m_id(0)
+				, m_nextBlocked(nullptr)
+			{}
+
+			bool await_ready() const noexcept { return false; }
+
+			bool await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+			{
+				m_awaitingCoroutine = awaitingCoroutine;
+				return m_multiplexer.start(this);
+			}
+
+			std::size_t await_resume() const;
+
+		private:
+
+			friend class udp_multiplexer;
+
+			udp_multiplexer& m_multiplexer;
+			ip_endpoint m_destination;
+			const void* m_payload;
+			std::size_t m_payloadSize;
+			void* m_replyBuffer;
+			std::size_t m_replyBufferSize;
+			std::chrono::milliseconds m_timeout;
+			int m_errorCode;
+			std::size_t m_replySize;
+			std::uint32_t m_id;
+			udp_multiplexer::clock::time_point m_deadline;
+			udp_request_operation* m_nextBlocked;
+			std::coroutine_handle<> m_awaitingCoroutine;
+
+		};
+
+		inline udp_request_operation udp_multiplexer::request(
+			const ip_endpoint& destination,
+			const void* payload,
+			std::size_t payloadSize,
+			void* replyBuffer,
+			std::size_t replyBufferSize,
+			std::chrono::milliseconds timeout) noexcept
+		{
+			return udp_request_operation{
+				*this, destination, payload, payloadSize, replyBuffer, replyBufferSize, timeout };
+		}
+	}
+}
+
+#endif // CPPCORO_OS_LINUX
+
+#endif
@@ -0,0 +1,496 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_OBJECT_POOL_HPP_INCLUDED
+#define CPPCORO_OBJECT_POOL_HPP_INCLUDED
+
+#include <cppcoro/static_thread_pool.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace cppcoro
+{
+	/// \brief
+	/// A fixed-size pool of reusable objects that coroutines can check out,
+	/// suspending while all of the objects are in use.
+	///
+	/// Each thread of the associated static_thread_pool keeps a small cache
+	/// (a "magazine") of free objects, so that checking an object out and
+	/// back in on a pool thread is normally a single compare-exchange on a
+	/// cache line that only that thread writes to. Caches are refilled from,
+	/// and overflow into, a shared depot in batches of \c magazineSize
+	/// objects. Threads outside the thread pool use the depot directly.
+	///
+	/// If both the depot and the calling thread's cache are empty then the
+	/// other threads' caches are raided before the caller is queued, and
+	/// while anyone is queued objects are released to the depot, where they
+	/// are handed to the queued coroutines in FIFO order. So a coroutine only
+	/// waits while every object is checked out.
+	///
+	/// The objects are created up front and are destroyed with the pool.
+	/// The pool must not be destroyed while objects are checked out or
+	/// coroutines are waiting for one.
+	template<typename T>
+	class object_pool
+	{
+		struct slot
+		{
+			template<typename FACTORY>
+			explicit slot(FACTORY& factory)
+				: m_value(factory())
+				, m_next(nullptr)
+			{}
+
+			T m_value;
+
+			// Atomic because a thread that loses a race to pop this slot from
+			// a cache may still read it after another thread has taken it.
+			std::atomic<slot*> m_next;
+		};
+
+		struct alignas(64) thread_cache
+		{
+			// Stack of free slots. Only the owning thread pushes or pops, but
+			// other threads may take the whole stack at once.
+			std::atomic<slot*> m_head{ nullptr };
+
+			// Approximate size of the stack, only accessed by the owning thread.
+			std::size_t m_count = 0;
+		};
+
+	public:
+
+		class lease;
+		class acquire_operation;
+
+		/// Construct a pool of \p capacity objects, each created by calling
+		/// \p factory.
+		///
+		/// \param threadPool
+		/// The thread pool whose threads each get their own cache.
+		///
+		/// \param magazineSize
+		/// The number of objects moved between a thread's cache and the depot
+		/// at a time. A thread's cache holds up to twice this many objects.
+		template<typename FACTORY>
+			requires std::invocable<FACTORY&> && std::same_as<std::invoke_result_t<FACTORY&>, T>
+		object_pool(
+			static_thread_pool& threadPool,
+			std::size_t capacity,
+			FACTORY&& factory,
+			std::size_t magazineSize = 16)
+			: m_threadPool(threadPool)
+			, m_magazineSize(magazineSize > 0 ? magazineSize : 1)
+			, m_caches(std::make_unique<thread_cache[]>(threadPool.thread_count()))
+			, m_waiterCount(0)
+			, m_depotHead(nullptr)
+			, m_waitersHead(nullptr)
+			, m_waitersTail(nullptr)
+		{
+			m_slots.reserve(capacity);
+			for (std::size_t i = 0; i < capacity; ++i)
+			{
+				m_slots.push_back(std::make_unique<slot>(factory));
+				m_slots.back()->m_next.store(m_depotHead, std::memory_order_relaxed);
+				m_depotHead = m_slots.back().get();
+			}
+		}
+
+		object_pool(const object_pool&) = delete;
+		object_pool& operator=(const object_pool&) = delete;
+
+		/// \brief
+		/// Check out an object, suspending until one is available.
+		///
+		/// \return
+		/// An operation that must be awaited. The result of the co_await
+		/// is a lease that returns the object to the pool when destroyed.
+		[[nodiscard]]
+		acquire_operation acquire() noexcept { return acquire_operation{ *this }; }
+
+		/// \brief
+		/// Attempt to check out an object without waiting.
+		///
+		/// \return
+		/// A lease on the object, or an empty lease if all of the objects
+		/// are checked out.
+		[[nodiscard]]
+		lease try_acquire() noexcept
+		{
+			slot* s = try_pop_cached();
+			if (s == nullptr)
+			{
+				std::scoped_lock lock{ m_depotMutex };
+				s = take_from_depot_locked();
+				if (s == nullptr)
+				{
+					s = steal_locked();
+				}
+			}
+
+			return s != nullptr ? lease{ *this, s } : lease{};
+		}
+
+		/// The total number of objects owned by the pool.
+		std::size_t capacity() const noexcept { return m_slots.size(); }
+
+	private:
+
+		/// Pop a slot from the calling thread's cache, if it has one.
+		slot* try_pop_cached() noexcept
+		{
+			const std::uint32_t index = m_threadPool.current_thread_index();
+			if (index == m_threadPool.thread_count())
+			{
+				return nullptr;
+			}
+
+			auto& cache = m_caches[index];
+			slot* head = cache.m_head.load(std::memory_order_acquire);
+			while (head != nullptr)
+			{
+				// No ABA problem here as only this thread pushes onto the cache,
+				// other threads only ever swap the whole stack for nullptr.
+				if (cache.m_head.compare_exchange_weak(
+					head,
+					head->m_next.load(std::memory_order_relaxed),
+					std::memory_order_acquire,
+					std::memory_order_acquire))
+				{
+					if (cache.m_count > 0)
+					{
+						--cache.m_count;
+					}
+					return head;
+				}
+			}
+
+			return nullptr;
+		}
+
+		/// Take a slot from the depot, moving up to a magazine's worth more
+		/// into the calling thread's cache if it is a thread pool thread.
+		///
+		/// Must be called with the depot lock held, after finding the cache
+		/// empty.
+		slot* take_from_depot_locked() noexcept
+		{
+			slot* s = m_depotHead;
+			if (s == nullptr)
+			{
+				return nullptr;
+			}
+			m_depotHead = s->m_next.load(std::memory_order_relaxed);
+
+			const std::uint32_t index = m_threadPool.current_thread_index();
+			if (index == m_threadPool.thread_count() || m_depotHead == nullptr)
+			{
+				return s;
+			}
+
+			slot* first = m_depotHead;
+			slot* last = first;
+			std::size_t count = 1;
+			while (count < m_magazineSize)
+			{
+				slot* next = last->m_next.load(std::memory_order_relaxed);
+				if (next == nullptr)
+				{
+					break;
+				}
+				last = next;
+				++count;
+			}
+
+			m_depotHead = last->m_next.load(std::memory_order_relaxed);
+			last->m_next.store(nullptr, std::memory_order_relaxed);
+
+			// Nothing else pushes onto our cache and it was empty, so there's
+			// no need to splice onto whatever is there.
+			auto& cache = m_caches[index];
+			cache.m_head.store(first, std::memory_order_release);
+			cache.m_count = count;
+
+			return s;
+		}
+
+		/// Take a slot from another thread's cache, moving the rest of that
+		/// cache into the depot.
+		///
+		/// Must be called with the depot lock held.
+		slot* steal_locked() noexcept
+		{
+			const std::uint32_t threadCount = m_threadPool.thread_count();
+			for (std::uint32_t i = 0; i < threadCount; ++i)
+			{
+				slot* head = m_caches[i].m_head.exchange(nullptr, std::memory_order_seq_cst);
+				if (head != nullptr)
+				{
+					push_to_depot_locked(head->m_next.load(std::memory_order_relaxed));
+					return head;
+				}
+			}
+
+			return nullptr;
+		}
+
+		/// Must be called with the depot lock held.
+		void push_to_depot_locked(slot* chain) noexcept
+		{
+			while (chain != nullptr)
+			{
+				slot* next = chain->m_next.load(std::memory_order_relaxed);
+				chain->m_next.store(m_depotHead, std::memory_order_relaxed);
+				m_depotHead = chain;
+				chain = next;
+			}
+		}
+
+		/// Called from acquire_operation::await_suspend() once the calling
+		/// thread's cache turned out to be empty.
+		///
+		/// Returns true if the operation was queued, or false if it got a
+		/// slot after all.
+		bool acquire_slow(acquire_operation* operation) noexcept
+		{
+			{
+				std::scoped_lock lock{ m_depotMutex };
+
+				slot* s = take_from_depot_locked();
+				if (s == nullptr)
+				{
+					// Announce the waiter before raiding the caches. A thread that
+					// releases into its cache after we've looked at it will see
+					// the count and flush its cache into the depot instead.
+					m_waiterCount.fetch_add(1, std::memory_order_seq_cst);
+					s = steal_locked();
+					if (s == nullptr)
+					{
+						operation->m_next = nullptr;
+						if (m_waitersTail == nullptr)
+						{
+							m_waitersHead = operation;
+						}
+						else
+						{
+							m_waitersTail->m_next = operation;
+						}
+						m_waitersTail = operation;
+						return true;
+					}
+
+					m_waiterCount.fetch_sub(1, std::memory_order_relaxed);
+				}
+
+				operation->m_slot = s;
+			}
+
+			return false;
+		}
+
+		void release(slot* s) noexcept
+		{
+			const std::uint32_t index = m_threadPool.current_thread_index();
+			if (index == m_threadPool.thread_count())
+			{
+				s->m_next.store(nullptr, std::memory_order_relaxed);
+				release_to_depot(s);
+				return;
+			}
+
+			auto& cache = m_caches[index];
+			slot* head = cache.m_head.load(std::memory_order_relaxed);
+			do
+			{
+				s->m_next.store(head, std::memory_order_relaxed);
+			} while (!cache.m_head.compare_exchange_weak(
+				head,
+				s,
+				std::memory_order_seq_cst,
+				std::memory_order_relaxed));
+
+			if (++cache.m_count >= 2 * m_magazineSize ||
+				m_waiterCount.load(std::memory_order_seq_cst) != 0)
+			{
+				cache.m_count = 0;
+				release_to_depot(cache.m_head.exchange(nullptr, std::memory_order_acquire));
+			}
+		}
+
+		/// Hand the slots in \p chain to queued coroutines, oldest first, and
+		/// put any left over into the depot.
+		void release_to_depot(slot* chain) noexcept
+		{
+			acquire_operation* toResume = nullptr;
+
+			{
+				std::scoped_lock lock{ m_depotMutex };
+
+				acquire_operation** toResumeTail = &toResume;
+				while (chain != nullptr && m_waitersHead != nullptr)
+				{
+					acquire_operation* waiter = m_waitersHead;
+					m_waitersHead = waiter->m_next;
+					if (m_waitersHead == nullptr)
+					{
+						m_waitersTail = nullptr;
+					}
+					m_waiterCount.fetch_sub(1, std::memory_order_relaxed);
+
+					waiter->m_slot = chain;
+					chain = chain->m_next.load(std::memory_order_relaxed);
+
+					waiter->m_next = nullptr;
+					*toResumeTail = waiter;
+					toResumeTail = &waiter->m_next;
+				}
+
+				push_to_depot_locked(chain);
+			}
+
+			while (toResume != nullptr)
+			{
+				// Read next before resuming, as resuming the coroutine will
+				// destroy the operation.
+				acquire_operation* next = toResume->m_next;
+				toResume->m_awaitingCoroutine.resume();
+				toResume = next;
+			}
+		}
+
+		static_thread_pool& m_threadPool;
+		const std::size_t m_magazineSize;
+
+		const std::unique_ptr<thread_cache[]> m_caches;
+
+		// Number of queued acquire operations.
+		std::atomic<std::size_t> m_waiterCount;
+
+		std::mutex m_depotMutex;
+		slot* m_depotHead;
+		acquire_operation* m_waitersHead;
+		acquire_operation* m_waitersTail;
+
+		std::vector<std::unique_ptr<slot>> m_slots;
+
+	};
+
+	template<typename T>
+	class object_pool<T>::acquire_operation
+	{
+	public:
+
+		explicit acquire_operation(object_pool& pool) noexcept
+			: m_pool(pool)
+		{}
+
+		bool await_ready() noexcept
+		{
+			m_slot = m_pool.try_pop_cached();
+			return m_slot != nullptr;
+		}
+
+		bool await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+		{
+			m_awaitingCoroutine = awaitingCoroutine;
+			return m_pool.acquire_slow(this);
+		}
+
+		[[nodiscard]]
+		lease await_resume() noexcept
+		{
+			return lease{ m_pool, m_slot };
+		}
+
+	private:
+
+		friend class object_pool;
+
+		object_pool& m_pool;
+		slot* m_slot = nullptr;
+		acquire_operation* m_next = nullptr;
+		std::coroutine_handle<> m_awaitingCoroutine;
+
+	};
+
+	/// \brief
+	/// RAII object that returns a checked out object to its pool when
+	/// it goes out of scope.
+	template<typename T>
+	class object_pool<T>::lease
+	{
+	public:
+
+		/// Construct an empty lease.
+		lease() noexcept
+			: m_pool(nullptr)
+			, m_slot(nullptr)
+		{}
+
+		lease(lease&& other) noexcept
+			: m_pool(std::exchange(other.m_pool, nullptr))
+			, m_slot(std::exchange(other.m_slot, nullptr))
+		{}
+
+		lease& operator=(lease&& other) noexcept
+		{
+			if (this != &other)
+			{
+				reset();
+				m_pool = std::exchange(other.m_pool, nullptr);
+				m_slot = std::exchange(other.m_slot, nullptr);
+			}
+			return *this;
+		}
+
+		// Leases are non-copyable.
+		lease(const lease&) = delete;
+		lease& operator=(const lease&) = delete;
+
+		~lease()
+		{
+			reset();
+		}
+
+		/// Return the object to the pool, if the lease holds one.
+		void reset() noexcept
+		{
+			if (m_slot != nullptr)
+			{
+				m_pool->release(std::exchange(m_slot, nullptr));
+				m_pool = nullptr;
+			}
+		}
+
+		explicit operator bool() const noexcept { return m_slot != nullptr; }
+
+		T& operator*() const noexcept { assert(m_slot != nullptr); return m_slot->m_value; }
+		T* operator->() const noexcept { return &**this; }
+		T* get() const noexcept { return m_slot != nullptr ? &m_slot->m_value : nullptr; }
+
+	private:
+
+		friend class object_pool;
+
+		lease(object_pool& pool, slot* s) noexcept
+			: m_pool(&pool)
+			, m_slot(s)
+		{}
+
+		object_pool* m_pool;
+		slot* m_slot;
+
+	};
+}
+
+#endif
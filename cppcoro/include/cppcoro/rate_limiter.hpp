@@ -0,0 +1,209 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_RATE_LIMITER_HPP_INCLUDED
+#define CPPCORO_RATE_LIMITER_HPP_INCLUDED
+
+#include <cppcoro/static_thread_pool.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace cppcoro
+{
+	class rate_limiter_acquire_operation;
+
+	/// \brief
+	/// A token-bucket rate limiter that coroutines can wait on.
+	///
+	/// Permits are released at a steady \c permitsPerSecond, and up to
+	/// \c burst unused permits accumulate for callers to use at once.
+	///
+	/// The bucket is kept as a single atomic "theoretical arrival time", the
+	/// time at which the bucket would be full again (the generic cell rate
+	/// algorithm). Acquiring permits just moves that time on, with a
+	/// compare-exchange, or a plain fetch_add while the limiter is saturated,
+	/// and the permits may be used as soon as the new time is within one
+	/// burst of now. So acquiring never takes a lock, and callers that have
+	/// to wait have already reserved their permits, in FIFO order.
+	///
+	/// Waiting coroutines are handed to an internal timer thread, which
+	/// sleeps until the earliest is due and then schedules it back onto the
+	/// thread pool, so no thread pool thread ever blocks.
+	///
+	/// With \c shardCount > 1 the rate and burst are split between that many
+	/// independent buckets, each on its own cache line. A thread pool thread
+	/// acquires from the bucket for its thread index, only trying the other
+	/// buckets if its own would make it wait, so high global rates don't all
+	/// contend on one atomic. Waiters are then only in FIFO order with the
+	/// other waiters on the same bucket. Use thread_count() of the pool as
+	/// the shard count to give every thread its own bucket.
+	class rate_limiter
+	{
+	public:
+
+		/// Construct a rate limiter that starts with a full bucket.
+		///
+		/// \param threadPool
+		/// The thread pool that waiting coroutines are resumed on.
+		///
+		/// \param permitsPerSecond
+		/// The rate at which permits are released. Must be positive.
+		///
+		/// \param burst
+		/// The maximum number of permits that can be acquired at once without
+		/// waiting. Treated as 1 if zero.
+		///
+		/// \param shardCount
+		/// The number of buckets to spread the rate over.
+		rate_limiter(
+			static_thread_pool& threadPool,
+			double permitsPerSecond,
+			std::size_t burst,
+			std::uint32_t shardCount = 1);
+
+		/// Destroys the rate limiter.
+		///
+		/// Behaviour is undefined if any coroutines are still waiting.
+		~rate_limiter();
+
+		rate_limiter(const rate_limiter&) = delete;
+		rate_limiter& operator=(const rate_limiter&) = delete;
+
+		/// \brief
+		/// Acquire \p count permits, suspending until they are available.
+		///
+		/// The permits are reserved when the operation is awaited, so can't
+		/// be handed back if the awaiting coroutine is destroyed. If \p count
+		/// is more than the burst size then the caller always waits.
+		///
+		/// \return
+		/// An operation that must be awaited. If the permits are available
+		/// straight away then the awaiting coroutine continues without
+		/// suspending, otherwise it is resumed on the thread pool.
+		[[nodiscard]]
+		rate_limiter_acquire_operation acquire(std::size_t count = 1) noexcept;
+
+		/// \brief
+		/// Attempt to acquire \p count permits without waiting.
+		///
+		/// \return
+		/// true if the permits were acquired, false if the caller would have
+		/// had to wait, in which case nothing is reserved.
+		bool try_acquire(std::size_t count = 1) noexcept;
+
+		std::uint32_t shard_count() const noexcept { return m_shardCount; }
+
+	private:
+
+		friend class rate_limiter_acquire_operation;
+
+		struct alignas(64) bucket
+		{
+			// Nanoseconds on the steady clock at which the bucket is full again.
+			std::atomic<std::int64_t> m_theoreticalArrivalTime{ 0 };
+
+			double m_nanosecondsPerPermit = 0;
+
+			// How far ahead of now the theoretical arrival time is allowed to
+			// get, ie. the time it takes to release a full burst.
+			std::int64_t m_burstWindow = 0;
+
+			/// Reserve \p count permits and return the time they may be used.
+			std::int64_t reserve(std::size_t count, std::int64_t now) noexcept;
+
+			/// Reserve \p count permits, if they may be used by \p now.
+			bool try_reserve(std::size_t count, std::int64_t now) noexcept;
+
+			std::int64_t cost(std::size_t count) const noexcept;
+		};
+
+		static std::int64_t now() noexcept
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		std::uint32_t home_shard() noexcept;
+
+		std::int64_t reserve(std::size_t count, std::int64_t now) noexcept;
+
+		void wait(rate_limiter_acquire_operation* operation) noexcept;
+
+		void run_timer() noexcept;
+
+		static_thread_pool& m_threadPool;
+
+		const std::uint32_t m_shardCount;
+		const std::unique_ptr<bucket[]> m_buckets;
+
+		// Used to spread threads outside the thread pool over the shards.
+		std::atomic<std::uint32_t> m_nextShard;
+
+		// Protects the timer thread's list of waiting operations, which is
+		// kept sorted by due time.
+		std::mutex m_timerMutex;
+		std::condition_variable m_timerWake;
+		rate_limiter_acquire_operation* m_waitersHead;
+		rate_limiter_acquire_operation* m_waitersTail;
+		bool m_stopRequested;
+
+		std::thread m_timerThread;
+
+	};
+
+	class rate_limiter_acquire_operation
+	{
+	public:
+
+		rate_limiter_acquire_operation(rate_limiter& limiter, std::size_t count) noexcept
+			: m_limiter(limiter)
+			, m_count(count)
+			, m_schedule(&limiter.m_threadPool)
+		{}
+
+		bool await_ready() noexcept
+		{
+			const auto now = rate_limiter::now();
+			m_due = m_limiter.reserve(m_count, now);
+			return m_due <= now;
+		}
+
+		void await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+		{
+			m_awaitingCoroutine = awaitingCoroutine;
+			m_limiter.wait(this);
+		}
+
+		void await_resume() const noexcept {}
+
+	private:
+
+		friend class rate_limiter;
+
+		rate_limiter& m_limiter;
+		std::size_t m_count;
+		std::int64_t m_due;
+		rate_limiter_acquire_operation* m_next;
+		std::coroutine_handle<> m_awaitingCoroutine;
+
+		// Used by the timer thread to hand the coroutine back to the pool.
+		static_thread_pool::schedule_operation m_schedule;
+
+	};
+
+	inline rate_limiter_acquire_operation rate_limiter::acquire(std::size_t count) noexcept
+	{
+		return rate_limiter_acquire_operation{ *this, count };
+	}
+}
+
+#endif
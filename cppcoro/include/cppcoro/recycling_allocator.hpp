@@ -0,0 +1,173 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_RECYCLING_ALLOCATOR_HPP_INCLUDED
+#define CPPCORO_RECYCLING_ALLOCATOR_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+namespace cppcoro
+{
+	/// \brief
+	/// Keeps freed blocks of memory for reuse by later allocations of exactly
+	/// the same size.
+	///
+	/// Meant for the frames of many short-lived coroutines of the same kind,
+	/// such as a generator created once per input record, which all need the
+	/// same size of frame. Allocate from it with a recycling_allocator passed
+	/// to the coroutine after \c std::allocator_arg.
+	///
+	/// A pool keeps free lists for a few distinct block sizes. Blocks of any
+	/// other size come from and go back to the global heap.
+	///
+	/// A pool is not thread-safe. Use one per thread. It must outlive every
+	/// block allocated from it.
+	class recycling_pool
+	{
+	public:
+
+		/// Construct a pool that keeps at most \p maxFreeBlocksPerSize free
+		/// blocks of each size.
+		explicit recycling_pool(std::size_t maxFreeBlocksPerSize = 256) noexcept;
+
+		/// Frees the blocks the pool is keeping.
+		~recycling_pool();
+
+		recycling_pool(const recycling_pool&) = delete;
+		recycling_pool& operator=(const recycling_pool&) = delete;
+
+		/// \throw std::bad_alloc
+		void* allocate(std::size_t size)
+		{
+			for (auto& list : m_freeLists)
+			{
+				if (list.m_blockSize == size && list.m_head != nullptr)
+				{
+					free_block* block = list.m_head;
+					list.m_head = block->m_next;
+					--list.m_count;
+					return block;
+				}
+			}
+
+			return ::operator new(block_size(size));
+		}
+
+		void deallocate(void* block, std::size_t size) noexcept
+		{
+			for (auto& list : m_freeLists)
+			{
+				if (list.m_blockSize == size && list.m_count < m_maxFreeBlocksPerSize)
+				{
+					list.m_head = ::new (block) free_block{ list.m_head };
+					++list.m_count;
+					return;
+				}
+			}
+
+			deallocate_slow(block, size);
+		}
+
+		/// The number of freed blocks being kept for reuse.
+		std::size_t free_block_count() const noexcept;
+
+	private:
+
+		struct free_block
+		{
+			free_block* m_next;
+		};
+
+		struct free_list
+		{
+			// Zero while the list isn't being used for any size.
+			std::size_t m_blockSize = 0;
+			free_block* m_head = nullptr;
+			std::size_t m_count = 0;
+		};
+
+		static constexpr std::size_t free_list_count = 4;
+
+		static std::size_t block_size(std::size_t size) noexcept
+		{
+			return size < sizeof(free_block) ? sizeof(free_block) : size;
+		}
+
+		void deallocate_slow(void* block, std::size_t size) noexcept;
+
+		const std::size_t m_maxFreeBlocksPerSize;
+		free_list m_freeLists[free_list_count];
+
+	};
+
+	/// \brief
+	/// A standard allocator that allocates from a recycling_pool.
+	///
+	/// Copies allocate from the same pool.
+	template<typename T>
+	class recycling_allocator
+	{
+		static_assert(
+			alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+			"recycling_allocator doesn't support over-aligned types");
+
+	public:
+
+		using value_type = T;
+
+		explicit recycling_allocator(recycling_pool& pool) noexcept
+			: m_pool(&pool)
+		{}
+
+		template<typename U>
+		recycling_allocator(const recycling_allocator<U>& other) noexcept
+			: m_pool(other.m_pool)
+		{}
+
+		T* allocate(std::size_t count)
+		{
+			if (count > std::numeric_limits<std::size_t>::max() / sizeof(T))
+			{
+				throw std::bad_array_new_length{};
+			}
+
+			return static_cast<T*>(m_pool->allocate(count * sizeof(T)));
+		}
+
+		void deallocate(T* pointer, std::size_t count) noexcept
+		{
+			m_pool->deallocate(pointer, count * sizeof(T));
+		}
+
+		recycling_pool& pool() const noexcept
+		{
+			return *m_pool;
+		}
+
+		template<typename U>
+		bool operator==(const recycling_allocator<U>& other) const noexcept
+		{
+			return m_pool == other.m_pool;
+		}
+
+		template<typename U>
+		bool operator!=(const recycling_allocator<U>& other) const noexcept
+		{
+			return m_pool != other.m_pool;
+		}
+
+	private:
+
+		template<typename U>
+		friend class recycling_allocator;
+
+		recycling_pool* m_pool;
+
+	};
+}
+
+#endif
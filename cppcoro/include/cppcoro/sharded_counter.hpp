@@ -0,0 +1,99 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_SHARDED_COUNTER_HPP_INCLUDED
+#define CPPCORO_SHARDED_COUNTER_HPP_INCLUDED
+
+#include <cppcoro/config.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/detail/shard_selector.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace cppcoro
+{
+	/// \brief
+	/// A counter that many threads can increment without contending on the
+	/// same cache line.
+	///
+	/// The count is split over shards, each on its own cache line. Each
+	/// thread of the thread pool the counter was constructed with has a
+	/// shard that only it writes, so incrementing it is a plain load and
+	/// store rather than an atomic read-modify-write. Other threads share a
+	/// few more shards, picked by a hash of the thread, which they increment
+	/// atomically.
+	///
+	/// value() adds up the shards. It includes every increment that
+	/// happened before the call to value(), and may include some that are
+	/// concurrent with it.
+	class sharded_counter
+	{
+	public:
+
+		/// The number of shards shared by threads that aren't in the pool.
+		static constexpr std::uint32_t default_shared_shard_count = 8;
+
+		/// Construct a counter with just the shared shards.
+		explicit sharded_counter(std::uint32_t sharedShardCount = default_shared_shard_count);
+
+		/// Construct a counter with a shard for each of \p threadPool's
+		/// threads, plus the shared shards. The thread pool must outlive the
+		/// counter.
+		explicit sharded_counter(
+			static_thread_pool& threadPool,
+			std::uint32_t sharedShardCount = default_shared_shard_count);
+
+		sharded_counter(const sharded_counter&) = delete;
+		sharded_counter& operator=(const sharded_counter&) = delete;
+
+		void add(std::uint64_t amount) noexcept
+		{
+			const std::uint32_t index = m_selector.current_shard();
+			std::atomic<std::uint64_t>& count = m_shards[index].m_count;
+			if (m_selector.is_exclusive(index))
+			{
+				count.store(count.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+			}
+			else
+			{
+				count.fetch_add(amount, std::memory_order_relaxed);
+			}
+		}
+
+		void increment() noexcept
+		{
+			add(1);
+		}
+
+		sharded_counter& operator++() noexcept
+		{
+			add(1);
+			return *this;
+		}
+
+		sharded_counter& operator+=(std::uint64_t amount) noexcept
+		{
+			add(amount);
+			return *this;
+		}
+
+		/// The total of all the shards.
+		std::uint64_t value() const noexcept;
+
+	private:
+
+		struct alignas(CPPCORO_CPU_CACHE_LINE) shard
+		{
+			std::atomic<std::uint64_t> m_count{ 0 };
+		};
+
+		detail::shard_selector m_selector;
+		std::unique_ptr<shard[]> m_shards;
+
+	};
+}
+
+#endif
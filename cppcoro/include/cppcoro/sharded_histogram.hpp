@@ -0,0 +1,141 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_SHARDED_HISTOGRAM_HPP_INCLUDED
+#define CPPCORO_SHARDED_HISTOGRAM_HPP_INCLUDED
+
+#include <cppcoro/config.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/detail/shard_selector.hpp>
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace cppcoro
+{
+	/// \brief
+	/// The counts of a sharded_histogram's buckets, added up over its
+	/// shards.
+	///
+	/// Bucket 0 counts zeros. Bucket i, for i > 0, counts values in
+	/// [2^(i-1), 2^i).
+	class histogram_snapshot
+	{
+	public:
+
+		static constexpr std::size_t bucket_count = 65;
+
+		histogram_snapshot() noexcept
+			: m_buckets{}
+			, m_sum(0)
+		{}
+
+		/// The number of values recorded.
+		std::uint64_t count() const noexcept;
+
+		/// The sum of the values recorded, modulo 2^64.
+		std::uint64_t sum() const noexcept { return m_sum; }
+
+		std::uint64_t bucket(std::size_t index) const noexcept { return m_buckets[index]; }
+
+		/// The smallest value that goes in bucket \p index.
+		static std::uint64_t bucket_lower_bound(std::size_t index) noexcept
+		{
+			return index == 0 ? 0 : std::uint64_t(1) << (index - 1);
+		}
+
+		/// The largest value that goes in bucket \p index.
+		static std::uint64_t bucket_upper_bound(std::size_t index) noexcept
+		{
+			return index == 0 ? 0 : ~std::uint64_t(0) >> (bucket_count - 1 - index);
+		}
+
+		/// \brief
+		/// An upper bound on the value below which a fraction \p quantile of
+		/// the recorded values lie.
+		///
+		/// This is the upper bound of the bucket that value falls in, so it is
+		/// at most twice the true value. Returns 0 if nothing was recorded.
+		std::uint64_t value_at_quantile(double quantile) const noexcept;
+
+	private:
+
+		friend class sharded_histogram;
+
+		std::array<std::uint64_t, bucket_count> m_buckets;
+		std::uint64_t m_sum;
+
+	};
+
+	/// \brief
+	/// A histogram of values, such as latencies in nanoseconds, that many
+	/// threads can record into without contending on the same cache lines.
+	///
+	/// Values are counted in power-of-two sized buckets. As with
+	/// sharded_counter, each thread of the thread pool the histogram was
+	/// constructed with records into a shard that only it writes, without
+	/// atomic read-modify-writes, and other threads share a few more shards.
+	///
+	/// snapshot() adds up the shards. Each count includes every value
+	/// recorded before the call, but values recorded concurrently with it may
+	/// be included in some counts and not others.
+	class sharded_histogram
+	{
+	public:
+
+		/// The number of shards shared by threads that aren't in the pool.
+		static constexpr std::uint32_t default_shared_shard_count = 8;
+
+		/// Construct a histogram with just the shared shards.
+		explicit sharded_histogram(std::uint32_t sharedShardCount = default_shared_shard_count);
+
+		/// Construct a histogram with a shard for each of \p threadPool's
+		/// threads, plus the shared shards. The thread pool must outlive the
+		/// histogram.
+		explicit sharded_histogram(
+			static_thread_pool& threadPool,
+			std::uint32_t sharedShardCount = default_shared_shard_count);
+
+		sharded_histogram(const sharded_histogram&) = delete;
+		sharded_histogram& operator=(const sharded_histogram&) = delete;
+
+		void record(std::uint64_t value) noexcept
+		{
+			const std::uint32_t index = m_selector.current_shard();
+			shard& s = m_shards[index];
+			std::atomic<std::uint64_t>& bucket = s.m_buckets[std::bit_width(value)];
+			if (m_selector.is_exclusive(index))
+			{
+				bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				s.m_sum.store(s.m_sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+			}
+			else
+			{
+				bucket.fetch_add(1, std::memory_order_relaxed);
+				s.m_sum.fetch_add(value, std::memory_order_relaxed);
+			}
+		}
+
+		/// The bucket counts, added up over all the shards.
+		histogram_snapshot snapshot() const noexcept;
+
+	private:
+
+		struct alignas(CPPCORO_CPU_CACHE_LINE) shard
+		{
+			std::atomic<std::uint64_t> m_buckets[histogram_snapshot::bucket_count] = {};
+			std::atomic<std::uint64_t> m_sum{ 0 };
+		};
+
+		detail::shard_selector m_selector;
+		std::unique_ptr<shard[]> m_shards;
+
+	};
+}
+
+#endif
@@ -5,6 +5,8 @@
 #ifndef CPPCORO_STATIC_THREAD_POOL_HPP_INCLUDED
 #define CPPCORO_STATIC_THREAD_POOL_HPP_INCLUDED
 
+#include <cppcoro/epoch_domain.hpp>
+
 #include <atomic>
 #include <cstdint>
 #include <memory>
@@ -53,6 +55,19 @@ namespace cppcoro
 
 		std::uint32_t thread_count() const noexcept { return m_threadCount; }
 
+		/// Query if the calling thread is one of this thread pool's threads.
+		bool is_current_thread_in_pool() const noexcept { return s_currentThreadPool == this; }
+
+		/// Get the index of the calling thread within this thread pool.
+		///
+		/// \return
+		/// A value in the range [0, thread_count()) if the calling thread is
+		/// one of this thread pool's threads, otherwise thread_count().
+		std::uint32_t current_thread_index() const noexcept
+		{
+			return s_currentThreadPool == this ? s_currentThreadIndex : m_threadCount;
+		}
+
 		[[nodiscard]]
 		schedule_operation schedule() noexcept { return schedule_operation{ this }; }
 
@@ -93,10 +108,14 @@ namespace cppcoro
 
 		static thread_local thread_state* s_currentState;
 		static thread_local static_thread_pool* s_currentThreadPool;
+		static thread_local std::uint32_t s_currentThreadIndex;
 
 		const std::uint32_t m_threadCount;
 		const std::unique_ptr<thread_state[]> m_threadStates;
 
+		// Reclaims local queues that have been replaced by larger ones.
+		epoch_domain m_epochDomain;
+
 		std::vector<std::thread> m_threads;
 
 		std::atomic<bool> m_stopRequested;
@@ -0,0 +1,383 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef CPPCORO_STRAND_HPP_INCLUDED
+#define CPPCORO_STRAND_HPP_INCLUDED
+
+#include <atomic>
+#include <cassert>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <utility>
+
+namespace cppcoro
+{
+	namespace detail
+	{
+		/// Coroutine type of the loop that drains a strand's queue.
+		///
+		/// Starts suspended and never completes; the strand resumes it when
+		/// work arrives and destroys it when the strand is destroyed.
+		class strand_drain_task
+		{
+		public:
+
+			struct promise_type
+			{
+				strand_drain_task get_return_object() noexcept
+				{
+					return strand_drain_task{
+						std::coroutine_handle<promise_type>::from_promise(*this) };
+				}
+
+				std::suspend_always initial_suspend() noexcept { return {}; }
+				std::suspend_always final_suspend() noexcept { return {}; }
+				void unhandled_exception() noexcept { std::terminate(); }
+				void return_void() noexcept {}
+			};
+
+			explicit strand_drain_task(std::coroutine_handle<promise_type> coroutine) noexcept
+				: m_coroutine(coroutine)
+			{}
+
+			std::coroutine_handle<promise_type> m_coroutine;
+
+		};
+
+		/// Set while the current thread is running an item of a strand.
+		inline bool& strand_is_draining() noexcept
+		{
+			static thread_local bool isDraining = false;
+			return isDraining;
+		}
+	}
+
+	/// \brief
+	/// Serialises the coroutines scheduled onto it, running them one at a
+	/// time in FIFO order on an underlying scheduler.
+	///
+	/// A coroutine that executes 'co_await strand.schedule()' is resumed on a
+	/// thread of the underlying scheduler and runs exclusively with respect to
+	/// every other coroutine scheduled onto the same strand until it next
+	/// suspends, eg. by scheduling itself back onto the thread pool.
+	///
+	/// Unlike an async_mutex, the strand never resumes a waiting coroutine
+	/// inline on the thread that happens to finish the previous item. Queued
+	/// coroutines are kept on an intrusive lock-free stack whose head also
+	/// acts as the "running" flag, in the same way as async_mutex's state.
+	/// Only the coroutine that finds the strand idle starts an internal drain
+	/// loop, which then runs up to \c maxBatchSize queued items per hop before
+	/// rescheduling itself, so a busy strand costs one scheduling operation
+	/// per batch rather than one per item.
+	///
+	/// If the scheduler has an is_current_thread_in_pool() method, as
+	/// static_thread_pool does, then a coroutine that finds the strand idle
+	/// while already running on one of the scheduler's threads runs its first
+	/// batch straight away on that thread instead of hopping.
+	///
+	/// \tparam SCHEDULER
+	/// The type of the underlying scheduler, eg. static_thread_pool. Must
+	/// provide a schedule() method returning an awaitable. The scheduler must
+	/// outlive the strand.
+	template<typename SCHEDULER>
+	class strand
+	{
+	public:
+
+		class schedule_operation
+		{
+		public:
+
+			explicit schedule_operation(strand& s) noexcept : m_strand(s) {}
+
+			bool await_ready() const noexcept { return false; }
+
+			void await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+			{
+				m_awaitingCoroutine = awaitingCoroutine;
+				m_strand.enqueue(this);
+			}
+
+			void await_resume() const noexcept {}
+
+		private:
+
+			friend class strand;
+
+			strand& m_strand;
+			schedule_operation* m_next;
+			std::coroutine_handle<> m_awaitingCoroutine;
+
+		};
+
+		/// Construct a strand that runs its work on \p scheduler.
+		///
+		/// \param maxBatchSize
+		/// The maximum number of queued coroutines to resume before the
+		/// strand reschedules itself, letting other work run on the thread.
+		explicit strand(SCHEDULER& scheduler, std::size_t maxBatchSize = 64)
+			: m_scheduler(scheduler)
+			, m_maxBatchSize(maxBatchSize > 0 ? maxBatchSize : 1)
+			, m_state(idle)
+			, m_pending(nullptr)
+			, m_drainer(drain(*this).m_coroutine)
+		{}
+
+		/// Destroys the strand.
+		///
+		/// The drain loop may still be returning from the last item it ran,
+		/// eg. if that item completed whatever the destroying thread was
+		/// waiting for, so this waits for it to go idle. Behaviour is
+		/// undefined if the strand is destroyed by a coroutine running on it,
+		/// or while coroutines may still be scheduled onto it.
+		~strand()
+		{
+			while (m_state.load(std::memory_order_acquire) != idle)
+			{
+				std::this_thread::yield();
+			}
+			m_drainer.destroy();
+		}
+
+		strand(const strand&) = delete;
+		strand& operator=(const strand&) = delete;
+
+		/// \brief
+		/// Returns an operation that, when awaited, resumes the awaiting
+		/// coroutine as the next item of this strand.
+		[[nodiscard]]
+		schedule_operation schedule() noexcept { return schedule_operation{ *this }; }
+
+		SCHEDULER& scheduler() const noexcept { return m_scheduler; }
+
+	private:
+
+		// Nothing is running or queued. The drain loop is suspended, waiting
+		// to be started by the next enqueue().
+		static constexpr std::uintptr_t idle = 1;
+
+		// assume == reinterpret_cast<std::uintptr_t>(static_cast<void*>(nullptr))
+		static constexpr std::uintptr_t running_no_queued = 0;
+
+		class park_operation
+		{
+		public:
+
+			explicit park_operation(strand& s) noexcept : m_strand(s) {}
+
+			bool await_ready() const noexcept { return false; }
+
+			bool await_suspend(std::coroutine_handle<>) noexcept
+			{
+				// Written before the strand becomes idle, after which the drain
+				// loop may be resumed on another thread at any time.
+				m_parked = true;
+				if (m_strand.try_park())
+				{
+					return true;
+				}
+
+				// More work was queued, keep going.
+				m_parked = false;
+				return false;
+			}
+
+			/// Returns true if the strand went idle and was started again.
+			bool await_resume() const noexcept { return m_parked; }
+
+		private:
+
+			strand& m_strand;
+			bool m_parked = false;
+
+		};
+
+		void enqueue(schedule_operation* operation) noexcept
+		{
+			std::uintptr_t oldState = m_state.load(std::memory_order_relaxed);
+			while (true)
+			{
+				if (oldState == idle)
+				{
+					operation->m_next = nullptr;
+					if (m_state.compare_exchange_weak(
+						oldState,
+						reinterpret_cast<std::uintptr_t>(operation),
+						std::memory_order_acq_rel,
+						std::memory_order_relaxed))
+					{
+						// We made the strand busy, so we have to start draining it,
+						// either right here or by starting the drain loop, which
+						// immediately reschedules itself onto the scheduler.
+						if (can_start_inline())
+						{
+							run_inline();
+						}
+						else
+						{
+							m_drainer.resume();
+						}
+						return;
+					}
+				}
+				else
+				{
+					operation->m_next = reinterpret_cast<schedule_operation*>(oldState);
+					if (m_state.compare_exchange_weak(
+						oldState,
+						reinterpret_cast<std::uintptr_t>(operation),
+						std::memory_order_release,
+						std::memory_order_relaxed))
+					{
+						// The running drain loop will pick it up.
+						return;
+					}
+				}
+			}
+		}
+
+		/// Take everything queued since the last call, in FIFO order.
+		schedule_operation* take_queued() noexcept
+		{
+			const std::uintptr_t oldState =
+				m_state.exchange(running_no_queued, std::memory_order_acquire);
+			assert(oldState != idle);
+
+			schedule_operation* head = nullptr;
+			auto* next = reinterpret_cast<schedule_operation*>(oldState);
+			while (next != nullptr)
+			{
+				auto* temp = next->m_next;
+				next->m_next = head;
+				head = next;
+				next = temp;
+			}
+			return head;
+		}
+
+		/// True if a strand that has just been started by the current thread
+		/// can run its first batch here rather than hopping onto the scheduler.
+		///
+		/// Only if the scheduler says this is one of its threads, and if not
+		/// already inside another strand's drain loop, so that a coroutine
+		/// moving from strand to strand doesn't nest ever deeper on the stack.
+		bool can_start_inline() const noexcept
+		{
+			if constexpr (requires(const SCHEDULER& scheduler)
+			{
+				{ scheduler.is_current_thread_in_pool() } -> std::convertible_to<bool>;
+			})
+			{
+				return !detail::strand_is_draining() && m_scheduler.is_current_thread_in_pool();
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		/// Transition from running with nothing queued to idle.
+		///
+		/// Returns false if more operations have been queued.
+		bool try_park() noexcept
+		{
+			auto oldState = running_no_queued;
+			return m_state.compare_exchange_strong(
+				oldState,
+				idle,
+				std::memory_order_release,
+				std::memory_order_relaxed);
+		}
+
+		/// Resume up to m_maxBatchSize queued operations, one after the other.
+		///
+		/// Returns true if it stopped because the batch was used up, or false
+		/// if there was nothing left in the queue.
+		bool run_batch() noexcept
+		{
+			for (std::size_t remaining = m_maxBatchSize; remaining > 0; --remaining)
+			{
+				if (m_pending == nullptr)
+				{
+					m_pending = take_queued();
+					if (m_pending == nullptr)
+					{
+						return false;
+					}
+				}
+
+				// Read next before resuming, as resuming the coroutine may
+				// destroy the operation.
+				schedule_operation* operation = m_pending;
+				m_pending = operation->m_next;
+
+				const bool wasDraining = std::exchange(detail::strand_is_draining(), true);
+				operation->m_awaitingCoroutine.resume();
+				detail::strand_is_draining() = wasDraining;
+			}
+
+			return true;
+		}
+
+		/// Drain the strand on the current thread, without touching the drain
+		/// loop's coroutine frame unless it has to be rescheduled.
+		void run_inline() noexcept
+		{
+			while (true)
+			{
+				if (run_batch())
+				{
+					// The drain loop is suspended, as the strand was idle. Let it
+					// carry on with the rest of the queue after a hop.
+					m_drainer.resume();
+					return;
+				}
+
+				if (try_park())
+				{
+					return;
+				}
+			}
+		}
+
+		static detail::strand_drain_task drain(strand& s)
+		{
+			// Suspended here, or in park_operation, whenever the strand is idle,
+			// and resumed by the enqueue() that makes it busy again.
+			bool hop = true;
+			while (true)
+			{
+				if (hop)
+				{
+					co_await s.m_scheduler.schedule();
+				}
+
+				// Rescheduled if the batch was used up, or if the strand went
+				// idle and was started again, but carries straight on if more
+				// work arrived while trying to go idle.
+				hop = s.run_batch() || co_await park_operation{ s };
+			}
+		}
+
+		SCHEDULER& m_scheduler;
+		const std::size_t m_maxBatchSize;
+
+		// Either idle, running_no_queued or a pointer to the most recently
+		// queued operation in a stack of operations queued while running.
+		std::atomic<std::uintptr_t> m_state;
+
+		// Operations taken from m_state that are yet to run, in FIFO order.
+		// Only accessed by the drain loop.
+		schedule_operation* m_pending;
+
+		std::coroutine_handle<> m_drainer;
+
+	};
+}
+
+#endif
@@ -8,7 +8,9 @@
 #include <cppcoro/config.hpp>
 #include <cppcoro/awaitable_traits.hpp>
 #include <cppcoro/broken_promise.hpp>
+#include <cppcoro/frame_arena.hpp>
 
+#include <cppcoro/detail/get_awaiter.hpp>
 #include <cppcoro/detail/remove_rvalue_reference.hpp>
 
 #include <atomic>
@@ -39,6 +41,7 @@ namespace cppcoro
 				std::coroutine_handle<> await_suspend(
 					std::coroutine_handle<PROMISE> coro) noexcept
 				{
+					coro.promise().leave_body();
 					return coro.promise().m_continuation;
 				}
 #else
@@ -52,6 +55,7 @@ namespace cppcoro
 				void await_suspend(std::coroutine_handle<PROMISE> coroutine)
 				{
 					task_promise_base& promise = coroutine.promise();
+					promise.leave_body();
 
 					// Use 'release' memory semantics in case we finish before the
 					// awaiter can suspend so that the awaiting thread sees our
@@ -69,17 +73,101 @@ namespace cppcoro
 				void await_resume() noexcept {}
 			};
 
+			/// Wraps every awaiter that the task's body awaits, to switch the
+			/// current frame_arena back to whatever it was before the body was
+			/// resumed while the task is suspended.
+			template<typename AWAITER>
+			class arena_awaiter
+			{
+			public:
+
+				template<typename AWAITABLE>
+				arena_awaiter(AWAITABLE&& awaitable, task_promise_base& promise)
+					: m_awaiter(detail::get_awaiter(static_cast<AWAITABLE&&>(awaitable)))
+					, m_promise(promise)
+					, m_suspended(false)
+				{}
+
+				decltype(auto) await_ready()
+				{
+					return m_awaiter.await_ready();
+				}
+
+				template<typename PROMISE>
+				decltype(auto) await_suspend(std::coroutine_handle<PROMISE> awaitingCoroutine)
+				{
+					m_suspended = true;
+					m_promise.leave_body();
+					try
+					{
+						return m_awaiter.await_suspend(awaitingCoroutine);
+					}
+					catch (...)
+					{
+						// The body carries on with the exception.
+						m_suspended = false;
+						m_promise.enter_body();
+						throw;
+					}
+				}
+
+				decltype(auto) await_resume()
+				{
+					if (m_suspended)
+					{
+						m_promise.enter_body();
+					}
+					return m_awaiter.await_resume();
+				}
+
+			private:
+
+				// A reference if the awaitable is its own awaiter, as it then
+				// lives until the end of the co_await expression anyway.
+				AWAITER m_awaiter;
+				task_promise_base& m_promise;
+				bool m_suspended;
+
+			};
+
 		public:
 
-			task_promise_base() noexcept
+			/// Constructed with the coroutine's parameters, to pick up an arena
+			/// passed after std::allocator_arg.
+			template<typename... ARGS>
+			explicit task_promise_base(ARGS&... args) noexcept
+				: m_arena(detail::find_frame_arena(args...))
+				, m_previousArena(nullptr)
 #if !CPPCORO_COMPILER_SUPPORTS_SYMMETRIC_TRANSFER
-				: m_state(false)
+				, m_state(false)
 #endif
 			{}
 
+			/// Allocates the frame from the current frame_arena, or the one passed
+			/// after std::allocator_arg, if any, otherwise from the global heap.
+			template<typename... ARGS>
+			static void* operator new(std::size_t size, ARGS&... args)
+			{
+				return detail::allocate_frame(size, detail::find_frame_arena(args...));
+			}
+
+			static void operator delete(void* frame, std::size_t size) noexcept
+			{
+				detail::deallocate_frame(frame, size);
+			}
+
 			auto initial_suspend() noexcept
 			{
-				return std::suspend_always{};
+				struct initial_awaitable
+				{
+					task_promise_base& m_promise;
+
+					bool await_ready() const noexcept { return false; }
+					void await_suspend(std::coroutine_handle<>) const noexcept {}
+					void await_resume() const noexcept { m_promise.enter_body(); }
+				};
+
+				return initial_awaitable{ *this };
 			}
 
 			auto final_suspend() noexcept
@@ -87,6 +175,22 @@ namespace cppcoro
 				return final_awaitable{};
 			}
 
+			template<typename AWAITABLE>
+			auto await_transform(AWAITABLE&& awaitable)
+				-> arena_awaiter<decltype(detail::get_awaiter(static_cast<AWAITABLE&&>(awaitable)))>
+			{
+				return { static_cast<AWAITABLE&&>(awaitable), *this };
+			}
+
+			// Awaitables that only work with particular promise types are
+			// awaited as they are.
+			template<typename AWAITABLE>
+				requires (!requires(AWAITABLE&& awaitable) { detail::get_awaiter(static_cast<AWAITABLE&&>(awaitable)); })
+			AWAITABLE&& await_transform(AWAITABLE&& awaitable) noexcept
+			{
+				return static_cast<AWAITABLE&&>(awaitable);
+			}
+
 #if CPPCORO_COMPILER_SUPPORTS_SYMMETRIC_TRANSFER
 			void set_continuation(std::coroutine_handle<> continuation) noexcept
 			{
@@ -102,8 +206,28 @@ namespace cppcoro
 
 		private:
 
+			/// Called whenever the body starts or resumes running.
+			void enter_body() noexcept
+			{
+				m_previousArena = std::exchange(frame_arena::current_arena(), m_arena);
+			}
+
+			/// Called whenever the body suspends or completes.
+			void leave_body() noexcept
+			{
+				frame_arena::current_arena() = m_previousArena;
+			}
+
 			std::coroutine_handle<> m_continuation;
 
+			// The arena that this task's frame was allocated from, which is
+			// current whenever its body is running, so that child tasks are
+			// allocated from it too.
+			frame_arena* m_arena;
+
+			// The current arena before the body was last resumed.
+			frame_arena* m_previousArena;
+
 #if !CPPCORO_COMPILER_SUPPORTS_SYMMETRIC_TRANSFER
 			// Initially false. Set to true when either a continuation is registered
 			// or when the coroutine has run to completion. Whichever operation
@@ -118,7 +242,10 @@ namespace cppcoro
 		{
 		public:
 
-			task_promise() noexcept {}
+			template<typename... ARGS>
+			explicit task_promise(ARGS&... args) noexcept
+				: task_promise_base(args...)
+			{}
 
 			~task_promise()
 			{
@@ -208,7 +335,10 @@ namespace cppcoro
 		{
 		public:
 
-			task_promise() noexcept = default;
+			template<typename... ARGS>
+			explicit task_promise(ARGS&... args) noexcept
+				: task_promise_base(args...)
+			{}
 
 			task<void> get_return_object() noexcept;
 
@@ -239,7 +369,10 @@ namespace cppcoro
 		{
 		public:
 
-			task_promise() noexcept = default;
+			template<typename... ARGS>
+			explicit task_promise(ARGS&... args) noexcept
+				: task_promise_base(args...)
+			{}
 
 			task<T&> get_return_object() noexcept;
 
@@ -9,6 +9,7 @@
 #include <cppcoro/awaitable_traits.hpp>
 #include <cppcoro/is_awaitable.hpp>
 
+#include <cppcoro/detail/when_all_awaiter.hpp>
 #include <cppcoro/detail/when_all_ready_awaitable.hpp>
 #include <cppcoro/detail/when_all_task.hpp>
 #include <cppcoro/detail/unwrap_reference.hpp>
@@ -27,9 +28,11 @@ namespace cppcoro
 	[[nodiscard]]
 	CPPCORO_FORCE_INLINE auto when_all_ready(AWAITABLES&&... awaitables)
 	{
-		return detail::when_all_ready_awaitable<std::tuple<detail::when_all_task<
-			typename awaitable_traits<detail::unwrap_reference_t<std::remove_reference_t<AWAITABLES>>>::await_result_t>...>>(
-				std::make_tuple(detail::make_when_all_task(std::forward<AWAITABLES>(awaitables))...));
+		// Plain awaiters are driven directly by the when_all_ready_awaitable,
+		// anything else from a when_all_task coroutine.
+		return detail::when_all_ready_awaitable<std::tuple<
+			decltype(detail::make_when_all_child(std::forward<AWAITABLES>(awaitables)))...>>(
+				std::make_tuple(detail::make_when_all_child(std::forward<AWAITABLES>(awaitables))...));
 	}
 
 	// TODO: Generalise this from vector<AWAITABLE> to arbitrary sequence of awaitable.
@@ -0,0 +1,99 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/async_condition_variable.hpp>
+
+#include <cassert>
+
+cppcoro::async_condition_variable::async_condition_variable() noexcept
+	: m_waitersHead(nullptr)
+	, m_waitersTail(nullptr)
+{}
+
+cppcoro::async_condition_variable::~async_condition_variable()
+{
+	assert(m_waitersHead == nullptr);
+}
+
+cppcoro::async_condition_variable_wait_operation
+cppcoro::async_condition_variable::wait(async_mutex_lock& lock) noexcept
+{
+	assert(lock.m_mutex != nullptr);
+	return async_condition_variable_wait_operation{ *this, *lock.m_mutex };
+}
+
+cppcoro::async_condition_variable_wait_operation
+cppcoro::async_condition_variable::wait(async_mutex& mutex) noexcept
+{
+	return async_condition_variable_wait_operation{ *this, mutex };
+}
+
+void cppcoro::async_condition_variable::notify_one() noexcept
+{
+	async_mutex_lock_operation* waiter = m_waitersHead;
+	if (waiter == nullptr)
+	{
+		return;
+	}
+
+	m_waitersHead = waiter->m_next;
+	if (m_waitersHead == nullptr)
+	{
+		m_waitersTail = nullptr;
+	}
+
+	// The caller holds the lock, so it owns the mutex's list of waiters.
+	async_mutex& mutex = waiter->m_mutex;
+	assert(mutex.m_state.load(std::memory_order_relaxed) != async_mutex::not_locked);
+	waiter->m_next = mutex.m_waiters;
+	mutex.m_waiters = waiter;
+}
+
+void cppcoro::async_condition_variable::notify_all() noexcept
+{
+	if (m_waitersHead == nullptr)
+	{
+		return;
+	}
+
+	// Splice the whole list onto the front of the mutex's list in one go.
+	async_mutex& mutex = m_waitersHead->m_mutex;
+	assert(mutex.m_state.load(std::memory_order_relaxed) != async_mutex::not_locked);
+	m_waitersTail->m_next = mutex.m_waiters;
+	mutex.m_waiters = m_waitersHead;
+
+	m_waitersHead = nullptr;
+	m_waitersTail = nullptr;
+}
+
+void cppcoro::async_condition_variable::enqueue(
+	async_mutex_lock_operation* operation,
+	std::coroutine_handle<> awaiter) noexcept
+{
+	assert(m_waitersHead == nullptr || &m_waitersHead->m_mutex == &operation->m_mutex);
+
+	operation->m_awaiter = awaiter;
+	operation->m_next = nullptr;
+	if (m_waitersTail == nullptr)
+	{
+		m_waitersHead = operation;
+	}
+	else
+	{
+		m_waitersTail->m_next = operation;
+	}
+	m_waitersTail = operation;
+}
+
+bool cppcoro::async_condition_variable_wait_operation::await_suspend(
+	std::coroutine_handle<> awaiter) noexcept
+{
+	m_conditionVariable.enqueue(this, awaiter);
+
+	// Once the lock is released this operation may be notified and resumed,
+	// possibly inside this call, so it must not be touched again.
+	m_mutex.unlock();
+	return true;
+}
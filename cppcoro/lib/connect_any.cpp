@@ -0,0 +1,302 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/net/connect_any.hpp>
+
+#include <cppcoro/async_manual_reset_event.hpp>
+#include <cppcoro/cancellation_registration.hpp>
+#include <cppcoro/cancellation_source.hpp>
+#include <cppcoro/operation_cancelled.hpp>
+#include <cppcoro/when_all_ready.hpp>
+#include <cppcoro/net/ipv4_endpoint.hpp>
+#include <cppcoro/net/ipv6_endpoint.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	namespace net = cppcoro::net;
+
+	using clock = std::chrono::steady_clock;
+
+	/// Reorder \p endPoints so that address families alternate, starting with
+	/// the family of the first end-point, as recommended by RFC 8305.
+	void interleave_address_families(std::vector<net::ip_endpoint>& endPoints)
+	{
+		if (endPoints.empty())
+		{
+			return;
+		}
+
+		const bool firstIsIpv4 = endPoints.front().is_ipv4();
+		std::vector<net::ip_endpoint> preferred;
+		std::vector<net::ip_endpoint> other;
+		for (const auto& endPoint : endPoints)
+		{
+			(endPoint.is_ipv4() == firstIsIpv4 ? preferred : other).push_back(endPoint);
+		}
+
+		endPoints.clear();
+		for (std::size_t i = 0; i < preferred.size() || i < other.size(); ++i)
+		{
+			if (i < preferred.size())
+			{
+				endPoints.push_back(preferred[i]);
+			}
+			if (i < other.size())
+			{
+				endPoints.push_back(other[i]);
+			}
+		}
+	}
+
+	class happy_eyeballs
+	{
+	public:
+
+		happy_eyeballs(
+			cppcoro::io_service& ioService,
+			std::span<const net::ip_endpoint> endPoints,
+			net::endpoint_health_cache* healthCache,
+			std::chrono::milliseconds stagger)
+			: m_ioService(ioService)
+			, m_healthCache(healthCache)
+			, m_stagger(stagger)
+			, m_attemptCount(endPoints.size())
+			, m_attempts(std::make_unique<attempt[]>(endPoints.size()))
+			, m_winner(no_winner)
+			, m_cancelled(false)
+		{
+			// Interleave before ordering by health, as the cache's stable sort
+			// keeps the interleaving within each tier but interleaving
+			// afterwards would move failed end-points ahead of healthy ones.
+			std::vector<net::ip_endpoint> ordered(endPoints.begin(), endPoints.end());
+			interleave_address_families(ordered);
+			if (m_healthCache != nullptr)
+			{
+				m_healthCache->order(ordered);
+			}
+
+			for (std::size_t i = 0; i < m_attemptCount; ++i)
+			{
+				m_attempts[i].m_endPoint = ordered[i];
+			}
+		}
+
+		cppcoro::task<net::socket> run(cppcoro::cancellation_token ct)
+		{
+			if (m_attemptCount == 0)
+			{
+				throw std::system_error{
+					std::make_error_code(std::errc::invalid_argument),
+					"connect_any: no end-points to connect to" };
+			}
+
+			cppcoro::cancellation_registration cancellationRegistration{
+				std::move(ct),
+				[this]
+				{
+					m_cancelled.store(true, std::memory_order_release);
+					cancel_all();
+				} };
+
+			std::vector<cppcoro::task<>> attempts;
+			attempts.reserve(m_attemptCount);
+			for (std::size_t i = 0; i < m_attemptCount; ++i)
+			{
+				attempts.push_back(run_attempt(i));
+			}
+
+			m_attempts[0].m_started.set();
+			co_await cppcoro::when_all_ready(std::move(attempts));
+
+			const std::size_t winner = m_winner.load(std::memory_order_acquire);
+			if (winner != no_winner)
+			{
+				co_return std::move(*m_attempts[winner].m_socket);
+			}
+
+			if (!m_cancelled.load(std::memory_order_acquire))
+			{
+				for (std::size_t i = m_attemptCount; i-- > 0;)
+				{
+					if (m_attempts[i].m_exception)
+					{
+						std::rethrow_exception(m_attempts[i].m_exception);
+					}
+				}
+			}
+
+			throw cppcoro::operation_cancelled{};
+		}
+
+	private:
+
+		struct attempt
+		{
+			net::ip_endpoint m_endPoint;
+
+			// Cancels both the connect and the stagger delay.
+			cppcoro::cancellation_source m_cancellationSource;
+
+			// Set once the previous attempt failed or its stagger delay elapsed.
+			cppcoro::async_manual_reset_event m_started;
+
+			std::optional<net::socket> m_socket;
+			std::exception_ptr m_exception;
+		};
+
+		static constexpr std::size_t no_winner = std::numeric_limits<std::size_t>::max();
+
+		bool is_finished() const noexcept
+		{
+			return m_winner.load(std::memory_order_acquire) != no_winner ||
+				m_cancelled.load(std::memory_order_acquire);
+		}
+
+		void cancel_all() noexcept
+		{
+			for (std::size_t i = 0; i < m_attemptCount; ++i)
+			{
+				m_attempts[i].m_cancellationSource.request_cancellation();
+			}
+		}
+
+		void start_next(std::size_t index) noexcept
+		{
+			if (index + 1 < m_attemptCount)
+			{
+				m_attempts[index + 1].m_started.set();
+			}
+		}
+
+		cppcoro::task<> run_attempt(std::size_t index)
+		{
+			co_await m_attempts[index].m_started;
+
+			if (is_finished())
+			{
+				// Let the remaining attempts run to completion without
+				// starting them.
+				start_next(index);
+				co_return;
+			}
+
+			co_await cppcoro::when_all_ready(connect(index), stagger_delay(index));
+		}
+
+		cppcoro::task<> connect(std::size_t index)
+		{
+			auto& a = m_attempts[index];
+			const auto start = clock::now();
+
+			try
+			{
+				auto socket = a.m_endPoint.is_ipv4()
+					? net::socket::create_tcpv4(m_ioService)
+					: net::socket::create_tcpv6(m_ioService);
+
+				// ConnectEx() requires the socket to be bound first.
+				if (a.m_endPoint.is_ipv4())
+				{
+					socket.bind(net::ipv4_endpoint{});
+				}
+				else
+				{
+					socket.bind(net::ipv6_endpoint{});
+				}
+
+				co_await socket.connect(a.m_endPoint, a.m_cancellationSource.token());
+
+				if (m_healthCache != nullptr)
+				{
+					m_healthCache->record_success(a.m_endPoint, clock::now() - start);
+				}
+
+				std::size_t noWinner = no_winner;
+				if (m_winner.compare_exchange_strong(noWinner, index, std::memory_order_acq_rel))
+				{
+					a.m_socket.emplace(std::move(socket));
+					cancel_all();
+				}
+			}
+			catch (const cppcoro::operation_cancelled&)
+			{
+			}
+			catch (...)
+			{
+				a.m_exception = std::current_exception();
+				if (m_healthCache != nullptr)
+				{
+					m_healthCache->record_failure(a.m_endPoint);
+				}
+			}
+
+			// Start the next attempt now rather than waiting for the delay.
+			a.m_cancellationSource.request_cancellation();
+		}
+
+		cppcoro::task<> stagger_delay(std::size_t index)
+		{
+			try
+			{
+				co_await m_ioService.schedule_after(
+					m_stagger, m_attempts[index].m_cancellationSource.token());
+			}
+			catch (const cppcoro::operation_cancelled&)
+			{
+			}
+
+			start_next(index);
+		}
+
+		cppcoro::io_service& m_ioService;
+		net::endpoint_health_cache* m_healthCache;
+		const std::chrono::milliseconds m_stagger;
+		const std::size_t m_attemptCount;
+		std::unique_ptr<attempt[]> m_attempts;
+		std::atomic<std::size_t> m_winner;
+		std::atomic<bool> m_cancelled;
+
+	};
+
+	cppcoro::task<net::socket> connect_any_impl(
+		cppcoro::io_service& ioService,
+		std::span<const net::ip_endpoint> endPoints,
+		net::endpoint_health_cache* healthCache,
+		std::chrono::milliseconds stagger,
+		cppcoro::cancellation_token ct)
+	{
+		happy_eyeballs state{ ioService, endPoints, healthCache, stagger };
+		co_return co_await state.run(std::move(ct));
+	}
+}
+
+cppcoro::task<cppcoro::net::socket> cppcoro::net::connect_any(
+	io_service& ioService,
+	std::span<const ip_endpoint> endPoints,
+	std::chrono::milliseconds stagger,
+	cancellation_token ct)
+{
+	return connect_any_impl(ioService, endPoints, nullptr, stagger, std::move(ct));
+}
+
+cppcoro::task<cppcoro::net::socket> cppcoro::net::connect_any(
+	io_service& ioService,
+	std::span<const ip_endpoint> endPoints,
+	endpoint_health_cache& healthCache,
+	std::chrono::milliseconds stagger,
+	cancellation_token ct)
+{
+	return connect_any_impl(ioService, endPoints, &healthCache, stagger, std::move(ct));
+}
@@ -0,0 +1,317 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/net/connection_pool.hpp>
+
+#include <cppcoro/net/ipv4_endpoint.hpp>
+#include <cppcoro/net/ipv6_endpoint.hpp>
+
+#include <cassert>
+#include <utility>
+
+#if CPPCORO_OS_WINNT
+# include <WinSock2.h>
+# include <WS2tcpip.h>
+# include <MSWSock.h>
+# include <Windows.h>
+#elif CPPCORO_OS_LINUX
+# include <cerrno>
+# include <poll.h>
+# include <sys/socket.h>
+#endif
+
+cppcoro::net::connection_lease::connection_lease() noexcept
+	: m_pool(nullptr)
+{}
+
+cppcoro::net::connection_lease::connection_lease(
+	connection_pool& pool,
+	net::socket&& socket) noexcept
+	: m_pool(&pool)
+	, m_socket(std::move(socket))
+{}
+
+cppcoro::net::connection_lease::connection_lease(connection_lease&& other) noexcept
+	: m_pool(std::exchange(other.m_pool, nullptr))
+	, m_socket(std::move(other.m_socket))
+{
+	other.m_socket.reset();
+}
+
+cppcoro::net::connection_lease&
+cppcoro::net::connection_lease::operator=(connection_lease&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		m_pool = std::exchange(other.m_pool, nullptr);
+		m_socket = std::move(other.m_socket);
+		other.m_socket.reset();
+	}
+
+	return *this;
+}
+
+cppcoro::net::connection_lease::~connection_lease()
+{
+	release();
+}
+
+void cppcoro::net::connection_lease::discard() noexcept
+{
+	if (m_pool != nullptr)
+	{
+		m_socket.reset();
+		std::exchange(m_pool, nullptr)->release(std::nullopt);
+	}
+}
+
+void cppcoro::net::connection_lease::release() noexcept
+{
+	if (m_pool != nullptr)
+	{
+		std::optional<net::socket> socket = std::move(m_socket);
+		m_socket.reset();
+		std::exchange(m_pool, nullptr)->release(std::move(socket));
+	}
+}
+
+cppcoro::net::connection_pool::connection_pool(
+	io_service& ioService,
+	const ip_endpoint& remoteEndPoint,
+	std::size_t maxConnections,
+	clock::duration idleTimeout)
+	: m_ioService(ioService)
+	, m_remoteEndPoint(remoteEndPoint)
+	, m_maxConnections(maxConnections)
+	, m_idleTimeout(idleTimeout)
+	, m_connectionCount(0)
+	, m_waitersHead(nullptr)
+	, m_waitersTail(nullptr)
+{
+	assert(maxConnections > 0);
+}
+
+cppcoro::net::connection_pool::~connection_pool()
+{
+	assert(m_waitersHead == nullptr);
+	assert(m_connectionCount == m_idleConnections.size());
+}
+
+cppcoro::task<cppcoro::net::connection_lease> cppcoro::net::connection_pool::acquire()
+{
+	std::optional<net::socket> socket = co_await acquire_slot_operation{ *this };
+
+	// We now own one of the pool's slots, either holding an idle connection
+	// or with permission to open a new one. Give the slot back if we fail
+	// to produce a connection.
+	try
+	{
+		if (socket && !is_healthy(*socket))
+		{
+			socket.reset();
+		}
+
+		if (!socket)
+		{
+			socket.emplace(co_await connect());
+		}
+	}
+	catch (...)
+	{
+		release(std::nullopt);
+		throw;
+	}
+
+	co_return connection_lease{ *this, std::move(*socket) };
+}
+
+std::size_t cppcoro::net::connection_pool::evict_idle()
+{
+	std::deque<idle_connection> expired;
+	{
+		std::lock_guard lock{ m_mutex };
+		take_expired(clock::now(), expired);
+	}
+
+	// Close the sockets outside of the lock.
+	return expired.size();
+}
+
+std::size_t cppcoro::net::connection_pool::connection_count() const noexcept
+{
+	std::lock_guard lock{ m_mutex };
+	return m_connectionCount;
+}
+
+std::size_t cppcoro::net::connection_pool::idle_count() const noexcept
+{
+	std::lock_guard lock{ m_mutex };
+	return m_idleConnections.size();
+}
+
+bool cppcoro::net::connection_pool::acquire_slot_operation::await_suspend(
+	std::coroutine_handle<> awaitingCoroutine)
+{
+	m_awaitingCoroutine = awaitingCoroutine;
+
+	std::deque<idle_connection> expired;
+
+	std::lock_guard lock{ m_pool.m_mutex };
+
+	m_pool.take_expired(clock::now(), expired);
+
+	if (!m_pool.m_idleConnections.empty())
+	{
+		// Reuse the most recently returned connection.
+		m_socket.emplace(std::move(m_pool.m_idleConnections.back().m_socket));
+		m_pool.m_idleConnections.pop_back();
+		return false;
+	}
+
+	if (m_pool.m_connectionCount < m_pool.m_maxConnections)
+	{
+		++m_pool.m_connectionCount;
+		return false;
+	}
+
+	if (m_pool.m_waitersTail == nullptr)
+	{
+		m_pool.m_waitersHead = this;
+	}
+	else
+	{
+		m_pool.m_waitersTail->m_next = this;
+	}
+	m_pool.m_waitersTail = this;
+
+	// NOTE: Another thread may resume the coroutine as soon as the lock is
+	// released, so must not touch 'this' after this point. The expired
+	// connections are destroyed after the lock is released.
+	return true;
+}
+
+void cppcoro::net::connection_pool::release(std::optional<net::socket> socket) noexcept
+{
+	acquire_slot_operation* waiter = nullptr;
+	std::deque<idle_connection> expired;
+	{
+		std::lock_guard lock{ m_mutex };
+
+		waiter = m_waitersHead;
+		if (waiter != nullptr)
+		{
+			// Hand the connection, or the slot if the connection was
+			// discarded, straight to the longest waiting coroutine.
+			m_waitersHead = waiter->m_next;
+			if (m_waitersHead == nullptr)
+			{
+				m_waitersTail = nullptr;
+			}
+
+			waiter->m_socket = std::move(socket);
+		}
+		else if (socket)
+		{
+			const auto now = clock::now();
+			take_expired(now, expired);
+
+			try
+			{
+				m_idleConnections.push_back(idle_connection{ std::move(*socket), now });
+			}
+			catch (const std::bad_alloc&)
+			{
+				--m_connectionCount;
+			}
+		}
+		else
+		{
+			--m_connectionCount;
+		}
+	}
+
+	if (waiter != nullptr)
+	{
+		waiter->m_awaitingCoroutine.resume();
+	}
+}
+
+void cppcoro::net::connection_pool::take_expired(
+	clock::time_point now,
+	std::deque<idle_connection>& expired) noexcept
+{
+	while (!m_idleConnections.empty() &&
+		(now - m_idleConnections.front().m_idleSince) >= m_idleTimeout)
+	{
+		try
+		{
+			expired.push_back(std::move(m_idleConnections.front()));
+		}
+		catch (const std::bad_alloc&)
+		{
+			// Close it while holding the lock instead.
+		}
+
+		m_idleConnections.pop_front();
+		--m_connectionCount;
+	}
+}
+
+cppcoro::task<cppcoro::net::socket> cppcoro::net::connection_pool::connect()
+{
+	auto socket = m_remoteEndPoint.is_ipv4()
+		? net::socket::create_tcpv4(m_ioService)
+		: net::socket::create_tcpv6(m_ioService);
+
+	// ConnectEx() requires the socket to be bound first.
+	if (m_remoteEndPoint.is_ipv4())
+	{
+		socket.bind(ipv4_endpoint{});
+	}
+	else
+	{
+		socket.bind(ipv6_endpoint{});
+	}
+
+	co_await socket.connect(m_remoteEndPoint);
+
+	co_return std::move(socket);
+}
+
+bool cppcoro::net::connection_pool::is_healthy(net::socket& socket) noexcept
+{
+	// An idle connection should have nothing to read. If it is readable then
+	// either the peer has closed the connection or has sent data we were not
+	// expecting, in which case the connection is out of sync with the
+	// protocol. Either way it can't be reused.
+#if CPPCORO_OS_WINNT
+	WSAPOLLFD pollFd;
+	pollFd.fd = socket.native_handle();
+	pollFd.events = POLLRDNORM;
+	pollFd.revents = 0;
+	const int result = ::WSAPoll(&pollFd, 1, 0);
+	if (result == SOCKET_ERROR)
+	{
+		return false;
+	}
+#elif CPPCORO_OS_LINUX
+	pollfd pollFd;
+	pollFd.fd = socket.native_handle();
+	pollFd.events = POLLIN | POLLRDHUP;
+	pollFd.revents = 0;
+	int result;
+	do
+	{
+		result = ::poll(&pollFd, 1, 0);
+	} while (result == -1 && errno == EINTR);
+	if (result == -1)
+	{
+		return false;
+	}
+#endif
+
+	return result == 0;
+}
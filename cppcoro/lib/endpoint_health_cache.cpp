@@ -0,0 +1,138 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/net/endpoint_health_cache.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+	constexpr std::uint32_t max_penalty_doublings = 6;
+
+	enum class tier
+	{
+		healthy,
+		unknown,
+		penalised
+	};
+}
+
+cppcoro::net::endpoint_health_cache::endpoint_health_cache(clock::duration failurePenalty)
+	: m_failurePenalty(failurePenalty)
+{}
+
+void cppcoro::net::endpoint_health_cache::record_success(
+	const ip_endpoint& endPoint,
+	clock::duration connectLatency)
+{
+	std::lock_guard lock{ m_mutex };
+	auto& e = m_entries[endPoint];
+	if (e.m_hasSucceeded)
+	{
+		// Same 1/8 gain as TCP's smoothed round-trip time.
+		e.m_smoothedLatency += (connectLatency - e.m_smoothedLatency) / 8;
+	}
+	else
+	{
+		e.m_smoothedLatency = connectLatency;
+	}
+	e.m_hasSucceeded = true;
+	e.m_consecutiveFailures = 0;
+}
+
+void cppcoro::net::endpoint_health_cache::record_failure(const ip_endpoint& endPoint)
+{
+	std::lock_guard lock{ m_mutex };
+	auto& e = m_entries[endPoint];
+	e.m_hasSucceeded = false;
+	e.m_lastFailure = clock::now();
+	++e.m_consecutiveFailures;
+}
+
+void cppcoro::net::endpoint_health_cache::order(std::span<ip_endpoint> endPoints) const
+{
+	struct ranked
+	{
+		tier m_tier;
+		clock::duration m_latency;
+		clock::time_point m_lastFailure;
+		ip_endpoint m_endPoint;
+	};
+
+	std::vector<ranked> rankedEndPoints;
+	rankedEndPoints.reserve(endPoints.size());
+
+	{
+		const auto now = clock::now();
+		std::lock_guard lock{ m_mutex };
+		for (const auto& endPoint : endPoints)
+		{
+			ranked r{ tier::unknown, {}, {}, endPoint };
+			auto it = m_entries.find(endPoint);
+			if (it != m_entries.end())
+			{
+				const entry& e = it->second;
+				if (e.m_hasSucceeded)
+				{
+					r.m_tier = tier::healthy;
+					r.m_latency = e.m_smoothedLatency;
+				}
+				else if (e.m_consecutiveFailures > 0)
+				{
+					const auto doublings = std::min(e.m_consecutiveFailures - 1, max_penalty_doublings);
+					if (now - e.m_lastFailure < m_failurePenalty * (1u << doublings))
+					{
+						r.m_tier = tier::penalised;
+						r.m_lastFailure = e.m_lastFailure;
+					}
+				}
+			}
+			rankedEndPoints.push_back(r);
+		}
+	}
+
+	std::stable_sort(
+		rankedEndPoints.begin(),
+		rankedEndPoints.end(),
+		[](const ranked& a, const ranked& b)
+		{
+			if (a.m_tier != b.m_tier)
+			{
+				return a.m_tier < b.m_tier;
+			}
+
+			switch (a.m_tier)
+			{
+			case tier::healthy: return a.m_latency < b.m_latency;
+			case tier::penalised: return a.m_lastFailure < b.m_lastFailure;
+			default: return false;
+			}
+		});
+
+	for (std::size_t i = 0; i < endPoints.size(); ++i)
+	{
+		endPoints[i] = rankedEndPoints[i].m_endPoint;
+	}
+}
+
+std::optional<cppcoro::net::endpoint_health_cache::clock::duration>
+cppcoro::net::endpoint_health_cache::latency(const ip_endpoint& endPoint) const
+{
+	std::lock_guard lock{ m_mutex };
+	auto it = m_entries.find(endPoint);
+	if (it == m_entries.end() || !it->second.m_hasSucceeded)
+	{
+		return std::nullopt;
+	}
+
+	return it->second.m_smoothedLatency;
+}
+
+void cppcoro::net::endpoint_health_cache::clear() noexcept
+{
+	std::lock_guard lock{ m_mutex };
+	m_entries.clear();
+}
@@ -0,0 +1,208 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/epoch_domain.hpp>
+
+#include <cassert>
+#include <utility>
+
+namespace
+{
+	namespace local
+	{
+		// How many objects a participant retires between attempts to
+		// advance the epoch and free its older objects.
+		constexpr std::uint32_t collect_interval = 64;
+	}
+}
+
+cppcoro::epoch_domain::epoch_domain() noexcept
+	: m_epoch(0)
+	, m_records(nullptr)
+{}
+
+cppcoro::epoch_domain::~epoch_domain()
+{
+	record* r = m_records.load(std::memory_order_acquire);
+	while (r != nullptr)
+	{
+		assert(!r->m_inUse.load(std::memory_order_relaxed));
+		record* next = r->m_next;
+		delete r;
+		r = next;
+	}
+
+	for (auto& bag : m_orphans)
+	{
+		free_bag(bag);
+	}
+}
+
+cppcoro::epoch_domain::record* cppcoro::epoch_domain::acquire_record()
+{
+	// Reuse the record of a participant that has gone away, if there is one.
+	for (record* r = m_records.load(std::memory_order_acquire); r != nullptr; r = r->m_next)
+	{
+		bool inUse = r->m_inUse.load(std::memory_order_relaxed);
+		if (!inUse && r->m_inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire))
+		{
+			return r;
+		}
+	}
+
+	record* r = new record;
+	record* head = m_records.load(std::memory_order_relaxed);
+	do
+	{
+		r->m_next = head;
+	} while (!m_records.compare_exchange_weak(
+		head,
+		r,
+		std::memory_order_release,
+		std::memory_order_relaxed));
+
+	return r;
+}
+
+void cppcoro::epoch_domain::release_record(record* r) noexcept
+{
+	assert(r->m_pinCount == 0);
+
+	// Anything that can't be freed yet is left for the other participants
+	// to free once it's safe, or for the domain's destructor.
+	collect(*r);
+	{
+		std::scoped_lock lock{ m_orphanMutex };
+		for (auto& bag : r->m_bags)
+		{
+			if (!bag.m_objects.empty())
+			{
+				try
+				{
+					m_orphans.push_back(std::move(bag));
+				}
+				catch (...)
+				{
+					// Out of memory. Keep them in the record, to be freed by
+					// whichever participant reuses it, or by the domain.
+					continue;
+				}
+				bag.m_objects.clear();
+			}
+		}
+	}
+
+	r->m_retiredSinceCollect = 0;
+	r->m_inUse.store(false, std::memory_order_release);
+}
+
+bool cppcoro::epoch_domain::try_advance() noexcept
+{
+	// Pair with the fence in pin(), so that any participant pinned in an
+	// older epoch is seen here.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	std::uint64_t epoch = m_epoch.load(std::memory_order_relaxed);
+	for (record* r = m_records.load(std::memory_order_acquire); r != nullptr; r = r->m_next)
+	{
+		// Acquire, so that anything a participant read before unpinning
+		// happens before whatever gets freed as a result.
+		const std::uint64_t state = r->m_state.load(std::memory_order_acquire);
+		if ((state & 1) != 0 && (state >> 1) != epoch)
+		{
+			return false;
+		}
+	}
+
+	// Fails harmlessly if another participant advanced it first.
+	m_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_release, std::memory_order_relaxed);
+	return true;
+}
+
+void cppcoro::epoch_domain::collect(record& r) noexcept
+{
+	try_advance();
+
+	const std::uint64_t epoch = m_epoch.load(std::memory_order_acquire);
+	for (auto& bag : r.m_bags)
+	{
+		if (bag.m_epoch + 2 <= epoch)
+		{
+			free_bag(bag);
+		}
+	}
+
+	collect_orphans();
+}
+
+void cppcoro::epoch_domain::collect_orphans() noexcept
+{
+	std::unique_lock lock{ m_orphanMutex, std::try_to_lock };
+	if (!lock.owns_lock() || m_orphans.empty())
+	{
+		return;
+	}
+
+	const std::uint64_t epoch = m_epoch.load(std::memory_order_acquire);
+	auto it = m_orphans.begin();
+	while (it != m_orphans.end())
+	{
+		if (it->m_epoch + 2 <= epoch)
+		{
+			free_bag(*it);
+			it = m_orphans.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void cppcoro::epoch_domain::free_bag(retired_bag& bag) noexcept
+{
+	for (auto& object : bag.m_objects)
+	{
+		object.m_deleter(object.m_pointer);
+	}
+	bag.m_objects.clear();
+}
+
+cppcoro::epoch_domain::participant::participant(epoch_domain& domain)
+	: m_domain(domain)
+	, m_record(domain.acquire_record())
+{}
+
+cppcoro::epoch_domain::participant::~participant()
+{
+	m_domain.release_record(m_record);
+}
+
+void cppcoro::epoch_domain::participant::retire(void* pointer, deleter_t deleter)
+{
+	const std::uint64_t epoch = m_domain.m_epoch.load(std::memory_order_acquire);
+
+	auto& bag = m_record->m_bags[epoch % bag_count];
+	if (bag.m_epoch != epoch)
+	{
+		// The bag was last used at least three epochs ago, so everything
+		// in it can be freed.
+		free_bag(bag);
+		bag.m_epoch = epoch;
+	}
+
+	bag.m_objects.push_back(retired_object{ pointer, deleter });
+
+	if (++m_record->m_retiredSinceCollect >= local::collect_interval)
+	{
+		collect();
+	}
+}
+
+void cppcoro::epoch_domain::participant::collect() noexcept
+{
+	m_record->m_retiredSinceCollect = 0;
+	m_domain.collect(*m_record);
+}
@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/frame_arena.hpp>
+
+#include <algorithm>
+
+namespace
+{
+	// Stop doubling the block size once blocks reach 1MB.
+	constexpr std::size_t max_block_size = 1024 * 1024;
+}
+
+cppcoro::frame_arena::frame_arena(std::size_t initialBlockSize) noexcept
+	: m_currentBlock(nullptr)
+	, m_blocks(nullptr)
+	, m_nextBlockSize(std::max<std::size_t>(initialBlockSize, 256))
+{}
+
+cppcoro::frame_arena::~frame_arena()
+{
+	block* b = m_blocks;
+	while (b != nullptr)
+	{
+		block* next = b->m_next;
+		const std::size_t size = header_size + b->m_size;
+		b->~block();
+		::operator delete(static_cast<void*>(b), size);
+		b = next;
+	}
+}
+
+std::size_t cppcoro::frame_arena::bytes_allocated() const noexcept
+{
+	std::scoped_lock lock{ m_mutex };
+
+	std::size_t total = 0;
+	for (block* b = m_blocks; b != nullptr; b = b->m_next)
+	{
+		total += std::min(b->m_used.load(std::memory_order_relaxed), b->m_size);
+	}
+	return total;
+}
+
+void* cppcoro::frame_arena::allocate_slow(std::size_t size)
+{
+	std::scoped_lock lock{ m_mutex };
+
+	// Another thread may have replaced the block while we were waiting.
+	block* current = m_blocks;
+	if (current != nullptr)
+	{
+		const std::size_t offset = current->m_used.fetch_add(size, std::memory_order_relaxed);
+		if (offset + size <= current->m_size)
+		{
+			return current->data() + offset;
+		}
+	}
+
+	const std::size_t blockSize = std::max(m_nextBlockSize, size);
+	void* memory = ::operator new(header_size + blockSize);
+	block* newBlock = ::new (memory) block{ m_blocks, blockSize, { size } };
+	m_blocks = newBlock;
+	m_nextBlockSize = std::min(m_nextBlockSize * 2, max_block_size);
+
+	m_currentBlock.store(newBlock, std::memory_order_release);
+
+	return newBlock->data();
+}
@@ -22,6 +22,14 @@
 # include <WS2tcpip.h>
 # include <MSWSock.h>
 # include <Windows.h>
+#elif CPPCORO_OS_LINUX
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+# include <sys/timerfd.h>
+# include <poll.h>
+# include <unistd.h>
+# include <cerrno>
+# include <cstring>
 #endif
 
 namespace
@@ -77,6 +85,89 @@ namespace
 
 		return cppcoro::detail::win32::safe_handle{ handle };
 	}
+#elif CPPCORO_OS_LINUX
+	cppcoro::detail::lnx::safe_fd create_epoll_fd()
+	{
+		const int fd = ::epoll_create1(EPOLL_CLOEXEC);
+		if (fd == -1)
+		{
+			throw std::system_error
+			{
+				errno,
+				std::system_category(),
+				"Error creating io_service: epoll_create1"
+			};
+		}
+
+		return cppcoro::detail::lnx::safe_fd{ fd };
+	}
+
+	cppcoro::detail::lnx::safe_fd create_event_fd()
+	{
+		const int fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (fd == -1)
+		{
+			throw std::system_error
+			{
+				errno,
+				std::system_category(),
+				"Error creating event: eventfd"
+			};
+		}
+
+		return cppcoro::detail::lnx::safe_fd{ fd };
+	}
+
+	cppcoro::detail::lnx::safe_fd create_timer_fd()
+	{
+		const int fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+		if (fd == -1)
+		{
+			throw std::system_error
+			{
+				errno,
+				std::system_category(),
+				"Error creating timer: timerfd_create"
+			};
+		}
+
+		return cppcoro::detail::lnx::safe_fd{ fd };
+	}
+
+	cppcoro::detail::lnx::safe_fd create_epoll_fd_with_wake_up(int wakeUpFd)
+	{
+		auto epollFd = create_epoll_fd();
+
+		// A null data pointer identifies the wake-up event.
+		epoll_event event;
+		event.events = EPOLLIN;
+		event.data.ptr = nullptr;
+		if (::epoll_ctl(epollFd.fd(), EPOLL_CTL_ADD, wakeUpFd, &event) == -1)
+		{
+			throw std::system_error
+			{
+				errno,
+				std::system_category(),
+				"Error creating io_service: epoll_ctl"
+			};
+		}
+
+		return epollFd;
+	}
+
+	void signal_event_fd(int fd) noexcept
+	{
+		// Ignore failure. The only expected failure is EAGAIN when the
+		// counter would overflow, in which case the event is already set.
+		const std::uint64_t one = 1;
+		(void)::write(fd, &one, sizeof(one));
+	}
+
+	void drain_event_fd(int fd) noexcept
+	{
+		std::uint64_t value;
+		(void)::read(fd, &value, sizeof(value));
+	}
 #endif
 }
 
@@ -312,6 +403,9 @@ public:
 #if CPPCORO_OS_WINNT
 	detail::win32::safe_handle m_wakeUpEvent;
 	detail::win32::safe_handle m_waitableTimerEvent;
+#elif CPPCORO_OS_LINUX
+	detail::lnx::safe_fd m_wakeUpEvent;
+	detail::lnx::safe_fd m_waitableTimerEvent;
 #endif
 
 	std::atomic<io_service::timed_schedule_operation*> m_newlyQueuedTimers;
@@ -335,10 +429,22 @@ cppcoro::io_service::io_service(std::uint32_t concurrencyHint)
 	, m_iocpHandle(create_io_completion_port(concurrencyHint))
 	, m_winsockInitialised(false)
 	, m_winsockInitialisationMutex()
+#elif CPPCORO_OS_LINUX
+	, m_wakeUpFd(create_event_fd())
+	, m_readyScheduleHead(nullptr)
+	, m_readyScheduleTail(nullptr)
+	, m_readyCompletionHead(nullptr)
+	, m_readyCompletionTail(nullptr)
+	, m_waitingThreadCount(0)
+	, m_freeRegistrations(nullptr)
 #endif
 	, m_scheduleOperations(nullptr)
 	, m_timerState(nullptr)
 {
+#if CPPCORO_OS_LINUX
+	(void)concurrencyHint;
+	m_epollFd = create_epoll_fd_with_wake_up(m_wakeUpFd.fd());
+#endif
 }
 
 cppcoro::io_service::~io_service()
@@ -355,6 +461,14 @@ cppcoro::io_service::~io_service()
 		// Don't want to throw from the destructor, so perhaps just log an error?
 		(void)::WSACleanup();
 	}
+#elif CPPCORO_OS_LINUX
+	assert(m_readyScheduleHead == nullptr);
+	assert(m_readyCompletionHead == nullptr);
+
+	while (m_freeRegistrations != nullptr)
+	{
+		delete std::exchange(m_freeRegistrations, m_freeRegistrations->m_nextFree);
+	}
 #endif
 }
 
@@ -451,6 +565,12 @@ void cppcoro::io_service::reset()
 
 	// Check that there were no active threads running the event loop.
 	assert(oldState == stop_requested_flag);
+
+#if CPPCORO_OS_LINUX
+	// The wake-up event is left signalled by stop() so that all threads
+	// blocked in epoll_wait() observe it.
+	drain_wake_up_event();
+#endif
 }
 
 bool cppcoro::io_service::is_stop_requested() const noexcept
@@ -471,13 +591,13 @@ void cppcoro::io_service::notify_work_finished() noexcept
 	}
 }
 
+#if CPPCORO_OS_WINNT
+
 cppcoro::detail::win32::handle_t cppcoro::io_service::native_iocp_handle() noexcept
 {
 	return m_iocpHandle.handle();
 }
 
-#if CPPCORO_OS_WINNT
-
 void cppcoro::io_service::ensure_winsock_initialised()
 {
 	if (!m_winsockInitialised.load(std::memory_order_acquire))
@@ -502,6 +622,123 @@ void cppcoro::io_service::ensure_winsock_initialised()
 	}
 }
 
+#elif CPPCORO_OS_LINUX
+
+cppcoro::detail::lnx::fd_t cppcoro::io_service::native_epoll_handle() noexcept
+{
+	return m_epollFd.fd();
+}
+
+cppcoro::detail::lnx::io_registration*
+cppcoro::io_service::register_fd(detail::lnx::fd_t fd)
+{
+	detail::lnx::io_registration* registration = nullptr;
+	{
+		std::lock_guard lock{ m_registrationMutex };
+		registration = m_freeRegistrations;
+		if (registration != nullptr)
+		{
+			m_freeRegistrations = registration->m_nextFree;
+		}
+	}
+
+	if (registration == nullptr)
+	{
+		registration = new detail::lnx::io_registration;
+	}
+
+	registration->m_nextFree = nullptr;
+
+	// unregister_fd() completed any operation that was still waiting, so
+	// at most readiness or cancellation state is left behind.
+	[[maybe_unused]] detail::lnx::io_state* staleRecv = registration->m_recv.close();
+	[[maybe_unused]] detail::lnx::io_state* staleSend = registration->m_send.close();
+	assert(staleRecv == nullptr && staleSend == nullptr);
+
+	// Register for both directions once, in edge-triggered mode, so that
+	// operations never need to modify the registration.
+	epoll_event event;
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	event.data.ptr = registration;
+	if (::epoll_ctl(m_epollFd.fd(), EPOLL_CTL_ADD, fd, &event) == -1)
+	{
+		const int errorCode = errno;
+		unregister_fd(-1, registration);
+		throw std::system_error
+		{
+			errorCode,
+			std::system_category(),
+			"Error registering file descriptor with io_service: epoll_ctl"
+		};
+	}
+
+	return registration;
+}
+
+void cppcoro::io_service::unregister_fd(
+	detail::lnx::fd_t fd,
+	detail::lnx::io_registration* registration) noexcept
+{
+	if (fd != -1)
+	{
+		(void)::epoll_ctl(m_epollFd.fd(), EPOLL_CTL_DEL, fd, nullptr);
+	}
+
+	// The descriptor will never become ready again, so complete any
+	// operation still waiting on it rather than leaving it suspended.
+	if (detail::lnx::io_state* waiter = registration->m_recv.close())
+	{
+		post_completion(waiter, ECANCELED);
+	}
+	if (detail::lnx::io_state* waiter = registration->m_send.close())
+	{
+		post_completion(waiter, ECANCELED);
+	}
+
+	std::lock_guard lock{ m_registrationMutex };
+	registration->m_nextFree = m_freeRegistrations;
+	m_freeRegistrations = registration;
+}
+
+void cppcoro::io_service::post_completion(
+	detail::lnx::io_state* state,
+	int errorCode) noexcept
+{
+	state->m_pendingErrorCode = errorCode;
+	state->m_next = nullptr;
+	queue_completions(state, state);
+}
+
+void cppcoro::io_service::queue_completions(
+	detail::lnx::io_state* head,
+	detail::lnx::io_state* tail) noexcept
+{
+	bool wakeUpThread;
+	{
+		std::lock_guard lock{ m_readyMutex };
+		if (m_readyCompletionTail == nullptr)
+		{
+			m_readyCompletionHead = head;
+		}
+		else
+		{
+			m_readyCompletionTail->m_next = head;
+		}
+		m_readyCompletionTail = tail;
+		wakeUpThread = m_waitingThreadCount > 0;
+	}
+
+	if (wakeUpThread)
+	{
+		post_wake_up_event();
+	}
+}
+
+void cppcoro::io_service::drain_wake_up_event() noexcept
+{
+	drain_event_fd(m_wakeUpFd.fd());
+}
+
 #endif // CPPCORO_OS_WINNT
 
 void cppcoro::io_service::schedule_impl(schedule_operation* operation) noexcept
@@ -531,6 +768,28 @@ void cppcoro::io_service::schedule_impl(schedule_operation* operation) noexcept
 			std::memory_order_release,
 			std::memory_order_acquire));
 	}
+#elif CPPCORO_OS_LINUX
+	operation->m_next = nullptr;
+
+	bool wakeUpThread;
+	{
+		std::lock_guard lock{ m_readyMutex };
+		if (m_readyScheduleTail == nullptr)
+		{
+			m_readyScheduleHead = operation;
+		}
+		else
+		{
+			m_readyScheduleTail->m_next = operation;
+		}
+		m_readyScheduleTail = operation;
+		wakeUpThread = m_waitingThreadCount > 0;
+	}
+
+	if (wakeUpThread)
+	{
+		post_wake_up_event();
+	}
 #endif
 }
 
@@ -673,6 +932,166 @@ bool cppcoro::io_service::try_process_one_event(bool waitForEvent)
 			};
 		}
 	}
+#elif CPPCORO_OS_LINUX
+	if (is_stop_requested())
+	{
+		return false;
+	}
+
+	while (true)
+	{
+		// Dispatch work that is already known to be ready before polling
+		// for more. Completions are dispatched before scheduled coroutines
+		// as they are typically resuming I/O that others are waiting on.
+		bool isWaiting = false;
+		{
+			std::unique_lock lock{ m_readyMutex };
+			if (m_readyCompletionHead != nullptr)
+			{
+				auto* state = m_readyCompletionHead;
+				m_readyCompletionHead = state->m_next;
+				if (m_readyCompletionHead == nullptr)
+				{
+					m_readyCompletionTail = nullptr;
+				}
+
+				const bool wakeUpThread =
+					m_waitingThreadCount > 0 &&
+					(m_readyCompletionHead != nullptr || m_readyScheduleHead != nullptr);
+				lock.unlock();
+
+				if (wakeUpThread)
+				{
+					post_wake_up_event();
+				}
+
+				state->m_callback(state, state->m_pendingErrorCode);
+				return true;
+			}
+
+			if (m_readyScheduleHead != nullptr)
+			{
+				auto* operation = m_readyScheduleHead;
+				m_readyScheduleHead = operation->m_next;
+				if (m_readyScheduleHead == nullptr)
+				{
+					m_readyScheduleTail = nullptr;
+				}
+
+				const bool wakeUpThread =
+					m_waitingThreadCount > 0 && m_readyScheduleHead != nullptr;
+				lock.unlock();
+
+				if (wakeUpThread)
+				{
+					post_wake_up_event();
+				}
+
+				operation->m_awaiter.resume();
+				return true;
+			}
+
+			if (waitForEvent)
+			{
+				++m_waitingThreadCount;
+				isWaiting = true;
+			}
+		}
+
+		constexpr int maxEventCount = 64;
+		epoll_event events[maxEventCount];
+		const int eventCount = ::epoll_wait(
+			m_epollFd.fd(),
+			events,
+			maxEventCount,
+			isWaiting ? -1 : 0);
+		const int errorCode = errno;
+
+		if (isWaiting)
+		{
+			std::lock_guard lock{ m_readyMutex };
+			--m_waitingThreadCount;
+		}
+
+		if (eventCount == -1)
+		{
+			if (errorCode == EINTR)
+			{
+				continue;
+			}
+
+			throw std::system_error
+			{
+				errorCode,
+				std::system_category(),
+				"Error retrieving events from io_service: epoll_wait"
+			};
+		}
+
+		if (eventCount == 0 && !isWaiting)
+		{
+			return false;
+		}
+
+		detail::lnx::io_state* readyHead = nullptr;
+		detail::lnx::io_state* readyTail = nullptr;
+		const auto addReady = [&](detail::lnx::io_state* state) noexcept
+		{
+			if (state != nullptr)
+			{
+				state->m_pendingErrorCode = 0;
+				state->m_next = nullptr;
+				if (readyTail == nullptr)
+				{
+					readyHead = state;
+				}
+				else
+				{
+					readyTail->m_next = state;
+				}
+				readyTail = state;
+			}
+		};
+
+		bool wokenUp = false;
+		for (int i = 0; i < eventCount; ++i)
+		{
+			auto* registration = static_cast<detail::lnx::io_registration*>(events[i].data.ptr);
+			if (registration == nullptr)
+			{
+				wokenUp = true;
+				continue;
+			}
+
+			const auto flags = events[i].events;
+			if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+			{
+				addReady(registration->m_recv.notify());
+			}
+			if (flags & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+			{
+				addReady(registration->m_send.notify());
+			}
+		}
+
+		if (readyHead != nullptr)
+		{
+			queue_completions(readyHead, readyTail);
+		}
+
+		if (wokenUp)
+		{
+			// Empty event is a wake-up request, either because new work was
+			// queued or because stop() was called. Leave the event signalled
+			// on stop so that other threads blocked in epoll_wait() also wake.
+			if (is_stop_requested())
+			{
+				return false;
+			}
+
+			drain_wake_up_event();
+		}
+	}
 #endif
 }
 
@@ -685,6 +1104,8 @@ void cppcoro::io_service::post_wake_up_event() noexcept
 	// and the system is out of memory. In this case threads should find other events
 	// in the queue next time they check anyway and thus wake-up.
 	(void)::PostQueuedCompletionStatus(m_iocpHandle.handle(), 0, 0, nullptr);
+#elif CPPCORO_OS_LINUX
+	signal_event_fd(m_wakeUpFd.fd());
 #endif
 }
 
@@ -715,8 +1136,14 @@ cppcoro::io_service::timer_thread_state::timer_thread_state()
 #if CPPCORO_OS_WINNT
 	: m_wakeUpEvent(create_auto_reset_event())
 	, m_waitableTimerEvent(create_waitable_timer_event())
-#endif
 	, m_newlyQueuedTimers(nullptr)
+#elif CPPCORO_OS_LINUX
+	: m_wakeUpEvent(create_event_fd())
+	, m_waitableTimerEvent(create_timer_fd())
+	, m_newlyQueuedTimers(nullptr)
+#else
+	: m_newlyQueuedTimers(nullptr)
+#endif
 	, m_timerCancellationRequested(false)
 	, m_shutDownRequested(false)
 	, m_thread([this] { this->run(); })
@@ -897,6 +1324,134 @@ void cppcoro::io_service::timer_thread_state::run() noexcept
 					&timer->m_scheduleOperation);
 			}
 
+			timersReadyToResume = nextTimer;
+		}
+	}
+#elif CPPCORO_OS_LINUX
+	using clock = std::chrono::high_resolution_clock;
+	using time_point = clock::time_point;
+
+	timer_queue timerQueue;
+
+	pollfd pollFds[2];
+	pollFds[0].fd = m_wakeUpEvent.fd();
+	pollFds[0].events = POLLIN;
+	pollFds[1].fd = m_waitableTimerEvent.fd();
+	pollFds[1].events = POLLIN;
+
+	time_point lastSetWaitEventTime = time_point::max();
+
+	timed_schedule_operation* timersReadyToResume = nullptr;
+
+	int timeout = -1;
+	while (!m_shutDownRequested.load(std::memory_order_relaxed))
+	{
+		pollFds[0].revents = 0;
+		pollFds[1].revents = 0;
+
+		const int waitResult = ::poll(pollFds, 2, timeout);
+		if (waitResult > 0 && (pollFds[1].revents & POLLIN) != 0)
+		{
+			drain_event_fd(m_waitableTimerEvent.fd());
+			lastSetWaitEventTime = time_point::max();
+		}
+
+		if (waitResult < 0 || (pollFds[0].revents & POLLIN) != 0)
+		{
+			// Wake-up event, see the Windows implementation above.
+			drain_event_fd(m_wakeUpEvent.fd());
+
+			if (m_timerCancellationRequested.exchange(false, std::memory_order_acquire))
+			{
+				timerQueue.remove_cancelled_timers(timersReadyToResume);
+			}
+
+			auto* newTimers = m_newlyQueuedTimers.exchange(nullptr, std::memory_order_acquire);
+			while (newTimers != nullptr)
+			{
+				auto* timer = newTimers;
+				newTimers = timer->m_next;
+
+				if (timer->m_cancellationToken.is_cancellation_requested())
+				{
+					timer->m_next = timersReadyToResume;
+					timersReadyToResume = timer;
+				}
+				else
+				{
+					timerQueue.enqueue_timer(timer);
+				}
+			}
+		}
+
+		if (!timerQueue.is_empty())
+		{
+			time_point currentTime = clock::now();
+
+			timerQueue.dequeue_due_timers(currentTime, timersReadyToResume);
+
+			if (!timerQueue.is_empty())
+			{
+				auto earliestDueTime = timerQueue.earliest_due_time();
+				assert(earliestDueTime > currentTime);
+
+				if (earliestDueTime != lastSetWaitEventTime)
+				{
+					const auto timeUntilNextDueTime = std::max(
+						std::chrono::duration_cast<std::chrono::nanoseconds>(
+							earliestDueTime - currentTime),
+						std::chrono::nanoseconds(1));
+
+					// Relative, one-shot expiry. A zero it_value would disarm the timer.
+					itimerspec dueTime;
+					std::memset(&dueTime, 0, sizeof(dueTime));
+					dueTime.it_value.tv_sec = static_cast<time_t>(
+						timeUntilNextDueTime.count() / 1'000'000'000);
+					dueTime.it_value.tv_nsec = static_cast<long>(
+						timeUntilNextDueTime.count() % 1'000'000'000);
+
+					if (::timerfd_settime(m_waitableTimerEvent.fd(), 0, &dueTime, nullptr) == 0)
+					{
+						lastSetWaitEventTime = earliestDueTime;
+						timeout = -1;
+					}
+					else
+					{
+						// Fall back to using the timeout parameter of poll(),
+						// waking at least once a second to retry setting the timer.
+						using namespace std::literals::chrono_literals;
+						if (timeUntilNextDueTime > 1s)
+						{
+							timeout = 1000;
+						}
+						else if (timeUntilNextDueTime > 1ms)
+						{
+							timeout = static_cast<int>(
+								std::chrono::duration_cast<std::chrono::milliseconds>(
+									timeUntilNextDueTime).count());
+						}
+						else
+						{
+							timeout = 1;
+						}
+					}
+				}
+			}
+		}
+
+		// Now schedule any ready-to-run timers.
+		while (timersReadyToResume != nullptr)
+		{
+			auto* timer = timersReadyToResume;
+			auto* nextTimer = timer->m_next;
+
+			// See the Windows implementation above for the memory ordering rationale.
+			if (timer->m_refCount.fetch_sub(1, std::memory_order_release) == 1)
+			{
+				timer->m_scheduleOperation.m_service.schedule_impl(
+					&timer->m_scheduleOperation);
+			}
+
 			timersReadyToResume = nextTimer;
 		}
 	}
@@ -907,6 +1462,8 @@ void cppcoro::io_service::timer_thread_state::wake_up_timer_thread() noexcept
 {
 #if CPPCORO_OS_WINNT
 	(void)::SetEvent(m_wakeUpEvent.handle());
+#elif CPPCORO_OS_LINUX
+	signal_event_fd(m_wakeUpEvent.fd());
 #endif
 }
 
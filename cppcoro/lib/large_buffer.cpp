@@ -0,0 +1,299 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/large_buffer.hpp>
+
+#include <climits>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+#if CPPCORO_OS_WINNT
+# ifndef WIN32_LEAN_AND_MEAN
+#  define WIN32_LEAN_AND_MEAN
+# endif
+# include <Windows.h>
+#elif CPPCORO_OS_LINUX
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+namespace
+{
+	namespace local
+	{
+		// Buffers smaller than this come from the heap. Mapping them
+		// separately would waste most of a page and cost a system call.
+		constexpr std::size_t min_mapped_size = 64 * 1024;
+
+		std::size_t round_up(std::size_t size, std::size_t alignment) noexcept
+		{
+			return (size + alignment - 1) & ~(alignment - 1);
+		}
+
+		cppcoro::detail::large_buffer_memory allocate_from_heap(std::size_t size)
+		{
+			cppcoro::detail::large_buffer_memory memory;
+			memory.m_data = ::operator new(size, std::align_val_t{ CPPCORO_CPU_CACHE_LINE });
+			memory.m_size = size;
+			memory.m_backing = cppcoro::large_buffer_backing::heap;
+			return memory;
+		}
+
+#if CPPCORO_OS_LINUX
+		// The size of a huge page, both for MAP_HUGETLB's default pool and
+		// for transparent huge pages, on x86-64 and on aarch64 with 4K pages.
+		constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+
+		// From <numaif.h>, which is part of libnuma rather than the C library.
+		constexpr int mpol_preferred = 1;
+
+		// Pages are only ever preferred to come from the node. Under a strict
+		// binding a fault on a node that has run out of memory invokes the
+		// OOM killer or raises SIGBUS instead of falling back to another node.
+		bool prefer_node(void* address, std::size_t size, int numaNode) noexcept
+		{
+			constexpr std::size_t bitsPerWord = sizeof(unsigned long) * CHAR_BIT;
+
+			unsigned long nodeMask[1024 / bitsPerWord] = {};
+			if (numaNode < 0 || static_cast<std::size_t>(numaNode) >= sizeof(nodeMask) * CHAR_BIT)
+			{
+				return false;
+			}
+			nodeMask[numaNode / bitsPerWord] = 1UL << (numaNode % bitsPerWord);
+
+			// The kernel only looks at the first maxnode - 1 bits.
+			return ::syscall(
+				SYS_mbind,
+				address,
+				size,
+				mpol_preferred,
+				nodeMask,
+				sizeof(nodeMask) * CHAR_BIT + 1,
+				0) == 0;
+		}
+
+		cppcoro::detail::large_buffer_memory map_huge_pages(std::size_t size, int numaNode) noexcept
+		{
+			cppcoro::detail::large_buffer_memory memory;
+
+#ifdef MAP_HUGETLB
+			const std::size_t mappedSize = round_up(size, huge_page_size);
+			void* address = ::mmap(
+				nullptr,
+				mappedSize,
+				PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+				-1,
+				0);
+			if (address == MAP_FAILED)
+			{
+				// Usually because no huge pages have been reserved.
+				return memory;
+			}
+
+			memory.m_data = address;
+			memory.m_size = mappedSize;
+			memory.m_backing = cppcoro::large_buffer_backing::huge_pages;
+
+			if (numaNode != cppcoro::any_numa_node &&
+				prefer_node(address, mappedSize, numaNode))
+			{
+				memory.m_numaNode = numaNode;
+			}
+#else
+			(void)size;
+			(void)numaNode;
+#endif
+
+			return memory;
+		}
+
+		cppcoro::detail::large_buffer_memory map_pages(std::size_t size, int numaNode)
+		{
+			const std::size_t pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+			const bool wantsHugePages = size >= huge_page_size;
+
+			// Over-allocate so the buffer can start on a huge page boundary,
+			// which the kernel needs before it can use a huge page for it.
+			const std::size_t alignment = wantsHugePages ? huge_page_size : pageSize;
+			const std::size_t mappedSize = round_up(size, pageSize);
+			const std::size_t reservedSize = mappedSize + (alignment - pageSize);
+
+			void* reserved = ::mmap(
+				nullptr,
+				reservedSize,
+				PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS,
+				-1,
+				0);
+			if (reserved == MAP_FAILED)
+			{
+				throw std::bad_alloc{};
+			}
+
+			const auto reservedStart = reinterpret_cast<std::uintptr_t>(reserved);
+			const std::uintptr_t start = round_up(reservedStart, alignment);
+			const std::uintptr_t end = start + mappedSize;
+			if (start != reservedStart)
+			{
+				::munmap(reserved, start - reservedStart);
+			}
+			if (end != reservedStart + reservedSize)
+			{
+				::munmap(reinterpret_cast<void*>(end), reservedStart + reservedSize - end);
+			}
+
+			cppcoro::detail::large_buffer_memory memory;
+			memory.m_data = reinterpret_cast<void*>(start);
+			memory.m_size = mappedSize;
+			memory.m_backing = cppcoro::large_buffer_backing::standard_pages;
+
+			// Nothing has touched the pages yet, so they'll all be placed
+			// according to the policy.
+			if (numaNode != cppcoro::any_numa_node &&
+				prefer_node(memory.m_data, mappedSize, numaNode))
+			{
+				memory.m_numaNode = numaNode;
+			}
+
+#ifdef MADV_HUGEPAGE
+			if (wantsHugePages && ::madvise(memory.m_data, mappedSize, MADV_HUGEPAGE) == 0)
+			{
+				memory.m_backing = cppcoro::large_buffer_backing::transparent_huge_pages;
+			}
+#endif
+
+			return memory;
+		}
+#elif CPPCORO_OS_WINNT
+		cppcoro::detail::large_buffer_memory map_pages(std::size_t size, int numaNode)
+		{
+			const DWORD preferredNode =
+				numaNode == cppcoro::any_numa_node ?
+				NUMA_NO_PREFERRED_NODE : static_cast<DWORD>(numaNode);
+
+			cppcoro::detail::large_buffer_memory memory;
+
+			// Large pages need the SeLockMemoryPrivilege, which most processes
+			// don't have, so failing here is normal.
+			const SIZE_T largePageSize = ::GetLargePageMinimum();
+			if (largePageSize != 0 && size >= largePageSize)
+			{
+				const std::size_t mappedSize = round_up(size, largePageSize);
+				void* address = ::VirtualAllocExNuma(
+					::GetCurrentProcess(),
+					nullptr,
+					mappedSize,
+					MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+					PAGE_READWRITE,
+					preferredNode);
+				if (address != nullptr)
+				{
+					memory.m_data = address;
+					memory.m_size = mappedSize;
+					memory.m_backing = cppcoro::large_buffer_backing::huge_pages;
+					memory.m_numaNode = numaNode;
+					return memory;
+				}
+			}
+
+			void* address = ::VirtualAllocExNuma(
+				::GetCurrentProcess(),
+				nullptr,
+				size,
+				MEM_RESERVE | MEM_COMMIT,
+				PAGE_READWRITE,
+				preferredNode);
+			if (address == nullptr)
+			{
+				throw std::bad_alloc{};
+			}
+
+			memory.m_data = address;
+			memory.m_size = size;
+			memory.m_backing = cppcoro::large_buffer_backing::standard_pages;
+			memory.m_numaNode = numaNode;
+			return memory;
+		}
+#endif
+	}
+}
+
+cppcoro::detail::large_buffer_memory cppcoro::detail::allocate_large_buffer(
+	std::size_t count, std::size_t elementSize, int numaNode)
+{
+	if (count == 0)
+	{
+		return large_buffer_memory{};
+	}
+
+	if (count > std::numeric_limits<std::size_t>::max() / elementSize)
+	{
+		throw std::bad_alloc{};
+	}
+
+	const std::size_t size = count * elementSize;
+	if (size < local::min_mapped_size)
+	{
+		return local::allocate_from_heap(size);
+	}
+
+#if CPPCORO_OS_LINUX
+	if (size >= local::huge_page_size)
+	{
+		auto memory = local::map_huge_pages(size, numaNode);
+		if (memory.m_data != nullptr)
+		{
+			return memory;
+		}
+	}
+
+	return local::map_pages(size, numaNode);
+#elif CPPCORO_OS_WINNT
+	return local::map_pages(size, numaNode);
+#else
+	(void)numaNode;
+	return local::allocate_from_heap(size);
+#endif
+}
+
+void cppcoro::detail::free_large_buffer(const large_buffer_memory& memory) noexcept
+{
+	if (memory.m_backing == large_buffer_backing::heap)
+	{
+		::operator delete(memory.m_data, std::align_val_t{ CPPCORO_CPU_CACHE_LINE });
+		return;
+	}
+
+#if CPPCORO_OS_LINUX
+	::munmap(memory.m_data, memory.m_size);
+#elif CPPCORO_OS_WINNT
+	::VirtualFree(memory.m_data, 0, MEM_RELEASE);
+#endif
+}
+
+int cppcoro::current_numa_node() noexcept
+{
+#if CPPCORO_OS_LINUX
+	unsigned cpu = 0;
+	unsigned node = 0;
+	if (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+	{
+		return static_cast<int>(node);
+	}
+#elif CPPCORO_OS_WINNT
+	PROCESSOR_NUMBER processor;
+	::GetCurrentProcessorNumberEx(&processor);
+	USHORT node = 0;
+	if (::GetNumaProcessorNodeEx(&processor, &node) && node != MAXUSHORT)
+	{
+		return static_cast<int>(node);
+	}
+#endif
+
+	return any_numa_node;
+}
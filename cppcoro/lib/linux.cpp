@@ -0,0 +1,22 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/config.hpp>
+
+#if CPPCORO_OS_LINUX
+#include <cppcoro/detail/linux.hpp>
+
+#include <unistd.h>
+
+void cppcoro::detail::lnx::safe_fd::close() noexcept
+{
+	if (m_fd != -1)
+	{
+		::close(m_fd);
+		m_fd = -1;
+	}
+}
+
+#endif
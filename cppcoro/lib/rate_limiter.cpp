@@ -0,0 +1,242 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/rate_limiter.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+cppcoro::rate_limiter::rate_limiter(
+	static_thread_pool& threadPool,
+	double permitsPerSecond,
+	std::size_t burst,
+	std::uint32_t shardCount)
+	: m_threadPool(threadPool)
+	, m_shardCount(shardCount > 0 ? shardCount : 1)
+	, m_buckets(std::make_unique<bucket[]>(m_shardCount))
+	, m_nextShard(0)
+	, m_waitersHead(nullptr)
+	, m_waitersTail(nullptr)
+	, m_stopRequested(false)
+{
+	assert(permitsPerSecond > 0);
+
+	// Each shard gets an equal share of the rate and of the burst, rounding
+	// the burst up so that every shard can hand out at least one permit.
+	const double nanosecondsPerPermit = 1e9 * m_shardCount / permitsPerSecond;
+	const std::size_t shardBurst = std::max<std::size_t>(
+		(std::max<std::size_t>(burst, 1) + m_shardCount - 1) / m_shardCount, 1);
+
+	const auto start = now();
+	for (std::uint32_t i = 0; i < m_shardCount; ++i)
+	{
+		auto& b = m_buckets[i];
+		b.m_nanosecondsPerPermit = nanosecondsPerPermit;
+		b.m_burstWindow = b.cost(shardBurst);
+		b.m_theoreticalArrivalTime.store(start, std::memory_order_relaxed);
+	}
+
+	m_timerThread = std::thread([this] { run_timer(); });
+}
+
+cppcoro::rate_limiter::~rate_limiter()
+{
+	{
+		std::scoped_lock lock{ m_timerMutex };
+		assert(m_waitersHead == nullptr);
+		m_stopRequested = true;
+	}
+	m_timerWake.notify_one();
+	m_timerThread.join();
+}
+
+bool cppcoro::rate_limiter::try_acquire(std::size_t count) noexcept
+{
+	const auto timeNow = now();
+	const std::uint32_t home = home_shard();
+	for (std::uint32_t i = 0; i < m_shardCount; ++i)
+	{
+		if (m_buckets[(home + i) % m_shardCount].try_reserve(count, timeNow))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+std::int64_t cppcoro::rate_limiter::bucket::cost(std::size_t count) const noexcept
+{
+	return std::llround(static_cast<double>(count) * m_nanosecondsPerPermit);
+}
+
+std::int64_t cppcoro::rate_limiter::bucket::reserve(std::size_t count, std::int64_t now) noexcept
+{
+	const std::int64_t permitCost = cost(count);
+
+	std::int64_t oldTime = m_theoreticalArrivalTime.load(std::memory_order_relaxed);
+	if (oldTime >= now)
+	{
+		// The bucket isn't full, and the theoretical arrival time only ever
+		// moves forwards, so it will still be ahead of now when we add to it.
+		oldTime = m_theoreticalArrivalTime.fetch_add(permitCost, std::memory_order_relaxed);
+		return oldTime + permitCost - m_burstWindow;
+	}
+
+	// The bucket is full, so start from now rather than from the past.
+	while (!m_theoreticalArrivalTime.compare_exchange_weak(
+		oldTime,
+		std::max(oldTime, now) + permitCost,
+		std::memory_order_relaxed))
+	{}
+
+	return std::max(oldTime, now) + permitCost - m_burstWindow;
+}
+
+bool cppcoro::rate_limiter::bucket::try_reserve(std::size_t count, std::int64_t now) noexcept
+{
+	const std::int64_t permitCost = cost(count);
+
+	std::int64_t oldTime = m_theoreticalArrivalTime.load(std::memory_order_relaxed);
+	std::int64_t newTime;
+	do
+	{
+		newTime = std::max(oldTime, now) + permitCost;
+		if (newTime - m_burstWindow > now)
+		{
+			return false;
+		}
+	} while (!m_theoreticalArrivalTime.compare_exchange_weak(
+		oldTime,
+		newTime,
+		std::memory_order_relaxed));
+
+	return true;
+}
+
+std::uint32_t cppcoro::rate_limiter::home_shard() noexcept
+{
+	if (m_shardCount == 1)
+	{
+		return 0;
+	}
+
+	const std::uint32_t index = m_threadPool.current_thread_index();
+	if (index < m_threadPool.thread_count())
+	{
+		return index % m_shardCount;
+	}
+
+	return m_nextShard.fetch_add(1, std::memory_order_relaxed) % m_shardCount;
+}
+
+std::int64_t cppcoro::rate_limiter::reserve(std::size_t count, std::int64_t now) noexcept
+{
+	const std::uint32_t home = home_shard();
+	if (m_shardCount > 1)
+	{
+		// Use spare permits from the other shards before waiting on our own.
+		for (std::uint32_t i = 0; i < m_shardCount; ++i)
+		{
+			if (m_buckets[(home + i) % m_shardCount].try_reserve(count, now))
+			{
+				return now;
+			}
+		}
+	}
+
+	return m_buckets[home].reserve(count, now);
+}
+
+void cppcoro::rate_limiter::wait(rate_limiter_acquire_operation* operation) noexcept
+{
+	bool isEarliest;
+	{
+		std::scoped_lock lock{ m_timerMutex };
+
+		// Permits are reserved in order, so the new operation almost always
+		// goes at the end, after any that are due at the same time.
+		operation->m_next = nullptr;
+		if (m_waitersTail == nullptr)
+		{
+			m_waitersHead = operation;
+			m_waitersTail = operation;
+		}
+		else if (m_waitersTail->m_due <= operation->m_due)
+		{
+			m_waitersTail->m_next = operation;
+			m_waitersTail = operation;
+		}
+		else
+		{
+			rate_limiter_acquire_operation** next = &m_waitersHead;
+			while ((*next)->m_due <= operation->m_due)
+			{
+				next = &(*next)->m_next;
+			}
+			operation->m_next = *next;
+			*next = operation;
+		}
+
+		isEarliest = m_waitersHead == operation;
+	}
+
+	if (isEarliest)
+	{
+		m_timerWake.notify_one();
+	}
+}
+
+void cppcoro::rate_limiter::run_timer() noexcept
+{
+	std::unique_lock lock{ m_timerMutex };
+	while (!m_stopRequested)
+	{
+		if (m_waitersHead == nullptr)
+		{
+			m_timerWake.wait(lock);
+			continue;
+		}
+
+		const auto timeNow = now();
+		if (m_waitersHead->m_due > timeNow)
+		{
+			m_timerWake.wait_until(
+				lock,
+				std::chrono::steady_clock::time_point{
+					std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+						std::chrono::nanoseconds{ m_waitersHead->m_due }) });
+			continue;
+		}
+
+		// Detach everything that is due and schedule it outside the lock.
+		rate_limiter_acquire_operation* ready = m_waitersHead;
+		rate_limiter_acquire_operation* last = ready;
+		while (last->m_next != nullptr && last->m_next->m_due <= timeNow)
+		{
+			last = last->m_next;
+		}
+		m_waitersHead = last->m_next;
+		if (m_waitersHead == nullptr)
+		{
+			m_waitersTail = nullptr;
+		}
+		last->m_next = nullptr;
+
+		lock.unlock();
+
+		while (ready != nullptr)
+		{
+			// Read next before scheduling, as the operation may be destroyed
+			// as soon as the coroutine is resumed.
+			auto* next = ready->m_next;
+			ready->m_schedule.await_suspend(ready->m_awaitingCoroutine);
+			ready = next;
+		}
+
+		lock.lock();
+	}
+}
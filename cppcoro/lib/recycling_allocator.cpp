@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/recycling_allocator.hpp>
+
+cppcoro::recycling_pool::recycling_pool(std::size_t maxFreeBlocksPerSize) noexcept
+	: m_maxFreeBlocksPerSize(maxFreeBlocksPerSize)
+	, m_freeLists()
+{}
+
+cppcoro::recycling_pool::~recycling_pool()
+{
+	for (auto& list : m_freeLists)
+	{
+		free_block* block = list.m_head;
+		while (block != nullptr)
+		{
+			free_block* next = block->m_next;
+			::operator delete(block, block_size(list.m_blockSize));
+			block = next;
+		}
+	}
+}
+
+std::size_t cppcoro::recycling_pool::free_block_count() const noexcept
+{
+	std::size_t count = 0;
+	for (auto& list : m_freeLists)
+	{
+		count += list.m_count;
+	}
+	return count;
+}
+
+void cppcoro::recycling_pool::deallocate_slow(void* block, std::size_t size) noexcept
+{
+	// Start keeping blocks of a new size if there's a list free for it.
+	// Otherwise either there are already too many of this size, or too many
+	// other sizes are being kept.
+	if (m_maxFreeBlocksPerSize != 0)
+	{
+		bool haveList = false;
+		for (auto& list : m_freeLists)
+		{
+			haveList = haveList || list.m_blockSize == size;
+		}
+
+		if (!haveList)
+		{
+			for (auto& list : m_freeLists)
+			{
+				if (list.m_blockSize == 0)
+				{
+					list.m_blockSize = size;
+					list.m_head = ::new (block) free_block{ nullptr };
+					list.m_count = 1;
+					return;
+				}
+			}
+		}
+	}
+
+	::operator delete(block, block_size(size));
+}
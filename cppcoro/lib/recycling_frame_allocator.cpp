@@ -0,0 +1,166 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/detail/recycling_frame_allocator.hpp>
+
+namespace cppcoro::detail
+{
+	// Shuts down the thread's cache when the thread exits.
+	struct thread_cache_owner
+	{
+		recycling_frame_allocator::thread_cache* m_cache = nullptr;
+
+		~thread_cache_owner()
+		{
+			if (m_cache != nullptr)
+			{
+				recycling_frame_allocator::shut_down(m_cache);
+			}
+		}
+	};
+}
+
+namespace
+{
+	thread_local cppcoro::detail::thread_cache_owner t_cacheOwner;
+
+	// Stops a new cache being created by frames allocated from thread_local
+	// destructors that run after the thread's cache has been shut down.
+	thread_local bool t_cacheShutDown = false;
+}
+
+cppcoro::detail::recycling_frame_allocator::free_frame*
+cppcoro::detail::recycling_frame_allocator::closed_sentinel() noexcept
+{
+	static free_frame closed;
+	return &closed;
+}
+
+void* cppcoro::detail::recycling_frame_allocator::allocate_slow(std::size_t sizeClass)
+{
+	thread_cache* cache = current_cache();
+	if (cache == nullptr && !t_cacheShutDown)
+	{
+		cache = new thread_cache;
+		t_cacheOwner.m_cache = cache;
+		current_cache() = cache;
+	}
+
+	if (cache != nullptr &&
+		take_remote_frees(*cache) &&
+		cache->m_freeLists[sizeClass] != nullptr)
+	{
+		free_frame* block = cache->m_freeLists[sizeClass];
+		cache->m_freeLists[sizeClass] = block->m_next;
+		--cache->m_freeCounts[sizeClass];
+		++cache->m_outstanding;
+		return frame_of(block);
+	}
+
+	void* memory = ::operator new(block_size(sizeClass));
+	auto* block = ::new (memory) free_frame{ cache, static_cast<std::uint32_t>(sizeClass), nullptr };
+	if (cache != nullptr)
+	{
+		++cache->m_outstanding;
+	}
+	return frame_of(block);
+}
+
+void cppcoro::detail::recycling_frame_allocator::deallocate_slow(free_frame* block) noexcept
+{
+	thread_cache* owner = block->m_owner;
+	const std::size_t size = block_size(block->m_sizeClass);
+	if (owner == nullptr)
+	{
+		::operator delete(static_cast<void*>(block), size);
+		return;
+	}
+
+	free_frame* head = owner->m_remoteFrees.load(std::memory_order_relaxed);
+	do
+	{
+		if (head == closed_sentinel())
+		{
+			// The owning thread has exited, so the frame has nowhere to go.
+			::operator delete(static_cast<void*>(block), size);
+			if (owner->m_orphanedFrames.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				delete owner;
+			}
+			return;
+		}
+
+		block->m_next = head;
+	} while (!owner->m_remoteFrees.compare_exchange_weak(
+		head,
+		block,
+		std::memory_order_release,
+		std::memory_order_relaxed));
+}
+
+bool cppcoro::detail::recycling_frame_allocator::take_remote_frees(thread_cache& cache) noexcept
+{
+	// Avoid the exchange in the common case that there's nothing there.
+	if (cache.m_remoteFrees.load(std::memory_order_relaxed) == nullptr)
+	{
+		return false;
+	}
+
+	free_frame* block = cache.m_remoteFrees.exchange(nullptr, std::memory_order_acquire);
+	while (block != nullptr)
+	{
+		free_frame* next = block->m_next;
+		const std::size_t sizeClass = block->m_sizeClass;
+		if (cache.m_freeCounts[sizeClass] < max_free_per_class)
+		{
+			block->m_next = cache.m_freeLists[sizeClass];
+			cache.m_freeLists[sizeClass] = block;
+			++cache.m_freeCounts[sizeClass];
+		}
+		else
+		{
+			::operator delete(static_cast<void*>(block), block_size(sizeClass));
+		}
+		--cache.m_outstanding;
+		block = next;
+	}
+
+	return true;
+}
+
+void cppcoro::detail::recycling_frame_allocator::shut_down(thread_cache* cache) noexcept
+{
+	current_cache() = nullptr;
+	t_cacheShutDown = true;
+
+	// Frames freed by other threads from now on are freed straight away.
+	free_frame* block = cache->m_remoteFrees.exchange(closed_sentinel(), std::memory_order_acq_rel);
+	while (block != nullptr)
+	{
+		free_frame* next = block->m_next;
+		::operator delete(static_cast<void*>(block), block_size(block->m_sizeClass));
+		--cache->m_outstanding;
+		block = next;
+	}
+
+	for (std::size_t sizeClass = 0; sizeClass < size_class_count; ++sizeClass)
+	{
+		block = cache->m_freeLists[sizeClass];
+		while (block != nullptr)
+		{
+			free_frame* next = block->m_next;
+			::operator delete(static_cast<void*>(block), block_size(sizeClass));
+			block = next;
+		}
+	}
+
+	// Other threads may already have counted down some of the outstanding
+	// frames, taking the count below zero.
+	const auto outstanding = static_cast<std::int64_t>(cache->m_outstanding);
+	if (cache->m_orphanedFrames.fetch_add(outstanding, std::memory_order_acq_rel) + outstanding == 0)
+	{
+		delete cache;
+	}
+}
@@ -0,0 +1,28 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/sharded_counter.hpp>
+
+cppcoro::sharded_counter::sharded_counter(std::uint32_t sharedShardCount)
+	: m_selector(nullptr, sharedShardCount)
+	, m_shards(std::make_unique<shard[]>(m_selector.shard_count()))
+{}
+
+cppcoro::sharded_counter::sharded_counter(
+	static_thread_pool& threadPool,
+	std::uint32_t sharedShardCount)
+	: m_selector(&threadPool, sharedShardCount)
+	, m_shards(std::make_unique<shard[]>(m_selector.shard_count()))
+{}
+
+std::uint64_t cppcoro::sharded_counter::value() const noexcept
+{
+	std::uint64_t total = 0;
+	for (std::uint32_t i = 0; i < m_selector.shard_count(); ++i)
+	{
+		total += m_shards[i].m_count.load(std::memory_order_relaxed);
+	}
+	return total;
+}
@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/sharded_histogram.hpp>
+
+#include <cmath>
+
+std::uint64_t cppcoro::histogram_snapshot::count() const noexcept
+{
+	std::uint64_t total = 0;
+	for (std::uint64_t bucketCount : m_buckets)
+	{
+		total += bucketCount;
+	}
+	return total;
+}
+
+std::uint64_t cppcoro::histogram_snapshot::value_at_quantile(double quantile) const noexcept
+{
+	const std::uint64_t total = count();
+	if (total == 0)
+	{
+		return 0;
+	}
+
+	// The rank of the value, counting from 1.
+	const double clamped = quantile < 0.0 ? 0.0 : (quantile > 1.0 ? 1.0 : quantile);
+	std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(clamped * static_cast<double>(total)));
+	if (rank == 0)
+	{
+		rank = 1;
+	}
+
+	std::uint64_t seen = 0;
+	for (std::size_t i = 0; i < bucket_count; ++i)
+	{
+		seen += m_buckets[i];
+		if (seen >= rank)
+		{
+			return bucket_upper_bound(i);
+		}
+	}
+
+	return bucket_upper_bound(bucket_count - 1);
+}
+
+cppcoro::sharded_histogram::sharded_histogram(std::uint32_t sharedShardCount)
+	: m_selector(nullptr, sharedShardCount)
+	, m_shards(std::make_unique<shard[]>(m_selector.shard_count()))
+{}
+
+cppcoro::sharded_histogram::sharded_histogram(
+	static_thread_pool& threadPool,
+	std::uint32_t sharedShardCount)
+	: m_selector(&threadPool, sharedShardCount)
+	, m_shards(std::make_unique<shard[]>(m_selector.shard_count()))
+{}
+
+cppcoro::histogram_snapshot cppcoro::sharded_histogram::snapshot() const noexcept
+{
+	histogram_snapshot result;
+	for (std::uint32_t i = 0; i < m_selector.shard_count(); ++i)
+	{
+		const shard& s = m_shards[i];
+		for (std::size_t b = 0; b < histogram_snapshot::bucket_count; ++b)
+		{
+			result.m_buckets[b] += s.m_buckets[b].load(std::memory_order_relaxed);
+		}
+		result.m_sum += s.m_sum.load(std::memory_order_relaxed);
+	}
+	return result;
+}
@@ -375,6 +375,248 @@ void cppcoro::net::socket::listen(std::uint32_t backlog)
 	}
 }
 
+void cppcoro::net::socket::close_send()
+{
+	int result = ::shutdown(m_handle, SD_SEND);
+	if (result == SOCKET_ERROR)
+	{
+		int errorCode = ::WSAGetLastError();
+		throw std::system_error(
+			errorCode,
+			std::system_category(),
+			"failed to close socket send stream: shutdown(SD_SEND)");
+	}
+}
+
+void cppcoro::net::socket::close_recv()
+{
+	int result = ::shutdown(m_handle, SD_RECEIVE);
+	if (result == SOCKET_ERROR)
+	{
+		int errorCode = ::WSAGetLastError();
+		throw std::system_error(
+			errorCode,
+			std::system_category(),
+			"failed to close socket receive stream: shutdown(SD_RECEIVE)");
+	}
+}
+
+cppcoro::net::socket::socket(
+	cppcoro::detail::win32::socket_t handle,
+	bool skipCompletionOnSuccess) noexcept
+	: m_handle(handle)
+	, m_skipCompletionOnSuccess(skipCompletionOnSuccess)
+{
+}
+
+#elif CPPCORO_OS_LINUX
+# include <cerrno>
+# include <netinet/in.h>
+# include <sys/socket.h>
+# include <unistd.h>
+
+namespace
+{
+	namespace local
+	{
+		int create_socket(int addressFamily, int socketType, int protocol)
+		{
+			const int fd = ::socket(
+				addressFamily,
+				socketType | SOCK_NONBLOCK | SOCK_CLOEXEC,
+				protocol);
+			if (fd == -1)
+			{
+				throw std::system_error(
+					errno,
+					std::system_category(),
+					"Error creating socket: socket");
+			}
+
+			return fd;
+		}
+	}
+}
+
+cppcoro::net::socket cppcoro::net::socket::create_tcpv4(io_service& ioSvc)
+{
+	const int fd = local::create_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	auto closeOnFailure = on_scope_failure([&] { ::close(fd); });
+
+	socket result(fd, ioSvc, ioSvc.register_fd(fd));
+	result.m_localEndPoint = ipv4_endpoint();
+	result.m_remoteEndPoint = ipv4_endpoint();
+	return result;
+}
+
+cppcoro::net::socket cppcoro::net::socket::create_tcpv6(io_service& ioSvc)
+{
+	const int fd = local::create_socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP);
+	auto closeOnFailure = on_scope_failure([&] { ::close(fd); });
+
+	socket result(fd, ioSvc, ioSvc.register_fd(fd));
+	result.m_localEndPoint = ipv6_endpoint();
+	result.m_remoteEndPoint = ipv6_endpoint();
+	return result;
+}
+
+cppcoro::net::socket cppcoro::net::socket::create_udpv4(io_service& ioSvc)
+{
+	const int fd = local::create_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	auto closeOnFailure = on_scope_failure([&] { ::close(fd); });
+
+	socket result(fd, ioSvc, ioSvc.register_fd(fd));
+	result.m_localEndPoint = ipv4_endpoint();
+	result.m_remoteEndPoint = ipv4_endpoint();
+	return result;
+}
+
+cppcoro::net::socket cppcoro::net::socket::create_udpv6(io_service& ioSvc)
+{
+	const int fd = local::create_socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	auto closeOnFailure = on_scope_failure([&] { ::close(fd); });
+
+	socket result(fd, ioSvc, ioSvc.register_fd(fd));
+	result.m_localEndPoint = ipv6_endpoint();
+	result.m_remoteEndPoint = ipv6_endpoint();
+	return result;
+}
+
+cppcoro::net::socket::socket(socket&& other) noexcept
+	: m_handle(std::exchange(other.m_handle, -1))
+	, m_ioService(other.m_ioService)
+	, m_registration(std::exchange(other.m_registration, nullptr))
+	, m_localEndPoint(std::move(other.m_localEndPoint))
+	, m_remoteEndPoint(std::move(other.m_remoteEndPoint))
+{}
+
+cppcoro::net::socket::~socket()
+{
+	close();
+}
+
+cppcoro::net::socket&
+cppcoro::net::socket::operator=(socket&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+
+		m_handle = std::exchange(other.m_handle, -1);
+		m_ioService = other.m_ioService;
+		m_registration = std::exchange(other.m_registration, nullptr);
+		m_localEndPoint = other.m_localEndPoint;
+		m_remoteEndPoint = other.m_remoteEndPoint;
+	}
+
+	return *this;
+}
+
+void cppcoro::net::socket::bind(const ip_endpoint& localEndPoint)
+{
+	sockaddr_storage sockaddrStorage = { 0 };
+	const int sockaddrLength = detail::ip_endpoint_to_sockaddr(
+		localEndPoint, std::ref(sockaddrStorage));
+
+	int result = ::bind(
+		m_handle,
+		reinterpret_cast<const sockaddr*>(&sockaddrStorage),
+		static_cast<socklen_t>(sockaddrLength));
+	if (result != 0)
+	{
+		throw std::system_error(
+			errno,
+			std::system_category(),
+			"Error binding to endpoint: bind()");
+	}
+
+	socklen_t nameLength = sizeof(sockaddrStorage);
+	result = ::getsockname(
+		m_handle,
+		reinterpret_cast<sockaddr*>(&sockaddrStorage),
+		&nameLength);
+	if (result == 0)
+	{
+		m_localEndPoint = cppcoro::net::detail::sockaddr_to_ip_endpoint(
+			*reinterpret_cast<const sockaddr*>(&sockaddrStorage));
+	}
+	else
+	{
+		m_localEndPoint = localEndPoint;
+	}
+}
+
+void cppcoro::net::socket::listen()
+{
+	listen(SOMAXCONN);
+}
+
+void cppcoro::net::socket::listen(std::uint32_t backlog)
+{
+	if (backlog > 0x7FFFFFFF)
+	{
+		backlog = 0x7FFFFFFF;
+	}
+
+	int result = ::listen(m_handle, (int)backlog);
+	if (result != 0)
+	{
+		throw std::system_error(
+			errno,
+			std::system_category(),
+			"Failed to start listening on bound endpoint: listen");
+	}
+}
+
+void cppcoro::net::socket::close_send()
+{
+	int result = ::shutdown(m_handle, SHUT_WR);
+	if (result == -1)
+	{
+		throw std::system_error(
+			errno,
+			std::system_category(),
+			"failed to close socket send stream: shutdown(SHUT_WR)");
+	}
+}
+
+void cppcoro::net::socket::close_recv()
+{
+	int result = ::shutdown(m_handle, SHUT_RD);
+	if (result == -1)
+	{
+		throw std::system_error(
+			errno,
+			std::system_category(),
+			"failed to close socket receive stream: shutdown(SHUT_RD)");
+	}
+}
+
+cppcoro::net::socket::socket(
+	cppcoro::detail::lnx::fd_t handle,
+	cppcoro::io_service& ioService,
+	cppcoro::detail::lnx::io_registration* registration) noexcept
+	: m_handle(handle)
+	, m_ioService(&ioService)
+	, m_registration(registration)
+{
+}
+
+void cppcoro::net::socket::close() noexcept
+{
+	if (m_handle != -1)
+	{
+		m_ioService->unregister_fd(m_handle, m_registration);
+		::close(m_handle);
+		m_handle = -1;
+		m_registration = nullptr;
+	}
+}
+
+#endif
+
+#if CPPCORO_OS_WINNT || CPPCORO_OS_LINUX
+
 cppcoro::net::socket_accept_operation
 cppcoro::net::socket::accept(socket& acceptingSocket) noexcept
 {
@@ -459,38 +701,4 @@ cppcoro::net::socket::send_to(const ip_endpoint& destination, const void* buffer
 	return socket_send_to_operation_cancellable{ *this, destination, buffer, byteCount, std::move(ct) };
 }
 
-void cppcoro::net::socket::close_send()
-{
-	int result = ::shutdown(m_handle, SD_SEND);
-	if (result == SOCKET_ERROR)
-	{
-		int errorCode = ::WSAGetLastError();
-		throw std::system_error(
-			errorCode,
-			std::system_category(),
-			"failed to close socket send stream: shutdown(SD_SEND)");
-	}
-}
-
-void cppcoro::net::socket::close_recv()
-{
-	int result = ::shutdown(m_handle, SD_RECEIVE);
-	if (result == SOCKET_ERROR)
-	{
-		int errorCode = ::WSAGetLastError();
-		throw std::system_error(
-			errorCode,
-			std::system_category(),
-			"failed to close socket receive stream: shutdown(SD_RECEIVE)");
-	}
-}
-
-cppcoro::net::socket::socket(
-	cppcoro::detail::win32::socket_t handle,
-	bool skipCompletionOnSuccess) noexcept
-	: m_handle(handle)
-	, m_skipCompletionOnSuccess(skipCompletionOnSuccess)
-{
-}
-
 #endif
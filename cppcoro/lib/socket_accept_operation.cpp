@@ -126,4 +126,108 @@ void cppcoro::net::socket_accept_operation_impl::get_result(
 	}
 }
 
+#elif CPPCORO_OS_LINUX
+# include <cerrno>
+# include <new>
+# include <sys/socket.h>
+# include <unistd.h>
+
+bool cppcoro::net::socket_accept_operation_impl::try_start(
+	cppcoro::detail::linux_async_operation_base& operation) noexcept
+{
+	return operation.try_complete(m_listeningSocket.recv_readiness(), [&]
+	{
+		int fd;
+		do
+		{
+			fd = ::accept4(
+				m_listeningSocket.native_handle(),
+				nullptr,
+				nullptr,
+				SOCK_NONBLOCK | SOCK_CLOEXEC);
+		} while (fd == -1 && (errno == EINTR || errno == ECONNABORTED));
+
+		if (fd == -1)
+		{
+			const int errorCode = errno;
+			if (errorCode == EAGAIN || errorCode == EWOULDBLOCK)
+			{
+				return false;
+			}
+
+			operation.m_errorCode = errorCode;
+			return true;
+		}
+
+		// Unlike AcceptEx(), accept4() creates a new socket for the connection
+		// so replace the accepting socket's descriptor with it.
+		io_service& ioService = m_acceptingSocket.service();
+		cppcoro::detail::lnx::io_registration* registration = nullptr;
+		try
+		{
+			registration = ioService.register_fd(fd);
+		}
+		catch (const std::system_error& ex)
+		{
+			::close(fd);
+			operation.m_errorCode = ex.code().value();
+			return true;
+		}
+		catch (const std::bad_alloc&)
+		{
+			::close(fd);
+			operation.m_errorCode = ENOMEM;
+			return true;
+		}
+
+		m_acceptingSocket.close();
+		m_acceptingSocket.m_handle = fd;
+		m_acceptingSocket.m_ioService = &ioService;
+		m_acceptingSocket.m_registration = registration;
+
+		operation.m_errorCode = 0;
+		return true;
+	});
+}
+
+void cppcoro::net::socket_accept_operation_impl::cancel(
+	cppcoro::detail::linux_async_operation_base& operation) noexcept
+{
+	operation.cancel_wait(m_listeningSocket.service());
+}
+
+void cppcoro::net::socket_accept_operation_impl::get_result(
+	cppcoro::detail::linux_async_operation_base& operation)
+{
+	if (operation.m_errorCode != 0)
+	{
+		throw std::system_error{
+			operation.m_errorCode,
+			std::system_category(),
+			"Accepting a connection failed: accept4"
+		};
+	}
+
+	sockaddr_storage sockaddrStorage;
+	socklen_t nameLength = sizeof(sockaddrStorage);
+	if (::getsockname(
+		m_acceptingSocket.native_handle(),
+		reinterpret_cast<sockaddr*>(&sockaddrStorage),
+		&nameLength) == 0)
+	{
+		m_acceptingSocket.m_localEndPoint =
+			detail::sockaddr_to_ip_endpoint(*reinterpret_cast<sockaddr*>(&sockaddrStorage));
+	}
+
+	nameLength = sizeof(sockaddrStorage);
+	if (::getpeername(
+		m_acceptingSocket.native_handle(),
+		reinterpret_cast<sockaddr*>(&sockaddrStorage),
+		&nameLength) == 0)
+	{
+		m_acceptingSocket.m_remoteEndPoint =
+			detail::sockaddr_to_ip_endpoint(*reinterpret_cast<sockaddr*>(&sockaddrStorage));
+	}
+}
+
 #endif
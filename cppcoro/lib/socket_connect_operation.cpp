@@ -175,4 +175,141 @@ void cppcoro::net::socket_connect_operation_impl::get_result(
 	}
 }
 
+#elif CPPCORO_OS_LINUX
+# include <cerrno>
+# include <sys/socket.h>
+
+bool cppcoro::net::socket_connect_operation_impl::try_start(
+	cppcoro::detail::linux_async_operation_base& operation) noexcept
+{
+	return operation.try_complete(m_socket.send_readiness(), [&]
+	{
+		if (!m_isConnecting)
+		{
+			sockaddr_storage remoteSockaddrStorage;
+			const int sockaddrNameLength = cppcoro::net::detail::ip_endpoint_to_sockaddr(
+				m_remoteEndPoint,
+				std::ref(remoteSockaddrStorage));
+
+			const int result = ::connect(
+				m_socket.native_handle(),
+				reinterpret_cast<const sockaddr*>(&remoteSockaddrStorage),
+				static_cast<socklen_t>(sockaddrNameLength));
+			if (result == 0)
+			{
+				operation.m_errorCode = 0;
+				return true;
+			}
+
+			const int errorCode = errno;
+			if (errorCode != EINPROGRESS && errorCode != EINTR)
+			{
+				// Failed synchronously.
+				operation.m_errorCode = errorCode;
+				return true;
+			}
+
+			// An interrupted connect() continues asynchronously, same as EINPROGRESS.
+			m_isConnecting = true;
+			return false;
+		}
+
+		int errorCode = 0;
+		socklen_t errorCodeLength = sizeof(errorCode);
+		if (::getsockopt(
+			m_socket.native_handle(),
+			SOL_SOCKET,
+			SO_ERROR,
+			&errorCode,
+			&errorCodeLength) == -1)
+		{
+			errorCode = errno;
+		}
+
+		if (errorCode != 0)
+		{
+			operation.m_errorCode = errorCode;
+			return true;
+		}
+
+		// The socket may have been reported writable spuriously, it is
+		// only connected once it has a peer.
+		sockaddr_storage remoteSockaddr;
+		socklen_t nameLength = sizeof(remoteSockaddr);
+		if (::getpeername(
+			m_socket.native_handle(),
+			reinterpret_cast<sockaddr*>(&remoteSockaddr),
+			&nameLength) == -1)
+		{
+			errorCode = errno;
+			if (errorCode == ENOTCONN)
+			{
+				return false;
+			}
+
+			operation.m_errorCode = errorCode;
+			return true;
+		}
+
+		operation.m_errorCode = 0;
+		return true;
+	});
+}
+
+void cppcoro::net::socket_connect_operation_impl::cancel(
+	cppcoro::detail::linux_async_operation_base& operation) noexcept
+{
+	operation.cancel_wait(m_socket.service());
+}
+
+void cppcoro::net::socket_connect_operation_impl::get_result(
+	cppcoro::detail::linux_async_operation_base& operation)
+{
+	if (operation.m_errorCode != 0)
+	{
+		if (operation.m_errorCode == ECANCELED)
+		{
+			throw operation_cancelled{};
+		}
+
+		throw std::system_error{
+			operation.m_errorCode,
+			std::system_category(),
+			"Connect operation failed: connect"
+		};
+	}
+
+	{
+		sockaddr_storage localSockaddr;
+		socklen_t nameLength = sizeof(localSockaddr);
+		const int result = ::getsockname(
+			m_socket.native_handle(),
+			reinterpret_cast<sockaddr*>(&localSockaddr),
+			&nameLength);
+		if (result == 0)
+		{
+			m_socket.m_localEndPoint = cppcoro::net::detail::sockaddr_to_ip_endpoint(
+				*reinterpret_cast<const sockaddr*>(&localSockaddr));
+		}
+	}
+
+	{
+		sockaddr_storage remoteSockaddr;
+		socklen_t nameLength = sizeof(remoteSockaddr);
+		const int result = ::getpeername(
+			m_socket.native_handle(),
+			reinterpret_cast<sockaddr*>(&remoteSockaddr),
+			&nameLength);
+		if (result == 0)
+		{
+			m_socket.m_remoteEndPoint = cppcoro::net::detail::sockaddr_to_ip_endpoint(
+				*reinterpret_cast<const sockaddr*>(&remoteSockaddr));
+		}
+		else
+		{
+			m_socket.m_remoteEndPoint = m_remoteEndPoint;
+		}
+	}
+}
+
 #endif
@@ -104,4 +104,49 @@ void cppcoro::net::socket_disconnect_operation_impl::get_result(
 	}
 }
 
+#elif CPPCORO_OS_LINUX
+# include <cerrno>
+# include <sys/socket.h>
+
+bool cppcoro::net::socket_disconnect_operation_impl::try_start(
+	cppcoro::detail::linux_async_operation_base& operation) noexcept
+{
+	// There is no asynchronous equivalent of DisconnectEx(), shutting down
+	// both directions of the connection completes synchronously.
+	if (::shutdown(m_socket.native_handle(), SHUT_RDWR) == -1 && errno != ENOTCONN)
+	{
+		operation.m_errorCode = errno;
+	}
+	else
+	{
+		operation.m_errorCode = 0;
+	}
+
+	return false;
+}
+
+void cppcoro::net::socket_disconnect_operation_impl::cancel(
+	cppcoro::detail::linux_async_operation_base&) noexcept
+{
+	// Always completes synchronously, nothing to cancel.
+}
+
+void cppcoro::net::socket_disconnect_operation_impl::get_result(
+	cppcoro::detail::linux_async_operation_base& operation)
+{
+	if (operation.m_errorCode != 0)
+	{
+		if (operation.m_errorCode == ECANCELED)
+		{
+			throw operation_cancelled{};
+		}
+
+		throw std::system_error{
+			operation.m_errorCode,
+			std::system_category(),
+			"Disconnect operation failed: shutdown"
+		};
+	}
+}
+
 #endif
@@ -9,6 +9,10 @@
 
 #if CPPCORO_OS_WINNT
 # include <cppcoro/detail/win32.hpp>
+#endif
+
+#if CPPCORO_OS_WINNT || CPPCORO_OS_LINUX
+# include <functional>
 struct sockaddr;
 struct sockaddr_storage;
 #endif
@@ -21,7 +25,7 @@ namespace cppcoro
 
 		namespace detail
 		{
-#if CPPCORO_OS_WINNT
+#if CPPCORO_OS_WINNT || CPPCORO_OS_LINUX
 			/// Convert a sockaddr to an IP endpoint.
 			ip_endpoint sockaddr_to_ip_endpoint(const sockaddr& address) noexcept;
 
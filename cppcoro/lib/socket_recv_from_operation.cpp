@@ -93,4 +93,86 @@ cppcoro::net::socket_recv_from_operation_impl::get_result(
 			*reinterpret_cast<SOCKADDR*>(&m_sourceSockaddrStorage)));
 }
 
+#elif CPPCORO_OS_LINUX
+# include "socket_helpers.hpp"
+
+# include <cerrno>
+# include <netinet/in.h>
+# include <sys/socket.h>
+
+bool cppcoro::net::socket_recv_from_operation_impl::try_start(
+	cppcoro::detail::linux_async_operation_base& operation) noexcept
+{
+	static_assert(
+		sizeof(m_sourceSockaddrStorage) >= sizeof(sockaddr_in) &&
+		sizeof(m_sourceSockaddrStorage) >= sizeof(sockaddr_in6));
+	static_assert(
+		sockaddrStorageAlignment >= alignof(sockaddr_in) &&
+		sockaddrStorageAlignment >= alignof(sockaddr_in6));
+
+	return operation.try_complete(m_socket.recv_readiness(), [&]
+	{
+		iovec buffer;
+		buffer.iov_base = m_buffer;
+		buffer.iov_len = m_byteCount;
+
+		msghdr message{};
+		message.msg_name = &m_sourceSockaddrStorage;
+		message.msg_namelen = sizeof(m_sourceSockaddrStorage);
+		message.msg_iov = &buffer;
+		message.msg_iovlen = 1;
+
+		ssize_t result;
+		do
+		{
+			result = ::recvmsg(m_socket.native_handle(), &message, MSG_DONTWAIT);
+		} while (result == -1 && errno == EINTR);
+
+		if (result == -1)
+		{
+			const int errorCode = errno;
+			if (errorCode == EAGAIN || errorCode == EWOULDBLOCK)
+			{
+				return false;
+			}
+
+			operation.m_errorCode = errorCode;
+			operation.m_numberOfBytesTransferred = 0;
+			return true;
+		}
+
+		m_sourceSockaddrLength = static_cast<int>(message.msg_namelen);
+
+		// WSARecvFrom() fails with WSAEMSGSIZE if the datagram did not fit
+		// in the buffer, report truncation the same way.
+		operation.m_errorCode = (message.msg_flags & MSG_TRUNC) ? EMSGSIZE : 0;
+		operation.m_numberOfBytesTransferred = static_cast<std::size_t>(result);
+		return true;
+	});
+}
+
+void cppcoro::net::socket_recv_from_operation_impl::cancel(
+	cppcoro::detail::linux_async_operation_base& operation) noexcept
+{
+	operation.cancel_wait(m_socket.service());
+}
+
+std::tuple<std::size_t, cppcoro::net::ip_endpoint>
+cppcoro::net::socket_recv_from_operation_impl::get_result(
+	cppcoro::detail::linux_async_operation_base& operation)
+{
+	if (operation.m_errorCode != 0)
+	{
+		throw std::system_error(
+			operation.m_errorCode,
+			std::system_category(),
+			"Error receiving message on socket: recvmsg");
+	}
+
+	return std::make_tuple(
+		operation.m_numberOfBytesTransferred,
+		detail::sockaddr_to_ip_endpoint(
+			*reinterpret_cast<sockaddr*>(&m_sourceSockaddrStorage)));
+}
+
 #endif
@@ -63,4 +63,44 @@ void cppcoro::net::socket_recv_operation_impl::cancel(
 		operation.get_overlapped());
 }
 
+#elif CPPCORO_OS_LINUX
+# include <cerrno>
+# include <sys/socket.h>
+
+bool cppcoro::net::socket_recv_operation_impl::try_start(
+	cppcoro::detail::linux_async_operation_base& operation) noexcept
+{
+	return operation.try_complete(m_socket.recv_readiness(), [&]
+	{
+		ssize_t result;
+		do
+		{
+			result = ::recv(m_socket.native_handle(), m_buffer, m_byteCount, MSG_DONTWAIT);
+		} while (result == -1 && errno == EINTR);
+
+		if (result == -1)
+		{
+			const int errorCode = errno;
+			if (errorCode == EAGAIN || errorCode == EWOULDBLOCK)
+			{
+				return false;
+			}
+
+			operation.m_errorCode = errorCode;
+			operation.m_numberOfBytesTransferred = 0;
+			return true;
+		}
+
+		operation.m_errorCode = 0;
+		operation.m_numberOfBytesTransferred = static_cast<std::size_t>(result);
+		return true;
+	});
+}
+
+void cppcoro::net::socket_recv_operation_impl::cancel(
+	cppcoro::detail::linux_async_operation_base& operation) noexcept
+{
+	operation.cancel_wait(m_socket.service());
+}
+
 #endif
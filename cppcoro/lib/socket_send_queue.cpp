@@ -0,0 +1,374 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/net/socket_send_queue.hpp>
+
+#if CPPCORO_OS_LINUX
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <climits>
+#include <system_error>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace
+{
+	// Number of sendmsg() calls a flusher makes before handing the rest of
+	// the flush over to an I/O thread. Bounds how long a sender that became
+	// the flusher waits for its own send, and how deep other senders nest on
+	// its stack, while they keep queueing more.
+	constexpr std::uint32_t max_batches_per_flush = 16;
+
+	std::size_t max_iovecs() noexcept
+	{
+		const long result = ::sysconf(_SC_IOV_MAX);
+		if (result > 0)
+		{
+			return static_cast<std::size_t>(result);
+		}
+
+#ifdef IOV_MAX
+		return IOV_MAX;
+#else
+		return 16;
+#endif
+	}
+}
+
+cppcoro::net::socket_send_queue::socket_send_queue(
+	socket& socket,
+	std::size_t highWaterMark)
+	: m_socket(socket)
+	, m_highWaterMark(std::max<std::size_t>(highWaterMark, 1))
+	, m_state(idle)
+	, m_syscallCount(0)
+	, m_pendingHead(nullptr)
+	, m_pendingTail(nullptr)
+	, m_headOffset(0)
+	, m_errorCode(0)
+	, m_flushState(*this)
+	, m_maxIovecs(max_iovecs())
+{
+	m_iovecs = std::make_unique<::iovec[]>(m_maxIovecs);
+}
+
+cppcoro::net::socket_send_queue::~socket_send_queue()
+{
+	assert(m_state.load(std::memory_order_relaxed) == idle);
+	assert(m_pendingHead == nullptr);
+}
+
+bool cppcoro::net::socket_send_queue::enqueue(socket_send_queue_operation* operation) noexcept
+{
+	auto oldState = m_state.load(std::memory_order_acquire);
+	while (true)
+	{
+		if (oldState == idle)
+		{
+			if (m_state.compare_exchange_weak(
+				oldState,
+				flushing_no_new_operations,
+				std::memory_order_acquire,
+				std::memory_order_relaxed))
+			{
+				// We are now the flusher.
+				assert(m_pendingHead == nullptr);
+				operation->m_next = nullptr;
+				m_pendingHead = operation;
+				m_pendingTail = operation;
+				return !flush(operation);
+			}
+		}
+		else
+		{
+			// A flush is in progress, the flusher will pick this operation up.
+			operation->m_next = reinterpret_cast<socket_send_queue_operation*>(oldState);
+			if (m_state.compare_exchange_weak(
+				oldState,
+				reinterpret_cast<std::uintptr_t>(operation),
+				std::memory_order_release,
+				std::memory_order_relaxed))
+			{
+				return true;
+			}
+		}
+	}
+}
+
+bool cppcoro::net::socket_send_queue::take_new_operations() noexcept
+{
+	if (m_state.load(std::memory_order_relaxed) == flushing_no_new_operations)
+	{
+		return false;
+	}
+
+	auto* operation = reinterpret_cast<socket_send_queue_operation*>(
+		m_state.exchange(flushing_no_new_operations, std::memory_order_acquire));
+	assert(operation != nullptr);
+
+	// Reverse the list so that operations are written in the order they were queued.
+	socket_send_queue_operation* newHead = nullptr;
+	socket_send_queue_operation* newTail = operation;
+	do
+	{
+		auto* next = operation->m_next;
+		operation->m_next = newHead;
+		newHead = operation;
+		operation = next;
+	} while (operation != nullptr);
+
+	if (m_pendingTail == nullptr)
+	{
+		m_pendingHead = newHead;
+	}
+	else
+	{
+		m_pendingTail->m_next = newHead;
+	}
+	m_pendingTail = newTail;
+
+	return true;
+}
+
+bool cppcoro::net::socket_send_queue::flush(socket_send_queue_operation* syncOperation) noexcept
+{
+	// Senders are resumed while we are still flushing so that any sends they
+	// queue straight away are gathered into the next sendmsg() call.
+	//
+	// A resumed coroutine is free to destroy the queue once all of its sends
+	// have completed though, so one completed operation is always held back
+	// until we have stopped touching the queue. This is the operation being
+	// queued on this thread if it has completed, as it is only resumed after
+	// we return, otherwise the most recently completed operation.
+	socket_send_queue_operation* completedHead = nullptr;
+	socket_send_queue_operation* completedTail = nullptr;
+	socket_send_queue_operation* heldBack = nullptr;
+	bool syncOperationCompleted = false;
+
+	auto complete = [&](socket_send_queue_operation* operation, int errorCode) noexcept
+	{
+		operation->m_errorCode = errorCode;
+		if (operation == syncOperation)
+		{
+			syncOperationCompleted = true;
+			return;
+		}
+
+		operation->m_next = nullptr;
+		if (completedTail == nullptr)
+		{
+			completedHead = operation;
+		}
+		else
+		{
+			completedTail->m_next = operation;
+		}
+		completedTail = operation;
+	};
+
+	auto resumeCompleted = [&]() noexcept
+	{
+		if (!syncOperationCompleted && completedTail != nullptr)
+		{
+			// Hold back the newest completed operation instead.
+			if (heldBack != nullptr)
+			{
+				heldBack->m_next = completedHead;
+				completedHead = heldBack;
+			}
+
+			heldBack = completedTail;
+			if (completedHead == completedTail)
+			{
+				completedHead = nullptr;
+			}
+			else
+			{
+				auto* operation = completedHead;
+				while (operation->m_next != completedTail)
+				{
+					operation = operation->m_next;
+				}
+				operation->m_next = nullptr;
+			}
+		}
+		else if (syncOperationCompleted && heldBack != nullptr)
+		{
+			heldBack->m_next = completedHead;
+			completedHead = heldBack;
+			heldBack = nullptr;
+		}
+
+		while (completedHead != nullptr)
+		{
+			auto* operation = completedHead;
+			completedHead = operation->m_next;
+			operation->m_awaitingCoroutine.resume();
+		}
+		completedTail = nullptr;
+	};
+
+	auto popHead = [&]() noexcept
+	{
+		auto* operation = m_pendingHead;
+		m_pendingHead = operation->m_next;
+		if (m_pendingHead == nullptr)
+		{
+			m_pendingTail = nullptr;
+		}
+		m_headOffset = 0;
+		return operation;
+	};
+
+	auto& readiness = m_socket.send_readiness();
+	std::uint32_t batchCount = 0;
+
+	while (true)
+	{
+		resumeCompleted();
+
+		// Gather everything queued so far so that the batch is as large as possible.
+		take_new_operations();
+
+		if (m_pendingHead == nullptr)
+		{
+			auto oldState = flushing_no_new_operations;
+			if (m_state.compare_exchange_strong(
+				oldState,
+				idle,
+				std::memory_order_release,
+				std::memory_order_relaxed))
+			{
+				break;
+			}
+
+			continue;
+		}
+
+		if (batchCount == max_batches_per_flush)
+		{
+			// Let an I/O thread carry on from here. It may start straight
+			// away, so must not touch the queue once posted.
+			m_socket.service().post_completion(&m_flushState, 0);
+			break;
+		}
+
+		if (m_errorCode != 0)
+		{
+			while (m_pendingHead != nullptr)
+			{
+				complete(popHead(), m_errorCode);
+			}
+			continue;
+		}
+
+		std::size_t iovecCount = 0;
+		std::size_t batchBytes = 0;
+		for (auto* operation = m_pendingHead;
+			operation != nullptr && iovecCount < m_maxIovecs && batchBytes < m_highWaterMark;
+			operation = operation->m_next)
+		{
+			const std::size_t offset = operation == m_pendingHead ? m_headOffset : 0;
+			auto& vec = m_iovecs[iovecCount++];
+			vec.iov_base = const_cast<char*>(static_cast<const char*>(operation->m_buffer) + offset);
+			vec.iov_len = operation->m_byteCount - offset;
+			batchBytes += vec.iov_len;
+		}
+
+		::msghdr message{};
+		message.msg_iov = m_iovecs.get();
+		message.msg_iovlen = iovecCount;
+
+		ssize_t result;
+		do
+		{
+			result = ::sendmsg(m_socket.native_handle(), &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+		} while (result == -1 && errno == EINTR);
+
+		if (result == -1)
+		{
+			const int errorCode = errno;
+			if (errorCode != EAGAIN && errorCode != EWOULDBLOCK)
+			{
+				m_errorCode = errorCode;
+				continue;
+			}
+
+			// Socket send buffer is full, wait until it becomes writable again.
+			// An I/O thread will continue flushing from there, so must not
+			// touch the queue once parked.
+			const auto parkResult = readiness.park(&m_flushState);
+			if (parkResult == detail::lnx::io_readiness::park_result::parked)
+			{
+				break;
+			}
+
+			if (parkResult == detail::lnx::io_readiness::park_result::busy)
+			{
+				// Some other operation is sending on the socket.
+				m_errorCode = EBUSY;
+			}
+
+			continue;
+		}
+
+		m_syscallCount.fetch_add(1, std::memory_order_relaxed);
+		++batchCount;
+
+		std::size_t bytesWritten = static_cast<std::size_t>(result);
+		while (bytesWritten > 0)
+		{
+			const std::size_t remaining = m_pendingHead->m_byteCount - m_headOffset;
+			if (bytesWritten < remaining)
+			{
+				m_headOffset += bytesWritten;
+				break;
+			}
+
+			bytesWritten -= remaining;
+			complete(popHead(), 0);
+		}
+	}
+
+	// No longer flushing, safe to resume everything.
+	if (heldBack != nullptr)
+	{
+		heldBack->m_awaitingCoroutine.resume();
+	}
+
+	return syncOperationCompleted;
+}
+
+void cppcoro::net::socket_send_queue::on_send_ready(
+	detail::lnx::io_state* state,
+	int errorCode) noexcept
+{
+	auto& queue = static_cast<flush_state*>(state)->m_queue;
+	if (errorCode != 0)
+	{
+		// The socket was closed while we were waiting for it.
+		queue.m_errorCode = errorCode;
+	}
+
+	queue.flush(nullptr);
+}
+
+void cppcoro::net::socket_send_queue_operation::await_resume() const
+{
+	if (m_errorCode != 0)
+	{
+		throw std::system_error{
+			m_errorCode,
+			std::system_category(),
+			"Error sending data on socket: sendmsg"
+		};
+	}
+}
+
+#endif
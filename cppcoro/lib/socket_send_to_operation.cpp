@@ -69,4 +69,56 @@ void cppcoro::net::socket_send_to_operation_impl::cancel(
 		operation.get_overlapped());
 }
 
+#elif CPPCORO_OS_LINUX
+# include "socket_helpers.hpp"
+
+# include <cerrno>
+# include <sys/socket.h>
+
+bool cppcoro::net::socket_send_to_operation_impl::try_start(
+	cppcoro::detail::linux_async_operation_base& operation) noexcept
+{
+	sockaddr_storage destinationAddress;
+	const int destinationLength = detail::ip_endpoint_to_sockaddr(
+		m_destination, std::ref(destinationAddress));
+
+	return operation.try_complete(m_socket.send_readiness(), [&]
+	{
+		ssize_t result;
+		do
+		{
+			result = ::sendto(
+				m_socket.native_handle(),
+				m_buffer,
+				m_byteCount,
+				MSG_DONTWAIT | MSG_NOSIGNAL,
+				reinterpret_cast<const sockaddr*>(&destinationAddress),
+				static_cast<socklen_t>(destinationLength));
+		} while (result == -1 && errno == EINTR);
+
+		if (result == -1)
+		{
+			const int errorCode = errno;
+			if (errorCode == EAGAIN || errorCode == EWOULDBLOCK)
+			{
+				return false;
+			}
+
+			operation.m_errorCode = errorCode;
+			operation.m_numberOfBytesTransferred = 0;
+			return true;
+		}
+
+		operation.m_errorCode = 0;
+		operation.m_numberOfBytesTransferred = static_cast<std::size_t>(result);
+		return true;
+	});
+}
+
+void cppcoro::net::socket_send_to_operation_impl::cancel(
+	cppcoro::detail::linux_async_operation_base& operation) noexcept
+{
+	operation.cancel_wait(m_socket.service());
+}
+
 #endif
@@ -4,6 +4,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/large_buffer.hpp>
 
 #include "auto_reset_event.hpp"
 #include "spin_mutex.hpp"
@@ -11,6 +12,7 @@
 
 #include <cassert>
 #include <mutex>
+#include <new>
 #include <chrono>
 #include <utility>
 
@@ -28,20 +30,41 @@ namespace cppcoro
 {
 	thread_local static_thread_pool::thread_state* static_thread_pool::s_currentState = nullptr;
 	thread_local static_thread_pool* static_thread_pool::s_currentThreadPool = nullptr;
+	thread_local std::uint32_t static_thread_pool::s_currentThreadIndex = 0;
 
 	class static_thread_pool::thread_state
 	{
 	public:
 
 		explicit thread_state()
-			: m_localQueue(
-				std::make_unique<std::atomic<schedule_operation*>[]>(
-					local::initial_local_queue_size))
-			, m_mask(local::initial_local_queue_size - 1)
+			: m_localQueue(local_queue::create(local::initial_local_queue_size))
 			, m_head(0)
 			, m_tail(0)
 			, m_isSleeping(false)
+			, m_epochParticipant(nullptr)
 		{
+			if (m_localQueue.load(std::memory_order_relaxed) == nullptr)
+			{
+				throw std::bad_alloc{};
+			}
+		}
+
+		~thread_state()
+		{
+			delete m_localQueue.load(std::memory_order_relaxed);
+		}
+
+		/// Set by the worker thread that owns this state, to retire the old
+		/// queue when it grows the local queue, and to pin the queues of
+		/// other threads while it steals from them.
+		void set_epoch_participant(epoch_domain::participant* participant) noexcept
+		{
+			m_epochParticipant = participant;
+		}
+
+		epoch_domain::participant& epoch_participant() noexcept
+		{
+			return *m_epochParticipant;
 		}
 
 		bool try_wake_up()
@@ -119,63 +142,72 @@ namespace cppcoro
 			// Here m_mask is equal to buffersize - 1 so we can only write to a slot
 			// if the number of items consumed in the queue (head - tail) is less than
 			// the mask.
+			// Only the current thread replaces the queue, so it doesn't need to
+			// be pinned to read it.
+			local_queue* queue = m_localQueue.load(std::memory_order_relaxed);
+
 			auto tail = m_tail.load(std::memory_order_relaxed);
-			if (difference(head, tail) < static_cast<offset_t>(m_mask))
+			if (difference(head, tail) < static_cast<offset_t>(queue->m_mask))
 			{
 				// There is space left in the local buffer.
-				m_localQueue[head & m_mask].store(operation, std::memory_order_relaxed);
+				queue->slot(head).store(operation, std::memory_order_relaxed);
 				m_head.store(head + 1, std::memory_order_seq_cst);
 				return true;
 			}
 
-			if (m_mask == local::max_local_queue_size)
+			const size_t newSize = (queue->m_mask + 1) * 2;
+			if (newSize > local::max_local_queue_size)
 			{
 				// No space in the buffer and we don't want to grow
 				// it any further.
 				return false;
 			}
 
-			// Allocate the new buffer before taking out the lock so that
-			// we ensure we hold the lock for as short a time as possible.
-			const size_t newSize = (m_mask + 1) * 2;
-
-			std::unique_ptr<std::atomic<schedule_operation*>[]> newLocalQueue{
-				new (std::nothrow) std::atomic<schedule_operation*>[newSize]
-			};
-			if (!newLocalQueue)
+			// Only this thread writes to the queue, so prefer this thread's
+			// node for its pages even if the thread later migrates.
+			local_queue* newQueue = local_queue::create(newSize, current_numa_node());
+			if (newQueue == nullptr)
 			{
 				// Unable to allocate more memory.
 				return false;
 			}
 
-			if (!m_remoteMutex.try_lock())
+			// Grow without taking m_remoteMutex. Stealers may carry on reading
+			// the old queue, which is never written to again and is retired
+			// rather than freed, so it stays valid while they are pinned.
+			//
+			// A stealer may have incremented m_tail and not yet read the item
+			// it stole, so copy from the slot before m_tail as well. That item
+			// is below m_tail in the new queue, so it won't be popped again.
+			tail = m_tail.load(std::memory_order_seq_cst) - 1;
+			for (size_t i = tail; i != head; ++i)
 			{
-				// Don't wait to acquire the lock if we can't get it immediately.
-				// Fail and let it be enqueued to the global queue.
-				// TODO: Should we have a per-thread overflow queue instead?
-				return false;
+				newQueue->slot(i).store(
+					queue->slot(i).load(std::memory_order_relaxed),
+					std::memory_order_relaxed);
 			}
 
-			std::scoped_lock lock{ std::adopt_lock, m_remoteMutex };
+			// Finally, write the new operation to the queue.
+			newQueue->slot(head).store(operation, std::memory_order_relaxed);
 
-			// We can now re-read tail, guaranteed that we are not seeing a stale version.
-			tail = m_tail.load(std::memory_order_relaxed);
+			// Publish the new queue before the new head, so that a stealer
+			// that sees the new item also sees the queue that holds it.
+			m_localQueue.store(newQueue, std::memory_order_release);
+			m_head.store(head + 1, std::memory_order_seq_cst);
 
-			// Copy the existing operations.
-			const size_t newMask = newSize - 1;
-			for (size_t i = tail; i != head; ++i)
+			try
 			{
-				newLocalQueue[i & newMask].store(
-					m_localQueue[i & m_mask].load(std::memory_order_relaxed),
-					std::memory_order_relaxed);
+				m_epochParticipant->retire(queue, [](void* p) noexcept
+				{
+					delete static_cast<local_queue*>(p);
+				});
+			}
+			catch (...)
+			{
+				// Out of memory. Leak the old queue rather than free it while
+				// a stealer might still be reading it.
 			}
 
-			// Finally, write the new operation to the queue.
-			newLocalQueue[head & newMask].store(operation, std::memory_order_relaxed);
-
-			m_head.store(head + 1, std::memory_order_relaxed);
-			m_localQueue = std::move(newLocalQueue);
-			m_mask = newMask;
 			return true;
 		}
 
@@ -231,10 +263,12 @@ namespace cppcoro
 			}
 
 			// We successfully acquired an item from the queue.
-			return m_localQueue[newHead & m_mask].load(std::memory_order_relaxed);
+			return m_localQueue.load(std::memory_order_relaxed)->slot(newHead).load(std::memory_order_relaxed);
 		}
 
-		schedule_operation* try_steal(bool* lockUnavailable = nullptr) noexcept
+		schedule_operation* try_steal(
+			epoch_domain::participant& stealer,
+			bool* lockUnavailable = nullptr) noexcept
 		{
 			if (lockUnavailable == nullptr)
 			{
@@ -273,7 +307,10 @@ namespace cppcoro
 			{
 				// There was still an item in the queue after incrementing tail.
 				// We managed to steal an item from the bottom of the stack.
-				return m_localQueue[tail & m_mask].load(std::memory_order_relaxed);
+				// The owning thread may be growing the queue concurrently, so
+				// pin the queue we read it from.
+				auto pinned = stealer.pin();
+				return m_localQueue.load(std::memory_order_acquire)->slot(tail).load(std::memory_order_relaxed);
 			}
 			else
 			{
@@ -293,8 +330,31 @@ namespace cppcoro
 			return static_cast<offset_t>(a - b);
 		}
 
-		std::unique_ptr<std::atomic<schedule_operation*>[]> m_localQueue;
-		std::size_t m_mask;
+		struct local_queue
+		{
+			static local_queue* create(std::size_t size, int numaNode = any_numa_node) noexcept
+			{
+				try
+				{
+					return new local_queue{ size - 1, large_buffer<std::atomic<schedule_operation*>>{ size, numaNode } };
+				}
+				catch (const std::bad_alloc&)
+				{
+					return nullptr;
+				}
+			}
+
+			std::atomic<schedule_operation*>& slot(std::size_t index) noexcept
+			{
+				return m_slots[index & m_mask];
+			}
+
+			const std::size_t m_mask;
+			large_buffer<std::atomic<schedule_operation*>> m_slots;
+		};
+
+		// Only replaced by the owning thread, when it grows the queue.
+		std::atomic<local_queue*> m_localQueue;
 
 #if CPPCORO_COMPILER_MSVC
 # pragma warning(push)
@@ -311,6 +371,8 @@ namespace cppcoro
 		std::atomic<bool> m_isSleeping;
 		spin_mutex m_remoteMutex;
 
+		epoch_domain::participant* m_epochParticipant;
+
 #if CPPCORO_COMPILER_MSVC
 # pragma warning(pop)
 #endif
@@ -370,8 +432,13 @@ namespace cppcoro
 	void static_thread_pool::run_worker_thread(std::uint32_t threadIndex) noexcept
 	{
 		auto& localState = m_threadStates[threadIndex];
+
+		epoch_domain::participant epochParticipant{ m_epochDomain };
+		localState.set_epoch_participant(&epochParticipant);
+
 		s_currentState = &localState;
 		s_currentThreadPool = this;
+		s_currentThreadIndex = threadIndex;
 
 		auto tryGetRemote = [&]()
 		{
@@ -681,6 +748,8 @@ namespace cppcoro
 	static_thread_pool::schedule_operation*
 	static_thread_pool::try_steal_from_other_thread(std::uint32_t thisThreadIndex) noexcept
 	{
+		auto& thisThreadState = m_threadStates[thisThreadIndex];
+
 		// Try first with non-blocking steal attempts.
 
 		bool anyLocksUnavailable = false;
@@ -688,7 +757,7 @@ namespace cppcoro
 		{
 			if (otherThreadIndex == thisThreadIndex) continue;
 			auto& otherThreadState = m_threadStates[otherThreadIndex];
-			auto* op = otherThreadState.try_steal(&anyLocksUnavailable);
+			auto* op = otherThreadState.try_steal(thisThreadState.epoch_participant(), &anyLocksUnavailable);
 			if (op != nullptr)
 			{
 				return op;
@@ -703,7 +772,7 @@ namespace cppcoro
 			{
 				if (otherThreadIndex == thisThreadIndex) continue;
 				auto& otherThreadState = m_threadStates[otherThreadIndex];
-				auto* op = otherThreadState.try_steal();
+				auto* op = otherThreadState.try_steal(thisThreadState.epoch_participant());
 				if (op != nullptr)
 				{
 					return op;
@@ -0,0 +1,863 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/net/udp_multiplexer.hpp>
+
+#if CPPCORO_OS_LINUX
+
+#include <cppcoro/cancellation_registration.hpp>
+#include <cppcoro/cancellation_source.hpp>
+#include <cppcoro/operation_cancelled.hpp>
+#include <cppcoro/when_all_ready.hpp>
+
+#include "socket_helpers.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace
+{
+	namespace lnx = cppcoro::detail::lnx;
+
+	// Leave at least 8 bits of each request ID for the slot's generation so
+	// that a late reply is unlikely to match a newer request in the same slot.
+	constexpr std::uint32_t max_index_bits = 24;
+
+	constexpr std::size_t timer_bucket_count = 4096;
+
+	constexpr std::size_t id_size = sizeof(std::uint32_t);
+
+	// How long the timer loop sleeps for while no timeouts are armed.
+	constexpr std::chrono::hours idle_timer_wait{ 1 };
+
+	/// Waits for a socket to become readable.
+	class recv_ready_operation : private lnx::io_state
+	{
+	public:
+
+		explicit recv_ready_operation(lnx::io_readiness& readiness) noexcept
+			: lnx::io_state(&recv_ready_operation::on_ready)
+			, m_readiness(readiness)
+			, m_errorCode(0)
+		{}
+
+		bool await_ready() const noexcept { return false; }
+
+		bool await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+		{
+			m_awaitingCoroutine = awaitingCoroutine;
+			switch (m_readiness.park(this))
+			{
+			case lnx::io_readiness::park_result::parked:
+				return true;
+			case lnx::io_readiness::park_result::ready:
+				return false;
+			case lnx::io_readiness::park_result::cancelled:
+				m_errorCode = ECANCELED;
+				return false;
+			case lnx::io_readiness::park_result::busy:
+				m_errorCode = EBUSY;
+				return false;
+			}
+
+			return false;
+		}
+
+		/// \return
+		/// false if the wait was cancelled.
+		bool await_resume() const
+		{
+			if (m_errorCode == EBUSY)
+			{
+				throw std::system_error{
+					EBUSY,
+					std::system_category(),
+					"Another operation is already receiving on the socket"
+				};
+			}
+
+			return m_errorCode == 0;
+		}
+
+		void cancel(cppcoro::io_service& ioService) noexcept
+		{
+			if (m_readiness.cancel(this))
+			{
+				ioService.post_completion(this, ECANCELED);
+			}
+		}
+
+	private:
+
+		static void on_ready(lnx::io_state* state, int errorCode) noexcept
+		{
+			auto* operation = static_cast<recv_ready_operation*>(state);
+			operation->m_errorCode = errorCode;
+			operation->m_awaitingCoroutine.resume();
+		}
+
+		lnx::io_readiness& m_readiness;
+		int m_errorCode;
+		std::coroutine_handle<> m_awaitingCoroutine;
+
+	};
+}
+
+cppcoro::net::udp_multiplexer::udp_multiplexer(
+	io_service& ioService,
+	socket& socket,
+	std::uint32_t maxOutstanding,
+	std::size_t maxDatagramSize,
+	std::chrono::milliseconds timerResolution)
+	: m_ioService(ioService)
+	, m_socket(socket)
+	, m_maxDatagramSize(std::max(maxDatagramSize, id_size))
+	, m_timerResolution(std::max(clock::duration{ timerResolution }, clock::duration{ 1 }))
+	, m_epoch(clock::now())
+	, m_indexBits(0)
+	, m_freeHead(no_slot)
+	, m_timerBuckets(std::make_unique<timer_bucket[]>(timer_bucket_count))
+	, m_timerBucketMask(timer_bucket_count - 1)
+	, m_lastExpiredTick(0)
+	, m_sleepTick(no_tick)
+	, m_blockedHead(nullptr)
+	, m_blockedTail(nullptr)
+	, m_drainScheduled(false)
+	, m_sendReadyState(*this)
+	, m_timedOutCount(0)
+	, m_unmatchedCount(0)
+	, m_receiveSyscallCount(0)
+	, m_receivedCount(0)
+{
+	while (m_indexBits < max_index_bits && (std::uint32_t(1) << m_indexBits) < maxOutstanding)
+	{
+		++m_indexBits;
+	}
+
+	const std::uint32_t slotCount = std::uint32_t(1) << m_indexBits;
+	m_indexMask = slotCount - 1;
+	m_slots = std::make_unique<slot[]>(slotCount);
+
+	// Thread all slots onto the free list, lowest index first.
+	for (std::uint32_t i = slotCount; i-- > 0;)
+	{
+		m_slots[i].m_nextFree.store(
+			static_cast<std::uint32_t>(m_freeHead.load(std::memory_order_relaxed)),
+			std::memory_order_relaxed);
+		m_freeHead.store(i, std::memory_order_relaxed);
+	}
+}
+
+cppcoro::net::udp_multiplexer::~udp_multiplexer()
+{
+	assert(m_blockedHead == nullptr);
+
+	// Stop waiting for the socket to become writable, it outlives us.
+	if (m_drainScheduled)
+	{
+		(void)m_socket.send_readiness().cancel(&m_sendReadyState);
+	}
+
+#ifndef NDEBUG
+	for (std::uint32_t i = 0; i <= m_indexMask; ++i)
+	{
+		assert(m_slots[i].m_activeId.load(std::memory_order_relaxed) == 0);
+	}
+#endif
+}
+
+cppcoro::task<> cppcoro::net::udp_multiplexer::run(cancellation_token ct)
+{
+	cancellation_source stopSource;
+	cancellation_registration forwardCancellation{
+		std::move(ct),
+		[&stopSource] { stopSource.request_cancellation(); } };
+
+	std::exception_ptr receiveException;
+	auto receive = [&]() -> task<>
+	{
+		try
+		{
+			co_await receive_loop(stopSource.token());
+		}
+		catch (...)
+		{
+			receiveException = std::current_exception();
+		}
+
+		// Stop the timer loop too.
+		stopSource.request_cancellation();
+	};
+
+	co_await when_all_ready(receive(), timer_loop(stopSource.token()));
+
+	// Nothing will complete the remaining requests any more.
+	for (std::uint32_t i = 0; i <= m_indexMask; ++i)
+	{
+		const std::uint32_t id = m_slots[i].m_activeId.load(std::memory_order_acquire);
+		if (id != 0)
+		{
+			try_complete(id, ECANCELED, nullptr, 0);
+		}
+	}
+
+	complete_blocked(ECANCELED, nullptr);
+
+	for (std::size_t i = 0; i < timer_bucket_count; ++i)
+	{
+		std::lock_guard lock{ m_timerBuckets[i].m_mutex };
+		m_timerBuckets[i].m_entries.clear();
+	}
+
+	if (receiveException)
+	{
+		std::rethrow_exception(receiveException);
+	}
+}
+
+bool cppcoro::net::udp_multiplexer::start(udp_request_operation* operation) noexcept
+{
+	const std::uint32_t index = allocate_slot();
+	if (index == no_slot)
+	{
+		operation->m_errorCode = ENOBUFS;
+		return false;
+	}
+
+	auto& s = m_slots[index];
+	const std::uint32_t generationMask = std::uint32_t(0xFFFFFFFFu) >> m_indexBits;
+	s.m_generation = (s.m_generation + 1) & generationMask;
+	if (s.m_generation == 0)
+	{
+		s.m_generation = 1;
+	}
+	s.m_operation = operation;
+
+	operation->m_id = (s.m_generation << m_indexBits) | index;
+	operation->m_deadline = clock::now() + operation->m_timeout;
+
+	switch (try_send(operation))
+	{
+	case send_result::in_flight:
+		return true;
+	case send_result::completed:
+		return false;
+	case send_result::would_block:
+		block(operation, false);
+		return true;
+	}
+
+	return true;
+}
+
+cppcoro::net::udp_multiplexer::send_result
+cppcoro::net::udp_multiplexer::try_send(udp_request_operation* operation) noexcept
+{
+	const std::uint32_t id = operation->m_id;
+	const std::uint32_t index = id & m_indexMask;
+	auto& s = m_slots[index];
+
+	const std::uint32_t networkId = htonl(id);
+
+	::iovec iovecs[2];
+	iovecs[0].iov_base = const_cast<std::uint32_t*>(&networkId);
+	iovecs[0].iov_len = id_size;
+	iovecs[1].iov_base = const_cast<void*>(operation->m_payload);
+	iovecs[1].iov_len = operation->m_payloadSize;
+
+	sockaddr_storage destination;
+	const int destinationLength =
+		detail::ip_endpoint_to_sockaddr(operation->m_destination, std::ref(destination));
+
+	::msghdr message{};
+	message.msg_name = &destination;
+	message.msg_namelen = destinationLength;
+	message.msg_iov = iovecs;
+	message.msg_iovlen = 2;
+
+	const auto deadline = operation->m_deadline;
+
+	// The ID is published before sending so that a fast reply can't be missed.
+	// Anything that claims the request while we are still reading its payload
+	// leaves resuming it to us, see try_complete().
+	s.m_sendState.store(send_state::sending, std::memory_order_relaxed);
+	s.m_activeId.store(id, std::memory_order_release);
+
+	ssize_t result;
+	do
+	{
+		result = ::sendmsg(m_socket.native_handle(), &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+	} while (result == -1 && errno == EINTR);
+
+	if (result == -1)
+	{
+		const int errorCode = errno;
+
+		std::uint32_t expected = id;
+		if (s.m_activeId.compare_exchange_strong(
+			expected, 0, std::memory_order_acq_rel, std::memory_order_relaxed))
+		{
+			// The request is ours again.
+			s.m_sendState.store(send_state::idle, std::memory_order_relaxed);
+			if (errorCode == EAGAIN || errorCode == EWOULDBLOCK)
+			{
+				return send_result::would_block;
+			}
+
+			operation->m_errorCode = errorCode;
+			free_slot(index);
+			return send_result::completed;
+		}
+
+		// Claimed by run() cancelling outstanding requests, which also
+		// decides the result.
+	}
+
+	auto sending = send_state::sending;
+	if (!s.m_sendState.compare_exchange_strong(
+		sending, send_state::idle, std::memory_order_acq_rel, std::memory_order_acquire))
+	{
+		assert(sending == send_state::completed_while_sending);
+		s.m_sendState.store(send_state::idle, std::memory_order_relaxed);
+		free_slot(index);
+		return send_result::completed;
+	}
+
+	if (result != -1)
+	{
+		// The operation may already have completed, only its ID is used.
+		arm_timeout(id, deadline);
+	}
+
+	return send_result::in_flight;
+}
+
+void cppcoro::net::udp_multiplexer::block(udp_request_operation* operation, bool retry) noexcept
+{
+	// Once queued the operation may be completed by another thread.
+	const std::uint32_t id = operation->m_id;
+	const auto deadline = operation->m_deadline;
+
+	bool wait;
+	{
+		std::lock_guard lock{ m_blockedMutex };
+		if (retry)
+		{
+			operation->m_nextBlocked = m_blockedHead;
+			m_blockedHead = operation;
+			if (m_blockedTail == nullptr)
+			{
+				m_blockedTail = operation;
+			}
+		}
+		else
+		{
+			operation->m_nextBlocked = nullptr;
+			if (m_blockedTail == nullptr)
+			{
+				m_blockedHead = operation;
+			}
+			else
+			{
+				m_blockedTail->m_nextBlocked = operation;
+			}
+			m_blockedTail = operation;
+		}
+
+		wait = retry || !m_drainScheduled;
+		m_drainScheduled = true;
+	}
+
+	// Wakes the timer loop at the deadline, which then finds the operation
+	// in the queue if it is still waiting to be sent.
+	arm_timeout(id, deadline);
+
+	if (wait)
+	{
+		wait_until_writable();
+	}
+}
+
+void cppcoro::net::udp_multiplexer::drain_blocked_sends() noexcept
+{
+	while (true)
+	{
+		udp_request_operation* operation;
+		{
+			std::lock_guard lock{ m_blockedMutex };
+			operation = m_blockedHead;
+			if (operation == nullptr)
+			{
+				m_drainScheduled = false;
+				return;
+			}
+
+			m_blockedHead = operation->m_nextBlocked;
+			if (m_blockedHead == nullptr)
+			{
+				m_blockedTail = nullptr;
+			}
+		}
+
+		switch (try_send(operation))
+		{
+		case send_result::in_flight:
+			break;
+		case send_result::completed:
+			operation->m_awaitingCoroutine.resume();
+			break;
+		case send_result::would_block:
+			block(operation, true);
+			return;
+		}
+	}
+}
+
+void cppcoro::net::udp_multiplexer::wait_until_writable() noexcept
+{
+	const auto result = m_socket.send_readiness().park(&m_sendReadyState);
+	assert(result != lnx::io_readiness::park_result::busy);
+	if (result != lnx::io_readiness::park_result::parked)
+	{
+		// Became writable since the last attempt, retry on an I/O thread.
+		m_ioService.post_completion(&m_sendReadyState, 0);
+	}
+}
+
+void cppcoro::net::udp_multiplexer::on_send_ready(
+	lnx::io_state* state,
+	[[maybe_unused]] int errorCode) noexcept
+{
+	static_cast<send_ready_state*>(state)->m_multiplexer.drain_blocked_sends();
+}
+
+std::size_t cppcoro::net::udp_multiplexer::complete_blocked(
+	int errorCode,
+	const clock::time_point* now) noexcept
+{
+	udp_request_operation* completedHead = nullptr;
+	{
+		std::lock_guard lock{ m_blockedMutex };
+		udp_request_operation* previous = nullptr;
+		udp_request_operation* operation = m_blockedHead;
+		while (operation != nullptr)
+		{
+			auto* next = operation->m_nextBlocked;
+			if (now == nullptr || operation->m_deadline <= *now)
+			{
+				if (previous == nullptr)
+				{
+					m_blockedHead = next;
+				}
+				else
+				{
+					previous->m_nextBlocked = next;
+				}
+
+				if (m_blockedTail == operation)
+				{
+					m_blockedTail = previous;
+				}
+
+				operation->m_nextBlocked = completedHead;
+				completedHead = operation;
+			}
+			else
+			{
+				previous = operation;
+			}
+
+			operation = next;
+		}
+	}
+
+	std::size_t count = 0;
+	while (completedHead != nullptr)
+	{
+		auto* operation = completedHead;
+		completedHead = operation->m_nextBlocked;
+
+		operation->m_errorCode = errorCode;
+		free_slot(operation->m_id & m_indexMask);
+		operation->m_awaitingCoroutine.resume();
+		++count;
+	}
+
+	return count;
+}
+
+bool cppcoro::net::udp_multiplexer::try_complete(
+	std::uint32_t id,
+	int errorCode,
+	const std::byte* reply,
+	std::size_t replySize) noexcept
+{
+	const std::uint32_t index = id & m_indexMask;
+	auto& s = m_slots[index];
+
+	std::uint32_t expected = id;
+	if (id == 0 || !s.m_activeId.compare_exchange_strong(
+		expected, 0, std::memory_order_acq_rel, std::memory_order_relaxed))
+	{
+		return false;
+	}
+
+	udp_request_operation* operation = s.m_operation;
+	if (errorCode == 0)
+	{
+		const std::size_t bytesToCopy = std::min(replySize, operation->m_replyBufferSize);
+		std::memcpy(operation->m_replyBuffer, reply, bytesToCopy);
+		operation->m_replySize = bytesToCopy;
+		if (bytesToCopy < replySize)
+		{
+			errorCode = EMSGSIZE;
+		}
+	}
+	operation->m_errorCode = errorCode;
+
+	auto sending = send_state::sending;
+	if (s.m_sendState.compare_exchange_strong(
+		sending,
+		send_state::completed_while_sending,
+		std::memory_order_acq_rel,
+		std::memory_order_relaxed))
+	{
+		// The sending thread is still reading the request, it resumes it.
+		return true;
+	}
+
+	free_slot(index);
+	operation->m_awaitingCoroutine.resume();
+	return true;
+}
+
+std::uint32_t cppcoro::net::udp_multiplexer::allocate_slot() noexcept
+{
+	std::uint64_t head = m_freeHead.load(std::memory_order_acquire);
+	while (true)
+	{
+		const auto index = static_cast<std::uint32_t>(head);
+		if (index == no_slot)
+		{
+			return no_slot;
+		}
+
+		const std::uint32_t next = m_slots[index].m_nextFree.load(std::memory_order_relaxed);
+		const std::uint64_t newHead = (head & 0xFFFFFFFF00000000u) | next;
+		if (m_freeHead.compare_exchange_weak(
+			head, newHead, std::memory_order_acquire, std::memory_order_acquire))
+		{
+			return index;
+		}
+	}
+}
+
+void cppcoro::net::udp_multiplexer::free_slot(std::uint32_t index) noexcept
+{
+	std::uint64_t head = m_freeHead.load(std::memory_order_relaxed);
+	while (true)
+	{
+		m_slots[index].m_nextFree.store(static_cast<std::uint32_t>(head), std::memory_order_relaxed);
+		const std::uint64_t newHead = (((head >> 32) + 1) << 32) | index;
+		if (m_freeHead.compare_exchange_weak(
+			head, newHead, std::memory_order_release, std::memory_order_relaxed))
+		{
+			return;
+		}
+	}
+}
+
+std::uint64_t cppcoro::net::udp_multiplexer::to_tick(
+	clock::time_point time,
+	bool roundUp) const noexcept
+{
+	const auto sinceEpoch = time - m_epoch;
+	if (sinceEpoch.count() <= 0)
+	{
+		return 0;
+	}
+
+	std::uint64_t tick = static_cast<std::uint64_t>(sinceEpoch / m_timerResolution);
+	if (roundUp && sinceEpoch % m_timerResolution != clock::duration::zero())
+	{
+		++tick;
+	}
+
+	return tick;
+}
+
+void cppcoro::net::udp_multiplexer::arm_timeout(std::uint32_t id, clock::time_point deadline)
+{
+	std::uint64_t tick = to_tick(deadline, true);
+	while (true)
+	{
+		// Ticks up to m_lastExpiredTick have already been processed, so an
+		// entry for one of them would not be seen for a whole revolution.
+		const std::uint64_t lastExpiredTick =
+			m_lastExpiredTick.load(std::memory_order_acquire);
+		tick = std::max(tick, lastExpiredTick + 1);
+
+		auto& bucket = m_timerBuckets[tick & m_timerBucketMask];
+		std::lock_guard lock{ bucket.m_mutex };
+		if (m_lastExpiredTick.load(std::memory_order_relaxed) < tick)
+		{
+			bucket.m_entries.push_back(timer_entry{ id, tick });
+			break;
+		}
+	}
+
+	// Usually the timer loop is already due to wake up earlier than this.
+	if (tick < m_sleepTick.load(std::memory_order_acquire))
+	{
+		std::lock_guard lock{ m_wakeMutex };
+		if (tick < m_sleepTick.load(std::memory_order_relaxed))
+		{
+			m_sleepTick.store(tick, std::memory_order_relaxed);
+			m_wakeSource.request_cancellation();
+		}
+	}
+}
+
+std::uint64_t cppcoro::net::udp_multiplexer::expire_timeouts(clock::time_point now)
+{
+	// Requests waiting to be sent are not matched by their ID.
+	m_timedOutCount.fetch_add(complete_blocked(ETIMEDOUT, &now), std::memory_order_relaxed);
+
+	const std::uint64_t nowTick = to_tick(now, false);
+	const std::uint64_t lastExpiredTick = m_lastExpiredTick.load(std::memory_order_relaxed);
+	if (nowTick <= lastExpiredTick)
+	{
+		return find_next_tick(lastExpiredTick + 1);
+	}
+
+	// Publish before visiting the buckets so that timeouts armed from now on
+	// go in future ticks. Each bucket's mutex orders this against arm_timeout().
+	m_lastExpiredTick.store(nowTick, std::memory_order_release);
+
+	std::vector<std::uint32_t> expired;
+	const std::uint64_t ticksToVisit = std::min<std::uint64_t>(nowTick - lastExpiredTick, timer_bucket_count);
+	for (std::uint64_t tick = lastExpiredTick + 1; tick <= lastExpiredTick + ticksToVisit; ++tick)
+	{
+		auto& bucket = m_timerBuckets[tick & m_timerBucketMask];
+		std::lock_guard lock{ bucket.m_mutex };
+
+		// Entries due in a later revolution of the wheel stay where they are.
+		auto it = std::remove_if(
+			bucket.m_entries.begin(),
+			bucket.m_entries.end(),
+			[&](const timer_entry& entry)
+			{
+				if (entry.m_expiryTick <= nowTick)
+				{
+					expired.push_back(entry.m_id);
+					return true;
+				}
+				return false;
+			});
+		bucket.m_entries.erase(it, bucket.m_entries.end());
+	}
+
+	// Requests that already received their reply no longer match their ID.
+	for (const std::uint32_t id : expired)
+	{
+		if (try_complete(id, ETIMEDOUT, nullptr, 0))
+		{
+			m_timedOutCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	return find_next_tick(nowTick + 1);
+}
+
+std::uint64_t cppcoro::net::udp_multiplexer::find_next_tick(std::uint64_t fromTick)
+{
+	// Pending entries in the bucket for a tick are all due on that tick or a
+	// whole number of revolutions later, so the first non-empty bucket
+	// usually holds the answer.
+	std::uint64_t nextTick = no_tick;
+	for (std::uint64_t tick = fromTick;
+		tick < nextTick && tick - fromTick < timer_bucket_count;
+		++tick)
+	{
+		auto& bucket = m_timerBuckets[tick & m_timerBucketMask];
+		std::lock_guard lock{ bucket.m_mutex };
+		for (const auto& entry : bucket.m_entries)
+		{
+			nextTick = std::min(nextTick, entry.m_expiryTick);
+		}
+	}
+
+	return nextTick;
+}
+
+cppcoro::task<> cppcoro::net::udp_multiplexer::receive_loop(cancellation_token ct)
+{
+	std::vector<std::byte> buffers(receive_batch_size * m_maxDatagramSize);
+	std::array<::iovec, receive_batch_size> iovecs;
+	std::array<::mmsghdr, receive_batch_size> messages;
+	for (std::size_t i = 0; i < receive_batch_size; ++i)
+	{
+		iovecs[i].iov_base = buffers.data() + i * m_maxDatagramSize;
+		iovecs[i].iov_len = m_maxDatagramSize;
+	}
+
+	auto& readiness = m_socket.recv_readiness();
+	if (!readiness.reset())
+	{
+		throw std::system_error{
+			EBUSY,
+			std::system_category(),
+			"Another operation is already receiving on the socket"
+		};
+	}
+
+	recv_ready_operation waitForDatagrams{ readiness };
+	cancellation_registration cancelWait{
+		ct,
+		[&] { waitForDatagrams.cancel(m_ioService); } };
+
+	while (!ct.is_cancellation_requested())
+	{
+		for (std::size_t i = 0; i < receive_batch_size; ++i)
+		{
+			messages[i].msg_hdr = ::msghdr{};
+			messages[i].msg_hdr.msg_iov = &iovecs[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+			messages[i].msg_len = 0;
+		}
+
+		const int result = ::recvmmsg(
+			m_socket.native_handle(),
+			messages.data(),
+			static_cast<unsigned int>(receive_batch_size),
+			MSG_DONTWAIT,
+			nullptr);
+		if (result > 0)
+		{
+			m_receiveSyscallCount.fetch_add(1, std::memory_order_relaxed);
+			m_receivedCount.fetch_add(result, std::memory_order_relaxed);
+
+			for (int i = 0; i < result; ++i)
+			{
+				const auto* datagram = static_cast<const std::byte*>(iovecs[i].iov_base);
+				const std::size_t size = messages[i].msg_len;
+
+				bool matched = false;
+				if (size >= id_size)
+				{
+					std::uint32_t networkId;
+					std::memcpy(&networkId, datagram, id_size);
+
+					const int errorCode = (messages[i].msg_hdr.msg_flags & MSG_TRUNC) ? EMSGSIZE : 0;
+					matched = try_complete(ntohl(networkId), errorCode, datagram + id_size, size - id_size);
+				}
+
+				if (!matched)
+				{
+					m_unmatchedCount.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+
+			continue;
+		}
+
+		const int errorCode = errno;
+		if (errorCode == EAGAIN || errorCode == EWOULDBLOCK)
+		{
+			if (!co_await waitForDatagrams)
+			{
+				break;
+			}
+		}
+		else if (errorCode != EINTR && errorCode != ECONNREFUSED)
+		{
+			// ECONNREFUSED reports an ICMP port unreachable for an earlier
+			// request, which will time out.
+			throw std::system_error{
+				errorCode,
+				std::system_category(),
+				"Error receiving datagrams: recvmmsg"
+			};
+		}
+	}
+}
+
+cppcoro::task<> cppcoro::net::udp_multiplexer::timer_loop(cancellation_token ct)
+{
+	cancellation_registration stopWaking{
+		ct,
+		[this]
+		{
+			std::lock_guard lock{ m_wakeMutex };
+			m_wakeSource.request_cancellation();
+		} };
+
+	while (true)
+	{
+		cancellation_token wakeToken;
+		{
+			// Until we know when the next timeout is due, any newly armed
+			// timeout wakes us up straight away.
+			std::lock_guard lock{ m_wakeMutex };
+			if (ct.is_cancellation_requested())
+			{
+				break;
+			}
+
+			m_wakeSource = cancellation_source{};
+			m_sleepTick.store(no_tick, std::memory_order_release);
+			wakeToken = m_wakeSource.token();
+		}
+
+		std::uint64_t sleepTick = expire_timeouts(clock::now());
+		{
+			std::lock_guard lock{ m_wakeMutex };
+			sleepTick = std::min(sleepTick, m_sleepTick.load(std::memory_order_relaxed));
+			m_sleepTick.store(sleepTick, std::memory_order_release);
+		}
+
+		const clock::duration delay = sleepTick == no_tick
+			? clock::duration{ idle_timer_wait }
+			: m_epoch + static_cast<clock::rep>(sleepTick) * m_timerResolution - clock::now();
+
+		try
+		{
+			co_await m_ioService.schedule_after(delay, std::move(wakeToken));
+		}
+		catch (const operation_cancelled&)
+		{
+		}
+	}
+}
+
+std::size_t cppcoro::net::udp_request_operation::await_resume() const
+{
+	if (m_errorCode == ECANCELED)
+	{
+		throw operation_cancelled{};
+	}
+
+	if (m_errorCode != 0)
+	{
+		throw std::system_error{
+			m_errorCode,
+			std::system_category(),
+			"udp_multiplexer request failed"
+		};
+	}
+
+	return m_replySize;
+}
+
+#endif
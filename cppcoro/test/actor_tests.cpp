@@ -0,0 +1,379 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/actor.hpp>
+#include <cppcoro/async_latch.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/sync_wait.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("actor");
+
+using namespace cppcoro;
+
+namespace
+{
+	struct recorder
+	{
+		std::vector<int> received;
+		async_latch* done = nullptr;
+	};
+}
+
+TEST_CASE("messages are handled in the order they were sent")
+{
+	static_thread_pool threadPool{ 2 };
+	async_latch done{ 100 };
+	recorder state;
+
+	{
+		actor<recorder*, int> a{
+			threadPool,
+			&state,
+			[](recorder*& s, int message) -> task<>
+			{
+				s->received.push_back(message);
+				s->done->count_down();
+				co_return;
+			} };
+		state.done = &done;
+
+		auto run = [&]() -> task<>
+		{
+			for (int i = 0; i < 100; ++i)
+			{
+				CHECK(co_await a.send(i));
+			}
+			co_await done;
+		};
+		sync_wait(run());
+
+		// Destroying the actor waits for the last handler to return.
+	}
+
+	std::vector<int> expected;
+	for (int i = 0; i < 100; ++i)
+	{
+		expected.push_back(i);
+	}
+	CHECK(state.received == expected);
+}
+
+TEST_CASE("handler runs on the thread pool, one message at a time")
+{
+	static_thread_pool threadPool{ 4 };
+
+	struct state
+	{
+		std::atomic<int>* running;
+		std::atomic<int>* maxRunning;
+		std::atomic<int>* handled;
+		static_thread_pool* threadPool;
+	};
+
+	std::atomic<int> running = 0;
+	std::atomic<int> maxRunning = 0;
+	std::atomic<int> handled = 0;
+
+	{
+		actor<state, int> a{
+			threadPool,
+			state{ &running, &maxRunning, &handled, &threadPool },
+			[](state& s, int) -> task<>
+			{
+				CHECK(s.threadPool->is_current_thread_in_pool());
+				const int nowRunning = s.running->fetch_add(1) + 1;
+				int expected = s.maxRunning->load();
+				while (nowRunning > expected && !s.maxRunning->compare_exchange_weak(expected, nowRunning))
+				{}
+
+				// Suspend mid-message; the next message mustn't start meanwhile.
+				co_await s.threadPool->schedule();
+
+				s.running->fetch_sub(1);
+				s.handled->fetch_add(1);
+			},
+			nullptr,
+			8,
+			4 };
+
+		auto sender = [&]() -> task<>
+		{
+			co_await threadPool.schedule();
+			for (int i = 0; i < 500; ++i)
+			{
+				CHECK(co_await a.send(i));
+			}
+		};
+
+		std::vector<task<>> senders;
+		for (int i = 0; i < 4; ++i)
+		{
+			senders.push_back(sender());
+		}
+		sync_wait(when_all(std::move(senders)));
+	}
+
+	CHECK(handled == 2000);
+	CHECK(maxRunning == 1);
+}
+
+TEST_CASE("try_send fails when the mailbox is full")
+{
+	static_thread_pool threadPool{ 1 };
+
+	struct state
+	{
+		std::atomic<int>* handled;
+	};
+	std::atomic<int> handled = 0;
+
+	{
+		actor<state, int> a{
+			threadPool,
+			state{ &handled },
+			[](state& s, int) -> task<>
+			{
+				s.handled->fetch_add(1);
+				co_return;
+			},
+			nullptr,
+			4 };
+
+		auto blockPool = [&]() -> task<>
+		{
+			co_await threadPool.schedule();
+
+			// The only pool thread is running this coroutine, so the actor
+			// can't handle anything until it suspends.
+			for (int i = 0; i < 4; ++i)
+			{
+				CHECK(a.try_send(i));
+			}
+			CHECK(!a.try_send(4));
+			CHECK(handled == 0);
+		};
+		sync_wait(blockPool());
+	}
+
+	CHECK(handled == 4);
+}
+
+TEST_CASE("send waits for room in the mailbox")
+{
+	static_thread_pool threadPool{ 1 };
+
+	struct state
+	{
+		std::vector<int>* received;
+	};
+	std::vector<int> received;
+
+	{
+		actor<state, int> a{
+			threadPool,
+			state{ &received },
+			[](state& s, int message) -> task<>
+			{
+				s.received->push_back(message);
+				co_return;
+			},
+			nullptr,
+			2,
+			1 };
+
+		auto run = [&]() -> task<>
+		{
+			co_await threadPool.schedule();
+
+			// Without yielding the thread, so the first sends fill the
+			// mailbox and the rest have to wait.
+			for (int i = 0; i < 20; ++i)
+			{
+				CHECK(co_await a.send(i));
+			}
+		};
+		sync_wait(run());
+	}
+
+	std::vector<int> expected;
+	for (int i = 0; i < 20; ++i)
+	{
+		expected.push_back(i);
+	}
+	CHECK(received == expected);
+}
+
+TEST_CASE("supervisor can resume after a failure")
+{
+	static_thread_pool threadPool{ 2 };
+
+	struct counts
+	{
+		int handled = 0;
+		int failures = 0;
+	};
+	counts result;
+
+	{
+		actor<counts*, int> a{
+			threadPool,
+			&result,
+			[](counts*& s, int message) -> task<>
+			{
+				if (message % 3 == 0)
+				{
+					throw std::runtime_error("bad message");
+				}
+				++s->handled;
+				co_return;
+			},
+			[](counts*& s, std::exception_ptr error)
+			{
+				try
+				{
+					std::rethrow_exception(error);
+				}
+				catch (const std::runtime_error&)
+				{
+					++s->failures;
+				}
+				return actor_directive::resume;
+			},
+			16 };
+
+		for (int i = 0; i < 10; ++i)
+		{
+			CHECK(a.try_send(i));
+		}
+
+		// Destroying the actor waits for all of the messages to be handled.
+	}
+
+	CHECK(result.handled == 6);
+	CHECK(result.failures == 4);
+}
+
+TEST_CASE("actor stops after an unsupervised failure")
+{
+	static_thread_pool threadPool{ 1 };
+
+	struct state
+	{
+		int* handled;
+	};
+	int handled = 0;
+
+	{
+		actor<state, int> a{
+			threadPool,
+			state{ &handled },
+			[](state& s, int message) -> task<>
+			{
+				if (message == 0)
+				{
+					throw std::runtime_error("failed");
+				}
+				++*s.handled;
+				co_return;
+			},
+			nullptr,
+			2 };
+
+		auto run = [&]() -> task<>
+		{
+			co_await threadPool.schedule();
+
+			CHECK(a.try_send(0));
+			CHECK(a.try_send(1));
+
+			// Waits for room until the actor stops, then fails.
+			CHECK(!co_await a.send(2));
+			CHECK(a.is_stopped());
+			CHECK(!a.try_send(3));
+		};
+		sync_wait(run());
+	}
+
+	CHECK(handled == 0);
+}
+
+TEST_CASE("many actors")
+{
+	using clock = std::chrono::steady_clock;
+
+	static_thread_pool threadPool{ 4 };
+
+	constexpr int actorCount = 100000;
+	constexpr int messagesPerActor = 4;
+
+	struct state
+	{
+		std::uint64_t sum = 0;
+		async_latch* done;
+	};
+
+	async_latch done{ actorCount * messagesPerActor };
+	std::vector<std::unique_ptr<actor<state, std::uint64_t>>> actors;
+	actors.reserve(actorCount);
+	for (int i = 0; i < actorCount; ++i)
+	{
+		actors.push_back(std::make_unique<actor<state, std::uint64_t>>(
+			threadPool,
+			state{ 0, &done },
+			[](state& s, std::uint64_t message) -> task<>
+			{
+				s.sum += message;
+				s.done->count_down();
+				co_return;
+			},
+			nullptr,
+			4));
+	}
+
+	auto sender = [&](int first, int count) -> task<>
+	{
+		co_await threadPool.schedule();
+		int failed = 0;
+		for (int m = 1; m <= messagesPerActor; ++m)
+		{
+			for (int i = first; i < first + count; ++i)
+			{
+				failed += co_await actors[i]->send(m) ? 0 : 1;
+			}
+		}
+		CHECK(failed == 0);
+	};
+
+	const auto start = clock::now();
+	auto run = [&]() -> task<>
+	{
+		std::vector<task<>> senders;
+		for (int i = 0; i < 4; ++i)
+		{
+			senders.push_back(sender(i * actorCount / 4, actorCount / 4));
+		}
+		co_await when_all(std::move(senders));
+		co_await done;
+	};
+	sync_wait(run());
+	const auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+	MESSAGE(
+		actorCount << " actors: "
+		<< actorCount * messagesPerActor / elapsed << " messages/s");
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,186 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/any_scheduler.hpp>
+#include <cppcoro/inline_scheduler.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/sync_wait.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+
+#include "io_service_fixture.hpp"
+
+#include <chrono>
+#include <coroutine>
+#include <thread>
+#include <vector>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("any_scheduler");
+
+using cppcoro::any_scheduler;
+
+namespace
+{
+	// A scheduler that isn't one of the built-in ones, so it's called
+	// through any_scheduler's function table.
+	class manual_scheduler
+	{
+	public:
+
+		class schedule_operation
+		{
+		public:
+
+			explicit schedule_operation(manual_scheduler& scheduler) noexcept
+				: m_scheduler(scheduler)
+			{}
+
+			bool await_ready() const noexcept { return m_scheduler.m_runInline; }
+
+			bool await_suspend(std::coroutine_handle<> awaitingCoroutine)
+			{
+				m_scheduler.m_queue.push_back(awaitingCoroutine);
+				return true;
+			}
+
+			void await_resume() const noexcept {}
+
+		private:
+
+			manual_scheduler& m_scheduler;
+
+		};
+
+		schedule_operation schedule() noexcept { return schedule_operation{ *this }; }
+
+		void run_all()
+		{
+			while (!m_queue.empty())
+			{
+				auto handle = m_queue.front();
+				m_queue.erase(m_queue.begin());
+				handle.resume();
+			}
+		}
+
+		bool m_runInline = false;
+		std::vector<std::coroutine_handle<>> m_queue;
+
+	};
+
+	// Not a template, which is the point of any_scheduler.
+	cppcoro::task<std::thread::id> thread_id_after_schedule(any_scheduler scheduler)
+	{
+		co_await scheduler.schedule();
+		co_return std::this_thread::get_id();
+	}
+}
+
+TEST_CASE("any_scheduler is small")
+{
+	CHECK(sizeof(any_scheduler) <= 3 * sizeof(void*));
+}
+
+TEST_CASE("any_scheduler with inline_scheduler resumes synchronously")
+{
+	cppcoro::inline_scheduler inlineScheduler;
+	any_scheduler scheduler{ inlineScheduler };
+
+	CHECK(scheduler.schedule().await_ready());
+	CHECK(cppcoro::sync_wait(thread_id_after_schedule(scheduler)) == std::this_thread::get_id());
+}
+
+TEST_CASE("any_scheduler with static_thread_pool resumes on a pool thread")
+{
+	cppcoro::static_thread_pool threadPool{ 2 };
+	any_scheduler scheduler{ threadPool };
+
+	CHECK(scheduler == any_scheduler{ threadPool });
+	CHECK(scheduler != any_scheduler{ cppcoro::inline_scheduler{} });
+
+	cppcoro::sync_wait([&]() -> cppcoro::task<>
+	{
+		co_await scheduler.schedule();
+		CHECK(threadPool.is_current_thread_in_pool());
+	}());
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "any_scheduler with io_service resumes on an I/O thread")
+{
+	any_scheduler scheduler{ io_service() };
+
+	const auto id = cppcoro::sync_wait(thread_id_after_schedule(scheduler));
+	CHECK(id != std::this_thread::get_id());
+}
+
+TEST_CASE("any_scheduler with another scheduler calls through to it")
+{
+	manual_scheduler manual;
+	any_scheduler scheduler{ manual };
+
+	bool resumed = false;
+	auto waiter = [&]() -> cppcoro::task<>
+	{
+		co_await scheduler.schedule();
+		resumed = true;
+	};
+	auto runner = [&]() -> cppcoro::task<>
+	{
+		CHECK(!resumed);
+		CHECK(manual.m_queue.size() == 1);
+		manual.run_all();
+		co_return;
+	};
+
+	cppcoro::sync_wait(cppcoro::when_all(waiter(), runner()));
+	CHECK(resumed);
+
+	manual.m_runInline = true;
+	CHECK(scheduler.schedule().await_ready());
+}
+
+TEST_CASE("schedule throughput through any_scheduler")
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr int scheduleCount = 1000000;
+
+	cppcoro::static_thread_pool threadPool{ 1 };
+
+	auto measure = [&](auto& scheduler)
+	{
+		const auto start = clock::now();
+		cppcoro::sync_wait([&]() -> cppcoro::task<>
+		{
+			for (int i = 0; i < scheduleCount; ++i)
+			{
+				co_await scheduler.schedule();
+			}
+		}());
+		const auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+		return elapsed * 1e9 / scheduleCount;
+	};
+
+	any_scheduler erasedPool{ threadPool };
+	const double directPoolNs = measure(threadPool);
+	const double erasedPoolNs = measure(erasedPool);
+
+	manual_scheduler manual;
+	manual.m_runInline = true;
+	any_scheduler erasedManual{ manual };
+	const double directManualNs = measure(manual);
+	const double erasedManualNs = measure(erasedManual);
+
+	MESSAGE(
+		"static_thread_pool: " << directPoolNs << " ns direct, "
+		<< erasedPoolNs << " ns through any_scheduler; "
+		"other scheduler, completing inline: " << directManualNs << " ns direct, "
+		<< erasedManualNs << " ns through any_scheduler");
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,257 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/async_barrier.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/when_all_ready.hpp>
+#include <cppcoro/sync_wait.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("async_barrier");
+
+using namespace cppcoro;
+
+TEST_CASE("single participant completes every phase without suspending")
+{
+	int completions = 0;
+	async_barrier barrier{ 1, [&]() noexcept { ++completions; } };
+
+	sync_wait([&]() -> task<>
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			co_await barrier.arrive_and_wait();
+			CHECK(completions == i + 1);
+		}
+	}());
+
+	CHECK(barrier.completed_phase_count() == 3);
+}
+
+TEST_CASE("participants are released together once all have arrived")
+{
+	async_barrier barrier{ 3 };
+	int arrived = 0;
+	int released = 0;
+
+	auto participant = [&]() -> task<>
+	{
+		++arrived;
+		co_await barrier.arrive_and_wait();
+		CHECK(arrived == 3);
+		++released;
+	};
+
+	auto checkNotReleased = [&]() -> task<>
+	{
+		CHECK(released == 0);
+		co_return;
+	};
+
+	sync_wait(when_all_ready(participant(), participant(), checkNotReleased(), participant()));
+
+	CHECK(released == 3);
+	CHECK(barrier.completed_phase_count() == 1);
+}
+
+TEST_CASE("completion function runs before waiters are resumed")
+{
+	int phase = 0;
+	async_barrier barrier{ 2, [&]() noexcept { ++phase; } };
+
+	auto participant = [&]() -> task<>
+	{
+		for (int i = 1; i <= 5; ++i)
+		{
+			co_await barrier.arrive_and_wait();
+			CHECK(phase == i);
+		}
+	};
+
+	sync_wait(when_all_ready(participant(), participant()));
+
+	CHECK(phase == 5);
+}
+
+TEST_CASE("arrive_and_drop reduces the participants of later phases")
+{
+	int completions = 0;
+	async_barrier barrier{ 3, [&]() noexcept { ++completions; } };
+
+	auto stayer = [&]() -> task<>
+	{
+		for (int i = 1; i <= 4; ++i)
+		{
+			co_await barrier.arrive_and_wait();
+			CHECK(completions == i);
+		}
+	};
+
+	auto dropper = [&]() -> task<>
+	{
+		co_await barrier.arrive_and_wait();
+		barrier.arrive_and_drop();
+	};
+
+	sync_wait(when_all_ready(stayer(), dropper(), stayer()));
+
+	CHECK(completions == 4);
+}
+
+TEST_CASE("last arrival may be a drop")
+{
+	async_barrier barrier{ 2 };
+	bool resumed = false;
+
+	auto waiter = [&]() -> task<>
+	{
+		co_await barrier.arrive_and_wait();
+		resumed = true;
+		co_await barrier.arrive_and_wait();
+	};
+
+	auto dropper = [&]() -> task<>
+	{
+		CHECK(!resumed);
+		barrier.arrive_and_drop();
+		CHECK(resumed);
+		co_return;
+	};
+
+	sync_wait(when_all_ready(waiter(), dropper()));
+
+	CHECK(barrier.completed_phase_count() == 2);
+}
+
+TEST_CASE("many participants spread over several leaves")
+{
+	constexpr int participantCount = 100;
+	constexpr int phaseCount = 20;
+
+	std::atomic<int> arrivals = 0;
+	int completions = 0;
+	bool allArrivedAtCompletion = true;
+	async_barrier barrier{ participantCount, [&]() noexcept
+	{
+		++completions;
+		allArrivedAtCompletion &= arrivals.exchange(0) == participantCount;
+	} };
+
+	auto participant = [&]() -> task<>
+	{
+		for (int i = 1; i <= phaseCount; ++i)
+		{
+			arrivals.fetch_add(1);
+			co_await barrier.arrive_and_wait();
+			CHECK(completions == i);
+		}
+	};
+
+	std::vector<task<>> tasks;
+	for (int i = 0; i < participantCount; ++i)
+	{
+		tasks.push_back(participant());
+	}
+	sync_wait(when_all(std::move(tasks)));
+
+	CHECK(completions == phaseCount);
+	CHECK(allArrivedAtCompletion);
+}
+
+TEST_CASE("multi-threaded phases with drops")
+{
+	static_thread_pool threadPool{ 4 };
+
+	constexpr int participantCount = 70;
+	constexpr int phaseCount = 50;
+
+	std::atomic<int> arrivals = 0;
+	int expected = participantCount;
+	int completions = 0;
+	bool allArrivedAtCompletion = true;
+	async_barrier barrier{ participantCount, [&]() noexcept
+	{
+		++completions;
+		allArrivedAtCompletion &= arrivals.exchange(0) == expected;
+		// Participant 0..(n-1) drops after phase n, one per phase.
+		expected = participantCount - completions < participantCount / 2
+			? participantCount / 2
+			: participantCount - completions;
+	} };
+
+	auto participant = [&](int id) -> task<>
+	{
+		for (int i = 0; i < phaseCount; ++i)
+		{
+			co_await threadPool.schedule();
+			arrivals.fetch_add(1);
+			if (id < participantCount / 2 && i == id)
+			{
+				barrier.arrive_and_drop();
+				co_return;
+			}
+			co_await barrier.arrive_and_wait();
+		}
+	};
+
+	std::vector<task<>> tasks;
+	for (int i = 0; i < participantCount; ++i)
+	{
+		tasks.push_back(participant(i));
+	}
+	sync_wait(when_all(std::move(tasks)));
+
+	CHECK(completions == phaseCount);
+	CHECK(allArrivedAtCompletion);
+}
+
+TEST_CASE("async_barrier phase throughput")
+{
+	using clock = std::chrono::steady_clock;
+
+	static_thread_pool threadPool{ 4 };
+
+	for (int participantCount : { 4, 16, 64, 256 })
+	{
+		const int phaseCount = 200000 / participantCount;
+		async_barrier barrier{ participantCount };
+
+		auto participant = [&]() -> task<>
+		{
+			co_await threadPool.schedule();
+			for (int i = 0; i < phaseCount; ++i)
+			{
+				co_await barrier.arrive_and_wait();
+			}
+		};
+
+		std::vector<task<>> tasks;
+		for (int i = 0; i < participantCount; ++i)
+		{
+			tasks.push_back(participant());
+		}
+
+		const auto start = clock::now();
+		sync_wait(when_all(std::move(tasks)));
+		const auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+		CHECK(barrier.completed_phase_count() == static_cast<std::uint64_t>(phaseCount));
+
+		MESSAGE(
+			participantCount << " participants: "
+			<< phaseCount / elapsed << " phases/s, "
+			<< elapsed * 1e9 / (static_cast<double>(phaseCount) * participantCount) << " ns/arrival");
+	}
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,450 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/async_concurrent_map.hpp>
+#include <cppcoro/async_manual_reset_event.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/sync_wait.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/when_all_ready.hpp>
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("async_concurrent_map");
+
+using cppcoro::async_concurrent_map;
+
+TEST_CASE("insert, find and erase")
+{
+	async_concurrent_map<std::string, int> map;
+	CHECK(map.size() == 0);
+	CHECK(!map.find("a"));
+
+	CHECK(map.insert("a", 1));
+	CHECK(map.insert("b", 2));
+	CHECK(!map.insert("a", 3));
+	CHECK(map.size() == 2);
+	CHECK(map.find("a") == 1);
+	CHECK(map.contains("b"));
+
+	CHECK(!map.insert_or_assign("a", 4));
+	CHECK(map.find("a") == 4);
+	CHECK(map.insert_or_assign("c", 5));
+
+	CHECK(map.erase("a"));
+	CHECK(!map.erase("a"));
+	CHECK(!map.contains("a"));
+	CHECK(map.size() == 2);
+}
+
+TEST_CASE("map grows and erases without losing entries")
+{
+	// A single stripe puts every key in the same table.
+	async_concurrent_map<int, int> map{ 1 };
+
+	constexpr int count = 10000;
+	for (int i = 0; i < count; ++i)
+	{
+		REQUIRE(map.insert(i, i * 2));
+	}
+	CHECK(map.size() == count);
+
+	for (int i = 1; i < count; i += 2)
+	{
+		REQUIRE(map.erase(i));
+	}
+	CHECK(map.size() == count / 2);
+
+	bool allFound = true;
+	for (int i = 0; i < count; ++i)
+	{
+		const auto value = map.find(i);
+		allFound = allFound && (i % 2 == 0 ? value == i * 2 : !value);
+	}
+	CHECK(allFound);
+}
+
+TEST_CASE("keys stepped by a large power of two spread across slots")
+{
+	// These keys agree in their low bits, so they would all probe from the
+	// same home slot if the hash were not mixed.
+	async_concurrent_map<std::uint64_t, int> map{ 1 };
+
+	constexpr int count = 50000;
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < count; ++i)
+	{
+		REQUIRE(map.insert(std::uint64_t(i) << 24, i));
+	}
+
+	bool allFound = true;
+	for (int i = 0; i < count; ++i)
+	{
+		allFound = allFound && map.find(std::uint64_t(i) << 24) == i;
+	}
+	CHECK(allFound);
+	CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+}
+
+TEST_CASE("wait_for completes immediately if the key is in the map")
+{
+	async_concurrent_map<int, std::string> map;
+	map.insert(1, "one");
+
+	auto value = cppcoro::sync_wait([&]() -> cppcoro::task<std::string>
+	{
+		co_return co_await map.wait_for(1);
+	}());
+	CHECK(value == "one");
+}
+
+TEST_CASE("wait_for resumes waiters when their key is inserted")
+{
+	async_concurrent_map<int, std::string> map{ 1 };
+
+	std::vector<std::string> results;
+	auto waiter = [&](int key) -> cppcoro::task<>
+	{
+		results.push_back(co_await map.wait_for(key));
+	};
+
+	auto inserter = [&]() -> cppcoro::task<>
+	{
+		CHECK(results.empty());
+
+		map.insert(2, "two");
+		CHECK(results == std::vector<std::string>{ "two" });
+
+		// Both waiters for the same key resume, in the order they waited.
+		map.insert(1, "one");
+		CHECK(results == std::vector<std::string>{ "two", "one", "one" });
+		co_return;
+	};
+
+	cppcoro::sync_wait(cppcoro::when_all_ready(waiter(1), waiter(2), waiter(1), inserter()));
+}
+
+TEST_CASE("waiters keep their order when the waiter table grows")
+{
+	async_concurrent_map<int, int> map{ 1 };
+
+	// Enough waiters to grow the stripe's waiter table a few times.
+	constexpr int waiterCount = 100;
+
+	std::vector<int> order;
+	auto waiter = [&](int key, int index) -> cppcoro::task<>
+	{
+		co_await map.wait_for(key);
+		order.push_back(index);
+	};
+
+	auto inserter = [&]() -> cppcoro::task<>
+	{
+		map.insert(0, 0);
+		map.insert(1, 1);
+		co_return;
+	};
+
+	std::vector<cppcoro::task<>> tasks;
+	for (int i = 0; i < waiterCount; ++i)
+	{
+		tasks.push_back(waiter(i % 2, i));
+	}
+	tasks.push_back(inserter());
+	cppcoro::sync_wait(cppcoro::when_all_ready(std::move(tasks)));
+
+	std::vector<int> expected;
+	for (int i = 0; i < waiterCount; i += 2)
+	{
+		expected.push_back(i);
+	}
+	for (int i = 1; i < waiterCount; i += 2)
+	{
+		expected.push_back(i);
+	}
+	CHECK(order == expected);
+}
+
+TEST_CASE("concurrent waiters and inserters")
+{
+	cppcoro::static_thread_pool threadPool{ 4 };
+	async_concurrent_map<int, int> map;
+
+	constexpr int keyCount = 10000;
+
+	auto waiter = [&](int key) -> cppcoro::task<int>
+	{
+		co_await threadPool.schedule();
+		co_return co_await map.wait_for(key);
+	};
+
+	auto inserter = [&](int first) -> cppcoro::task<>
+	{
+		co_await threadPool.schedule();
+		for (int key = first; key < keyCount; key += 2)
+		{
+			map.insert(key, key * 3);
+		}
+	};
+
+	std::vector<cppcoro::task<int>> waiters;
+	for (int key = 0; key < keyCount; ++key)
+	{
+		waiters.push_back(waiter(key));
+	}
+
+	auto [results, ignore1, ignore2] = cppcoro::sync_wait(cppcoro::when_all(
+		cppcoro::when_all(std::move(waiters)), inserter(0), inserter(1)));
+
+	bool allCorrect = true;
+	for (int key = 0; key < keyCount; ++key)
+	{
+		allCorrect = allCorrect && results[key] == key * 3;
+	}
+	CHECK(allCorrect);
+}
+
+namespace
+{
+	// What the map replaces: a mutex-protected unordered_map, plus an event
+	// allocated for each key that somebody waits for.
+	class locked_map_with_events
+	{
+	public:
+
+		std::optional<int> find(int key)
+		{
+			std::scoped_lock lock{ m_mutex };
+			auto it = m_values.find(key);
+			return it != m_values.end() ? std::optional<int>{ it->second } : std::nullopt;
+		}
+
+		void insert(int key, int value)
+		{
+			std::unique_ptr<cppcoro::async_manual_reset_event> event;
+			{
+				std::scoped_lock lock{ m_mutex };
+				if (!m_values.emplace(key, value).second)
+				{
+					return;
+				}
+
+				auto it = m_events.find(key);
+				if (it != m_events.end())
+				{
+					event = std::move(it->second);
+					m_events.erase(it);
+				}
+			}
+
+			if (event)
+			{
+				event->set();
+			}
+		}
+
+		void erase(int key)
+		{
+			std::scoped_lock lock{ m_mutex };
+			m_values.erase(key);
+		}
+
+		cppcoro::task<int> wait_for(int key)
+		{
+			cppcoro::async_manual_reset_event* event;
+			{
+				std::scoped_lock lock{ m_mutex };
+				auto it = m_values.find(key);
+				if (it != m_values.end())
+				{
+					co_return it->second;
+				}
+
+				auto& slot = m_events[key];
+				if (!slot)
+				{
+					slot = std::make_unique<cppcoro::async_manual_reset_event>();
+				}
+				event = slot.get();
+			}
+
+			co_await *event;
+			co_return *find(key);
+		}
+
+	private:
+
+		std::mutex m_mutex;
+		std::unordered_map<int, int> m_values;
+		std::unordered_map<int, std::unique_ptr<cppcoro::async_manual_reset_event>> m_events;
+
+	};
+
+	struct concurrent_map_adapter
+	{
+		std::optional<int> find(int key) { return m_map.find(key); }
+		void insert(int key, int value) { m_map.insert(key, value); }
+		void erase(int key) { m_map.erase(key); }
+
+		cppcoro::task<int> wait_for(int key)
+		{
+			co_return co_await m_map.wait_for(key);
+		}
+
+		async_concurrent_map<int, int> m_map;
+	};
+
+	// Mostly lookups, with inserts, erases and waits mixed in. Each wait is
+	// for a key that nobody else uses, and is satisfied by an insert on the
+	// same thread.
+	template<typename MAP>
+	double mixed_workload_ns_per_op(MAP& map, int threadCount, int opsPerThread)
+	{
+		using clock = std::chrono::steady_clock;
+
+		constexpr int sharedKeyCount = 4096;
+		for (int key = 0; key < sharedKeyCount; key += 2)
+		{
+			map.insert(key, key);
+		}
+
+		const auto start = clock::now();
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; ++t)
+		{
+			threads.emplace_back([&map, t, opsPerThread]
+			{
+				std::uint32_t random = 12345u + static_cast<std::uint32_t>(t);
+				std::uint64_t found = 0;
+				int privateKey = (t + 1) * 100000000;
+				for (int i = 0; i < opsPerThread; ++i)
+				{
+					random = random * 1664525u + 1013904223u;
+					const int key = static_cast<int>((random >> 8) % sharedKeyCount);
+					const std::uint32_t choice = random >> 24;
+					if (choice < 200)
+					{
+						found += map.find(key).has_value();
+					}
+					else if (choice < 225)
+					{
+						map.insert(key, key);
+					}
+					else if (choice < 250)
+					{
+						map.erase(key);
+					}
+					else
+					{
+						cppcoro::sync_wait(cppcoro::when_all_ready(
+							map.wait_for(privateKey),
+							[&]() -> cppcoro::task<>
+							{
+								map.insert(privateKey, i);
+								co_return;
+							}()));
+						map.erase(privateKey);
+						++privateKey;
+					}
+				}
+				CHECK(found > 0);
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		const auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+		return elapsed * 1e9 / (static_cast<double>(threadCount) * opsPerThread);
+	}
+}
+
+TEST_CASE("async_concurrent_map mixed workload throughput")
+{
+	constexpr int threadCount = 4;
+	constexpr int opsPerThread = 500000;
+
+	locked_map_with_events baseline;
+	const double baselineNs = mixed_workload_ns_per_op(baseline, threadCount, opsPerThread);
+
+	concurrent_map_adapter map;
+	const double mapNs = mixed_workload_ns_per_op(map, threadCount, opsPerThread);
+
+	MESSAGE(
+		"78% find, 10% insert, 10% erase, 2% wait: "
+		<< baselineNs << " ns per op with a locked unordered_map and events, "
+		<< mapNs << " ns with async_concurrent_map");
+}
+
+TEST_CASE("async_concurrent_map insert throughput with many outstanding waiters")
+{
+	constexpr int insertCount = 200000;
+	constexpr int waiterCount = 100000;
+
+	using clock = std::chrono::steady_clock;
+	async_concurrent_map<int, int> map;
+
+	// Inserts keys nobody waits for, returning the ns per insert.
+	auto timeInserts = [&](int first)
+	{
+		const auto start = clock::now();
+		for (int key = first; key < first + insertCount; ++key)
+		{
+			map.insert(key, key);
+		}
+		const auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+		return elapsed * 1e9 / insertCount;
+	};
+
+	const double noWaitersNs = timeInserts(0);
+
+	// Waiters for keys above everything timed, resumed once the timing's done.
+	int resumed = 0;
+	auto waiter = [&](int key) -> cppcoro::task<>
+	{
+		co_await map.wait_for(key);
+		++resumed;
+	};
+
+	double manyWaitersNs = 0;
+	auto driver = [&]() -> cppcoro::task<>
+	{
+		manyWaitersNs = timeInserts(insertCount);
+		for (int i = 0; i < waiterCount; ++i)
+		{
+			map.insert(2 * insertCount + i, i);
+		}
+		co_return;
+	};
+
+	std::vector<cppcoro::task<>> tasks;
+	for (int i = 0; i < waiterCount; ++i)
+	{
+		tasks.push_back(waiter(2 * insertCount + i));
+	}
+	tasks.push_back(driver());
+	cppcoro::sync_wait(cppcoro::when_all_ready(std::move(tasks)));
+	CHECK(resumed == waiterCount);
+
+	MESSAGE(
+		"insert: " << noWaitersNs << " ns with no waiters, "
+		<< manyWaitersNs << " ns with " << waiterCount << " outstanding waiters");
+}
+
+TEST_SUITE_END();
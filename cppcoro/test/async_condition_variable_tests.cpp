@@ -0,0 +1,360 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/async_condition_variable.hpp>
+#include <cppcoro/async_auto_reset_event.hpp>
+#include <cppcoro/async_mutex.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/when_all_ready.hpp>
+#include <cppcoro/sync_wait.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("async_condition_variable");
+
+using namespace cppcoro;
+
+TEST_CASE("notify without waiters does nothing")
+{
+	async_mutex mutex;
+	async_condition_variable cv;
+	CHECK(mutex.try_lock());
+	cv.notify_one();
+	cv.notify_all();
+	mutex.unlock();
+	CHECK(mutex.try_lock());
+	mutex.unlock();
+}
+
+TEST_CASE("wait releases the lock and resumes holding it")
+{
+	async_mutex mutex;
+	async_condition_variable cv;
+	bool ready = false;
+	bool resumed = false;
+
+	auto waiter = [&]() -> task<>
+	{
+		auto lock = co_await mutex.scoped_lock_async();
+		while (!ready)
+		{
+			co_await cv.wait(lock);
+		}
+		CHECK(!mutex.try_lock());
+		resumed = true;
+	};
+
+	auto notifier = [&]() -> task<>
+	{
+		// The waiter must have released the lock while waiting.
+		auto lock = co_await mutex.scoped_lock_async();
+		ready = true;
+		cv.notify_one();
+
+		// Morphed onto the mutex, so not resumed until the lock is released.
+		CHECK(!resumed);
+	};
+
+	sync_wait(when_all_ready(waiter(), notifier()));
+
+	CHECK(resumed);
+	CHECK(mutex.try_lock());
+	mutex.unlock();
+}
+
+TEST_CASE("notify_one wakes waiters in the order they waited")
+{
+	async_mutex mutex;
+	async_condition_variable cv;
+	std::vector<int> order;
+
+	auto waiter = [&](int id) -> task<>
+	{
+		co_await mutex.lock_async();
+		co_await cv.wait(mutex);
+		order.push_back(id);
+		mutex.unlock();
+	};
+
+	auto notifier = [&]() -> task<>
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			auto lock = co_await mutex.scoped_lock_async();
+			cv.notify_one();
+		}
+	};
+
+	sync_wait(when_all_ready(waiter(1), waiter(2), waiter(3), notifier()));
+
+	CHECK(order == std::vector<int>{ 1, 2, 3 });
+}
+
+TEST_CASE("notified waiters acquire the lock before existing lock waiters")
+{
+	async_mutex mutex;
+	async_condition_variable cv;
+	std::vector<int> order;
+	async_auto_reset_event release;
+
+	auto waiter = [&](int id) -> task<>
+	{
+		auto lock = co_await mutex.scoped_lock_async();
+		co_await cv.wait(lock);
+		order.push_back(id);
+	};
+
+	auto locker = [&]() -> task<>
+	{
+		auto lock = co_await mutex.scoped_lock_async();
+		order.push_back(0);
+	};
+
+	auto notifier = [&]() -> task<>
+	{
+		auto lock = co_await mutex.scoped_lock_async();
+		co_await release;
+		cv.notify_all();
+	};
+
+	auto run = [&]() -> task<>
+	{
+		// The locker queues on the mutex while the notifier holds it.
+		release.set();
+		co_return;
+	};
+
+	sync_wait(when_all_ready(waiter(1), waiter(2), notifier(), locker(), run()));
+
+	CHECK(order == std::vector<int>{ 1, 2, 0 });
+}
+
+TEST_CASE("wait with predicate")
+{
+	async_mutex mutex;
+	async_condition_variable cv;
+	int value = 0;
+	int checks = 0;
+
+	auto waiter = [&]() -> task<>
+	{
+		auto lock = co_await mutex.scoped_lock_async();
+		co_await cv.wait(lock, [&] { ++checks; return value == 3; });
+		CHECK(value == 3);
+	};
+
+	auto incrementer = [&]() -> task<>
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			auto lock = co_await mutex.scoped_lock_async();
+			++value;
+			cv.notify_all();
+		}
+	};
+
+	sync_wait(when_all_ready(waiter(), incrementer()));
+
+	CHECK(checks == 4);
+}
+
+namespace
+{
+	constexpr std::size_t queue_capacity = 16;
+
+	/// Bounded queue using a condition variable for each condition.
+	struct cv_queue
+	{
+		async_mutex mutex;
+		async_condition_variable notEmpty;
+		async_condition_variable notFull;
+		std::deque<std::uint64_t> items;
+
+		task<> push(std::uint64_t value)
+		{
+			auto lock = co_await mutex.scoped_lock_async();
+			while (items.size() >= queue_capacity)
+			{
+				co_await notFull.wait(lock);
+			}
+			items.push_back(value);
+			notEmpty.notify_one();
+		}
+
+		task<std::uint64_t> pop()
+		{
+			auto lock = co_await mutex.scoped_lock_async();
+			while (items.empty())
+			{
+				co_await notEmpty.wait(lock);
+			}
+			const auto value = items.front();
+			items.pop_front();
+			notFull.notify_one();
+			co_return value;
+		}
+	};
+
+	/// The same queue emulating the conditions with auto-reset events, where
+	/// a woken coroutine has to contend for the mutex again.
+	struct event_queue
+	{
+		async_mutex mutex;
+		async_auto_reset_event notEmpty;
+		async_auto_reset_event notFull;
+		std::deque<std::uint64_t> items;
+
+		task<> push(std::uint64_t value)
+		{
+			co_await mutex.lock_async();
+			while (items.size() >= queue_capacity)
+			{
+				mutex.unlock();
+				co_await notFull;
+				co_await mutex.lock_async();
+			}
+			items.push_back(value);
+			// Pass the signal on if there is still room, as the event only
+			// remembers a single set().
+			const bool hasRoom = items.size() < queue_capacity;
+			mutex.unlock();
+			notEmpty.set();
+			if (hasRoom)
+			{
+				notFull.set();
+			}
+		}
+
+		task<std::uint64_t> pop()
+		{
+			co_await mutex.lock_async();
+			while (items.empty())
+			{
+				mutex.unlock();
+				co_await notEmpty;
+				co_await mutex.lock_async();
+			}
+			const auto value = items.front();
+			items.pop_front();
+			const bool hasMore = !items.empty();
+			mutex.unlock();
+			notFull.set();
+			if (hasMore)
+			{
+				notEmpty.set();
+			}
+			co_return value;
+		}
+	};
+
+	template<typename QUEUE>
+	std::uint64_t run_producers_and_consumers(
+		static_thread_pool& threadPool,
+		QUEUE& queue,
+		int producerCount,
+		int consumerCount,
+		int itemsPerProducer)
+	{
+		std::atomic<std::uint64_t> sum = 0;
+
+		auto producer = [&]() -> task<>
+		{
+			co_await threadPool.schedule();
+			for (int i = 1; i <= itemsPerProducer; ++i)
+			{
+				co_await queue.push(static_cast<std::uint64_t>(i));
+				if (i % 1024 == 0)
+				{
+					co_await threadPool.schedule();
+				}
+			}
+		};
+
+		auto consumer = [&](int count) -> task<>
+		{
+			co_await threadPool.schedule();
+			std::uint64_t localSum = 0;
+			for (int i = 1; i <= count; ++i)
+			{
+				localSum += co_await queue.pop();
+				if (i % 1024 == 0)
+				{
+					co_await threadPool.schedule();
+				}
+			}
+			sum += localSum;
+		};
+
+		const int itemCount = producerCount * itemsPerProducer;
+		std::vector<task<>> tasks;
+		for (int i = 0; i < producerCount; ++i)
+		{
+			tasks.push_back(producer());
+		}
+		for (int i = 0; i < consumerCount; ++i)
+		{
+			tasks.push_back(consumer(itemCount / consumerCount + (i < itemCount % consumerCount ? 1 : 0)));
+		}
+		sync_wait(when_all(std::move(tasks)));
+
+		return sum.load();
+	}
+}
+
+TEST_CASE("bounded queue with multiple producers and consumers")
+{
+	static_thread_pool threadPool{ 4 };
+	cv_queue queue;
+
+	constexpr int itemsPerProducer = 10000;
+	const auto sum = run_producers_and_consumers(threadPool, queue, 4, 3, itemsPerProducer);
+
+	CHECK(sum == 4ull * itemsPerProducer * (itemsPerProducer + 1) / 2);
+	CHECK(queue.items.empty());
+}
+
+TEST_CASE("condition variable vs auto-reset event throughput")
+{
+	using clock = std::chrono::steady_clock;
+
+	static_thread_pool threadPool{ 4 };
+
+	constexpr int itemsPerProducer = 50000;
+
+	for (int threads : { 1, 4 })
+	{
+		const auto expected = static_cast<std::uint64_t>(threads) * itemsPerProducer * (itemsPerProducer + 1) / 2;
+
+		auto start = clock::now();
+		{
+			cv_queue queue;
+			CHECK(run_producers_and_consumers(threadPool, queue, threads, threads, itemsPerProducer) == expected);
+		}
+		const auto cvElapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+		start = clock::now();
+		{
+			event_queue queue;
+			CHECK(run_producers_and_consumers(threadPool, queue, threads, threads, itemsPerProducer) == expected);
+		}
+		const auto eventElapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+		const double itemCount = static_cast<double>(threads) * itemsPerProducer;
+		MESSAGE(
+			threads << " producers/" << threads << " consumers: "
+			<< "condition variable " << itemCount / cvElapsed << " items/s, "
+			<< "auto-reset events " << itemCount / eventElapsed << " items/s");
+	}
+}
+
+TEST_SUITE_END();
@@ -4,6 +4,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <cppcoro/async_generator.hpp>
+#include <cppcoro/recycling_allocator.hpp>
 #include <cppcoro/single_consumer_event.hpp>
 #include <cppcoro/task.hpp>
 #include <cppcoro/sync_wait.hpp>
@@ -327,4 +328,37 @@ TEST_CASE("fmap")
 	}());
 }
 
+TEST_CASE("async_generator frame is allocated with the allocator passed after std::allocator_arg")
+{
+	cppcoro::recycling_pool pool;
+
+	auto count_to = [](std::allocator_arg_t, cppcoro::recycling_allocator<char>, int n)
+		-> cppcoro::async_generator<int>
+	{
+		for (int i = 1; i <= n; ++i)
+		{
+			co_yield i;
+		}
+	};
+
+	cppcoro::sync_wait([&]() -> cppcoro::task<>
+	{
+		for (int round = 0; round < 3; ++round)
+		{
+			auto gen = count_to(std::allocator_arg, cppcoro::recycling_allocator<char>{ pool }, 3);
+			CHECK(pool.free_block_count() == 0);
+
+			int sum = 0;
+			for (auto it = co_await gen.begin(); it != gen.end(); co_await ++it)
+			{
+				sum += *it;
+			}
+			CHECK(sum == 6);
+		}
+	}());
+
+	// Every round reused the frame the first one freed.
+	CHECK(pool.free_block_count() == 1);
+}
+
 TEST_SUITE_END();
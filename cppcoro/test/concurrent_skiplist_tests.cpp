@@ -0,0 +1,261 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/concurrent_skiplist.hpp>
+#include <cppcoro/sync_wait.hpp>
+#include <cppcoro/task.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("concurrent_skiplist");
+
+using cppcoro::concurrent_skiplist;
+
+namespace
+{
+	using int_skiplist = concurrent_skiplist<std::uint64_t, std::uint64_t>;
+
+	// Run a scan to completion, returning the keys and the size of each
+	// batch.
+	std::pair<std::vector<std::uint64_t>, std::vector<std::size_t>> scan_keys(
+		cppcoro::async_generator<std::span<const int_skiplist::value_type>> scan)
+	{
+		return cppcoro::sync_wait([&]() -> cppcoro::task<
+			std::pair<std::vector<std::uint64_t>, std::vector<std::size_t>>>
+		{
+			std::vector<std::uint64_t> keys;
+			std::vector<std::size_t> batchSizes;
+			auto it = co_await scan.begin();
+			while (it != scan.end())
+			{
+				batchSizes.push_back((*it).size());
+				for (auto& entry : *it)
+				{
+					keys.push_back(entry.first);
+				}
+				co_await ++it;
+			}
+			co_return std::pair{ std::move(keys), std::move(batchSizes) };
+		}());
+	}
+
+	std::uint64_t mix(std::uint64_t x)
+	{
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdULL;
+		x ^= x >> 33;
+		return x;
+	}
+}
+
+TEST_CASE("insert and find")
+{
+	concurrent_skiplist<std::string, int> skiplist;
+	CHECK(skiplist.size() == 0);
+	CHECK(skiplist.find("b") == nullptr);
+
+	CHECK(skiplist.insert("b", 2));
+	CHECK(skiplist.insert("a", 1));
+	CHECK(skiplist.insert("c", 3));
+	CHECK(!skiplist.insert("b", 4));
+	CHECK(skiplist.size() == 3);
+
+	REQUIRE(skiplist.find("b") != nullptr);
+	CHECK(*skiplist.find("b") == 2);
+	CHECK(skiplist.contains("a"));
+	CHECK(!skiplist.contains("d"));
+}
+
+TEST_CASE("scan yields a range in order, in batches")
+{
+	int_skiplist skiplist;
+	for (std::uint64_t i = 0; i < 1000; ++i)
+	{
+		const std::uint64_t key = mix(i) % 100000;
+		skiplist.insert(key, key * 10);
+	}
+
+	auto [allKeys, allBatches] = scan_keys(skiplist.scan(0, 100000));
+	CHECK(allKeys.size() == skiplist.size());
+	CHECK(std::is_sorted(allKeys.begin(), allKeys.end()));
+	CHECK(std::adjacent_find(allKeys.begin(), allKeys.end()) == allKeys.end());
+
+	for (std::uint64_t key : allKeys)
+	{
+		REQUIRE(skiplist.find(key) != nullptr);
+		CHECK(*skiplist.find(key) == key * 10);
+	}
+
+	auto [keys, batches] = scan_keys(skiplist.scan(25000, 75000, 16));
+	std::vector<std::uint64_t> expected;
+	std::copy_if(
+		allKeys.begin(), allKeys.end(), std::back_inserter(expected),
+		[](std::uint64_t key) { return key >= 25000 && key < 75000; });
+	CHECK(keys == expected);
+
+	REQUIRE(!batches.empty());
+	CHECK(std::all_of(batches.begin(), batches.end() - 1, [](std::size_t size) { return size == 16; }));
+	CHECK(batches.back() <= 16);
+
+	CHECK(scan_keys(skiplist.scan(100000, 200000)).first.empty());
+}
+
+TEST_CASE("scan sees a snapshot of the skiplist when it was started")
+{
+	int_skiplist skiplist;
+	for (std::uint64_t key = 0; key < 100; key += 2)
+	{
+		skiplist.insert(key, key * 10);
+	}
+
+	auto scan = skiplist.scan(0, 100, 4);
+	skiplist.insert(1, 10);
+
+	auto keys = cppcoro::sync_wait([&]() -> cppcoro::task<std::vector<std::uint64_t>>
+	{
+		std::vector<std::uint64_t> keys;
+		auto it = co_await scan.begin();
+		while (it != scan.end())
+		{
+			for (auto& entry : *it)
+			{
+				keys.push_back(entry.first);
+			}
+
+			// Inserted between batches, both ahead of and behind the scan.
+			skiplist.insert(keys.back() + 1, (keys.back() + 1) * 10);
+			co_await ++it;
+		}
+		co_return keys;
+	}());
+
+	CHECK(keys.size() == 50);
+	CHECK(std::all_of(keys.begin(), keys.end(), [](std::uint64_t key) { return key % 2 == 0; }));
+
+	// A new scan sees them.
+	CHECK(scan_keys(skiplist.scan(0, 100)).first.size() == 50 + 1 + 13);
+}
+
+TEST_CASE("concurrent inserts and scans")
+{
+	int_skiplist skiplist;
+
+	constexpr std::uint64_t threadCount = 4;
+	constexpr std::uint64_t keysPerThread = 5000;
+
+	// Keys present before the scans start, which every scan must see.
+	for (std::uint64_t key = 0; key < threadCount * keysPerThread * 2; key += 2)
+	{
+		skiplist.insert(key, key * 10);
+	}
+
+	std::atomic<bool> scansOk = true;
+	std::atomic<int> insertersRunning = threadCount;
+	std::vector<std::thread> threads;
+	for (std::uint64_t t = 0; t < threadCount; ++t)
+	{
+		threads.emplace_back([&, t]
+		{
+			// Odd keys, with each thread taking a different share and
+			// repeating some of another thread's.
+			for (std::uint64_t i = 0; i < keysPerThread; ++i)
+			{
+				const std::uint64_t key = ((t * keysPerThread + i * 7) % (threadCount * keysPerThread)) * 2 + 1;
+				skiplist.insert(key, key * 10);
+			}
+			--insertersRunning;
+		});
+	}
+	threads.emplace_back([&]
+	{
+		do
+		{
+			auto keys = scan_keys(skiplist.scan(0, threadCount * keysPerThread * 2)).first;
+			const auto evenCount = std::count_if(
+				keys.begin(), keys.end(), [](std::uint64_t key) { return key % 2 == 0; });
+			if (!std::is_sorted(keys.begin(), keys.end()) ||
+				evenCount != static_cast<std::ptrdiff_t>(threadCount * keysPerThread))
+			{
+				scansOk = false;
+			}
+		} while (insertersRunning.load() != 0);
+	});
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	CHECK(scansOk);
+
+	auto keys = scan_keys(skiplist.scan(0, threadCount * keysPerThread * 2)).first;
+	CHECK(keys.size() == skiplist.size());
+	CHECK(std::is_sorted(keys.begin(), keys.end()));
+	CHECK(std::adjacent_find(keys.begin(), keys.end()) == keys.end());
+	for (std::uint64_t key = 0; key < threadCount * keysPerThread * 2; key += 2)
+	{
+		REQUIRE(skiplist.find(key) != nullptr);
+	}
+}
+
+TEST_CASE("concurrent_skiplist insert and scan throughput")
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr std::uint64_t totalInserts = 400000;
+
+	for (std::uint64_t threadCount : { 1, 4, 16, 64 })
+	{
+		int_skiplist skiplist;
+
+		auto runThreads = [&](auto body)
+		{
+			const auto start = clock::now();
+			std::vector<std::thread> threads;
+			for (std::uint64_t t = 0; t < threadCount; ++t)
+			{
+				threads.emplace_back(body, t);
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+			return std::chrono::duration<double>(clock::now() - start).count();
+		};
+
+		const double insertSeconds = runThreads([&](std::uint64_t t)
+		{
+			for (std::uint64_t i = t; i < totalInserts; i += threadCount)
+			{
+				const std::uint64_t key = mix(i);
+				skiplist.insert(key, key * 10);
+			}
+		});
+
+		// Each thread scans a different slice of the key space.
+		std::atomic<std::uint64_t> scanned = 0;
+		const double scanSeconds = runThreads([&](std::uint64_t t)
+		{
+			const std::uint64_t slice = UINT64_MAX / threadCount;
+			auto keys = scan_keys(skiplist.scan(t * slice, (t + 1) * slice)).first;
+			scanned += keys.size();
+		});
+
+		MESSAGE(
+			threadCount << " threads: "
+			<< insertSeconds * 1e9 / totalInserts << " ns per insert, "
+			<< scanSeconds * 1e9 / static_cast<double>(scanned.load()) << " ns per scanned entry");
+	}
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,314 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/net/connect_any.hpp>
+#include <cppcoro/net/endpoint_health_cache.hpp>
+#include <cppcoro/net/socket.hpp>
+#include <cppcoro/cancellation_source.hpp>
+#include <cppcoro/operation_cancelled.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/sync_wait.hpp>
+
+#include "io_service_fixture.hpp"
+
+#include <chrono>
+#include <system_error>
+#include <vector>
+
+#include "doctest/doctest.h"
+
+using namespace cppcoro;
+using namespace cppcoro::net;
+using namespace std::chrono_literals;
+
+TEST_SUITE_BEGIN("connect_any");
+
+namespace
+{
+	using clock = std::chrono::steady_clock;
+
+	ipv4_endpoint loopback_any_port()
+	{
+		return ipv4_endpoint{ ipv4_address::loopback(), 0 };
+	}
+
+	/// An end-point that accepts connections.
+	struct listening_endpoint
+	{
+		explicit listening_endpoint(io_service& ioSvc)
+			: m_socket(net::socket::create_tcpv4(ioSvc))
+		{
+			m_socket.bind(loopback_any_port());
+			m_socket.listen();
+		}
+
+		ip_endpoint endpoint() const { return m_socket.local_endpoint(); }
+
+		net::socket m_socket;
+	};
+
+	/// An end-point that refuses connections: bound, but not listening.
+	struct refusing_endpoint
+	{
+		explicit refusing_endpoint(io_service& ioSvc)
+			: m_socket(net::socket::create_tcpv4(ioSvc))
+		{
+			m_socket.bind(loopback_any_port());
+		}
+
+		ip_endpoint endpoint() const { return m_socket.local_endpoint(); }
+
+		net::socket m_socket;
+	};
+
+#if CPPCORO_OS_LINUX
+	/// An end-point that never answers.
+	///
+	/// Linux drops SYNs to a listening socket whose accept queue is full, so
+	/// once the single connection a backlog of 0 allows has been queued any
+	/// further connects hang until they time out.
+	struct blackholed_endpoint
+	{
+		explicit blackholed_endpoint(io_service& ioSvc, bool ipv6 = false)
+			: m_listener(ipv6 ? net::socket::create_tcpv6(ioSvc) : net::socket::create_tcpv4(ioSvc))
+			, m_filler(ipv6 ? net::socket::create_tcpv6(ioSvc) : net::socket::create_tcpv4(ioSvc))
+		{
+			if (ipv6)
+			{
+				m_listener.bind(ipv6_endpoint{ ipv6_address::loopback(), 0 });
+				m_filler.bind(ipv6_endpoint{});
+			}
+			else
+			{
+				m_listener.bind(loopback_any_port());
+				m_filler.bind(ipv4_endpoint{});
+			}
+			m_listener.listen(0);
+			sync_wait(m_filler.connect(m_listener.local_endpoint()));
+		}
+
+		ip_endpoint endpoint() const { return m_listener.local_endpoint(); }
+
+		net::socket m_listener;
+		net::socket m_filler;
+	};
+#endif
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "connects to the only end-point")
+{
+	listening_endpoint server{ io_service() };
+	const std::vector<ip_endpoint> endPoints{ server.endpoint() };
+
+	auto s = sync_wait(connect_any(io_service(), endPoints));
+	CHECK(s.remote_endpoint() == server.endpoint());
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "refused end-point falls through without waiting for the stagger delay")
+{
+	refusing_endpoint refused{ io_service() };
+	listening_endpoint server{ io_service() };
+	const std::vector<ip_endpoint> endPoints{ refused.endpoint(), server.endpoint() };
+
+	const auto start = clock::now();
+	auto s = sync_wait(connect_any(io_service(), endPoints, 10s));
+	CHECK(s.remote_endpoint() == server.endpoint());
+	CHECK(clock::now() - start < 5s);
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "fails with the last error when all end-points fail")
+{
+	refusing_endpoint refused1{ io_service() };
+	refusing_endpoint refused2{ io_service() };
+	const std::vector<ip_endpoint> endPoints{ refused1.endpoint(), refused2.endpoint() };
+
+	CHECK_THROWS_AS(sync_wait(connect_any(io_service(), endPoints, 10s)), const std::system_error&);
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "no end-points")
+{
+	CHECK_THROWS_AS(
+		sync_wait(connect_any(io_service(), std::span<const ip_endpoint>{})),
+		const std::system_error&);
+}
+
+#if CPPCORO_OS_LINUX
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "blackholed end-point delays the connection by the stagger delay")
+{
+	blackholed_endpoint blackhole{ io_service() };
+	listening_endpoint server{ io_service() };
+	const std::vector<ip_endpoint> endPoints{ blackhole.endpoint(), server.endpoint() };
+
+	const auto start = clock::now();
+	auto s = sync_wait(connect_any(io_service(), endPoints, 50ms));
+	const auto elapsed = clock::now() - start;
+
+	CHECK(s.remote_endpoint() == server.endpoint());
+	CHECK(elapsed >= 50ms);
+	CHECK(elapsed < 1s);
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "cancellation stops all attempts")
+{
+	blackholed_endpoint blackhole1{ io_service() };
+	blackholed_endpoint blackhole2{ io_service() };
+	const std::vector<ip_endpoint> endPoints{ blackhole1.endpoint(), blackhole2.endpoint() };
+
+	cancellation_source canceller;
+	const auto start = clock::now();
+
+	CHECK_THROWS_AS(
+		sync_wait(when_all(
+			connect_any(io_service(), endPoints, 10ms, canceller.token()),
+			[&]() -> task<>
+			{
+				co_await io_service().schedule_after(50ms);
+				canceller.request_cancellation();
+			}())),
+		const operation_cancelled&);
+
+	CHECK(clock::now() - start < 1s);
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "health cache tries the last good end-point first")
+{
+	blackholed_endpoint blackhole{ io_service() };
+	listening_endpoint server{ io_service() };
+	const std::vector<ip_endpoint> endPoints{ blackhole.endpoint(), server.endpoint() };
+
+	endpoint_health_cache cache;
+
+	auto first = sync_wait(connect_any(io_service(), endPoints, cache, 200ms));
+	CHECK(first.remote_endpoint() == server.endpoint());
+	CHECK(cache.latency(server.endpoint()).has_value());
+
+	// The blackholed end-point was cancelled rather than failing, so it is
+	// not penalised, but the known-good end-point now goes first.
+	CHECK(!cache.latency(blackhole.endpoint()).has_value());
+
+	const auto start = clock::now();
+	auto second = sync_wait(connect_any(io_service(), endPoints, cache, 200ms));
+	CHECK(second.remote_endpoint() == server.endpoint());
+	CHECK(clock::now() - start < 200ms);
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "health cache tries a failed end-point after healthy ones of both families")
+{
+	blackholed_endpoint healthyV4{ io_service() };
+	blackholed_endpoint healthyV6{ io_service(), true };
+	blackholed_endpoint slowerHealthyV6{ io_service(), true };
+	listening_endpoint server{ io_service() };
+	const std::vector<ip_endpoint> endPoints{
+		server.endpoint(), healthyV4.endpoint(), healthyV6.endpoint(), slowerHealthyV6.endpoint()
+	};
+
+	endpoint_health_cache cache;
+	cache.record_success(healthyV4.endpoint(), 10ms);
+	cache.record_success(healthyV6.endpoint(), 20ms);
+	cache.record_success(slowerHealthyV6.endpoint(), 30ms);
+	cache.record_failure(server.endpoint());
+
+	// Interleaving families after ordering by health would try the failed
+	// IPv4 end-point before the slower IPv6 one. Since the healthy ones
+	// never answer, the failed one is only tried after a stagger delay each.
+	constexpr auto stagger = 100ms;
+	const auto start = clock::now();
+	auto s = sync_wait(connect_any(io_service(), endPoints, cache, stagger));
+	CHECK(s.remote_endpoint() == server.endpoint());
+	CHECK(clock::now() - start >= 3 * stagger);
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "connect latency with a blackholed end-point")
+{
+	blackholed_endpoint blackhole{ io_service() };
+	listening_endpoint server{ io_service() };
+	const std::vector<ip_endpoint> endPoints{ blackhole.endpoint(), server.endpoint() };
+
+	constexpr int connectCount = 10;
+	constexpr auto stagger = 50ms;
+
+	auto averageMilliseconds = [&](auto connect)
+	{
+		const auto start = clock::now();
+		for (int i = 0; i < connectCount; ++i)
+		{
+			auto s = sync_wait(connect());
+			CHECK(s.remote_endpoint() == server.endpoint());
+		}
+		return std::chrono::duration<double, std::milli>(clock::now() - start).count() / connectCount;
+	};
+
+	const double withoutCache = averageMilliseconds([&]
+	{
+		return connect_any(io_service(), endPoints, stagger);
+	});
+
+	endpoint_health_cache cache;
+	const double withCache = averageMilliseconds([&]
+	{
+		return connect_any(io_service(), endPoints, cache, stagger);
+	});
+
+	MESSAGE(
+		"average connect time with the first end-point blackholed and a "
+		<< stagger.count() << "ms stagger: "
+		<< withoutCache << "ms without health cache, "
+		<< withCache << "ms with health cache");
+}
+
+#endif
+
+TEST_CASE("endpoint_health_cache orders healthy, unknown then failed end-points")
+{
+	const ip_endpoint a = ipv4_endpoint{ ipv4_address::loopback(), 1 };
+	const ip_endpoint b = ipv4_endpoint{ ipv4_address::loopback(), 2 };
+	const ip_endpoint c = ipv4_endpoint{ ipv4_address::loopback(), 3 };
+	const ip_endpoint d = ipv4_endpoint{ ipv4_address::loopback(), 4 };
+	const ip_endpoint e = ipv4_endpoint{ ipv4_address::loopback(), 5 };
+
+	endpoint_health_cache cache;
+	cache.record_failure(a);
+	cache.record_success(b, 20ms);
+	cache.record_success(d, 10ms);
+
+	std::vector<ip_endpoint> endPoints{ a, b, c, d, e };
+	cache.order(endPoints);
+	CHECK(endPoints == std::vector<ip_endpoint>{ d, b, c, e, a });
+
+	// A success after a failure makes the end-point healthy again.
+	cache.record_success(a, 5ms);
+	cache.order(endPoints);
+	CHECK(endPoints.front() == a);
+}
+
+TEST_CASE("endpoint_health_cache smooths latency and forgives failures")
+{
+	const ip_endpoint a = ipv4_endpoint{ ipv4_address::loopback(), 1 };
+	const ip_endpoint b = ipv4_endpoint{ ipv4_address::loopback(), 2 };
+
+	{
+		endpoint_health_cache cache;
+		cache.record_success(a, 80ms);
+		cache.record_success(a, 160ms);
+		CHECK(cache.latency(a) == endpoint_health_cache::clock::duration{ 90ms });
+		CHECK(!cache.latency(b).has_value());
+
+		cache.clear();
+		CHECK(!cache.latency(a).has_value());
+	}
+
+	{
+		endpoint_health_cache cache{ 0ms };
+		cache.record_failure(a);
+
+		std::vector<ip_endpoint> endPoints{ a, b };
+		cache.order(endPoints);
+		CHECK(endPoints == std::vector<ip_endpoint>{ a, b });
+	}
+}
+
+TEST_SUITE_END();
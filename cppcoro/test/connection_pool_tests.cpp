@@ -0,0 +1,339 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/net/connection_pool.hpp>
+#include <cppcoro/net/socket.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/sync_wait.hpp>
+#include <cppcoro/on_scope_exit.hpp>
+#include <cppcoro/cancellation_source.hpp>
+#include <cppcoro/cancellation_token.hpp>
+#include <cppcoro/async_scope.hpp>
+
+#include "io_service_fixture.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "doctest/doctest.h"
+
+using namespace cppcoro;
+using namespace cppcoro::net;
+using namespace std::chrono_literals;
+
+TEST_SUITE_BEGIN("connection_pool");
+
+namespace
+{
+	/// Loopback server that echoes back each byte it receives.
+	///
+	/// Closes the connection after echoing an 'x'.
+	struct echo_server
+	{
+		explicit echo_server(io_service& ioSvc)
+			: m_ioSvc(ioSvc)
+			, m_listeningSocket(socket::create_tcpv4(ioSvc))
+			, m_acceptCount(0)
+		{
+			m_listeningSocket.bind(ipv4_endpoint{ ipv4_address::loopback(), 0 });
+			m_listeningSocket.listen(64);
+		}
+
+		ip_endpoint endpoint() const { return m_listeningSocket.local_endpoint(); }
+
+		task<> serve(cancellation_token ct)
+		{
+			async_scope connectionScope;
+
+			try
+			{
+				while (true)
+				{
+					auto acceptingSocket = socket::create_tcpv4(m_ioSvc);
+					co_await m_listeningSocket.accept(acceptingSocket, ct);
+					++m_acceptCount;
+					connectionScope.spawn(handle_connection(std::move(acceptingSocket)));
+				}
+			}
+			catch (const operation_cancelled&)
+			{
+			}
+
+			co_await connectionScope.join();
+		}
+
+		static task<> handle_connection(socket s)
+		{
+			std::uint8_t buffer[64];
+			std::size_t bytesReceived;
+			bool closeRequested = false;
+			do
+			{
+				bytesReceived = co_await s.recv(buffer, sizeof(buffer));
+				std::size_t bytesSent = 0;
+				while (bytesSent < bytesReceived)
+				{
+					bytesSent += co_await s.send(buffer + bytesSent, bytesReceived - bytesSent);
+				}
+
+				for (std::size_t i = 0; i < bytesReceived; ++i)
+				{
+					closeRequested |= buffer[i] == 'x';
+				}
+			} while (bytesReceived > 0 && !closeRequested);
+
+			s.close_send();
+		}
+
+		io_service& m_ioSvc;
+		socket m_listeningSocket;
+		std::atomic<int> m_acceptCount;
+	};
+
+	task<char> round_trip(socket& s, char request)
+	{
+		std::size_t bytesSent = 0;
+		while (bytesSent == 0)
+		{
+			bytesSent = co_await s.send(&request, 1);
+		}
+
+		char response = 0;
+		const std::size_t bytesReceived = co_await s.recv(&response, 1);
+		CHECK(bytesReceived == 1);
+		co_return response;
+	}
+
+	/// Run \p clientTask against \p server, shutting the server down once
+	/// the client has finished.
+	void run_with_server(echo_server& server, task<> clientTask)
+	{
+		cancellation_source canceller;
+		sync_wait(when_all(
+			server.serve(canceller.token()),
+			[&]() -> task<>
+			{
+				auto stopServerOnExit = on_scope_exit([&] { canceller.request_cancellation(); });
+				co_await std::move(clientTask);
+			}()));
+	}
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "reuses idle connection")
+{
+	echo_server server{ io_service() };
+
+	auto client = [&]() -> task<>
+	{
+		connection_pool pool{ io_service(), server.endpoint(), 2 };
+
+		ip_endpoint firstLocalEndPoint;
+		{
+			auto lease = co_await pool.acquire();
+			CHECK(co_await round_trip(lease.socket(), 'a') == 'a');
+			firstLocalEndPoint = lease->local_endpoint();
+		}
+
+		CHECK(pool.idle_count() == 1);
+
+		{
+			auto lease = co_await pool.acquire();
+			CHECK(pool.idle_count() == 0);
+			CHECK(lease->local_endpoint() == firstLocalEndPoint);
+			CHECK(co_await round_trip(lease.socket(), 'b') == 'b');
+		}
+
+		CHECK(pool.connection_count() == 1);
+		CHECK(server.m_acceptCount == 1);
+	};
+
+	run_with_server(server, client());
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "waiters are served in FIFO order")
+{
+	echo_server server{ io_service() };
+
+	auto client = [&]() -> task<>
+	{
+		connection_pool pool{ io_service(), server.endpoint(), 1 };
+
+		auto lease = co_await pool.acquire();
+
+		std::vector<int> order;
+
+		auto waiter = [&](int id) -> task<>
+		{
+			auto waiterLease = co_await pool.acquire();
+			order.push_back(id);
+			CHECK(co_await round_trip(waiterLease.socket(), 'w') == 'w');
+		};
+
+		co_await when_all(
+			waiter(0),
+			waiter(1),
+			waiter(2),
+			[&]() -> task<>
+			{
+				// All three waiters should be suspended by now.
+				CHECK(order.empty());
+				CHECK(pool.connection_count() == 1);
+				lease.release();
+				co_return;
+			}());
+
+		CHECK(order == std::vector<int>{ 0, 1, 2 });
+		CHECK(pool.connection_count() == 1);
+		CHECK(server.m_acceptCount == 1);
+	};
+
+	run_with_server(server, client());
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "discarded connection frees its slot")
+{
+	echo_server server{ io_service() };
+
+	auto client = [&]() -> task<>
+	{
+		connection_pool pool{ io_service(), server.endpoint(), 1 };
+
+		auto lease = co_await pool.acquire();
+
+		co_await when_all(
+			[&]() -> task<>
+			{
+				auto waiterLease = co_await pool.acquire();
+				CHECK(co_await round_trip(waiterLease.socket(), 'c') == 'c');
+			}(),
+			[&]() -> task<>
+			{
+				lease.discard();
+				CHECK(!lease);
+				co_return;
+			}());
+
+		CHECK(pool.connection_count() == 1);
+		CHECK(server.m_acceptCount == 2);
+	};
+
+	run_with_server(server, client());
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "replaces connection closed by peer")
+{
+	echo_server server{ io_service() };
+
+	auto client = [&]() -> task<>
+	{
+		connection_pool pool{ io_service(), server.endpoint(), 1 };
+
+		{
+			auto lease = co_await pool.acquire();
+
+			// Server closes the connection after echoing 'x'.
+			CHECK(co_await round_trip(lease.socket(), 'x') == 'x');
+		}
+
+		// Give the FIN time to arrive.
+		co_await io_service().schedule_after(50ms);
+
+		{
+			auto lease = co_await pool.acquire();
+			CHECK(co_await round_trip(lease.socket(), 'd') == 'd');
+		}
+
+		CHECK(pool.connection_count() == 1);
+		CHECK(server.m_acceptCount == 2);
+	};
+
+	run_with_server(server, client());
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "evicts idle connections")
+{
+	echo_server server{ io_service() };
+
+	auto client = [&]() -> task<>
+	{
+		connection_pool pool{ io_service(), server.endpoint(), 2, 10ms };
+
+		{
+			auto lease1 = co_await pool.acquire();
+			auto lease2 = co_await pool.acquire();
+		}
+
+		CHECK(pool.idle_count() == 2);
+		CHECK(pool.evict_idle() == 0);
+
+		co_await io_service().schedule_after(30ms);
+
+		CHECK(pool.evict_idle() == 2);
+		CHECK(pool.connection_count() == 0);
+
+		{
+			auto lease = co_await pool.acquire();
+			CHECK(co_await round_trip(lease.socket(), 'e') == 'e');
+		}
+
+		CHECK(server.m_acceptCount == 3);
+	};
+
+	run_with_server(server, client());
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "latency vs connect per request")
+{
+	echo_server server{ io_service() };
+
+	constexpr int requestCount = 500;
+
+	auto connectPerRequest = [&]() -> task<>
+	{
+		for (int i = 0; i < requestCount; ++i)
+		{
+			auto s = socket::create_tcpv4(io_service());
+			s.bind(ipv4_endpoint{});
+			co_await s.connect(server.endpoint());
+			CHECK(co_await round_trip(s, 'p') == 'p');
+		}
+	};
+
+	auto pooled = [&]() -> task<>
+	{
+		connection_pool pool{ io_service(), server.endpoint(), 1 };
+		for (int i = 0; i < requestCount; ++i)
+		{
+			auto lease = co_await pool.acquire();
+			CHECK(co_await round_trip(lease.socket(), 'p') == 'p');
+		}
+	};
+
+	auto client = [&]() -> task<>
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		co_await connectPerRequest();
+		auto mid = std::chrono::high_resolution_clock::now();
+		co_await pooled();
+		auto end = std::chrono::high_resolution_clock::now();
+
+		using std::chrono::duration_cast;
+		using std::chrono::microseconds;
+		MESSAGE(
+			requestCount << " requests, connect per request: "
+			<< duration_cast<microseconds>(mid - start).count() / requestCount
+			<< "us/request, pooled: "
+			<< duration_cast<microseconds>(end - mid).count() / requestCount
+			<< "us/request");
+
+		CHECK(server.m_acceptCount == requestCount + 1);
+	};
+
+	run_with_server(server, client());
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,219 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/epoch_domain.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("epoch_domain");
+
+using cppcoro::epoch_domain;
+
+namespace
+{
+	std::atomic<int> freedCount{ 0 };
+
+	void count_free(void*) noexcept
+	{
+		freedCount.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+TEST_CASE("retired objects are freed once nobody is pinned")
+{
+	freedCount = 0;
+
+	epoch_domain domain;
+	epoch_domain::participant p{ domain };
+
+	for (int i = 0; i < 10; ++i)
+	{
+		p.retire(nullptr, count_free);
+	}
+	CHECK(freedCount == 0);
+
+	// Takes two epochs.
+	p.collect();
+	p.collect();
+	p.collect();
+	CHECK(freedCount == 10);
+}
+
+TEST_CASE("retired objects aren't freed while another participant is pinned")
+{
+	freedCount = 0;
+
+	epoch_domain domain;
+	epoch_domain::participant reader{ domain };
+	epoch_domain::participant writer{ domain };
+
+	{
+		auto pinned = reader.pin();
+		CHECK(reader.is_pinned());
+
+		for (int i = 0; i < 1000; ++i)
+		{
+			writer.retire(nullptr, count_free);
+			writer.collect();
+		}
+		CHECK(freedCount == 0);
+	}
+	CHECK(!reader.is_pinned());
+
+	writer.collect();
+	writer.collect();
+	writer.collect();
+	CHECK(freedCount == 1000);
+}
+
+TEST_CASE("pins nest")
+{
+	freedCount = 0;
+
+	epoch_domain domain;
+	epoch_domain::participant reader{ domain };
+	epoch_domain::participant writer{ domain };
+
+	auto outer = reader.pin();
+	{
+		auto inner = reader.pin();
+	}
+	CHECK(reader.is_pinned());
+
+	writer.retire(nullptr, count_free);
+	for (int i = 0; i < 10; ++i)
+	{
+		writer.collect();
+	}
+	CHECK(freedCount == 0);
+}
+
+TEST_CASE("objects retired by a destroyed participant are still freed")
+{
+	freedCount = 0;
+
+	{
+		epoch_domain domain;
+		epoch_domain::participant reader{ domain };
+		auto pinned = reader.pin();
+
+		{
+			epoch_domain::participant writer{ domain };
+			writer.retire(nullptr, count_free);
+		}
+
+		// Its record is reused.
+		epoch_domain::participant other{ domain };
+		other.collect();
+		CHECK(freedCount == 0);
+	}
+
+	CHECK(freedCount == 1);
+}
+
+TEST_CASE("readers never see a freed object")
+{
+	constexpr std::uint64_t live = 0x1111111111111111;
+	constexpr std::uint64_t dead = 0xdeaddeaddeaddead;
+
+	struct node
+	{
+		std::uint64_t m_value = live;
+	};
+
+	constexpr int readerCount = 3;
+	constexpr int replaceCount = 200000;
+
+	epoch_domain domain;
+	std::atomic<node*> shared{ new node };
+	std::atomic<bool> done{ false };
+	std::atomic<int> badReads{ 0 };
+
+	std::vector<std::thread> readers;
+	for (int i = 0; i < readerCount; ++i)
+	{
+		readers.emplace_back([&]
+		{
+			epoch_domain::participant participant{ domain };
+			while (!done.load(std::memory_order_relaxed))
+			{
+				auto pinned = participant.pin();
+				node* n = shared.load(std::memory_order_acquire);
+				if (n->m_value != live)
+				{
+					badReads.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+		});
+	}
+
+	{
+		epoch_domain::participant writer{ domain };
+		for (int i = 0; i < replaceCount; ++i)
+		{
+			node* old = shared.exchange(new node, std::memory_order_acq_rel);
+			writer.retire(old, [](void* p) noexcept
+			{
+				auto* n = static_cast<node*>(p);
+				n->m_value = dead;
+				delete n;
+			});
+		}
+
+		done = true;
+		for (auto& t : readers)
+		{
+			t.join();
+		}
+	}
+
+	delete shared.load();
+
+	CHECK(badReads == 0);
+	CHECK(domain.epoch() > 0);
+}
+
+TEST_CASE("epoch_domain retire throughput")
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr int threadCount = 4;
+	constexpr int retiresPerThread = 500000;
+
+	epoch_domain domain;
+
+	const auto start = clock::now();
+	std::vector<std::thread> threads;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		threads.emplace_back([&]
+		{
+			epoch_domain::participant participant{ domain };
+			for (int j = 0; j < retiresPerThread; ++j)
+			{
+				auto pinned = participant.pin();
+				participant.retire(new int{ j });
+			}
+		});
+	}
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+	const auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+	MESSAGE(
+		elapsed * 1e9 / (threadCount * retiresPerThread)
+		<< " ns per pin + new + retire, " << domain.epoch() << " epochs");
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,257 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/frame_arena.hpp>
+#include <cppcoro/async_manual_reset_event.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/when_all_ready.hpp>
+#include <cppcoro/sync_wait.hpp>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("frame_arena");
+
+using namespace cppcoro;
+
+namespace
+{
+	task<int> leaf(int value)
+	{
+		co_return value;
+	}
+
+	task<int> branch(int depth)
+	{
+		if (depth == 0)
+		{
+			co_return co_await leaf(1);
+		}
+
+		const int left = co_await branch(depth - 1);
+		const int right = co_await branch(depth - 1);
+		co_return left + right;
+	}
+
+	task<int> request(std::allocator_arg_t, frame_arena&, int depth)
+	{
+		co_return co_await branch(depth);
+	}
+}
+
+TEST_CASE("allocate returns aligned, distinct memory")
+{
+	frame_arena arena{ 256 };
+	CHECK(arena.bytes_allocated() == 0);
+
+	std::vector<char*> allocations;
+	for (int i = 1; i < 100; ++i)
+	{
+		auto* p = static_cast<char*>(arena.allocate(i));
+		CHECK(reinterpret_cast<std::uintptr_t>(p) % __STDCPP_DEFAULT_NEW_ALIGNMENT__ == 0);
+		std::fill(p, p + i, static_cast<char>(i));
+		allocations.push_back(p);
+	}
+
+	for (int i = 1; i < 100; ++i)
+	{
+		CHECK(allocations[i - 1][i - 1] == static_cast<char>(i));
+	}
+	CHECK(arena.bytes_allocated() >= 99 * 100 / 2);
+}
+
+TEST_CASE("child tasks inherit the arena of the task that creates them")
+{
+	frame_arena arena;
+
+	auto t = arena.invoke([] { return branch(0); });
+	CHECK(frame_arena::current_arena() == nullptr);
+	const auto topLevelBytes = arena.bytes_allocated();
+	CHECK(topLevelBytes > 0);
+
+	CHECK(sync_wait(t) == 1);
+	CHECK(arena.bytes_allocated() > topLevelBytes);
+	CHECK(frame_arena::current_arena() == nullptr);
+
+	// Tasks created outside the arena don't touch it.
+	const auto bytes = arena.bytes_allocated();
+	CHECK(sync_wait(branch(3)) == 8);
+	CHECK(arena.bytes_allocated() == bytes);
+}
+
+TEST_CASE("arena can be passed with std::allocator_arg")
+{
+	frame_arena arena;
+
+	CHECK(sync_wait(request(std::allocator_arg, arena, 2)) == 4);
+	CHECK(arena.bytes_allocated() > 0);
+	CHECK(frame_arena::current_arena() == nullptr);
+
+	frame_arena lambdaArena;
+	auto run = [](std::allocator_arg_t, frame_arena&) -> task<int>
+	{
+		co_return co_await branch(1);
+	};
+	CHECK(sync_wait(run(std::allocator_arg, lambdaArena)) == 2);
+	CHECK(lambdaArena.bytes_allocated() > 0);
+}
+
+TEST_CASE("arena follows the task onto thread pool threads")
+{
+	static_thread_pool threadPool{ 2 };
+	frame_arena arena;
+	frame_arena otherArena;
+
+	auto inArena = [&](frame_arena& expected) -> task<int>
+	{
+		co_await threadPool.schedule();
+		CHECK(frame_arena::current_arena() == &expected);
+		const int result = co_await branch(2);
+		co_await threadPool.schedule();
+		CHECK(frame_arena::current_arena() == &expected);
+		co_return result;
+	};
+
+	auto outsideArena = [&]() -> task<int>
+	{
+		co_await threadPool.schedule();
+		CHECK(frame_arena::current_arena() == nullptr);
+		co_return co_await branch(2);
+	};
+
+	auto a = arena.invoke([&] { return inArena(arena); });
+	auto b = otherArena.invoke([&] { return inArena(otherArena); });
+	const auto [x, y, z] = sync_wait(when_all(std::move(a), std::move(b), outsideArena()));
+	CHECK(x == 4);
+	CHECK(y == 4);
+	CHECK(z == 4);
+}
+
+TEST_CASE("arena is restored when another task is resumed inline")
+{
+	frame_arena arena;
+	async_manual_reset_event event;
+
+	auto waiter = [&]() -> task<>
+	{
+		co_await event;
+		CHECK(frame_arena::current_arena() == nullptr);
+	};
+
+	auto setter = [&]() -> task<>
+	{
+		CHECK(frame_arena::current_arena() == &arena);
+		event.set();
+		CHECK(frame_arena::current_arena() == &arena);
+		co_return;
+	};
+
+	auto s = arena.invoke(setter);
+	sync_wait(when_all_ready(waiter(), std::move(s)));
+	CHECK(frame_arena::current_arena() == nullptr);
+}
+
+TEST_CASE("when_all frames come from the arena")
+{
+	frame_arena arena;
+
+	auto fanOut = []() -> task<int>
+	{
+		std::vector<task<int>> children;
+		for (int i = 0; i < 8; ++i)
+		{
+			children.push_back(leaf(i));
+		}
+
+		int total = 0;
+		for (int value : co_await when_all(std::move(children)))
+		{
+			total += value;
+		}
+		co_return total;
+	};
+
+	auto t = arena.invoke(fanOut);
+	const auto topLevelBytes = arena.bytes_allocated();
+	CHECK(sync_wait(t) == 28);
+
+	// At least the 8 leaves and their 8 when_all frames.
+	CHECK(arena.bytes_allocated() > topLevelBytes + 16 * 32);
+}
+
+TEST_CASE("arena vs global heap per request")
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr int requestCount = 100000;
+
+	// Each request is a tree of about 30 task frames plus a when_all.
+	auto handle = []() -> task<int>
+	{
+		std::vector<task<int>> children;
+		for (int i = 0; i < 4; ++i)
+		{
+			children.push_back(branch(2));
+		}
+
+		int total = 0;
+		for (int value : co_await when_all(std::move(children)))
+		{
+			total += value;
+		}
+		co_return total;
+	};
+
+	// Batched, to amortise sync_wait() without synchronously completing an
+	// unbounded number of tasks in a row.
+	constexpr int batchSize = 100;
+
+	auto runOnHeap = [&]() -> task<int>
+	{
+		int total = 0;
+		for (int i = 0; i < batchSize; ++i)
+		{
+			total += co_await handle();
+		}
+		co_return total;
+	};
+
+	auto runInArenas = [&]() -> task<int>
+	{
+		int total = 0;
+		for (int i = 0; i < batchSize; ++i)
+		{
+			frame_arena arena{ 8 * 1024 };
+			total += co_await arena.invoke(handle);
+		}
+		co_return total;
+	};
+
+	auto start = clock::now();
+	for (int i = 0; i < requestCount; i += batchSize)
+	{
+		CHECK(sync_wait(runOnHeap()) == 16 * batchSize);
+	}
+	const auto heapElapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+	start = clock::now();
+	for (int i = 0; i < requestCount; i += batchSize)
+	{
+		CHECK(sync_wait(runInArenas()) == 16 * batchSize);
+	}
+	const auto arenaElapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+	MESSAGE(
+		"global heap " << heapElapsed * 1e9 / requestCount << " ns/request, "
+		<< "arena " << arenaElapsed * 1e9 / requestCount << " ns/request");
+}
+
+TEST_SUITE_END();
@@ -11,6 +11,7 @@
 #include <vector>
 #include <string>
 #include <forward_list>
+#include <memory>
 
 #include "doctest/doctest.h"
 
@@ -409,4 +410,110 @@ TEST_CASE("low_pass" * doctest::skip{ true })
 	}
 }
 
+namespace
+{
+	struct allocation_counts
+	{
+		int m_allocations = 0;
+		int m_deallocations = 0;
+	};
+
+	template<typename T>
+	class counting_allocator
+	{
+	public:
+
+		using value_type = T;
+
+		explicit counting_allocator(allocation_counts& counts) noexcept
+			: m_counts(&counts)
+		{}
+
+		template<typename U>
+		counting_allocator(const counting_allocator<U>& other) noexcept
+			: m_counts(other.m_counts)
+		{}
+
+		T* allocate(std::size_t count)
+		{
+			++m_counts->m_allocations;
+			return std::allocator<T>{}.allocate(count);
+		}
+
+		void deallocate(T* pointer, std::size_t count) noexcept
+		{
+			++m_counts->m_deallocations;
+			std::allocator<T>{}.deallocate(pointer, count);
+		}
+
+		template<typename U>
+		bool operator==(const counting_allocator<U>& other) const noexcept
+		{
+			return m_counts == other.m_counts;
+		}
+
+		template<typename U>
+		bool operator!=(const counting_allocator<U>& other) const noexcept
+		{
+			return m_counts != other.m_counts;
+		}
+
+	private:
+
+		template<typename U>
+		friend class counting_allocator;
+
+		allocation_counts* m_counts;
+
+	};
+}
+
+TEST_CASE("generator frame is allocated with the allocator passed after std::allocator_arg")
+{
+	allocation_counts counts;
+
+	auto count_to = [](std::allocator_arg_t, counting_allocator<int>, int n) -> generator<int>
+	{
+		for (int i = 1; i <= n; ++i)
+		{
+			co_yield i;
+		}
+	};
+
+	{
+		auto gen = count_to(std::allocator_arg, counting_allocator<int>{ counts }, 3);
+		CHECK(counts.m_allocations == 1);
+
+		int sum = 0;
+		for (int value : gen)
+		{
+			sum += value;
+		}
+		CHECK(sum == 6);
+		CHECK(counts.m_deallocations == 0);
+	}
+
+	CHECK(counts.m_allocations == 1);
+	CHECK(counts.m_deallocations == 1);
+}
+
+namespace
+{
+	generator<int> one_two(std::allocator_arg_t, std::allocator<char>)
+	{
+		co_yield 1;
+		co_yield 2;
+	}
+}
+
+TEST_CASE("generator can be allocated with a stateless allocator")
+{
+	auto gen = one_two(std::allocator_arg, {});
+	auto it = gen.begin();
+	CHECK(*it == 1);
+	CHECK(*++it == 2);
+	CHECK(++it == gen.end());
+}
+
+
 TEST_SUITE_END();
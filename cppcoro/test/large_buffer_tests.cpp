@@ -0,0 +1,166 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/large_buffer.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("large_buffer");
+
+using cppcoro::large_buffer;
+using cppcoro::large_buffer_backing;
+
+namespace
+{
+	const char* to_string(large_buffer_backing backing)
+	{
+		switch (backing)
+		{
+		case large_buffer_backing::heap: return "heap";
+		case large_buffer_backing::standard_pages: return "standard pages";
+		case large_buffer_backing::transparent_huge_pages: return "transparent huge pages";
+		case large_buffer_backing::huge_pages: return "huge pages";
+		}
+		return "?";
+	}
+
+	template<typename T>
+	bool all_zero(const large_buffer<T>& buffer)
+	{
+		for (const auto& element : buffer)
+		{
+			if (element != T{})
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+TEST_CASE("default constructed buffer is empty")
+{
+	large_buffer<int> buffer;
+	CHECK(buffer.size() == 0);
+	CHECK(buffer.data() == nullptr);
+	CHECK(buffer.begin() == buffer.end());
+}
+
+TEST_CASE("small buffers come from the heap")
+{
+	large_buffer<int> buffer{ 100 };
+	CHECK(buffer.size() == 100);
+	CHECK(buffer.backing() == large_buffer_backing::heap);
+	CHECK(all_zero(buffer));
+
+	buffer[99] = 7;
+	CHECK(buffer[99] == 7);
+}
+
+TEST_CASE("big buffers are mapped and value-initialised")
+{
+	large_buffer<std::uint64_t> buffer{ 128 * 1024 };
+	CHECK(buffer.backing() != large_buffer_backing::heap);
+	CHECK(reinterpret_cast<std::uintptr_t>(buffer.data()) % CPPCORO_CPU_CACHE_LINE == 0);
+	CHECK(all_zero(buffer));
+
+	for (std::size_t i = 0; i < buffer.size(); ++i)
+	{
+		buffer[i] = i;
+	}
+	CHECK(buffer[buffer.size() - 1] == buffer.size() - 1);
+}
+
+TEST_CASE("buffers of at least a huge page ask for huge pages")
+{
+	large_buffer<std::atomic<std::uint64_t>> buffer{ 1024 * 1024 };
+	CHECK(buffer.size() == 1024 * 1024);
+
+	// Which kind depends on how the system is configured.
+	MESSAGE("8 MiB buffer backed by " << to_string(buffer.backing()));
+
+	buffer[12345].store(1, std::memory_order_relaxed);
+	CHECK(buffer[12345].load(std::memory_order_relaxed) == 1);
+}
+
+TEST_CASE("buffer can prefer the current NUMA node")
+{
+	const int node = cppcoro::current_numa_node();
+
+	large_buffer<std::uint64_t> buffer{ 64 * 1024, node };
+
+	// Binding is best-effort, eg. it's not allowed in some containers.
+	CHECK((buffer.numa_node() == node || buffer.numa_node() == cppcoro::any_numa_node));
+	CHECK(all_zero(buffer));
+}
+
+TEST_CASE("moving a buffer transfers its memory")
+{
+	large_buffer<int> a{ 64 * 1024 };
+	a[10] = 10;
+	int* data = a.data();
+
+	large_buffer<int> b{ std::move(a) };
+	CHECK(a.size() == 0);
+	CHECK(b.data() == data);
+	CHECK(b[10] == 10);
+
+	large_buffer<int> c{ 10 };
+	c = std::move(b);
+	CHECK(b.size() == 0);
+	CHECK(c.data() == data);
+	CHECK(c.size() == 64 * 1024);
+}
+
+TEST_CASE("large_buffer random slot access throughput")
+{
+	using clock = std::chrono::steady_clock;
+
+	// Much larger than the reach of the TLB with 4K pages.
+	constexpr std::size_t slotCount = 16 * 1024 * 1024;
+	constexpr std::size_t accessCount = 20 * 1000 * 1000;
+
+	auto measure = [&](std::uint64_t* slots)
+	{
+		// Fault every page in first, so only the accesses are measured.
+		for (std::size_t i = 0; i < slotCount; i += 512)
+		{
+			slots[i] = i;
+		}
+
+		std::uint64_t index = 1;
+		std::uint64_t sum = 0;
+		const auto start = clock::now();
+		for (std::size_t i = 0; i < accessCount; ++i)
+		{
+			index = index * 6364136223846793005ULL + 1442695040888963407ULL;
+			sum += ++slots[(index >> 20) & (slotCount - 1)];
+		}
+		const auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+		CHECK(sum != 0);
+		return elapsed * 1e9 / accessCount;
+	};
+
+	auto plain = std::make_unique<std::uint64_t[]>(slotCount);
+	const double plainNs = measure(plain.get());
+	plain.reset();
+
+	large_buffer<std::uint64_t> buffer{ slotCount };
+	const double largeNs = measure(buffer.data());
+
+	MESSAGE(
+		plainNs << " ns per slot access with new[], "
+		<< largeNs << " ns with large_buffer (" << to_string(buffer.backing()) << ")");
+}
+
+TEST_SUITE_END();
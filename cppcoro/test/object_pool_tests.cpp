@@ -0,0 +1,241 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/object_pool.hpp>
+#include <cppcoro/async_manual_reset_event.hpp>
+#include <cppcoro/async_mutex.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/when_all_ready.hpp>
+#include <cppcoro/sync_wait.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("object_pool");
+
+using namespace cppcoro;
+
+TEST_CASE("objects are created up front and reused")
+{
+	static_thread_pool threadPool{ 2 };
+
+	int created = 0;
+	object_pool<std::vector<int>> pool{ threadPool, 3, [&] { ++created; return std::vector<int>{}; } };
+	CHECK(created == 3);
+	CHECK(pool.capacity() == 3);
+
+	auto run = [&]() -> task<>
+	{
+		co_await threadPool.schedule();
+		for (int i = 0; i < 100; ++i)
+		{
+			auto lease = co_await pool.acquire();
+			lease->push_back(i);
+		}
+	};
+	sync_wait(when_all(run(), run()));
+
+	CHECK(created == 3);
+
+	std::size_t total = 0;
+	std::vector<object_pool<std::vector<int>>::lease> leases;
+	for (int i = 0; i < 3; ++i)
+	{
+		leases.push_back(pool.try_acquire());
+		REQUIRE(leases.back());
+		total += leases.back()->size();
+	}
+	CHECK(total == 200);
+}
+
+TEST_CASE("try_acquire fails when every object is checked out")
+{
+	static_thread_pool threadPool{ 1 };
+	object_pool<int> pool{ threadPool, 2, [] { return 7; } };
+
+	auto a = pool.try_acquire();
+	auto b = pool.try_acquire();
+	REQUIRE(a);
+	REQUIRE(b);
+	CHECK(*a == 7);
+
+	auto c = pool.try_acquire();
+	CHECK(!c);
+	CHECK(c.get() == nullptr);
+
+	a.reset();
+	CHECK(!a);
+
+	c = pool.try_acquire();
+	CHECK(c);
+}
+
+TEST_CASE("acquire waits for an object to be released")
+{
+	static_thread_pool threadPool{ 1 };
+	object_pool<int> pool{ threadPool, 1, [] { return 0; } };
+	async_manual_reset_event release;
+	bool acquired = false;
+
+	auto holder = [&]() -> task<>
+	{
+		auto lease = co_await pool.acquire();
+		co_await release;
+	};
+
+	auto waiter = [&]() -> task<>
+	{
+		auto lease = co_await pool.acquire();
+		acquired = true;
+	};
+
+	auto releaser = [&]() -> task<>
+	{
+		CHECK(!acquired);
+		release.set();
+		CHECK(acquired);
+		co_return;
+	};
+
+	sync_wait(when_all_ready(holder(), waiter(), releaser()));
+	CHECK(acquired);
+}
+
+TEST_CASE("objects cached by idle threads are handed to waiters")
+{
+	static_thread_pool threadPool{ 4 };
+
+	constexpr std::size_t capacity = 3;
+	object_pool<int> pool{ threadPool, capacity, [] { return 0; }, 2 };
+
+	std::atomic<int> checkedOut = 0;
+	std::atomic<int> maxCheckedOut = 0;
+
+	auto worker = [&]() -> task<>
+	{
+		co_await threadPool.schedule();
+		for (int i = 0; i < 500; ++i)
+		{
+			{
+				auto lease = co_await pool.acquire();
+				++*lease;
+				const int now = checkedOut.fetch_add(1) + 1;
+				int expected = maxCheckedOut.load();
+				while (now > expected && !maxCheckedOut.compare_exchange_weak(expected, now))
+				{}
+
+				co_await threadPool.schedule();
+				checkedOut.fetch_sub(1);
+			}
+			co_await threadPool.schedule();
+		}
+	};
+
+	std::vector<task<>> tasks;
+	for (int i = 0; i < 32; ++i)
+	{
+		tasks.push_back(worker());
+	}
+	sync_wait(when_all(std::move(tasks)));
+
+	CHECK(maxCheckedOut <= static_cast<int>(capacity));
+
+	int total = 0;
+	std::vector<object_pool<int>::lease> leases;
+	for (std::size_t i = 0; i < capacity; ++i)
+	{
+		leases.push_back(pool.try_acquire());
+		REQUIRE(leases.back());
+		total += *leases.back();
+	}
+	CHECK(total == 32 * 500);
+}
+
+TEST_CASE("object_pool vs async_mutex checkout throughput")
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr std::uint32_t threadCount = 4;
+	constexpr int operationsPerWorker = 200000;
+
+	static_thread_pool threadPool{ threadCount };
+
+	for (std::uint32_t workerCount : { 1u, threadCount })
+	{
+		const double operationCount = static_cast<double>(workerCount) * operationsPerWorker;
+
+		double poolElapsed;
+		{
+			object_pool<std::uint64_t> pool{ threadPool, 64, [] { return std::uint64_t(0); } };
+
+			auto worker = [&]() -> task<>
+			{
+				co_await threadPool.schedule();
+				for (int i = 0; i < operationsPerWorker; ++i)
+				{
+					auto lease = co_await pool.acquire();
+					++*lease;
+				}
+			};
+
+			std::vector<task<>> tasks;
+			for (std::uint32_t i = 0; i < workerCount; ++i)
+			{
+				tasks.push_back(worker());
+			}
+			const auto start = clock::now();
+			sync_wait(when_all(std::move(tasks)));
+			poolElapsed = std::chrono::duration<double>(clock::now() - start).count();
+		}
+
+		double mutexElapsed;
+		{
+			async_mutex mutex;
+			std::vector<std::uint64_t> objects(64);
+
+			auto worker = [&]() -> task<>
+			{
+				co_await threadPool.schedule();
+				for (int i = 0; i < operationsPerWorker; ++i)
+				{
+					std::uint64_t object;
+					{
+						auto lock = co_await mutex.scoped_lock_async();
+						object = objects.back();
+						objects.pop_back();
+					}
+					++object;
+					{
+						auto lock = co_await mutex.scoped_lock_async();
+						objects.push_back(object);
+					}
+				}
+			};
+
+			std::vector<task<>> tasks;
+			for (std::uint32_t i = 0; i < workerCount; ++i)
+			{
+				tasks.push_back(worker());
+			}
+			const auto start = clock::now();
+			sync_wait(when_all(std::move(tasks)));
+			mutexElapsed = std::chrono::duration<double>(clock::now() - start).count();
+		}
+
+		MESSAGE(
+			workerCount << " workers: "
+			<< "object_pool " << poolElapsed * 1e9 / operationCount << " ns/checkout, "
+			<< "async_mutex + vector " << mutexElapsed * 1e9 / operationCount << " ns/checkout");
+	}
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,187 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/rate_limiter.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/sync_wait.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("rate_limiter");
+
+using namespace cppcoro;
+
+TEST_CASE("a full burst is available straight away")
+{
+	static_thread_pool threadPool{ 1 };
+	rate_limiter limiter{ threadPool, 10, 5 };
+
+	for (int i = 0; i < 5; ++i)
+	{
+		CHECK(limiter.try_acquire());
+	}
+	CHECK(!limiter.try_acquire());
+}
+
+TEST_CASE("try_acquire of more than is left reserves nothing")
+{
+	static_thread_pool threadPool{ 1 };
+	rate_limiter limiter{ threadPool, 10, 5 };
+
+	CHECK(limiter.try_acquire(3));
+	CHECK(!limiter.try_acquire(3));
+	CHECK(limiter.try_acquire(2));
+	CHECK(!limiter.try_acquire());
+}
+
+TEST_CASE("acquire waits for permits at the configured rate")
+{
+	using clock = std::chrono::steady_clock;
+
+	static_thread_pool threadPool{ 1 };
+	rate_limiter limiter{ threadPool, 1000, 1 };
+
+	auto run = [&]() -> task<>
+	{
+		co_await threadPool.schedule();
+		for (int i = 0; i < 50; ++i)
+		{
+			co_await limiter.acquire();
+			CHECK(threadPool.is_current_thread_in_pool());
+		}
+	};
+
+	const auto start = clock::now();
+	sync_wait(run());
+	const auto elapsed = clock::now() - start;
+
+	// The first permit is free, the rest are released every millisecond.
+	CHECK(elapsed >= std::chrono::milliseconds(48));
+}
+
+TEST_CASE("waiters are resumed in the order they acquired")
+{
+	static_thread_pool threadPool{ 1 };
+	rate_limiter limiter{ threadPool, 500, 1 };
+
+	std::vector<int> order;
+
+	auto waiter = [&](int id) -> task<>
+	{
+		co_await limiter.acquire();
+		co_await threadPool.schedule();
+		order.push_back(id);
+	};
+
+	std::vector<task<>> tasks;
+	for (int i = 0; i < 10; ++i)
+	{
+		tasks.push_back(waiter(i));
+	}
+	sync_wait(when_all(std::move(tasks)));
+
+	CHECK(order == std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 });
+}
+
+TEST_CASE("sharded limiter borrows permits from other shards")
+{
+	static_thread_pool threadPool{ 2 };
+	rate_limiter limiter{ threadPool, 10, 4, 4 };
+	CHECK(limiter.shard_count() == 4);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		CHECK(limiter.try_acquire());
+	}
+	CHECK(!limiter.try_acquire());
+
+	auto run = [&]() -> task<>
+	{
+		co_await threadPool.schedule();
+		CHECK(!limiter.try_acquire());
+	};
+	sync_wait(run());
+}
+
+TEST_CASE("rate_limiter overhead at 10M permits/s")
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr std::uint32_t threadCount = 4;
+	constexpr double rate = 10'000'000;
+	constexpr int permitsPerWorker = 500'000;
+
+	static_thread_pool threadPool{ threadCount };
+
+	for (std::uint32_t shardCount : { 1u, threadCount })
+	{
+		// Unlimited, to measure the cost of acquiring a permit.
+		double uncontendedElapsed;
+		{
+			rate_limiter limiter{ threadPool, 1e15, 1'000'000, shardCount };
+
+			auto worker = [&]() -> task<>
+			{
+				co_await threadPool.schedule();
+				for (int i = 0; i < permitsPerWorker; ++i)
+				{
+					co_await limiter.acquire();
+				}
+			};
+
+			std::vector<task<>> tasks;
+			for (std::uint32_t i = 0; i < threadCount; ++i)
+			{
+				tasks.push_back(worker());
+			}
+			const auto start = clock::now();
+			sync_wait(when_all(std::move(tasks)));
+			uncontendedElapsed = std::chrono::duration<double>(clock::now() - start).count();
+		}
+
+		// Saturated at 10M permits/s.
+		double saturatedElapsed;
+		{
+			rate_limiter limiter{ threadPool, rate, 1000, shardCount };
+
+			auto worker = [&]() -> task<>
+			{
+				co_await threadPool.schedule();
+				for (int i = 0; i < permitsPerWorker; ++i)
+				{
+					co_await limiter.acquire();
+				}
+			};
+
+			std::vector<task<>> tasks;
+			for (std::uint32_t i = 0; i < threadCount; ++i)
+			{
+				tasks.push_back(worker());
+			}
+			const auto start = clock::now();
+			sync_wait(when_all(std::move(tasks)));
+			saturatedElapsed = std::chrono::duration<double>(clock::now() - start).count();
+		}
+
+		const double permitCount = static_cast<double>(threadCount) * permitsPerWorker;
+
+		// Can't go faster than the rate, give or take the initial burst.
+		CHECK(permitCount / saturatedElapsed < rate * 1.01);
+
+		MESSAGE(
+			shardCount << " shard(s): "
+			<< uncontendedElapsed * 1e9 / permitCount << " ns/acquire unlimited, "
+			<< permitCount / saturatedElapsed << " permits/s limited to " << rate);
+	}
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,204 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/recycling_allocator.hpp>
+#include <cppcoro/async_generator.hpp>
+#include <cppcoro/generator.hpp>
+#include <cppcoro/sync_wait.hpp>
+#include <cppcoro/task.hpp>
+
+#include <chrono>
+#include <memory>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("recycling_allocator");
+
+using cppcoro::recycling_allocator;
+using cppcoro::recycling_pool;
+
+TEST_CASE("freed blocks are reused for allocations of the same size")
+{
+	recycling_pool pool;
+
+	void* block = pool.allocate(100);
+	pool.deallocate(block, 100);
+	CHECK(pool.free_block_count() == 1);
+
+	void* other = pool.allocate(101);
+	CHECK(other != block);
+
+	void* reused = pool.allocate(100);
+	CHECK(reused == block);
+	CHECK(pool.free_block_count() == 0);
+
+	pool.deallocate(reused, 100);
+	pool.deallocate(other, 101);
+	CHECK(pool.free_block_count() == 2);
+}
+
+TEST_CASE("pool keeps a limited number of blocks")
+{
+	recycling_pool pool{ 2 };
+
+	void* blocks[3];
+	for (auto& block : blocks)
+	{
+		block = pool.allocate(64);
+	}
+	for (auto& block : blocks)
+	{
+		pool.deallocate(block, 64);
+	}
+	CHECK(pool.free_block_count() == 2);
+
+	// Only a few distinct sizes are kept.
+	void* sizes[8];
+	for (int i = 0; i < 8; ++i)
+	{
+		sizes[i] = pool.allocate(200 + i);
+	}
+	for (int i = 0; i < 8; ++i)
+	{
+		pool.deallocate(sizes[i], 200 + i);
+	}
+	CHECK(pool.free_block_count() < 2 + 8);
+}
+
+TEST_CASE("recycling_allocator copies share a pool")
+{
+	recycling_pool pool;
+	recycling_allocator<int> ints{ pool };
+	recycling_allocator<double> doubles{ ints };
+	CHECK(ints == doubles);
+	CHECK(&doubles.pool() == &pool);
+
+	std::allocator_traits<recycling_allocator<double>>::deallocate(
+		doubles, std::allocator_traits<recycling_allocator<double>>::allocate(doubles, 4), 4);
+
+	recycling_pool otherPool;
+	CHECK(ints != recycling_allocator<int>{ otherPool });
+}
+
+namespace
+{
+	cppcoro::generator<int> count_heap(int n)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			co_yield i;
+		}
+	}
+
+	cppcoro::generator<int> count_recycled(std::allocator_arg_t, recycling_allocator<char>, int n)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			co_yield i;
+		}
+	}
+
+	cppcoro::async_generator<int> async_count_heap(int n)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			co_yield i;
+		}
+	}
+
+	cppcoro::async_generator<int> async_count_recycled(std::allocator_arg_t, recycling_allocator<char>, int n)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			co_yield i;
+		}
+	}
+}
+
+TEST_CASE("short-lived generator throughput")
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr int totalItems = 2000000;
+
+	recycling_pool pool;
+	recycling_allocator<char> allocator{ pool };
+
+	for (int itemsPerGenerator : { 1, 10, 100 })
+	{
+		const int generatorCount = totalItems / itemsPerGenerator;
+
+		auto measure = [&](auto makeGenerator)
+		{
+			long long sum = 0;
+			const auto start = clock::now();
+			for (int i = 0; i < generatorCount; ++i)
+			{
+				for (int value : makeGenerator(itemsPerGenerator))
+				{
+					sum += value;
+				}
+			}
+			const auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+			CHECK(sum == static_cast<long long>(generatorCount) * itemsPerGenerator * (itemsPerGenerator - 1) / 2);
+			return elapsed * 1e9 / generatorCount;
+		};
+
+		const double heapNs = measure([](int n) { return count_heap(n); });
+		const double recycledNs = measure([&](int n) { return count_recycled(std::allocator_arg, allocator, n); });
+
+		MESSAGE(
+			"generator of " << itemsPerGenerator << " items: "
+			<< heapNs << " ns from the heap, " << recycledNs << " ns recycled");
+	}
+}
+
+TEST_CASE("short-lived async_generator throughput")
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr int totalItems = 2000000;
+
+	recycling_pool pool;
+	recycling_allocator<char> allocator{ pool };
+
+	for (int itemsPerGenerator : { 1, 10, 100 })
+	{
+		const int generatorCount = totalItems / itemsPerGenerator;
+
+		auto measure = [&](auto makeGenerator)
+		{
+			const auto start = clock::now();
+			const long long sum = cppcoro::sync_wait([&]() -> cppcoro::task<long long>
+			{
+				long long sum = 0;
+				for (int i = 0; i < generatorCount; ++i)
+				{
+					auto gen = makeGenerator(itemsPerGenerator);
+					auto it = co_await gen.begin();
+					while (it != gen.end())
+					{
+						sum += *it;
+						co_await ++it;
+					}
+				}
+				co_return sum;
+			}());
+			const auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+			CHECK(sum == static_cast<long long>(generatorCount) * itemsPerGenerator * (itemsPerGenerator - 1) / 2);
+			return elapsed * 1e9 / generatorCount;
+		};
+
+		const double heapNs = measure([](int n) { return async_count_heap(n); });
+		const double recycledNs = measure([&](int n) { return async_count_recycled(std::allocator_arg, allocator, n); });
+
+		MESSAGE(
+			"async_generator of " << itemsPerGenerator << " items: "
+			<< heapNs << " ns from the heap, " << recycledNs << " ns recycled");
+	}
+}
+
+TEST_SUITE_END();
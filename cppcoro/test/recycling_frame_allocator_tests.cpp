@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/detail/recycling_frame_allocator.hpp>
+#include <cppcoro/async_scope.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/sync_wait.hpp>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("recycling_frame_allocator");
+
+using cppcoro::detail::recycling_frame_allocator;
+
+TEST_CASE("freed frames are reused by the same thread")
+{
+	void* frame = recycling_frame_allocator::allocate(200);
+	recycling_frame_allocator::deallocate(frame, 200);
+
+	// Any size in the same size class gets the same frame back.
+	void* reused = recycling_frame_allocator::allocate(250);
+	CHECK(reused == frame);
+	recycling_frame_allocator::deallocate(reused, 250);
+}
+
+TEST_CASE("frames freed on another thread go back to the allocating thread")
+{
+	void* frame = recycling_frame_allocator::allocate(300);
+
+	std::thread{ [&] { recycling_frame_allocator::deallocate(frame, 300); } }.join();
+
+	void* reused = recycling_frame_allocator::allocate(300);
+	CHECK(reused == frame);
+	recycling_frame_allocator::deallocate(reused, 300);
+}
+
+TEST_CASE("frames can outlive the thread that allocated them")
+{
+	std::vector<void*> frames;
+	std::thread{ [&]
+	{
+		for (int i = 0; i < 10; ++i)
+		{
+			frames.push_back(recycling_frame_allocator::allocate(100));
+		}
+
+		// Return one before the thread exits, so it has a cache to shut down.
+		recycling_frame_allocator::deallocate(frames.back(), 100);
+		frames.pop_back();
+	} }.join();
+
+	for (void* frame : frames)
+	{
+		recycling_frame_allocator::deallocate(frame, 100);
+	}
+}
+
+TEST_CASE("large frames aren't recycled")
+{
+	void* frame = recycling_frame_allocator::allocate(64 * 1024);
+	recycling_frame_allocator::deallocate(frame, 64 * 1024);
+}
+
+TEST_CASE("sync_wait(when_all()) overhead")
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr int iterationCount = 200000;
+
+	auto leaf = [](int value) -> cppcoro::task<int>
+	{
+		co_return value;
+	};
+
+	long long total = 0;
+	const auto start = clock::now();
+	for (int i = 0; i < iterationCount; ++i)
+	{
+		auto [a, b] = cppcoro::sync_wait(cppcoro::when_all(leaf(1), leaf(2)));
+		total += a + b;
+	}
+	const auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+	cppcoro::async_scope scope;
+	const auto spawnStart = clock::now();
+	for (int i = 0; i < iterationCount; ++i)
+	{
+		scope.spawn(leaf(i));
+	}
+	const auto spawnElapsed = std::chrono::duration<double>(clock::now() - spawnStart).count();
+	cppcoro::sync_wait(scope.join());
+
+	CHECK(total == 3LL * iterationCount);
+
+	MESSAGE(
+		elapsed * 1e9 / iterationCount << " ns per sync_wait(when_all(a, b)), "
+		<< spawnElapsed * 1e9 / iterationCount << " ns per async_scope::spawn()");
+}
+
+TEST_SUITE_END();
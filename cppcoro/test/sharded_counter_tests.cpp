@@ -0,0 +1,146 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/sharded_counter.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/sync_wait.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("sharded_counter");
+
+using cppcoro::sharded_counter;
+
+TEST_CASE("sharded_counter counts on the calling thread")
+{
+	sharded_counter counter;
+	CHECK(counter.value() == 0);
+
+	counter.increment();
+	++counter;
+	counter += 5;
+	counter.add(10);
+	CHECK(counter.value() == 17);
+}
+
+TEST_CASE("sharded_counter counts from pool threads and other threads")
+{
+	cppcoro::static_thread_pool threadPool{ 4 };
+	sharded_counter counter{ threadPool };
+
+	constexpr int taskCount = 64;
+	constexpr int incrementsPerTask = 10000;
+
+	auto incrementOnPool = [&]() -> cppcoro::task<>
+	{
+		co_await threadPool.schedule();
+		for (int i = 0; i < incrementsPerTask; ++i)
+		{
+			++counter;
+		}
+	};
+
+	std::vector<cppcoro::task<>> tasks;
+	for (int i = 0; i < taskCount; ++i)
+	{
+		tasks.push_back(incrementOnPool());
+	}
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&]
+		{
+			for (int i = 0; i < incrementsPerTask; ++i)
+			{
+				++counter;
+			}
+		});
+	}
+
+	cppcoro::sync_wait(cppcoro::when_all(std::move(tasks)));
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	CHECK(counter.value() == std::uint64_t(taskCount + 4) * incrementsPerTask);
+}
+
+TEST_CASE("sharded_counter increment overhead")
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr std::uint32_t threadCount = 4;
+	constexpr int incrementsPerThread = 20000000;
+
+	cppcoro::static_thread_pool threadPool{ threadCount };
+
+	// Run the same loop on each of the pool's threads.
+	auto measure = [&](auto increment)
+	{
+		auto run = [&]() -> cppcoro::task<>
+		{
+			co_await threadPool.schedule();
+			for (int i = 0; i < incrementsPerThread; ++i)
+			{
+				increment();
+			}
+		};
+
+		std::vector<cppcoro::task<>> tasks;
+		for (std::uint32_t t = 0; t < threadCount; ++t)
+		{
+			tasks.push_back(run());
+		}
+
+		const auto start = clock::now();
+		cppcoro::sync_wait(cppcoro::when_all(std::move(tasks)));
+		const auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+		return elapsed * 1e9 / (double(threadCount) * incrementsPerThread);
+	};
+
+	// A non-atomic add to memory, which the compiler can't keep in a
+	// register, on a line of its own for each thread.
+	struct alignas(CPPCORO_CPU_CACHE_LINE) padded_count
+	{
+		volatile std::uint64_t m_count = 0;
+	};
+	std::vector<padded_count> plainCounts(threadCount);
+	const double plainNs = measure([&]
+	{
+		auto& count = plainCounts[threadPool.current_thread_index()].m_count;
+		count = count + 1;
+	});
+
+	std::atomic<std::uint64_t> sharedCount{ 0 };
+	const double atomicNs = measure([&]
+	{
+		sharedCount.fetch_add(1, std::memory_order_relaxed);
+	});
+
+	sharded_counter counter{ threadPool };
+	const double shardedNs = measure([&] { ++counter; });
+
+	CHECK(counter.value() == std::uint64_t(threadCount) * incrementsPerThread);
+	CHECK(sharedCount.load() == std::uint64_t(threadCount) * incrementsPerThread);
+
+	MESSAGE(
+		"per increment from " << threadCount << " pool threads: "
+		<< plainNs << " ns plain add, "
+		<< atomicNs << " ns one std::atomic, "
+		<< shardedNs << " ns sharded_counter");
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/sharded_histogram.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/sync_wait.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("sharded_histogram");
+
+using cppcoro::histogram_snapshot;
+using cppcoro::sharded_histogram;
+
+TEST_CASE("histogram buckets are powers of two")
+{
+	CHECK(histogram_snapshot::bucket_lower_bound(0) == 0);
+	CHECK(histogram_snapshot::bucket_upper_bound(0) == 0);
+	CHECK(histogram_snapshot::bucket_lower_bound(1) == 1);
+	CHECK(histogram_snapshot::bucket_upper_bound(1) == 1);
+	CHECK(histogram_snapshot::bucket_lower_bound(4) == 8);
+	CHECK(histogram_snapshot::bucket_upper_bound(4) == 15);
+	CHECK(histogram_snapshot::bucket_upper_bound(64) == UINT64_MAX);
+
+	sharded_histogram histogram;
+	histogram.record(0);
+	histogram.record(1);
+	histogram.record(8);
+	histogram.record(15);
+	histogram.record(16);
+	histogram.record(UINT64_MAX);
+
+	const auto snapshot = histogram.snapshot();
+	CHECK(snapshot.count() == 6);
+	CHECK(snapshot.bucket(0) == 1);
+	CHECK(snapshot.bucket(1) == 1);
+	CHECK(snapshot.bucket(4) == 2);
+	CHECK(snapshot.bucket(5) == 1);
+	CHECK(snapshot.bucket(64) == 1);
+	CHECK(snapshot.sum() == 0 + 1 + 8 + 15 + 16 + UINT64_MAX);
+}
+
+TEST_CASE("histogram quantiles")
+{
+	sharded_histogram histogram;
+	CHECK(histogram.snapshot().value_at_quantile(0.5) == 0);
+
+	// 90 small values and 10 large ones.
+	for (int i = 0; i < 90; ++i)
+	{
+		histogram.record(100);
+	}
+	for (int i = 0; i < 10; ++i)
+	{
+		histogram.record(10000);
+	}
+
+	const auto snapshot = histogram.snapshot();
+	CHECK(snapshot.value_at_quantile(0.0) == 127);
+	CHECK(snapshot.value_at_quantile(0.5) == 127);
+	CHECK(snapshot.value_at_quantile(0.9) == 127);
+	CHECK(snapshot.value_at_quantile(0.91) == 16383);
+	CHECK(snapshot.value_at_quantile(1.0) == 16383);
+}
+
+TEST_CASE("histogram records from pool threads")
+{
+	cppcoro::static_thread_pool threadPool{ 4 };
+	sharded_histogram histogram{ threadPool };
+
+	constexpr int taskCount = 64;
+	constexpr std::uint64_t valuesPerTask = 1000;
+
+	auto recordOnPool = [&]() -> cppcoro::task<>
+	{
+		co_await threadPool.schedule();
+		for (std::uint64_t value = 0; value < valuesPerTask; ++value)
+		{
+			histogram.record(value);
+		}
+	};
+
+	std::vector<cppcoro::task<>> tasks;
+	for (int i = 0; i < taskCount; ++i)
+	{
+		tasks.push_back(recordOnPool());
+	}
+	cppcoro::sync_wait(cppcoro::when_all(std::move(tasks)));
+
+	const auto snapshot = histogram.snapshot();
+	CHECK(snapshot.count() == taskCount * valuesPerTask);
+	CHECK(snapshot.sum() == taskCount * (valuesPerTask * (valuesPerTask - 1) / 2));
+	CHECK(snapshot.bucket(10) == taskCount * (valuesPerTask - 512));
+}
+
+TEST_SUITE_END();
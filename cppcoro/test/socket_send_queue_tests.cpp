@@ -0,0 +1,359 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/net/socket_send_queue.hpp>
+#include <cppcoro/net/socket.hpp>
+#include <cppcoro/async_mutex.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/sync_wait.hpp>
+
+#include "io_service_fixture.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include "doctest/doctest.h"
+
+using namespace cppcoro;
+using namespace cppcoro::net;
+using namespace std::chrono_literals;
+
+TEST_SUITE_BEGIN("socket_send_queue");
+
+namespace
+{
+	struct connected_pair
+	{
+		net::socket client;
+		net::socket server;
+	};
+
+	connected_pair connect_pair(io_service& ioSvc, int bufferSize = 0)
+	{
+		auto listeningSocket = net::socket::create_tcpv4(ioSvc);
+		listeningSocket.bind(ipv4_endpoint{ ipv4_address::loopback(), 0 });
+		listeningSocket.listen(1);
+
+		auto client = net::socket::create_tcpv4(ioSvc);
+		auto server = net::socket::create_tcpv4(ioSvc);
+
+		if (bufferSize != 0)
+		{
+			::setsockopt(client.native_handle(), SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+			::setsockopt(listeningSocket.native_handle(), SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+		}
+
+		sync_wait(when_all(
+			listeningSocket.accept(server),
+			client.connect(listeningSocket.local_endpoint())));
+
+		return { std::move(client), std::move(server) };
+	}
+
+	task<std::size_t> recv_exactly(net::socket& s, std::uint8_t* buffer, std::size_t byteCount)
+	{
+		std::size_t totalBytesReceived = 0;
+		while (totalBytesReceived < byteCount)
+		{
+			const std::size_t bytesReceived = co_await s.recv(
+				buffer + totalBytesReceived, byteCount - totalBytesReceived);
+			if (bytesReceived == 0)
+			{
+				break;
+			}
+			totalBytesReceived += bytesReceived;
+		}
+		co_return totalBytesReceived;
+	}
+
+	struct message
+	{
+		std::uint32_t writer;
+		std::uint32_t sequence;
+		std::uint8_t payload[56];
+	};
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "concurrent sends are written contiguously and in order")
+{
+	auto [client, server] = connect_pair(io_service());
+	socket_send_queue queue{ client };
+	static_thread_pool threadPool{ 4 };
+
+	constexpr std::uint32_t writerCount = 64;
+	constexpr std::uint32_t messagesPerWriter = 200;
+
+	auto writer = [&](std::uint32_t writerId) -> task<>
+	{
+		co_await threadPool.schedule();
+		for (std::uint32_t i = 0; i < messagesPerWriter; ++i)
+		{
+			message m;
+			m.writer = writerId;
+			m.sequence = i;
+			std::memset(m.payload, static_cast<int>(writerId), sizeof(m.payload));
+			co_await queue.send(&m, sizeof(m));
+		}
+	};
+
+	auto reader = [&]() -> task<>
+	{
+		std::vector<message> messages(writerCount * messagesPerWriter);
+		const std::size_t byteCount = messages.size() * sizeof(message);
+		CHECK(co_await recv_exactly(
+			server, reinterpret_cast<std::uint8_t*>(messages.data()), byteCount) == byteCount);
+
+		std::vector<std::uint32_t> nextSequence(writerCount, 0);
+		for (const auto& m : messages)
+		{
+			REQUIRE(m.writer < writerCount);
+			CHECK(m.sequence == nextSequence[m.writer]++);
+			CHECK(m.payload[0] == m.writer);
+			CHECK(m.payload[sizeof(m.payload) - 1] == m.writer);
+		}
+	};
+
+	std::vector<task<>> writers;
+	for (std::uint32_t i = 0; i < writerCount; ++i)
+	{
+		writers.push_back(writer(i));
+	}
+
+	sync_wait(when_all(when_all(std::move(writers)), reader()));
+
+	CHECK(queue.syscall_count() <= writerCount * messagesPerWriter);
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "sends complete while other writers keep sending")
+{
+	auto [client, server] = connect_pair(io_service());
+	socket_send_queue queue{ client };
+	static_thread_pool threadPool{ 4 };
+
+	constexpr std::uint32_t writerCount = 64;
+	constexpr std::uint32_t probeCount = 100;
+	constexpr std::uint32_t endOfStream = 0xFFFFFFFFu;
+	std::atomic<bool> stop = false;
+
+	auto writer = [&](std::uint32_t writerId) -> task<>
+	{
+		co_await threadPool.schedule();
+		message m{};
+		m.writer = writerId;
+		while (!stop.load(std::memory_order_relaxed))
+		{
+			co_await queue.send(&m, sizeof(m));
+			++m.sequence;
+		}
+	};
+
+	// Whenever this becomes the flusher, its send must not be held up by
+	// the other writers queueing more.
+	auto prober = [&]() -> task<>
+	{
+		co_await threadPool.schedule();
+		message m{};
+		m.writer = writerCount;
+		for (; m.sequence < probeCount; ++m.sequence)
+		{
+			co_await queue.send(&m, sizeof(m));
+		}
+		stop = true;
+	};
+
+	auto writeAll = [&]() -> task<>
+	{
+		std::vector<task<>> writers;
+		for (std::uint32_t i = 0; i < writerCount; ++i)
+		{
+			writers.push_back(writer(i));
+		}
+		writers.push_back(prober());
+		co_await when_all(std::move(writers));
+
+		message m{};
+		m.writer = endOfStream;
+		co_await queue.send(&m, sizeof(m));
+	};
+
+	auto reader = [&]() -> task<>
+	{
+		std::vector<std::uint32_t> nextSequence(writerCount + 1, 0);
+		message m;
+		while (co_await recv_exactly(server, reinterpret_cast<std::uint8_t*>(&m), sizeof(m)) == sizeof(m) &&
+			m.writer != endOfStream)
+		{
+			REQUIRE(m.writer <= writerCount);
+			CHECK(m.sequence == nextSequence[m.writer]++);
+		}
+
+		CHECK(m.writer == endOfStream);
+		CHECK(nextSequence[writerCount] == probeCount);
+	};
+
+	sync_wait(when_all(writeAll(), reader()));
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "senders are held back while the send buffer is full")
+{
+	auto [client, server] = connect_pair(io_service(), 64 * 1024);
+	socket_send_queue queue{ client };
+
+	constexpr std::size_t writerCount = 4;
+	constexpr std::size_t bufferSize = 1024 * 1024;
+	std::vector<std::uint8_t> data(bufferSize, 'a');
+	std::atomic<std::size_t> completedCount = 0;
+
+	auto writer = [&]() -> task<>
+	{
+		co_await queue.send(data.data(), data.size());
+		++completedCount;
+	};
+
+	auto reader = [&]() -> task<>
+	{
+		co_await io_service().schedule_after(100ms);
+
+		// Nothing has been read so the kernel can't have accepted everything yet.
+		CHECK(completedCount < writerCount);
+
+		std::vector<std::uint8_t> buffer(writerCount * bufferSize);
+		CHECK(co_await recv_exactly(server, buffer.data(), buffer.size()) == buffer.size());
+	};
+
+	std::vector<task<>> writers;
+	for (std::size_t i = 0; i < writerCount; ++i)
+	{
+		writers.push_back(writer());
+	}
+
+	sync_wait(when_all(when_all(std::move(writers)), reader()));
+
+	CHECK(completedCount == writerCount);
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "sends fail once the connection is reset")
+{
+	auto [client, server] = connect_pair(io_service());
+	socket_send_queue queue{ client };
+
+	// Closing with unread data resets the connection.
+	const char unread = 'x';
+	sync_wait(client.send(&unread, 1));
+	sync_wait(io_service().schedule_after(10ms));
+	{
+		auto closed = std::move(server);
+	}
+
+	std::vector<std::uint8_t> data(64 * 1024, 'a');
+	bool failed = false;
+	sync_wait([&]() -> task<>
+	{
+		try
+		{
+			for (int i = 0; i < 1000; ++i)
+			{
+				co_await queue.send(data.data(), data.size());
+			}
+		}
+		catch (const std::system_error&)
+		{
+			failed = true;
+		}
+	}());
+
+	CHECK(failed);
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "throughput with 64 concurrent writers")
+{
+	constexpr std::uint32_t writerCount = 64;
+	constexpr std::uint32_t messagesPerWriter = 2000;
+	constexpr std::size_t messageSize = 64;
+	constexpr std::size_t totalBytes = writerCount * messagesPerWriter * messageSize;
+
+	static_thread_pool threadPool{ 4 };
+
+	auto drain = [](net::socket& s) -> task<>
+	{
+		std::vector<std::uint8_t> buffer(256 * 1024);
+		std::size_t totalBytesReceived = 0;
+		while (totalBytesReceived < totalBytes)
+		{
+			totalBytesReceived += co_await s.recv(buffer.data(), buffer.size());
+		}
+	};
+
+	auto run = [&](auto sendMessage, net::socket& server) -> std::chrono::nanoseconds
+	{
+		auto writer = [&]() -> task<>
+		{
+			co_await threadPool.schedule();
+			std::uint8_t m[messageSize] = {};
+			for (std::uint32_t i = 0; i < messagesPerWriter; ++i)
+			{
+				co_await sendMessage(m, sizeof(m));
+			}
+		};
+
+		std::vector<task<>> writers;
+		for (std::uint32_t i = 0; i < writerCount; ++i)
+		{
+			writers.push_back(writer());
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		sync_wait(when_all(when_all(std::move(writers)), drain(server)));
+		return std::chrono::high_resolution_clock::now() - start;
+	};
+
+	auto megabytesPerSecond = [&](std::chrono::nanoseconds elapsed)
+	{
+		return static_cast<double>(totalBytes) / std::chrono::duration<double>(elapsed).count() / 1e6;
+	};
+
+	std::uint64_t syscallCount = 0;
+	std::chrono::nanoseconds queueTime;
+	{
+		auto [client, server] = connect_pair(io_service());
+		socket_send_queue queue{ client };
+		queueTime = run([&](const void* buffer, std::size_t size) -> task<>
+		{
+			co_await queue.send(buffer, size);
+		}, server);
+		syscallCount = queue.syscall_count();
+	}
+
+	std::chrono::nanoseconds mutexTime;
+	{
+		auto [client, server] = connect_pair(io_service());
+		async_mutex mutex;
+		mutexTime = run([&](const void* buffer, std::size_t size) -> task<>
+		{
+			auto lock = co_await mutex.scoped_lock_async();
+			std::size_t bytesSent = 0;
+			while (bytesSent < size)
+			{
+				bytesSent += co_await client.send(
+					static_cast<const std::uint8_t*>(buffer) + bytesSent, size - bytesSent);
+			}
+		}, server);
+	}
+
+	MESSAGE(
+		writerCount << " writers x " << messagesPerWriter << " x " << messageSize << " bytes: "
+		<< "send queue " << megabytesPerSecond(queueTime) << " MB/s ("
+		<< static_cast<double>(writerCount * messagesPerWriter) / static_cast<double>(syscallCount)
+		<< " messages/sendmsg), "
+		<< "async_mutex + send " << megabytesPerSecond(mutexTime) << " MB/s");
+}
+
+TEST_SUITE_END();
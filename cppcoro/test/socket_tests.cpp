@@ -13,6 +13,9 @@
 #include <cppcoro/cancellation_token.hpp>
 #include <cppcoro/async_scope.hpp>
 
+#include <cerrno>
+#include <optional>
+
 #include "doctest/doctest.h"
 
 using namespace cppcoro;
@@ -471,4 +474,125 @@ TEST_CASE("udp send_to/recv_from")
 		}()));
 }
 
+#if CPPCORO_OS_LINUX
+
+TEST_CASE("concurrent recv_from on one socket fails with EBUSY without disturbing the first")
+{
+	io_service ioSvc;
+
+	auto serverSocket = socket::create_udpv4(ioSvc);
+	serverSocket.bind(ipv4_endpoint{ ipv4_address::loopback(), 0 });
+	auto clientSocket = socket::create_udpv4(ioSvc);
+
+	auto firstReceiver = [&]() -> task<std::size_t>
+	{
+		std::uint8_t buffer[16];
+		auto [bytesReceived, sender] = co_await serverSocket.recv_from(buffer, sizeof(buffer));
+		co_return bytesReceived;
+	};
+
+	auto secondReceiverThenSend = [&]() -> task<>
+	{
+		std::uint8_t buffer[16];
+		try
+		{
+			(void)co_await serverSocket.recv_from(buffer, sizeof(buffer));
+			FAIL("Should have thrown");
+		}
+		catch (const std::system_error& ex)
+		{
+			CHECK(ex.code().value() == EBUSY);
+		}
+
+		const std::uint8_t message[3] = { 1, 2, 3 };
+		co_await clientSocket.send_to(serverSocket.local_endpoint(), message, sizeof(message));
+	};
+
+	(void)sync_wait(when_all(
+		[&]() -> task<int>
+		{
+			auto stopOnExit = on_scope_exit([&] { ioSvc.stop(); });
+			auto [bytesReceived, unused] = co_await when_all(firstReceiver(), secondReceiverThenSend());
+			CHECK(bytesReceived == 3);
+			co_return 0;
+		}(),
+		[&]() -> task<int>
+		{
+			ioSvc.process_events();
+			co_return 0;
+		}()));
+}
+
+TEST_CASE("closing a socket completes a pending recv_from with ECANCELED")
+{
+	io_service ioSvc;
+
+	std::optional<socket> serverSocket = socket::create_udpv4(ioSvc);
+	serverSocket->bind(ipv4_endpoint{ ipv4_address::loopback(), 0 });
+
+	auto receiver = [&]() -> task<>
+	{
+		std::uint8_t buffer[16];
+		try
+		{
+			(void)co_await serverSocket->recv_from(buffer, sizeof(buffer));
+			FAIL("Should have thrown");
+		}
+		catch (const std::system_error& ex)
+		{
+			CHECK(ex.code().value() == ECANCELED);
+		}
+	};
+
+	auto closer = [&]() -> task<>
+	{
+		// The receiver is waiting by the time we get here.
+		co_await ioSvc.schedule();
+		serverSocket.reset();
+	};
+
+	(void)sync_wait(when_all(
+		[&]() -> task<int>
+		{
+			auto stopOnExit = on_scope_exit([&] { ioSvc.stop(); });
+			co_await when_all(receiver(), closer());
+			co_return 0;
+		}(),
+		[&]() -> task<int>
+		{
+			ioSvc.process_events();
+			co_return 0;
+		}()));
+
+	// The recycled registration doesn't remember the cancelled receiver.
+	ioSvc.reset();
+	auto nextSocket = socket::create_udpv4(ioSvc);
+	nextSocket.bind(ipv4_endpoint{ ipv4_address::loopback(), 0 });
+	auto clientSocket = socket::create_udpv4(ioSvc);
+
+	(void)sync_wait(when_all(
+		[&]() -> task<int>
+		{
+			auto stopOnExit = on_scope_exit([&] { ioSvc.stop(); });
+			std::uint8_t buffer[16];
+			const std::uint8_t message[3] = { 1, 2, 3 };
+			auto [bytesReceived, unused] = co_await when_all(
+				[&]() -> task<std::size_t>
+				{
+					auto [count, sender] = co_await nextSocket.recv_from(buffer, sizeof(buffer));
+					co_return count;
+				}(),
+				clientSocket.send_to(nextSocket.local_endpoint(), message, sizeof(message)));
+			CHECK(bytesReceived == 3);
+			co_return 0;
+		}(),
+		[&]() -> task<int>
+		{
+			ioSvc.process_events();
+			co_return 0;
+		}()));
+}
+
+#endif
+
 TEST_SUITE_END();
@@ -92,6 +92,38 @@ cppcoro::task<std::uint64_t> sum_of_squares(
 	}
 }
 
+TEST_CASE("local queue grows while other threads steal from it")
+{
+	cppcoro::static_thread_pool threadPool{ 4 };
+
+	constexpr int taskCount = 200'000;
+	std::atomic<int> runCount{ 0 };
+
+	auto child = [&]() -> cppcoro::task<>
+	{
+		co_await threadPool.schedule();
+		runCount.fetch_add(1, std::memory_order_relaxed);
+	};
+
+	// Every child is scheduled from the same pool thread, so its local
+	// queue keeps growing while the other threads steal from it.
+	cppcoro::sync_wait([&]() -> cppcoro::task<>
+	{
+		co_await threadPool.schedule();
+
+		std::vector<cppcoro::task<>> tasks;
+		tasks.reserve(taskCount);
+		for (int i = 0; i < taskCount; ++i)
+		{
+			tasks.push_back(child());
+		}
+
+		co_await cppcoro::when_all(std::move(tasks));
+	}());
+
+	CHECK(runCount == taskCount);
+}
+
 TEST_CASE("launch sub-task with many sub-tasks")
 {
 	using namespace std::chrono_literals;
@@ -0,0 +1,240 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/strand.hpp>
+#include <cppcoro/async_mutex.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/sync_wait.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <ostream>
+#include "doctest/doctest.h"
+
+TEST_SUITE_BEGIN("strand");
+
+using namespace cppcoro;
+
+TEST_CASE("schedule resumes on a thread pool thread")
+{
+	static_thread_pool threadPool{ 2 };
+	strand<static_thread_pool> s{ threadPool };
+
+	auto run = [&]() -> task<std::thread::id>
+	{
+		co_await s.schedule();
+		co_return std::this_thread::get_id();
+	};
+
+	CHECK(sync_wait(run()) != std::this_thread::get_id());
+}
+
+TEST_CASE("items run one at a time")
+{
+	static_thread_pool threadPool{ 4 };
+	strand<static_thread_pool> s{ threadPool };
+
+	std::atomic<int> running = 0;
+	std::atomic<int> maxRunning = 0;
+	int count = 0;
+
+	auto worker = [&]() -> task<>
+	{
+		for (int i = 0; i < 1000; ++i)
+		{
+			co_await s.schedule();
+			const int nowRunning = running.fetch_add(1) + 1;
+			int expected = maxRunning.load();
+			while (nowRunning > expected && !maxRunning.compare_exchange_weak(expected, nowRunning))
+			{}
+			++count;
+			running.fetch_sub(1);
+			co_await threadPool.schedule();
+		}
+	};
+
+	std::vector<task<>> tasks;
+	for (int i = 0; i < 8; ++i)
+	{
+		tasks.push_back(worker());
+	}
+	sync_wait(when_all(std::move(tasks)));
+
+	CHECK(count == 8000);
+	CHECK(maxRunning == 1);
+}
+
+TEST_CASE("items run in the order they were scheduled")
+{
+	static_thread_pool threadPool{ 1 };
+	strand<static_thread_pool> s{ threadPool, 4 };
+
+	std::vector<int> order;
+
+	auto item = [&](int id) -> task<>
+	{
+		co_await s.schedule();
+		order.push_back(id);
+	};
+
+	// Queue all of the items from the pool thread, so that they are all on
+	// the strand's queue before the first one runs.
+	auto run = [&]() -> task<>
+	{
+		co_await threadPool.schedule();
+		std::vector<task<>> tasks;
+		for (int i = 0; i < 20; ++i)
+		{
+			tasks.push_back(item(i));
+		}
+		co_await when_all(std::move(tasks));
+	};
+	sync_wait(run());
+
+	std::vector<int> expected(20);
+	for (int i = 0; i < 20; ++i)
+	{
+		expected[i] = i;
+	}
+	CHECK(order == expected);
+}
+
+TEST_CASE("strand is idle again once drained")
+{
+	static_thread_pool threadPool{ 2 };
+	strand<static_thread_pool> s{ threadPool };
+
+	int count = 0;
+	auto run = [&]() -> task<>
+	{
+		co_await s.schedule();
+		++count;
+	};
+
+	for (int i = 0; i < 100; ++i)
+	{
+		sync_wait(run());
+	}
+	CHECK(count == 100);
+}
+
+TEST_CASE("strand vs async_mutex throughput")
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr std::uint32_t threadCount = 64;
+	constexpr std::size_t objectCount = 10000;
+	constexpr int workerCount = 1024;
+	constexpr int operationsPerWorker = 500;
+
+	static_thread_pool threadPool{ threadCount };
+
+	struct alignas(64) object
+	{
+		std::uint64_t value = 0;
+	};
+
+	// Each worker updates a pseudo-random sequence of objects, hopping back
+	// onto the thread pool between updates as a request handler would.
+	auto nextIndex = [](std::uint64_t& seed, std::size_t count)
+	{
+		seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+		return static_cast<std::size_t>((seed >> 33) % count);
+	};
+
+	for (std::size_t hotCount : { objectCount, std::size_t(16) })
+	{
+		const auto expected = static_cast<std::uint64_t>(workerCount) * operationsPerWorker;
+
+		double strandElapsed;
+		{
+			std::vector<object> objects(hotCount);
+			std::vector<std::unique_ptr<strand<static_thread_pool>>> strands;
+			for (std::size_t i = 0; i < hotCount; ++i)
+			{
+				strands.push_back(std::make_unique<strand<static_thread_pool>>(threadPool));
+			}
+
+			auto worker = [&](std::uint64_t seed) -> task<>
+			{
+				co_await threadPool.schedule();
+				for (int i = 0; i < operationsPerWorker; ++i)
+				{
+					const auto index = nextIndex(seed, hotCount);
+					co_await strands[index]->schedule();
+					++objects[index].value;
+					co_await threadPool.schedule();
+				}
+			};
+
+			std::vector<task<>> tasks;
+			for (int i = 0; i < workerCount; ++i)
+			{
+				tasks.push_back(worker(i));
+			}
+			const auto start = clock::now();
+			sync_wait(when_all(std::move(tasks)));
+			strandElapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+			std::uint64_t total = 0;
+			for (auto& o : objects)
+			{
+				total += o.value;
+			}
+			CHECK(total == expected);
+		}
+
+		double mutexElapsed;
+		{
+			std::vector<object> objects(hotCount);
+			std::vector<async_mutex> mutexes(hotCount);
+
+			auto worker = [&](std::uint64_t seed) -> task<>
+			{
+				co_await threadPool.schedule();
+				for (int i = 0; i < operationsPerWorker; ++i)
+				{
+					const auto index = nextIndex(seed, hotCount);
+					{
+						auto lock = co_await mutexes[index].scoped_lock_async();
+						++objects[index].value;
+					}
+					co_await threadPool.schedule();
+				}
+			};
+
+			std::vector<task<>> tasks;
+			for (int i = 0; i < workerCount; ++i)
+			{
+				tasks.push_back(worker(i));
+			}
+			const auto start = clock::now();
+			sync_wait(when_all(std::move(tasks)));
+			mutexElapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+			std::uint64_t total = 0;
+			for (auto& o : objects)
+			{
+				total += o.value;
+			}
+			CHECK(total == expected);
+		}
+
+		MESSAGE(
+			hotCount << " objects, " << threadCount << " threads: "
+			<< "strand " << static_cast<double>(expected) / strandElapsed << " ops/s, "
+			<< "async_mutex " << static_cast<double>(expected) / mutexElapsed << " ops/s");
+	}
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,362 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright (c) Lewis Baker
+// Licenced under MIT license. See LICENSE.txt for details.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cppcoro/net/udp_multiplexer.hpp>
+#include <cppcoro/net/socket.hpp>
+#include <cppcoro/cancellation_source.hpp>
+#include <cppcoro/on_scope_exit.hpp>
+#include <cppcoro/operation_cancelled.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/sync_wait.hpp>
+
+#include "io_service_fixture.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include "doctest/doctest.h"
+
+using namespace cppcoro;
+using namespace cppcoro::net;
+using namespace std::chrono_literals;
+
+TEST_SUITE_BEGIN("udp_multiplexer");
+
+namespace
+{
+	using clock = std::chrono::steady_clock;
+
+	net::socket create_bound_udp_socket(io_service& ioSvc)
+	{
+		auto s = net::socket::create_udpv4(ioSvc);
+		s.bind(ipv4_endpoint{ ipv4_address::loopback(), 0 });
+		return s;
+	}
+
+	/// Echo every datagram back to its sender until cancelled.
+	task<> echo_server(net::socket& s, cancellation_token ct)
+	{
+		std::uint8_t buffer[2048];
+		try
+		{
+			while (true)
+			{
+				auto [bytesReceived, sender] = co_await s.recv_from(buffer, sizeof(buffer), ct);
+				co_await s.send_to(sender, buffer, bytesReceived);
+			}
+		}
+		catch (const operation_cancelled&)
+		{
+		}
+	}
+
+	task<std::string> request_string(
+		udp_multiplexer& mux,
+		const ip_endpoint& destination,
+		std::string_view payload,
+		std::chrono::milliseconds timeout = 1s)
+	{
+		char reply[256];
+		const std::size_t replySize = co_await mux.request(
+			destination, payload.data(), payload.size(), reply, sizeof(reply), timeout);
+		co_return std::string{ reply, replySize };
+	}
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "request receives the reply")
+{
+	auto server = create_bound_udp_socket(io_service());
+	auto client = create_bound_udp_socket(io_service());
+	udp_multiplexer mux{ io_service(), client };
+
+	cancellation_source canceller;
+	sync_wait(when_all(
+		mux.run(canceller.token()),
+		echo_server(server, canceller.token()),
+		[&]() -> task<>
+		{
+			auto stopOnExit = on_scope_exit([&] { canceller.request_cancellation(); });
+			CHECK(co_await request_string(mux, server.local_endpoint(), "hello") == "hello");
+			CHECK(co_await request_string(mux, server.local_endpoint(), "") == "");
+		}()));
+
+	CHECK(mux.timed_out_count() == 0);
+	CHECK(mux.unmatched_count() == 0);
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "replies are matched to their requests by ID")
+{
+	auto server = create_bound_udp_socket(io_service());
+	auto client = create_bound_udp_socket(io_service());
+	udp_multiplexer mux{ io_service(), client };
+
+	// Reply to two requests in the opposite order that they arrived.
+	auto reversingServer = [&]() -> task<>
+	{
+		std::uint8_t first[64];
+		std::uint8_t second[64];
+		auto [firstSize, firstSender] = co_await server.recv_from(first, sizeof(first));
+		auto [secondSize, secondSender] = co_await server.recv_from(second, sizeof(second));
+		co_await server.send_to(secondSender, second, secondSize);
+		co_await server.send_to(firstSender, first, firstSize);
+	};
+
+	cancellation_source canceller;
+	sync_wait(when_all(
+		mux.run(canceller.token()),
+		reversingServer(),
+		[&]() -> task<>
+		{
+			auto stopOnExit = on_scope_exit([&] { canceller.request_cancellation(); });
+			auto [a, b] = co_await when_all(
+				request_string(mux, server.local_endpoint(), "first"),
+				request_string(mux, server.local_endpoint(), "second"));
+			CHECK(a == "first");
+			CHECK(b == "second");
+		}()));
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "many concurrent requests")
+{
+	auto server = create_bound_udp_socket(io_service());
+	auto client = create_bound_udp_socket(io_service());
+	udp_multiplexer mux{ io_service(), client };
+	static_thread_pool threadPool{ 4 };
+
+	constexpr int requesterCount = 64;
+	constexpr int requestsPerRequester = 100;
+
+	auto requester = [&](int requesterId) -> task<>
+	{
+		co_await threadPool.schedule();
+		for (int i = 0; i < requestsPerRequester; ++i)
+		{
+			const std::string payload = std::to_string(requesterId) + ":" + std::to_string(i);
+			CHECK(co_await request_string(mux, server.local_endpoint(), payload, 10s) == payload);
+		}
+	};
+
+	cancellation_source canceller;
+	sync_wait(when_all(
+		mux.run(canceller.token()),
+		echo_server(server, canceller.token()),
+		[&]() -> task<>
+		{
+			auto stopOnExit = on_scope_exit([&] { canceller.request_cancellation(); });
+			std::vector<task<>> requesters;
+			for (int i = 0; i < requesterCount; ++i)
+			{
+				requesters.push_back(requester(i));
+			}
+			co_await when_all(std::move(requesters));
+		}()));
+
+	CHECK(mux.received_count() == requesterCount * requestsPerRequester);
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "request times out and a late reply is dropped")
+{
+	auto server = create_bound_udp_socket(io_service());
+	auto client = create_bound_udp_socket(io_service());
+	udp_multiplexer mux{ io_service(), client };
+
+	auto slowServer = [&]() -> task<>
+	{
+		std::uint8_t buffer[64];
+		auto [bytesReceived, sender] = co_await server.recv_from(buffer, sizeof(buffer));
+		co_await io_service().schedule_after(50ms);
+		co_await server.send_to(sender, buffer, bytesReceived);
+	};
+
+	cancellation_source canceller;
+	sync_wait(when_all(
+		mux.run(canceller.token()),
+		slowServer(),
+		[&]() -> task<>
+		{
+			auto stopOnExit = on_scope_exit([&] { canceller.request_cancellation(); });
+
+			const auto start = clock::now();
+			try
+			{
+				(void)co_await request_string(mux, server.local_endpoint(), "ping", 10ms);
+				FAIL("expected the request to time out");
+			}
+			catch (const std::system_error& ex)
+			{
+				CHECK(ex.code() == std::error_code{ ETIMEDOUT, std::system_category() });
+			}
+
+			const auto elapsed = clock::now() - start;
+			CHECK(elapsed >= 10ms);
+			CHECK(elapsed < 1s);
+
+			// Wait for the late reply to arrive.
+			for (int i = 0; i < 100 && mux.unmatched_count() == 0; ++i)
+			{
+				co_await io_service().schedule_after(10ms);
+			}
+		}()));
+
+	CHECK(mux.timed_out_count() == 1);
+	CHECK(mux.unmatched_count() == 1);
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "outstanding requests are cancelled when run() is cancelled")
+{
+	auto silent = create_bound_udp_socket(io_service());
+	auto client = create_bound_udp_socket(io_service());
+	udp_multiplexer mux{ io_service(), client, 1 };
+
+	cancellation_source canceller;
+	sync_wait(when_all(
+		mux.run(canceller.token()),
+		[&]() -> task<>
+		{
+			CHECK_THROWS_AS(
+				co_await request_string(mux, silent.local_endpoint(), "ping", 10s),
+				const operation_cancelled&);
+		}(),
+		[&]() -> task<>
+		{
+			co_await io_service().schedule_after(20ms);
+
+			// The only slot is in use.
+			try
+			{
+				(void)co_await request_string(mux, silent.local_endpoint(), "ping", 10s);
+				FAIL("expected the request to fail");
+			}
+			catch (const std::system_error& ex)
+			{
+				CHECK(ex.code() == std::error_code{ ENOBUFS, std::system_category() });
+			}
+
+			canceller.request_cancellation();
+		}()));
+}
+
+TEST_CASE_FIXTURE(io_service_fixture_with_threads<1>, "request throughput on loopback")
+{
+	auto client = create_bound_udp_socket(io_service());
+
+	// Reduce drops from the socket buffers overflowing, which would show up
+	// as timeouts.
+	const int bufferSize = 4 * 1024 * 1024;
+	::setsockopt(client.native_handle(), SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+	// A blocking echo server on its own thread that uses batched system
+	// calls so that it is not the bottleneck.
+	auto server = create_bound_udp_socket(io_service());
+	const auto serverEndPoint = server.local_endpoint();
+	::setsockopt(server.native_handle(), SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+	std::atomic<bool> stopServer = false;
+	std::thread serverThread{ [&]
+	{
+		constexpr unsigned batchSize = 64;
+		std::vector<std::uint8_t> buffers(batchSize * 256);
+		::iovec iovecs[batchSize];
+		::mmsghdr messages[batchSize];
+		sockaddr_storage senders[batchSize];
+
+		::timeval timeout{ 0, 10000 };
+		::setsockopt(server.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		const int flags = ::fcntl(server.native_handle(), F_GETFL);
+		::fcntl(server.native_handle(), F_SETFL, flags & ~O_NONBLOCK);
+
+		while (!stopServer.load(std::memory_order_relaxed))
+		{
+			for (unsigned i = 0; i < batchSize; ++i)
+			{
+				iovecs[i] = ::iovec{ buffers.data() + i * 256, 256 };
+				messages[i].msg_hdr = ::msghdr{};
+				messages[i].msg_hdr.msg_name = &senders[i];
+				messages[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+				messages[i].msg_hdr.msg_iov = &iovecs[i];
+				messages[i].msg_hdr.msg_iovlen = 1;
+			}
+
+			const int received = ::recvmmsg(server.native_handle(), messages, batchSize, MSG_WAITFORONE, nullptr);
+			if (received <= 0)
+			{
+				continue;
+			}
+
+			for (int i = 0; i < received; ++i)
+			{
+				iovecs[i].iov_len = messages[i].msg_len;
+			}
+			::sendmmsg(server.native_handle(), messages, static_cast<unsigned>(received), 0);
+		}
+	} };
+	auto joinServer = on_scope_exit([&]
+	{
+		stopServer = true;
+		serverThread.join();
+	});
+
+	constexpr int requesterCount = 256;
+	constexpr auto duration = 500ms;
+
+	udp_multiplexer mux{ io_service(), client };
+	std::atomic<std::uint64_t> completedCount = 0;
+	std::atomic<std::uint64_t> failedCount = 0;
+
+	auto requester = [&](clock::time_point deadline) -> task<>
+	{
+		std::uint8_t payload[32] = {};
+		std::uint8_t reply[64];
+		while (clock::now() < deadline)
+		{
+			try
+			{
+				co_await mux.request(serverEndPoint, payload, sizeof(payload), reply, sizeof(reply), 100ms);
+				completedCount.fetch_add(1, std::memory_order_relaxed);
+			}
+			catch (const std::system_error&)
+			{
+				failedCount.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	cancellation_source canceller;
+	const auto start = clock::now();
+	sync_wait(when_all(
+		mux.run(canceller.token()),
+		[&]() -> task<>
+		{
+			auto stopOnExit = on_scope_exit([&] { canceller.request_cancellation(); });
+			std::vector<task<>> requesters;
+			for (int i = 0; i < requesterCount; ++i)
+			{
+				requesters.push_back(requester(start + duration));
+			}
+			co_await when_all(std::move(requesters));
+		}()));
+	const auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+	CHECK(completedCount > 0);
+
+	MESSAGE(
+		requesterCount << " concurrent requesters: "
+		<< static_cast<double>(completedCount) / elapsed << " requests/s, "
+		<< static_cast<double>(mux.received_count()) / static_cast<double>(mux.receive_syscall_count())
+		<< " datagrams/recvmmsg, "
+		<< failedCount << " timed out");
+}
+
+TEST_SUITE_END();
@@ -9,11 +9,16 @@
 #include <cppcoro/shared_task.hpp>
 #include <cppcoro/sync_wait.hpp>
 #include <cppcoro/async_manual_reset_event.hpp>
+#include <cppcoro/static_thread_pool.hpp>
 
 #include "counted.hpp"
 
+#include <array>
+#include <chrono>
 #include <functional>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <ostream>
@@ -262,4 +267,175 @@ TEST_CASE("when_all_ready() doesn't rethrow exceptions")
 	}());
 }
 
+namespace
+{
+	// Suspends, then changes its mind and completes synchronously.
+	struct value_awaiter
+	{
+		int m_value;
+
+		bool await_ready() noexcept { return false; }
+		bool await_suspend(std::coroutine_handle<>) noexcept { return false; }
+
+		int await_resume()
+		{
+			if (m_value < 0)
+			{
+				throw std::runtime_error{ "negative" };
+			}
+
+			return m_value;
+		}
+	};
+
+	struct reference_awaiter
+	{
+		std::string& m_value;
+
+		bool await_ready() noexcept { return true; }
+		void await_suspend(std::coroutine_handle<>) noexcept {}
+		std::string& await_resume() noexcept { return m_value; }
+	};
+}
+
+TEST_CASE("when_all_ready() with plain awaiters")
+{
+	cppcoro::async_manual_reset_event event;
+	std::string value = "value";
+	bool finished = false;
+
+	cppcoro::sync_wait(cppcoro::when_all_ready(
+		[&]() -> cppcoro::task<>
+	{
+		auto [a, b, c, d, e] = co_await cppcoro::when_all_ready(
+			cppcoro::async_manual_reset_event_operation{ event },
+			value_awaiter{ 1 },
+			value_awaiter{ -1 },
+			reference_awaiter{ value },
+			when_event_set_return<cppcoro::task>(event, 2));
+		finished = true;
+
+		a.result();
+		CHECK(b.result() == 1);
+		CHECK_THROWS_AS(c.result(), const std::runtime_error&);
+		CHECK(&d.result() == &value);
+		CHECK(e.result() == 2);
+	}(),
+		[&]() -> cppcoro::task<>
+	{
+		CHECK(!finished);
+		event.set();
+		CHECK(finished);
+		co_return;
+	}()));
+}
+
+TEST_CASE("when_all_ready() with plain awaiters resumed on other threads")
+{
+	cppcoro::static_thread_pool threadPool{ 2 };
+
+	auto run = [&]() -> cppcoro::task<>
+	{
+		for (int i = 0; i < 1000; ++i)
+		{
+			co_await cppcoro::when_all_ready(
+				threadPool.schedule(),
+				threadPool.schedule(),
+				threadPool.schedule());
+			CHECK(threadPool.is_current_thread_in_pool());
+		}
+	};
+
+	cppcoro::sync_wait(run());
+}
+
+TEST_CASE("when_all() with plain awaiters")
+{
+	std::string value = "value";
+	auto [x, y, z] = cppcoro::sync_wait(cppcoro::when_all(
+		value_awaiter{ 1 },
+		reference_awaiter{ value },
+		std::suspend_never{}));
+	CHECK(x == 1);
+	CHECK(y == "value");
+	(void)z;
+
+	CHECK_THROWS_AS(
+		cppcoro::sync_wait(cppcoro::when_all(value_awaiter{ 1 }, value_awaiter{ -1 })),
+		const std::runtime_error&);
+}
+
+// Lvalue arguments never take the frameless path, so they are held exactly
+// as they were before plain awaiters were special-cased.
+static_assert(!cppcoro::detail::is_frameless_when_all_child<std::suspend_never&>::value);
+static_assert(!cppcoro::detail::is_frameless_when_all_child<const std::suspend_never&>::value);
+static_assert(
+	cppcoro::detail::is_frameless_when_all_child<std::suspend_never>::value ==
+	bool(CPPCORO_USE_FRAMELESS_CONTINUATIONS));
+
+#if CPPCORO_USE_FRAMELESS_CONTINUATIONS
+
+namespace
+{
+	template<typename AWAITABLE>
+	bool run_when_all_ready(cppcoro::async_manual_reset_event& event, AWAITABLE&& whenAllReady)
+	{
+		auto awaiter = whenAllReady.operator co_await();
+		const bool suspended = awaiter.await_suspend(std::noop_coroutine());
+		event.set();
+		return suspended && awaiter.await_ready();
+	}
+
+	template<bool VIA_TASKS, std::size_t... INDICES>
+	double when_all_ready_ns(std::index_sequence<INDICES...>)
+	{
+		using clock = std::chrono::steady_clock;
+
+		constexpr int iterationCount = 100000;
+
+		int completed = 0;
+		const auto start = clock::now();
+		for (int i = 0; i < iterationCount; ++i)
+		{
+			cppcoro::async_manual_reset_event event;
+			if constexpr (VIA_TASKS)
+			{
+				// Awaiters passed by std::ref() always go through a when_all_task.
+				std::array<cppcoro::async_manual_reset_event_operation, sizeof...(INDICES)> operations{
+					((void)INDICES, cppcoro::async_manual_reset_event_operation{ event })...
+				};
+				completed += run_when_all_ready(event, cppcoro::when_all_ready(std::ref(operations[INDICES])...));
+			}
+			else
+			{
+				completed += run_when_all_ready(event, cppcoro::when_all_ready(
+					((void)INDICES, cppcoro::async_manual_reset_event_operation{ event })...));
+			}
+		}
+		const auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+		CHECK(completed == iterationCount);
+		return elapsed * 1e9 / iterationCount;
+	}
+
+	template<std::size_t COUNT>
+	void report_when_all_ready_overhead()
+	{
+		const double framelessNs = when_all_ready_ns<false>(std::make_index_sequence<COUNT>{});
+		const double taskNs = when_all_ready_ns<true>(std::make_index_sequence<COUNT>{});
+		MESSAGE(COUNT << " awaiters: " << framelessNs << " ns frameless, " << taskNs << " ns via when_all_task");
+	}
+}
+
+TEST_CASE("when_all_ready() overhead for 2-8 event waits")
+{
+	report_when_all_ready_overhead<2>();
+	report_when_all_ready_overhead<3>();
+	report_when_all_ready_overhead<4>();
+	report_when_all_ready_overhead<6>();
+	report_when_all_ready_overhead<8>();
+}
+
+#endif
+
 TEST_SUITE_END();
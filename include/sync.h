@@ -1,8 +1,18 @@
 #pragma once
 
+#include "timer_queue.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <concepts>
 #include <coroutine>
+#include <cstddef>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
 namespace tfcoro
 {
  
@@ -73,92 +83,646 @@ namespace tfcoro
             }
         };
 
-        struct awaitable_event
+        // Result of a timed wait on an event.
+        enum class wait_status
         {
-            void set() const
-            {
-                shared->set();
-            }
+            signalled,
+            timed_out
+        };
 
-            auto operator co_await() const noexcept
+        // The waiter list and signalled flag behind every event type below.
+        //
+        // Not used directly: awaitable_event, unique_event and local_event each
+        // own one in a different way, and event_ref refers to any of them.
+        class event_state
+        {
+        public:
+            void set()
             {
-                return awaiter{*shared};
+                node *claimed = nullptr;
+                {
+                    auto guard = std::lock_guard(mutex);
+                    // auto guard = winrt::slim_lock_guard(mutex);
+                    signalled.store(true);
+
+                    // Claim the waiters under the lock: a waiter that has already
+                    // timed out is left to the timer, which takes this lock
+                    // before resuming it, so none of them can go away while
+                    // we're walking the list.
+                    node **last = &claimed;
+                    for (auto n = std::exchange(head, nullptr); n;)
+                    {
+                        auto next = n->next;
+                        n->linked = false;
+                        if (n->try_complete(node_status::signalled))
+                        {
+                            *last = n;
+                            last = &n->next;
+                        }
+                        n = next;
+                    }
+                    *last = nullptr;
+                    tail = nullptr;
+                }
+
+                while (claimed)
+                {
+                    auto n = std::exchange(claimed, claimed->next);
+                    if (n->group)
+                    {
+                        n->group->complete(*n->group, *n);
+                        continue;
+                    }
+                    if (n->timers)
+                        n->timers->remove(*n->timer);
+                    if (n->registered.exchange(true, std::memory_order_acq_rel))
+                        n->handle();
+                }
             }
 
         private:
+            template <typename>
+            friend struct event_operations;
+
+            template <typename... Events>
+            friend auto wait_any(const Events &...events) noexcept;
+
+            template <typename... Events>
+            friend auto wait_all(const Events &...events) noexcept;
+
+            enum class node_status : unsigned char
+            {
+                waiting,
+                signalled,
+                timed_out
+            };
+
+            struct node;
+
+            // Shared by the nodes of a wait_any() or wait_all(), which wait on
+            // several events from one awaiter.
+            struct multi_wait
+            {
+                // Called by set(), outside its lock, once it has claimed n.
+                void (*complete)(multi_wait &, node &) noexcept;
+
+                // For wait_any(), claimed instead of each node's own status so
+                // that only the first event to be set wins.
+                bool shared_claim;
+                std::atomic<node_status> status{node_status::waiting};
+            };
+
+            // The waiter list is doubly linked so that a timed out waiter can
+            // unlink itself in O(1) without walking the list.
             struct node
             {
-                node *next;
+                node *next = nullptr;
+                node *prev = nullptr;
                 std::coroutine_handle<> handle;
+
+                // Whoever moves this away from waiting decides how the wait ends,
+                // so set() and the timer never both resume the same waiter.
+                std::atomic<node_status> status{node_status::waiting};
+
+                // Cleared while a timed wait is still registering with the timer
+                // queue. Whichever of the registration and the completion
+                // finishes last resumes the waiter.
+                std::atomic<bool> registered{true};
+
+                // Only set for timed waits.
+                timer_queue *timers = nullptr;
+                timer_queue::entry *timer = nullptr;
+
+                // Only set for wait_any() and wait_all().
+                multi_wait *group = nullptr;
+
+                bool linked = false;
+
+                bool try_complete(node_status result) noexcept
+                {
+                    auto &claim = group && group->shared_claim ? group->status : status;
+                    auto expected = node_status::waiting;
+                    return claim.compare_exchange_strong(expected, result, std::memory_order_acq_rel);
+                }
             };
 
-            struct state
+            // winrt::slim_mutex mutex;
+            std::mutex mutex;
+            node *head = nullptr;
+            node *tail = nullptr;
+            relaxed_atomic<bool> signalled = false;
+
+            bool await_ready() const noexcept
+            {
+                return signalled.load();
+            }
+
+            // Returns false if the event has already been set.
+            bool await_suspend(node &n) noexcept
+            {
+                // auto guard = winrt::slim_lock_guard(mutex);
+                auto guard = std::lock_guard(mutex);
+                if (signalled.load())
+                    return false;
+                append(n);
+                return true;
+            }
+
+            void await_resume() const noexcept {}
+
+            void append(node &n) noexcept
+            {
+                n.next = nullptr;
+                n.prev = tail;
+                if (tail)
+                    tail->next = &n;
+                else
+                    head = &n;
+                tail = &n;
+                n.linked = true;
+            }
+
+            // Called by the timer once it has claimed n, and by wait_any() to
+            // cancel the nodes that lost.
+            void unlink(node &n) noexcept
             {
-                // std::atomic_bool signaled =false;
-                // winrt::slim_mutex mutex;
-                std::mutex mutex;
-                node *head = nullptr;
-                relaxed_atomic<node **> last = &head; // new
+                auto guard = std::lock_guard(mutex);
+                if (!n.linked)
+                    return;
+                if (n.prev)
+                    n.prev->next = n.next;
+                else
+                    head = n.next;
+                if (n.next)
+                    n.next->prev = n.prev;
+                else
+                    tail = n.prev;
+                n.linked = false;
+            }
 
-                void set()
+            struct awaiter
+            {
+                event_state &s;
+                node n;
+
+                bool await_ready() const noexcept { return s.await_ready(); }
+                bool await_suspend(
+                    std::coroutine_handle<> handle) noexcept
                 {
-                    node *rest = nullptr;
-                    {
-                        auto guard = std::lock_guard(mutex);
-                        // auto guard = winrt::slim_lock_guard(mutex);
-                        last.store(nullptr); //, std::memory_order_relaxed); new
-                        rest = std::exchange(head, nullptr);
-                    }
-                    // while (lifo) {
-                    //     auto n = lifo;
-                    //     lifo = std::exchange(n->next, fifo);
-                    //     fifo = n;
-                    // }
-                    while (rest)
+                    n.handle = handle;
+                    return s.await_suspend(n);
+                }
+
+                void await_resume() const noexcept { return s.await_resume(); }
+            };
+
+            // Holds a scheduler's schedule() operation in the awaiter so that
+            // hopping to the scheduler after a timeout doesn't allocate.
+            template <typename Scheduler, typename = void>
+            struct schedule_slot
+            {
+                using operation = decltype(std::declval<Scheduler &>().schedule());
+
+                struct holder
+                {
+                    operation op;
+
+                    template <typename F>
+                    explicit holder(F &&make) : op(make()) {}
+                };
+
+                std::optional<holder> slot;
+
+                void resume(Scheduler &scheduler, std::coroutine_handle<> handle) noexcept
+                {
+                    slot.emplace([&] { return scheduler.schedule(); });
+                    auto &op = slot->op;
+                    if (op.await_ready())
                     {
-                        auto handle = rest->handle;
-                        rest = rest->next;
                         handle();
+                        return;
                     }
-                }
 
-                bool await_ready() const noexcept
-                {
-                    return !last.load(); // new
+                    using result = decltype(op.await_suspend(handle));
+                    if constexpr (std::is_void_v<result>)
+                        op.await_suspend(handle);
+                    else if constexpr (std::is_same_v<result, bool>)
+                    {
+                        if (!op.await_suspend(handle))
+                            handle();
+                    }
+                    else
+                        op.await_suspend(handle).resume();
                 }
 
-                bool await_suspend(node &n) noexcept
+                void await_resume()
                 {
-                    // auto guard = winrt::slim_lock_guard(mutex);
-                    auto guard = std::lock_guard(mutex);
-                    auto p = last.load();
-                    if (!p)
-                        return false;
-                    *p = &n;
-                    last = &n.next;
-                    n.next = nullptr;
-                    return true;
+                    if (slot)
+                        slot->op.await_resume();
                 }
+            };
 
-                void await_resume() const noexcept {}
+            template <typename Unused>
+            struct schedule_slot<void, Unused>
+            {
+                void await_resume() noexcept {}
             };
 
-            struct awaiter
+            template <typename Scheduler>
+            struct timed_awaiter : timer_queue::entry
             {
-                state &s;
+                event_state &s;
+                timer_queue &timers;
+                Scheduler *scheduler;
                 node n;
+                schedule_slot<Scheduler> hop;
+
+                timed_awaiter(event_state &s, timer_queue &timers, timer_queue::clock::time_point deadline, Scheduler *scheduler) noexcept
+                    : s(s), timers(timers), scheduler(scheduler)
+                {
+                    this->deadline = deadline;
+                    try_claim = &timed_awaiter::claim;
+                    fire = &timed_awaiter::expire;
+                }
+
+                timed_awaiter(const timed_awaiter &) = delete;
+                timed_awaiter &operator=(const timed_awaiter &) = delete;
 
                 bool await_ready() const noexcept { return s.await_ready(); }
-                bool await_suspend(
-                    std::coroutine_handle<> handle) noexcept
+
+                bool await_suspend(std::coroutine_handle<> handle)
                 {
                     n.handle = handle;
-                    return s.await_suspend(n);
+                    n.timers = &timers;
+                    n.timer = this;
+                    n.registered.store(false, std::memory_order_relaxed);
+                    {
+                        auto guard = std::lock_guard(s.mutex);
+                        if (s.signalled.load())
+                        {
+                            n.status.store(node_status::signalled, std::memory_order_relaxed);
+                            return false;
+                        }
+                        if (deadline <= timer_queue::clock::now())
+                        {
+                            n.status.store(node_status::timed_out, std::memory_order_relaxed);
+                            return false;
+                        }
+                        s.append(n);
+                    }
+
+                    // set() may already have claimed the waiter, in which case it
+                    // has nothing to remove from the timer queue and we mustn't
+                    // add to it.
+                    timers.add_if(*this, [&] {
+                        return n.status.load(std::memory_order_acquire) == node_status::waiting;
+                    });
+
+                    // If the wait has already completed, carry on without suspending.
+                    return !n.registered.exchange(true, std::memory_order_acq_rel);
                 }
 
-                void await_resume() const noexcept { return s.await_resume(); }
+                wait_status await_resume()
+                {
+                    // Still waiting if await_ready() found the event already set.
+                    if (n.status.load(std::memory_order_acquire) != node_status::timed_out)
+                        return wait_status::signalled;
+                    hop.await_resume();
+                    return wait_status::timed_out;
+                }
+
+            private:
+                static bool claim(timer_queue::entry &e) noexcept
+                {
+                    return static_cast<timed_awaiter &>(e).n.try_complete(node_status::timed_out);
+                }
+
+                static void expire(timer_queue::entry &e) noexcept
+                {
+                    auto &self = static_cast<timed_awaiter &>(e);
+                    self.s.unlink(self.n);
+                    if (!self.n.registered.exchange(true, std::memory_order_acq_rel))
+                        return;
+                    if constexpr (std::is_void_v<Scheduler>)
+                        self.n.handle();
+                    else
+                        self.hop.resume(*self.scheduler, self.n.handle);
+                }
+            };
+
+            // One node per event, all in the awaiter, so waiting on several
+            // events doesn't allocate.
+            //
+            // Registration races with the events being set: a node is only
+            // appended while the wait is still undecided, the winning set()
+            // unlinks every node that did get appended before resuming, and a
+            // registration flag makes whichever of await_suspend() and the
+            // winner finishes last resume the coroutine.
+            template <std::size_t N>
+            struct any_awaiter : multi_wait
+            {
+                std::array<event_state *, N> events;
+                std::array<node, N> nodes;
+                std::size_t winner = N;
+                std::atomic<bool> registered{true};
+
+                explicit any_awaiter(std::array<event_state *, N> events) noexcept
+                    : multi_wait{&any_awaiter::finish, true}, events(events)
+                {
+                }
+
+                any_awaiter(const any_awaiter &) = delete;
+                any_awaiter &operator=(const any_awaiter &) = delete;
+
+                bool await_ready() noexcept
+                {
+                    for (std::size_t i = 0; i < N; ++i)
+                    {
+                        if (events[i]->await_ready())
+                        {
+                            winner = i;
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+
+                bool await_suspend(std::coroutine_handle<> handle) noexcept
+                {
+                    registered.store(false, std::memory_order_relaxed);
+                    for (std::size_t i = 0; i < N; ++i)
+                    {
+                        auto &n = nodes[i];
+                        n.handle = handle;
+                        n.group = this;
+
+                        auto &e = *events[i];
+                        auto guard = std::unique_lock(e.mutex);
+                        if (e.signalled.load())
+                        {
+                            if (!n.try_complete(node_status::signalled))
+                                break;
+
+                            // Set before we got to it, and nothing else has won.
+                            guard.unlock();
+                            winner = i;
+                            cancel();
+                            return false;
+                        }
+                        if (status.load(std::memory_order_acquire) != node_status::waiting)
+                            break;
+                        e.append(n);
+                    }
+
+                    return !registered.exchange(true, std::memory_order_acq_rel);
+                }
+
+                // Index of the event that was set.
+                std::size_t await_resume() const noexcept
+                {
+                    return winner;
+                }
+
+            private:
+                void cancel() noexcept
+                {
+                    for (std::size_t i = 0; i < N; ++i)
+                        events[i]->unlink(nodes[i]);
+                }
+
+                static void finish(multi_wait &group, node &n) noexcept
+                {
+                    auto &self = static_cast<any_awaiter &>(group);
+                    self.winner = static_cast<std::size_t>(&n - self.nodes.data());
+                    self.cancel();
+                    if (self.registered.exchange(true, std::memory_order_acq_rel))
+                        n.handle();
+                }
+            };
+
+            // Each node completes on its own; the last one, or await_suspend()
+            // if every event was already set, resumes the coroutine.
+            template <std::size_t N>
+            struct all_awaiter : multi_wait
+            {
+                std::array<event_state *, N> events;
+                std::array<node, N> nodes;
+                std::atomic<std::size_t> remaining{N + 1};
+
+                explicit all_awaiter(std::array<event_state *, N> events) noexcept
+                    : multi_wait{&all_awaiter::finish, false}, events(events)
+                {
+                }
+
+                all_awaiter(const all_awaiter &) = delete;
+                all_awaiter &operator=(const all_awaiter &) = delete;
+
+                bool await_ready() const noexcept
+                {
+                    for (auto e : events)
+                    {
+                        if (!e->await_ready())
+                            return false;
+                    }
+                    return true;
+                }
+
+                bool await_suspend(std::coroutine_handle<> handle) noexcept
+                {
+                    // One count for the registration itself, released at the end.
+                    std::size_t done = 1;
+                    for (std::size_t i = 0; i < N; ++i)
+                    {
+                        auto &n = nodes[i];
+                        n.handle = handle;
+                        n.group = this;
+                        if (!events[i]->await_suspend(n))
+                            ++done;
+                    }
+
+                    return remaining.fetch_sub(done, std::memory_order_acq_rel) != done;
+                }
+
+                void await_resume() const noexcept {}
+
+            private:
+                static void finish(multi_wait &group, node &n) noexcept
+                {
+                    auto &self = static_cast<all_awaiter &>(group);
+                    if (self.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        n.handle();
+                }
+            };
+
+            template <typename Clock, typename Duration>
+            static timer_queue::clock::time_point to_timer_clock(std::chrono::time_point<Clock, Duration> deadline) noexcept
+            {
+                if constexpr (std::is_same_v<Clock, timer_queue::clock>)
+                    return std::chrono::time_point_cast<timer_queue::clock::duration>(deadline);
+                else
+                    return timer_queue::clock::now() +
+                           std::chrono::duration_cast<timer_queue::clock::duration>(deadline - Clock::now());
+            }
+        };
+
+        // set(), co_await and the timed waits, for each event type. Event only
+        // has to provide state().
+        template <typename Event>
+        struct event_operations
+        {
+            void set() const
+            {
+                self().state().set();
+            }
+
+            auto operator co_await() const noexcept
+            {
+                return event_state::awaiter{self().state(), {}};
+            }
+
+            // co_await event.wait_until(deadline) resumes with wait_status::signalled
+            // once the event is set, or wait_status::timed_out once deadline has
+            // passed, whichever happens first. A timed out waiter is resumed on
+            // the timer queue's thread.
+            template <typename Clock, typename Duration>
+            auto wait_until(std::chrono::time_point<Clock, Duration> deadline,
+                            timer_queue &timers = timer_queue::shared()) const noexcept
+            {
+                return event_state::timed_awaiter<void>{self().state(), timers, event_state::to_timer_clock(deadline), nullptr};
+            }
+
+            template <typename Rep, typename Period>
+            auto wait_for(std::chrono::duration<Rep, Period> timeout,
+                          timer_queue &timers = timer_queue::shared()) const noexcept
+            {
+                return wait_until(timer_queue::clock::now() + timeout, timers);
+            }
+
+            // As above, but a timed out waiter is resumed through
+            // scheduler.schedule() rather than on the timer queue's thread.
+            template <typename Rep, typename Period, typename Scheduler>
+            auto wait_for(std::chrono::duration<Rep, Period> timeout, Scheduler &scheduler,
+                          timer_queue &timers = timer_queue::shared()) const noexcept
+            {
+                return event_state::timed_awaiter<Scheduler>{
+                    self().state(), timers, event_state::to_timer_clock(timer_queue::clock::now() + timeout), &scheduler};
+            }
+
+        private:
+            const Event &self() const noexcept
+            {
+                return static_cast<const Event &>(*this);
+            }
+        };
+
+        // Copies share the state through a std::shared_ptr, so each copy costs an
+        // atomic increment and decrement. Still the default; prefer event_ref
+        // when passing an event to coroutines that don't outlive it.
+        struct awaitable_event : event_operations<awaitable_event>
+        {
+            event_state &state() const noexcept
+            {
+                return *shared;
+            }
+
+        private:
+            std::shared_ptr<event_state> shared = std::make_shared<event_state>();
+        };
+
+        // Non-owning reference to any of the event types. Copying it copies a
+        // pointer; the event must outlive the reference and its waiters.
+        struct event_ref : event_operations<event_ref>
+        {
+            template <typename Event>
+                requires requires(const Event &e) { { e.state() } -> std::same_as<event_state &>; }
+            event_ref(const Event &e) noexcept : s(&e.state())
+            {
+            }
+
+            event_state &state() const noexcept
+            {
+                return *s;
+            }
+
+        private:
+            event_state *s;
+        };
+
+        // Owns its state inline, so creating one doesn't allocate. Can't be copied
+        // or moved, as waiters point into it; hand out event_refs instead.
+        struct unique_event : event_operations<unique_event>
+        {
+            unique_event() = default;
+            unique_event(const unique_event &) = delete;
+            unique_event &operator=(const unique_event &) = delete;
+
+            event_state &state() const noexcept
+            {
+                return s;
+            }
+
+        private:
+            mutable event_state s;
+        };
+
+        // Shares its state like awaitable_event, but with an intrusive, non-atomic
+        // reference count. All copies must be made and destroyed on one thread;
+        // set() and co_await are still safe from any thread.
+        struct local_event : event_operations<local_event>
+        {
+            local_event() : s(new counted_state)
+            {
+            }
+
+            local_event(const local_event &other) noexcept : s(other.s)
+            {
+                ++s->refs;
+            }
+
+            local_event(local_event &&other) noexcept : s(std::exchange(other.s, nullptr))
+            {
+            }
+
+            local_event &operator=(local_event other) noexcept
+            {
+                std::swap(s, other.s);
+                return *this;
+            }
+
+            ~local_event()
+            {
+                if (s && --s->refs == 0)
+                    delete s;
+            }
+
+            event_state &state() const noexcept
+            {
+                return *s;
+            }
+
+        private:
+            struct counted_state : event_state
+            {
+                std::size_t refs = 1;
             };
 
-            std::shared_ptr<state> shared = std::make_shared<state>();
+            counted_state *s;
         };
-}
\ No newline at end of file
+
+        // co_await wait_any(e1, e2, ...) resumes once any of the events is set,
+        // with the index of the one that was. Takes any of the event types above.
+        template <typename... Events>
+        auto wait_any(const Events &...events) noexcept
+        {
+            static_assert(sizeof...(Events) > 0);
+            return event_state::any_awaiter<sizeof...(Events)>{{&events.state()...}};
+        }
+
+        // co_await wait_all(e1, e2, ...) resumes once all of the events are set.
+        template <typename... Events>
+        auto wait_all(const Events &...events) noexcept
+        {
+            static_assert(sizeof...(Events) > 0);
+            return event_state::all_awaiter<sizeof...(Events)>{{&events.state()...}};
+        }
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace tfcoro
+{
+        // Shared timer structure for timed waits.
+        //
+        // Deadlines are rounded up to the queue's resolution and entries with
+        // the same rounded deadline are kept together in one bucket, so a
+        // burst of waits with similar timeouts costs one map lookup each and
+        // is expired as a single batch by the timer thread.
+        //
+        // Each bucket is an intrusive doubly-linked list of entries owned by
+        // the waiters, so adding and removing an entry never allocates apart
+        // from creating a new bucket, and removal is O(1).
+        //
+        //   buckets (std::map, ordered by deadline)
+        //   ┌──────────┐    ┌──────────┐
+        //   │ t+1ms    │    │ t+2ms    │
+        //   │ head ────┼─→ [entry] ⇄ [entry] ⇄ [entry]
+        //   └──────────┘    │ head ────┼─→ [entry]
+        //                   └──────────┘
+        class timer_queue
+        {
+        public:
+            using clock = std::chrono::steady_clock;
+
+            struct entry;
+
+        private:
+            struct bucket
+            {
+                entry *head = nullptr;
+                entry *tail = nullptr;
+            };
+
+            using bucket_map = std::map<clock::time_point, bucket>;
+
+        public:
+            // Embedded in whatever is waiting for the deadline.
+            struct entry
+            {
+                // Called by the timer thread, with the queue's lock held, once the
+                // deadline has passed. Returns false if the wait completed some
+                // other way in the meantime, in which case the entry is dropped.
+                bool (*try_claim)(entry &) noexcept = nullptr;
+
+                // Called by the timer thread, without the lock, after a
+                // successful try_claim(). The queue doesn't touch the entry again.
+                void (*fire)(entry &) noexcept = nullptr;
+
+                clock::time_point deadline;
+
+            private:
+                friend class timer_queue;
+
+                entry *next = nullptr;
+                entry *prev = nullptr;
+                bucket_map::iterator where;
+                bool queued = false;
+            };
+
+            explicit timer_queue(clock::duration resolution = std::chrono::milliseconds(1))
+                : resolution(resolution > clock::duration::zero() ? resolution : clock::duration(1)),
+                  thread([this] { run(); })
+            {
+            }
+
+            ~timer_queue()
+            {
+                {
+                    auto guard = std::lock_guard(mutex);
+                    stopping = true;
+                }
+                wakeup.notify_one();
+                thread.join();
+            }
+
+            timer_queue(const timer_queue &) = delete;
+            timer_queue &operator=(const timer_queue &) = delete;
+
+            // Process-wide queue used by timed waits that don't specify one.
+            static timer_queue &shared()
+            {
+                static timer_queue queue;
+                return queue;
+            }
+
+            // Queue e if accept() still returns true once the lock is held.
+            //
+            // Lets a waiter that may be completed concurrently avoid queuing an
+            // entry that nobody would ever remove.
+            template <typename Accept>
+            bool add_if(entry &e, Accept &&accept)
+            {
+                bool notify = false;
+                {
+                    auto guard = std::lock_guard(mutex);
+                    if (!accept())
+                        return false;
+
+                    auto since = e.deadline.time_since_epoch();
+                    auto ticks = (since + resolution - clock::duration(1)) / resolution;
+                    auto [where, inserted] = buckets.try_emplace(clock::time_point(ticks * resolution));
+
+                    e.where = where;
+                    e.next = nullptr;
+                    e.prev = where->second.tail;
+                    if (e.prev)
+                        e.prev->next = &e;
+                    else
+                        where->second.head = &e;
+                    where->second.tail = &e;
+                    e.queued = true;
+                    ++count;
+
+                    notify = inserted && where == buckets.begin();
+                }
+
+                if (notify)
+                    wakeup.notify_one();
+                return true;
+            }
+
+            // O(1). Returns false if e wasn't queued, eg. because the timer
+            // thread has already taken it.
+            bool remove(entry &e) noexcept
+            {
+                auto guard = std::lock_guard(mutex);
+                if (!e.queued)
+                    return false;
+
+                unlink(e);
+                return true;
+            }
+
+            // Number of queued entries.
+            std::size_t size() const
+            {
+                auto guard = std::lock_guard(mutex);
+                return count;
+            }
+
+        private:
+            void unlink(entry &e) noexcept
+            {
+                auto &b = e.where->second;
+                if (e.prev)
+                    e.prev->next = e.next;
+                else
+                    b.head = e.next;
+                if (e.next)
+                    e.next->prev = e.prev;
+                else
+                    b.tail = e.prev;
+                if (!b.head)
+                    buckets.erase(e.where);
+                e.queued = false;
+                --count;
+            }
+
+            void run()
+            {
+                auto lock = std::unique_lock(mutex);
+                while (!stopping)
+                {
+                    if (buckets.empty())
+                    {
+                        wakeup.wait(lock);
+                        continue;
+                    }
+
+                    // Copied, as the bucket may be removed while we're waiting.
+                    auto next_deadline = buckets.begin()->first;
+                    auto now = clock::now();
+                    if (now < next_deadline)
+                    {
+                        wakeup.wait_until(lock, next_deadline);
+                        continue;
+                    }
+
+                    // Claim every due entry as one batch, then fire them without
+                    // the lock so that resumed waiters can queue new timers.
+                    entry *fired = nullptr;
+                    entry **last = &fired;
+                    while (!buckets.empty() && buckets.begin()->first <= now)
+                    {
+                        auto where = buckets.begin();
+                        for (auto *e = where->second.head; e;)
+                        {
+                            auto *next = e->next;
+                            e->queued = false;
+                            --count;
+                            if (e->try_claim(*e))
+                            {
+                                e->next = nullptr;
+                                *last = e;
+                                last = &e->next;
+                            }
+                            e = next;
+                        }
+                        buckets.erase(where);
+                    }
+
+                    lock.unlock();
+                    while (fired)
+                    {
+                        auto *e = fired;
+                        fired = e->next;
+                        e->fire(*e);
+                    }
+                    lock.lock();
+                }
+            }
+
+            const clock::duration resolution;
+            mutable std::mutex mutex;
+            std::condition_variable wakeup;
+            bucket_map buckets;
+            std::size_t count = 0;
+            bool stopping = false;
+            std::thread thread;
+        };
+}
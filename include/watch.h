@@ -0,0 +1,298 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+namespace tfcoro
+{
+        // A watch's value together with the version it was published as.
+        //
+        // Trivially copyable values are copied into the snapshot. Anything else
+        // is shared with the watch, and the snapshot keeps the value it was
+        // taken of alive however many times the watch is published to since.
+        template <typename T>
+        class watch_snapshot
+        {
+            static constexpr bool stored_inline = std::is_trivially_copyable_v<T>;
+            using storage = std::conditional_t<stored_inline, T, std::shared_ptr<const T>>;
+
+        public:
+            watch_snapshot(std::uint64_t version, storage value) noexcept
+                : ver(version), val(std::move(value))
+            {
+            }
+
+            std::uint64_t version() const noexcept { return ver; }
+
+            const T &value() const noexcept
+            {
+                if constexpr (stored_inline)
+                    return val;
+                else
+                    return *val;
+            }
+
+            const T &operator*() const noexcept { return value(); }
+            const T *operator->() const noexcept { return &value(); }
+
+        private:
+            std::uint64_t ver;
+            storage val;
+        };
+
+        // Broadcasts the latest value of something, eg. configuration, to any
+        // number of readers.
+        //
+        // publish(value) bumps the version and wakes every coroutine waiting in
+        // co_await w.changed(last_seen_version), which resumes with a snapshot
+        // of a version newer than last_seen_version. load() reads the current
+        // snapshot without waiting.
+        //
+        // The value is kept in two slots, each guarded by its own sequence
+        // counter (a seqlock). publish() writes the slot that isn't current, so
+        // readers of the current value never see it change underneath them and
+        // never have to retry, and the writer never waits for readers. A reader
+        // only retries if two publishes happen while it is copying. Reading
+        // doesn't write to any shared memory, so reads scale across cores.
+        //
+        //   version ──→ 5
+        //   slots[0]   seq 10, version 4, value  (the previous value)
+        //   slots[1]   seq 10, version 5, value  ← readers copy this one
+        //   publish() writes slots[0] as version 6, then sets version to 6
+        //
+        // Copying the value while it may be written requires T to be trivially
+        // copyable. Any other T, eg. a configuration holding strings, is
+        // published as a new std::shared_ptr<const T> instead, RCU style: a
+        // snapshot shares the value it was taken of, and each value is freed
+        // once the watch and the last snapshot of it have let go. Such reads
+        // take a reference, so they don't scale across cores like the copies do.
+        template <typename T>
+        class watch
+        {
+            static constexpr bool stored_inline = std::is_trivially_copyable_v<T>;
+
+        public:
+            using snapshot = watch_snapshot<T>;
+
+            explicit watch(const T &initial = T{}) noexcept(stored_inline)
+            {
+                if constexpr (stored_inline)
+                {
+                    for (auto &s : slots)
+                        s.store(initial);
+                }
+                else
+                    shared.store(std::make_shared<shared_value>(initial), std::memory_order_relaxed);
+            }
+
+            watch(const watch &) = delete;
+            watch &operator=(const watch &) = delete;
+
+            // Current version; 0 until the first publish().
+            std::uint64_t version() const noexcept
+            {
+                return current.load(std::memory_order_acquire);
+            }
+
+            snapshot load() const noexcept
+            {
+                if constexpr (stored_inline)
+                {
+                    for (;;)
+                    {
+                        auto v = current.load(std::memory_order_acquire);
+                        const auto &s = slots[v & 1];
+
+                        auto before = s.seq.load(std::memory_order_acquire);
+                        if (before & 1)
+                            continue;
+
+                        auto value = s.load();
+                        auto version = s.version.load(std::memory_order_relaxed);
+
+                        std::atomic_thread_fence(std::memory_order_acquire);
+                        if (s.seq.load(std::memory_order_relaxed) == before)
+                            return snapshot{version, value};
+                    }
+                }
+                else
+                {
+                    auto p = shared.load(std::memory_order_acquire);
+                    auto version = p->version;
+                    const T *value = &p->value;
+                    return snapshot{version, std::shared_ptr<const T>(std::move(p), value)};
+                }
+            }
+
+            // Publishers are serialised with each other, but never wait for readers.
+            void publish(T value)
+            {
+                // Allocated before taking the lock; the version is filled in
+                // under it, before anyone else can see the value.
+                std::shared_ptr<shared_value> published;
+                if constexpr (!stored_inline)
+                    published = std::make_shared<shared_value>(std::move(value));
+
+                waiter *woken = nullptr;
+                {
+                    auto guard = std::lock_guard(mutex);
+
+                    auto v = current.load(std::memory_order_relaxed) + 1;
+                    if constexpr (stored_inline)
+                    {
+                        auto &s = slots[v & 1];
+                        auto seq = s.seq.load(std::memory_order_relaxed);
+
+                        s.seq.store(seq + 1, std::memory_order_relaxed);
+                        std::atomic_thread_fence(std::memory_order_release);
+                        s.store(value);
+                        s.version.store(v, std::memory_order_relaxed);
+                        s.seq.store(seq + 2, std::memory_order_release);
+                    }
+                    else
+                    {
+                        // The previous value is freed here, or by whichever
+                        // snapshot of it is destroyed last.
+                        published->version = v;
+                        shared.store(std::move(published), std::memory_order_release);
+                    }
+
+                    current.store(v, std::memory_order_release);
+                    woken = std::exchange(waiters, nullptr);
+                }
+
+                // Waiters were pushed in LIFO order; wake them in the order they arrived.
+                waiter *fifo = nullptr;
+                while (woken)
+                {
+                    auto n = woken;
+                    woken = n->next;
+                    n->next = fifo;
+                    fifo = n;
+                }
+                while (fifo)
+                {
+                    auto n = fifo;
+                    fifo = n->next;
+                    n->handle();
+                }
+            }
+
+        private:
+            struct waiter
+            {
+                waiter *next = nullptr;
+                std::coroutine_handle<> handle;
+            };
+
+        public:
+            struct changed_awaiter
+            {
+                const watch &w;
+                std::uint64_t last_seen;
+                waiter n{};
+
+                bool await_ready() const noexcept
+                {
+                    return w.version() > last_seen;
+                }
+
+                bool await_suspend(std::coroutine_handle<> handle) noexcept
+                {
+                    n.handle = handle;
+                    return w.enqueue(n, last_seen);
+                }
+
+                snapshot await_resume() const noexcept
+                {
+                    return w.load();
+                }
+            };
+
+            // co_await w.changed(last_seen_version) resumes with a snapshot once a
+            // version newer than last_seen_version has been published, without
+            // suspending if there already is one.
+            changed_awaiter changed(std::uint64_t last_seen_version) const noexcept
+            {
+                return changed_awaiter{*this, last_seen_version};
+            }
+
+        private:
+            // The value is stored as relaxed atomic words rather than a T, so that
+            // a reader copying it while it's being rewritten isn't a data race;
+            // the sequence counter tells the reader to discard such a copy.
+            static constexpr std::size_t word_count = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+            using words = std::array<std::uint64_t, word_count>;
+
+            struct alignas(64) slot
+            {
+                std::atomic<std::uint64_t> seq{0};
+                std::atomic<std::uint64_t> version{0};
+                std::atomic<std::uint64_t> value[word_count];
+
+                void store(const T &v) noexcept
+                {
+                    words w{};
+                    std::memcpy(w.data(), &v, sizeof(T));
+                    for (std::size_t i = 0; i < word_count; ++i)
+                        value[i].store(w[i], std::memory_order_relaxed);
+                }
+
+                T load() const noexcept
+                {
+                    words w;
+                    for (std::size_t i = 0; i < word_count; ++i)
+                        w[i] = value[i].load(std::memory_order_relaxed);
+                    std::array<unsigned char, sizeof(T)> bytes;
+                    std::memcpy(bytes.data(), w.data(), sizeof(T));
+                    return std::bit_cast<T>(bytes);
+                }
+            };
+
+            // Returns false if a newer version has been published meanwhile.
+            bool enqueue(waiter &n, std::uint64_t last_seen) const noexcept
+            {
+                auto guard = std::lock_guard(mutex);
+                if (current.load(std::memory_order_relaxed) > last_seen)
+                    return false;
+                n.next = waiters;
+                waiters = &n;
+                return true;
+            }
+
+            // A published value that isn't trivially copyable. Snapshots point
+            // at value but share ownership of the whole thing.
+            struct shared_value
+            {
+                explicit shared_value(T value) : value(std::move(value)) {}
+
+                std::uint64_t version = 0;
+                const T value;
+            };
+
+            // Only one of slots and shared is used, depending on T.
+            struct no_slots
+            {
+            };
+
+            struct no_shared
+            {
+            };
+
+            alignas(64) std::atomic<std::uint64_t> current{0};
+            [[no_unique_address]] std::conditional_t<stored_inline, slot[2], no_slots> slots;
+            [[no_unique_address]] std::conditional_t<stored_inline, no_shared, std::atomic<std::shared_ptr<const shared_value>>> shared;
+
+            mutable std::mutex mutex;
+            mutable waiter *waiters = nullptr;
+        };
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+namespace http_bench
+{
+    // Minimal HTTP/1.1 message framing, just enough to split a byte stream
+    // of pipelined requests or responses into individual messages.
+    //
+    // Chunked transfer encoding is not supported, bodies must be framed by
+    // Content-Length.
+
+    struct message_frame
+    {
+        // Total size of the message, header block plus body.
+        std::size_t size;
+
+        // Whether the connection should stay open after this message.
+        bool keepAlive;
+    };
+
+    enum class parse_status
+    {
+        complete,
+        incomplete,
+        invalid
+    };
+
+    struct parse_result
+    {
+        parse_status status;
+        message_frame frame;
+    };
+
+    namespace detail
+    {
+        inline bool iequals(std::string_view a, std::string_view b) noexcept
+        {
+            if (a.size() != b.size())
+            {
+                return false;
+            }
+
+            for (std::size_t i = 0; i < a.size(); ++i)
+            {
+                char x = a[i];
+                char y = b[i];
+                if (x >= 'A' && x <= 'Z') x = static_cast<char>(x - 'A' + 'a');
+                if (y >= 'A' && y <= 'Z') y = static_cast<char>(y - 'A' + 'a');
+                if (x != y)
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        inline std::string_view trim(std::string_view s) noexcept
+        {
+            while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+            while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+            return s;
+        }
+
+        inline std::optional<std::size_t> parse_size(std::string_view s) noexcept
+        {
+            if (s.empty() || s.size() > 18)
+            {
+                return std::nullopt;
+            }
+
+            std::size_t value = 0;
+            for (char c : s)
+            {
+                if (c < '0' || c > '9')
+                {
+                    return std::nullopt;
+                }
+                value = value * 10 + static_cast<std::size_t>(c - '0');
+            }
+
+            return value;
+        }
+    }
+
+    /// Frame the message at the start of \p data.
+    ///
+    /// \p startLine receives the first line of the message, either the request
+    /// line or the status line, so that the caller can inspect it.
+    inline parse_result parse_message(std::string_view data, std::string_view& startLine) noexcept
+    {
+        const std::size_t headerEnd = data.find("\r\n\r\n");
+        if (headerEnd == std::string_view::npos)
+        {
+            return { parse_status::incomplete, {} };
+        }
+
+        std::string_view headers = data.substr(0, headerEnd + 2);
+
+        std::size_t lineEnd = headers.find("\r\n");
+        startLine = headers.substr(0, lineEnd);
+        headers.remove_prefix(lineEnd + 2);
+
+        // HTTP/1.1 defaults to keep-alive, HTTP/1.0 to close.
+        const bool isHttp10 = startLine.find("HTTP/1.0") != std::string_view::npos;
+        bool keepAlive = !isHttp10;
+        std::size_t contentLength = 0;
+
+        while (!headers.empty())
+        {
+            lineEnd = headers.find("\r\n");
+            const std::string_view line = headers.substr(0, lineEnd);
+            headers.remove_prefix(lineEnd + 2);
+
+            const std::size_t colon = line.find(':');
+            if (colon == std::string_view::npos)
+            {
+                return { parse_status::invalid, {} };
+            }
+
+            const std::string_view name = detail::trim(line.substr(0, colon));
+            const std::string_view value = detail::trim(line.substr(colon + 1));
+
+            if (detail::iequals(name, "content-length"))
+            {
+                const auto length = detail::parse_size(value);
+                if (!length)
+                {
+                    return { parse_status::invalid, {} };
+                }
+                contentLength = *length;
+            }
+            else if (detail::iequals(name, "connection"))
+            {
+                if (detail::iequals(value, "close"))
+                {
+                    keepAlive = false;
+                }
+                else if (detail::iequals(value, "keep-alive"))
+                {
+                    keepAlive = true;
+                }
+            }
+            else if (detail::iequals(name, "transfer-encoding"))
+            {
+                return { parse_status::invalid, {} };
+            }
+        }
+
+        const std::size_t size = headerEnd + 4 + contentLength;
+        if (data.size() < size)
+        {
+            return { parse_status::incomplete, {} };
+        }
+
+        return { parse_status::complete, { size, keepAlive } };
+    }
+}
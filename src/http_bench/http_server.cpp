@@ -0,0 +1,167 @@
+#include "http_server.hpp"
+#include "http_message.hpp"
+
+#include <cppcoro/async_scope.hpp>
+#include <cppcoro/operation_cancelled.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace
+{
+    constexpr std::size_t max_request_size = 64 * 1024;
+
+    constexpr std::string_view ok_response =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain\r\n"
+        "Content-Length: 13\r\n"
+        "\r\n"
+        "Hello, World!";
+
+    constexpr std::string_view ok_close_response =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain\r\n"
+        "Content-Length: 13\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "Hello, World!";
+
+    constexpr std::string_view bad_request_response =
+        "HTTP/1.1 400 Bad Request\r\n"
+        "Content-Length: 0\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+
+    constexpr std::string_view too_large_response =
+        "HTTP/1.1 431 Request Header Fields Too Large\r\n"
+        "Content-Length: 0\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+
+    cppcoro::task<> send_all(cppcoro::net::socket& s, const std::string& data)
+    {
+        std::size_t bytesSent = 0;
+        while (bytesSent < data.size())
+        {
+            bytesSent += co_await s.send(data.data() + bytesSent, data.size() - bytesSent);
+        }
+    }
+}
+
+http_bench::http_server::http_server(
+    cppcoro::io_service& ioService,
+    cppcoro::static_thread_pool& threadPool,
+    const cppcoro::net::ip_endpoint& endpoint)
+    : m_ioService(ioService)
+    , m_threadPool(threadPool)
+    , m_listeningSocket(endpoint.is_ipv4()
+        ? cppcoro::net::socket::create_tcpv4(ioService)
+        : cppcoro::net::socket::create_tcpv6(ioService))
+    , m_requestsServed(0)
+{
+    m_listeningSocket.bind(endpoint);
+    m_listeningSocket.listen();
+}
+
+cppcoro::task<> http_bench::http_server::run(cppcoro::cancellation_token ct)
+{
+    cppcoro::async_scope connectionScope;
+
+    try
+    {
+        const bool isIpv4 = endpoint().is_ipv4();
+        while (true)
+        {
+            auto acceptingSocket = isIpv4
+                ? cppcoro::net::socket::create_tcpv4(m_ioService)
+                : cppcoro::net::socket::create_tcpv6(m_ioService);
+            co_await m_listeningSocket.accept(acceptingSocket, ct);
+            connectionScope.spawn(handle_connection(std::move(acceptingSocket)));
+        }
+    }
+    catch (const cppcoro::operation_cancelled&)
+    {
+    }
+    catch (const std::system_error& ex)
+    {
+        std::fprintf(stderr, "accept failed: %s\n", ex.what());
+    }
+
+    co_await connectionScope.join();
+}
+
+cppcoro::task<> http_bench::http_server::handle_connection(cppcoro::net::socket s)
+{
+    std::vector<char> input(max_request_size);
+    std::size_t inputSize = 0;
+    std::string output;
+
+    try
+    {
+        bool keepAlive = true;
+        while (keepAlive)
+        {
+            const std::size_t bytesReceived = co_await s.recv(
+                input.data() + inputSize, input.size() - inputSize);
+            if (bytesReceived == 0)
+            {
+                break;
+            }
+            inputSize += bytesReceived;
+
+            // Handle the requests on the thread pool, the response is sent
+            // from there too.
+            co_await m_threadPool.schedule();
+
+            std::size_t consumed = 0;
+            std::uint64_t requestCount = 0;
+            while (keepAlive)
+            {
+                std::string_view requestLine;
+                const auto result = parse_message(
+                    std::string_view{ input.data() + consumed, inputSize - consumed },
+                    requestLine);
+                if (result.status == parse_status::incomplete)
+                {
+                    break;
+                }
+
+                if (result.status == parse_status::invalid)
+                {
+                    output += bad_request_response;
+                    keepAlive = false;
+                    break;
+                }
+
+                consumed += result.frame.size;
+                keepAlive = result.frame.keepAlive;
+                output += keepAlive ? ok_response : ok_close_response;
+                ++requestCount;
+            }
+
+            // Keep any partial request for the next read.
+            std::memmove(input.data(), input.data() + consumed, inputSize - consumed);
+            inputSize -= consumed;
+
+            if (keepAlive && inputSize == input.size())
+            {
+                output += too_large_response;
+                keepAlive = false;
+            }
+
+            m_requestsServed.fetch_add(requestCount, std::memory_order_relaxed);
+
+            co_await send_all(s, output);
+            output.clear();
+        }
+
+        s.close_send();
+    }
+    catch (const std::system_error&)
+    {
+        // Connection reset by the client, just drop it.
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cppcoro/cancellation_token.hpp>
+#include <cppcoro/io_service.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/net/ip_endpoint.hpp>
+#include <cppcoro/net/socket.hpp>
+
+#include <atomic>
+#include <cstdint>
+
+namespace http_bench
+{
+    /// Minimal HTTP/1.1 server answering every request with a fixed
+    /// "Hello, World!" response.
+    ///
+    /// Connections are kept alive and requests may be pipelined: every
+    /// complete request that arrives in one read is answered with a single
+    /// send. Socket I/O completes on the io_service threads while requests
+    /// are handled on the thread pool, so the server exercises both.
+    class http_server
+    {
+    public:
+
+        /// Bind a listening socket to \p endpoint.
+        ///
+        /// Use port 0 to have the OS pick a free port, see endpoint().
+        http_server(
+            cppcoro::io_service& ioService,
+            cppcoro::static_thread_pool& threadPool,
+            const cppcoro::net::ip_endpoint& endpoint);
+
+        /// The end-point the server is listening on.
+        const cppcoro::net::ip_endpoint& endpoint() const noexcept
+        {
+            return m_listeningSocket.local_endpoint();
+        }
+
+        /// Accept connections until \p ct is cancelled, then wait for all
+        /// open connections to be closed by their clients.
+        cppcoro::task<> run(cppcoro::cancellation_token ct);
+
+        std::uint64_t requests_served() const noexcept
+        {
+            return m_requestsServed.load(std::memory_order_relaxed);
+        }
+
+    private:
+
+        cppcoro::task<> handle_connection(cppcoro::net::socket s);
+
+        cppcoro::io_service& m_ioService;
+        cppcoro::static_thread_pool& m_threadPool;
+        cppcoro::net::socket m_listeningSocket;
+        std::atomic<std::uint64_t> m_requestsServed;
+    };
+}
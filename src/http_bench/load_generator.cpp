@@ -0,0 +1,193 @@
+#include "load_generator.hpp"
+#include "http_message.hpp"
+
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/net/ipv4_endpoint.hpp>
+#include <cppcoro/net/ipv6_endpoint.hpp>
+#include <cppcoro/net/socket.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <system_error>
+
+namespace
+{
+    using clock = std::chrono::steady_clock;
+
+    constexpr std::string_view request =
+        "GET / HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "\r\n";
+
+    struct connection_stats
+    {
+        std::uint64_t requests = 0;
+        std::uint64_t errors = 0;
+        std::vector<std::chrono::nanoseconds> latencies;
+    };
+
+    cppcoro::task<> run_connection(
+        cppcoro::io_service& ioService,
+        const http_bench::load_options& options,
+        clock::time_point measureFrom,
+        clock::time_point deadline,
+        connection_stats& stats)
+    {
+        using namespace http_bench;
+
+        try
+        {
+            auto s = options.target.is_ipv4()
+                ? cppcoro::net::socket::create_tcpv4(ioService)
+                : cppcoro::net::socket::create_tcpv6(ioService);
+            if (options.target.is_ipv4())
+            {
+                s.bind(cppcoro::net::ipv4_endpoint{});
+            }
+            else
+            {
+                s.bind(cppcoro::net::ipv6_endpoint{});
+            }
+            co_await s.connect(options.target);
+
+            std::string batch;
+            for (std::uint32_t i = 0; i < options.pipelineDepth; ++i)
+            {
+                batch += request;
+            }
+
+            std::vector<char> input(64 * 1024);
+            std::size_t inputSize = 0;
+
+            while (clock::now() < deadline)
+            {
+                const auto start = clock::now();
+
+                std::size_t bytesSent = 0;
+                while (bytesSent < batch.size())
+                {
+                    bytesSent += co_await s.send(batch.data() + bytesSent, batch.size() - bytesSent);
+                }
+
+                std::uint32_t responsesReceived = 0;
+                while (responsesReceived < options.pipelineDepth)
+                {
+                    const std::size_t bytesReceived = co_await s.recv(
+                        input.data() + inputSize, input.size() - inputSize);
+                    if (bytesReceived == 0)
+                    {
+                        throw std::system_error{
+                            std::make_error_code(std::errc::connection_reset) };
+                    }
+                    inputSize += bytesReceived;
+
+                    std::size_t consumed = 0;
+                    while (responsesReceived < options.pipelineDepth)
+                    {
+                        std::string_view statusLine;
+                        const auto result = parse_message(
+                            std::string_view{ input.data() + consumed, inputSize - consumed },
+                            statusLine);
+                        if (result.status == parse_status::incomplete)
+                        {
+                            break;
+                        }
+
+                        if (result.status == parse_status::invalid ||
+                            statusLine.substr(0, 12) != "HTTP/1.1 200")
+                        {
+                            throw std::system_error{
+                                std::make_error_code(std::errc::protocol_error) };
+                        }
+
+                        consumed += result.frame.size;
+                        ++responsesReceived;
+
+                        const auto end = clock::now();
+                        if (start >= measureFrom)
+                        {
+                            ++stats.requests;
+                            stats.latencies.push_back(end - start);
+                        }
+                    }
+
+                    std::memmove(input.data(), input.data() + consumed, inputSize - consumed);
+                    inputSize -= consumed;
+                }
+            }
+
+            s.close_send();
+        }
+        catch (const std::system_error& ex)
+        {
+            if (stats.errors++ == 0)
+            {
+                std::fprintf(stderr, "connection failed: %s\n", ex.what());
+            }
+        }
+    }
+}
+
+double http_bench::load_result::requests_per_second() const noexcept
+{
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    return seconds > 0 ? static_cast<double>(requests) / seconds : 0.0;
+}
+
+std::chrono::nanoseconds http_bench::load_result::percentile(double p) const noexcept
+{
+    if (latencies.empty())
+    {
+        return std::chrono::nanoseconds{ 0 };
+    }
+
+    const double rank = std::ceil(p / 100.0 * static_cast<double>(latencies.size()));
+    const std::size_t index = rank < 1.0 ? 0 : static_cast<std::size_t>(rank) - 1;
+    return latencies[std::min(index, latencies.size() - 1)];
+}
+
+cppcoro::task<http_bench::load_result> http_bench::generate_load(
+    cppcoro::io_service& ioService,
+    const load_options& options)
+{
+    const auto measureFrom = clock::now() + options.warmup;
+    const auto deadline = measureFrom + options.duration;
+
+    std::vector<connection_stats> stats(options.connections);
+
+    std::vector<cppcoro::task<>> connections;
+    connections.reserve(options.connections);
+    for (auto& connectionStats : stats)
+    {
+        connections.push_back(run_connection(ioService, options, measureFrom, deadline, connectionStats));
+    }
+
+    co_await cppcoro::when_all(std::move(connections));
+
+    load_result result;
+    result.elapsed = std::min(clock::now(), deadline) - measureFrom;
+
+    std::size_t latencyCount = 0;
+    for (const auto& connectionStats : stats)
+    {
+        latencyCount += connectionStats.latencies.size();
+    }
+    result.latencies.reserve(latencyCount);
+
+    for (const auto& connectionStats : stats)
+    {
+        result.requests += connectionStats.requests;
+        result.errors += connectionStats.errors;
+        result.latencies.insert(
+            result.latencies.end(),
+            connectionStats.latencies.begin(),
+            connectionStats.latencies.end());
+    }
+
+    std::sort(result.latencies.begin(), result.latencies.end());
+
+    co_return result;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cppcoro/io_service.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/net/ip_endpoint.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace http_bench
+{
+    struct load_options
+    {
+        cppcoro::net::ip_endpoint target;
+
+        // Number of concurrent keep-alive connections.
+        std::uint32_t connections = 64;
+
+        // Number of requests each connection sends before waiting for the
+        // responses.
+        std::uint32_t pipelineDepth = 1;
+
+        std::chrono::milliseconds warmup{ 500 };
+        std::chrono::milliseconds duration{ 5000 };
+    };
+
+    struct load_result
+    {
+        std::uint64_t requests = 0;
+        std::uint64_t errors = 0;
+        std::chrono::nanoseconds elapsed{ 0 };
+
+        // Latency of every request completed after the warm-up, sorted.
+        std::vector<std::chrono::nanoseconds> latencies;
+
+        double requests_per_second() const noexcept;
+
+        /// \param p
+        /// The percentile, in the range [0, 100].
+        std::chrono::nanoseconds percentile(double p) const noexcept;
+    };
+
+    /// Closed-loop HTTP/1.1 load generator.
+    ///
+    /// Each connection sends pipelineDepth requests, waits for all of the
+    /// responses and then immediately sends the next batch. The latency of
+    /// a request is measured from sending its batch to receiving its response.
+    cppcoro::task<load_result> generate_load(
+        cppcoro::io_service& ioService,
+        const load_options& options);
+}
@@ -0,0 +1,206 @@
+// HTTP/1.1 macro-benchmark for the scheduler and I/O layers.
+//
+// By default runs a pipelined keep-alive server and a closed-loop load
+// generator against it over loopback in the same process, then reports
+// throughput and latency percentiles. Either side can also be run on its
+// own, eg. to benchmark against another server or with another client.
+//
+//   http_bench [--mode both|server|client] [--port N] [--target ADDR:PORT]
+//              [--connections N] [--pipeline N] [--duration SECONDS]
+//              [--warmup SECONDS] [--io-threads N] [--pool-threads N]
+
+#include "http_server.hpp"
+#include "load_generator.hpp"
+
+#include <cppcoro/cancellation_source.hpp>
+#include <cppcoro/io_service.hpp>
+#include <cppcoro/on_scope_exit.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/sync_wait.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+#include <cppcoro/net/ipv4_endpoint.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct options
+    {
+        std::string mode = "both";
+        std::uint16_t port = 0;
+        std::string target = "127.0.0.1:8080";
+        std::uint32_t connections = 64;
+        std::uint32_t pipeline = 1;
+        double duration = 5.0;
+        double warmup = 0.5;
+        std::uint32_t ioThreads = 1;
+        std::uint32_t poolThreads = std::max(1u, std::thread::hardware_concurrency());
+    };
+
+    [[noreturn]] void usage(const char* program)
+    {
+        std::fprintf(stderr,
+            "usage: %s [--mode both|server|client] [--port N] [--target ADDR:PORT]\n"
+            "          [--connections N] [--pipeline N] [--duration SECONDS]\n"
+            "          [--warmup SECONDS] [--io-threads N] [--pool-threads N]\n",
+            program);
+        std::exit(1);
+    }
+
+    options parse_options(int argc, char** argv)
+    {
+        options result;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string_view arg = argv[i];
+            if (i + 1 >= argc)
+            {
+                usage(argv[0]);
+            }
+
+            const char* value = argv[++i];
+            if (arg == "--mode") result.mode = value;
+            else if (arg == "--port") result.port = static_cast<std::uint16_t>(std::atoi(value));
+            else if (arg == "--target") result.target = value;
+            else if (arg == "--connections") result.connections = static_cast<std::uint32_t>(std::atoi(value));
+            else if (arg == "--pipeline") result.pipeline = static_cast<std::uint32_t>(std::atoi(value));
+            else if (arg == "--duration") result.duration = std::atof(value);
+            else if (arg == "--warmup") result.warmup = std::atof(value);
+            else if (arg == "--io-threads") result.ioThreads = static_cast<std::uint32_t>(std::atoi(value));
+            else if (arg == "--pool-threads") result.poolThreads = static_cast<std::uint32_t>(std::atoi(value));
+            else usage(argv[0]);
+        }
+
+        if (result.mode != "both" && result.mode != "server" && result.mode != "client")
+        {
+            usage(argv[0]);
+        }
+
+        result.connections = std::max(1u, result.connections);
+        result.pipeline = std::max(1u, result.pipeline);
+        result.ioThreads = std::max(1u, result.ioThreads);
+        result.poolThreads = std::max(1u, result.poolThreads);
+        return result;
+    }
+
+    std::chrono::milliseconds to_milliseconds(double seconds)
+    {
+        return std::chrono::milliseconds{ static_cast<std::int64_t>(seconds * 1000.0) };
+    }
+
+    double to_microseconds(std::chrono::nanoseconds ns)
+    {
+        return std::chrono::duration<double, std::micro>(ns).count();
+    }
+
+    void print_result(const http_bench::load_result& result, const options& opts)
+    {
+        std::printf("connections: %u, pipeline depth: %u\n", opts.connections, opts.pipeline);
+        std::printf("requests:    %llu in %.2fs (%llu errors)\n",
+            static_cast<unsigned long long>(result.requests),
+            std::chrono::duration<double>(result.elapsed).count(),
+            static_cast<unsigned long long>(result.errors));
+        std::printf("throughput:  %.0f req/s\n", result.requests_per_second());
+        std::printf("latency:     p50 %.1fus  p90 %.1fus  p99 %.1fus  p99.9 %.1fus  max %.1fus\n",
+            to_microseconds(result.percentile(50)),
+            to_microseconds(result.percentile(90)),
+            to_microseconds(result.percentile(99)),
+            to_microseconds(result.percentile(99.9)),
+            to_microseconds(result.percentile(100)));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const options opts = parse_options(argc, argv);
+
+    cppcoro::io_service ioService;
+    cppcoro::static_thread_pool threadPool{ opts.poolThreads };
+
+    std::vector<std::thread> ioThreads;
+    for (std::uint32_t i = 0; i < opts.ioThreads; ++i)
+    {
+        ioThreads.emplace_back([&] { ioService.process_events(); });
+    }
+
+    auto stopIoThreads = cppcoro::on_scope_exit([&]
+    {
+        ioService.stop();
+        for (auto& thread : ioThreads)
+        {
+            thread.join();
+        }
+    });
+
+    if (opts.mode == "client")
+    {
+        const auto target = cppcoro::net::ip_endpoint::from_string(opts.target);
+        if (!target)
+        {
+            std::fprintf(stderr, "invalid target end-point: %s\n", opts.target.c_str());
+            return 1;
+        }
+
+        http_bench::load_options loadOptions;
+        loadOptions.target = *target;
+        loadOptions.connections = opts.connections;
+        loadOptions.pipelineDepth = opts.pipeline;
+        loadOptions.warmup = to_milliseconds(opts.warmup);
+        loadOptions.duration = to_milliseconds(opts.duration);
+
+        print_result(cppcoro::sync_wait(http_bench::generate_load(ioService, loadOptions)), opts);
+        return 0;
+    }
+
+    http_bench::http_server server{
+        ioService,
+        threadPool,
+        cppcoro::net::ipv4_endpoint{ cppcoro::net::ipv4_address::loopback(), opts.port } };
+
+    std::printf("listening on %s\n", server.endpoint().to_string().c_str());
+
+    cppcoro::cancellation_source canceller;
+
+    if (opts.mode == "server")
+    {
+        // Serve until stdin is closed.
+        std::thread stdinWatcher([&]
+        {
+            std::string line;
+            while (std::getline(std::cin, line)) {}
+            canceller.request_cancellation();
+        });
+        cppcoro::sync_wait(server.run(canceller.token()));
+        stdinWatcher.join();
+        std::printf("served %llu requests\n", static_cast<unsigned long long>(server.requests_served()));
+        return 0;
+    }
+
+    http_bench::load_options loadOptions;
+    loadOptions.target = server.endpoint();
+    loadOptions.connections = opts.connections;
+    loadOptions.pipelineDepth = opts.pipeline;
+    loadOptions.warmup = to_milliseconds(opts.warmup);
+    loadOptions.duration = to_milliseconds(opts.duration);
+
+    http_bench::load_result result;
+    cppcoro::sync_wait(cppcoro::when_all(
+        server.run(canceller.token()),
+        [&]() -> cppcoro::task<>
+        {
+            auto stopServerOnExit = cppcoro::on_scope_exit([&] { canceller.request_cancellation(); });
+            result = co_await http_bench::generate_load(ioService, loadOptions);
+        }()));
+
+    print_result(result, opts);
+    return result.errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,544 @@
+// Micro-benchmarks for the tfcoro synchronisation primitives.
+//
+//   sync_bench [--waiters N] [--pool-threads N] [--only NAME]
+//
+// Each benchmark prints one line of results. --only runs a single benchmark.
+
+#include "sync.h"
+#include "watch.h"
+
+#include <cppcoro/async_scope.hpp>
+#include <cppcoro/static_thread_pool.hpp>
+#include <cppcoro/sync_wait.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    std::atomic<std::uint64_t> allocationCount = 0;
+}
+
+// Count allocations so that benchmarks can report allocations per operation.
+void* operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size != 0 ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+    using clock = std::chrono::steady_clock;
+    using namespace std::chrono_literals;
+
+    struct options
+    {
+        std::uint32_t waiters = 100000;
+        std::uint32_t poolThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::string only;
+    };
+
+    [[noreturn]] void usage(const char* program)
+    {
+        std::fprintf(stderr, "usage: %s [--waiters N] [--pool-threads N] [--only NAME]\n", program);
+        std::exit(1);
+    }
+
+    options parse_options(int argc, char** argv)
+    {
+        options result;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string_view arg = argv[i];
+            if (i + 1 >= argc)
+            {
+                usage(argv[0]);
+            }
+
+            const char* value = argv[++i];
+            if (arg == "--waiters") result.waiters = static_cast<std::uint32_t>(std::atoi(value));
+            else if (arg == "--pool-threads") result.poolThreads = static_cast<std::uint32_t>(std::atoi(value));
+            else if (arg == "--only") result.only = value;
+            else usage(argv[0]);
+        }
+        return result;
+    }
+
+    double microseconds(clock::duration d)
+    {
+        return std::chrono::duration<double, std::micro>(d).count();
+    }
+
+    double nanoseconds_each(clock::duration d, std::size_t count)
+    {
+        return std::chrono::duration<double, std::nano>(d).count() / static_cast<double>(count);
+    }
+
+    clock::duration percentile(std::vector<clock::duration>& samples, double p)
+    {
+        if (samples.empty())
+        {
+            return clock::duration::zero();
+        }
+        const auto index = static_cast<std::size_t>(p * static_cast<double>(samples.size() - 1));
+        std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+        return samples[index];
+    }
+
+    // Every waiter times out. Reports the cost of registering a timed wait and
+    // how late waiters are resumed relative to their deadline.
+    void timed_wait_timeout(const options& opts, cppcoro::static_thread_pool& pool)
+    {
+        const tfcoro::awaitable_event event;
+        const auto timeout = 50ms;
+        std::vector<clock::duration> lateness(opts.waiters);
+        std::atomic<std::uint32_t> timedOut = 0;
+
+        auto waiter = [&](std::uint32_t index) -> cppcoro::task<>
+        {
+            const auto deadline = clock::now() + timeout;
+            if (co_await event.wait_for(timeout, pool) == tfcoro::wait_status::timed_out)
+            {
+                timedOut.fetch_add(1, std::memory_order_relaxed);
+            }
+            lateness[index] = clock::now() - deadline;
+        };
+
+        std::vector<cppcoro::task<>> tasks;
+        tasks.reserve(opts.waiters + 1);
+        for (std::uint32_t i = 0; i < opts.waiters; ++i)
+        {
+            tasks.push_back(waiter(i));
+        }
+
+        // when_all() starts the tasks in order, so this runs once every waiter
+        // has registered.
+        clock::time_point registered;
+        auto marker = [&]() -> cppcoro::task<>
+        {
+            registered = clock::now();
+            co_return;
+        };
+        tasks.push_back(marker());
+
+        const auto start = clock::now();
+        cppcoro::sync_wait(cppcoro::when_all(std::move(tasks)));
+
+        std::printf(
+            "timed_wait_timeout: %u waiters, %.0f ns/registration, "
+            "lateness p50 %.0f us, p99 %.0f us, max %.0f us, %u timed out\n",
+            opts.waiters,
+            nanoseconds_each(registered - start, opts.waiters),
+            microseconds(percentile(lateness, 0.5)),
+            microseconds(percentile(lateness, 0.99)),
+            microseconds(percentile(lateness, 1.0)),
+            timedOut.load());
+    }
+
+    // Every waiter is signalled long before its deadline. Reports the cost of
+    // waking a timed waiter, which includes removing its timer.
+    void timed_wait_signal(const options& opts, cppcoro::static_thread_pool& pool)
+    {
+        const tfcoro::awaitable_event event;
+        std::atomic<std::uint32_t> signalled = 0;
+
+        auto waiter = [&]() -> cppcoro::task<>
+        {
+            if (co_await event.wait_for(10s, pool) == tfcoro::wait_status::signalled)
+            {
+                signalled.fetch_add(1, std::memory_order_relaxed);
+            }
+        };
+
+        std::vector<cppcoro::task<>> tasks;
+        tasks.reserve(opts.waiters + 1);
+        for (std::uint32_t i = 0; i < opts.waiters; ++i)
+        {
+            tasks.push_back(waiter());
+        }
+
+        std::size_t queuedTimers = 0;
+        clock::duration setTime{};
+        auto setter = [&]() -> cppcoro::task<>
+        {
+            queuedTimers = tfcoro::timer_queue::shared().size();
+            const auto start = clock::now();
+            event.set();
+            setTime = clock::now() - start;
+            co_return;
+        };
+        tasks.push_back(setter());
+
+        cppcoro::sync_wait(cppcoro::when_all(std::move(tasks)));
+
+        std::printf(
+            "timed_wait_signal: %u waiters, %zu timers queued, %.0f ns/wake, "
+            "%u signalled, %zu timers left\n",
+            opts.waiters,
+            queuedTimers,
+            nanoseconds_each(setTime, opts.waiters),
+            signalled.load(),
+            tfcoro::timer_queue::shared().size());
+    }
+
+    template <typename Event>
+    cppcoro::task<> wait_on(Event event)
+    {
+        co_await event;
+    }
+
+    // Each thread passes an already-set event by value into iterations
+    // coroutines, the way waiters usually receive it. Returns ns/coroutine.
+    template <typename Event>
+    double pass_by_value(const Event& event, std::uint32_t threads, std::uint32_t iterations, cppcoro::static_thread_pool& pool)
+    {
+        auto worker = [&]() -> cppcoro::task<>
+        {
+            co_await pool.schedule();
+            for (std::uint32_t i = 0; i < iterations; ++i)
+            {
+                co_await wait_on<Event>(event);
+
+                // The waits complete synchronously; unwind the stack now and then
+                // for builds where symmetric transfer isn't a tail call.
+                if (i % 1024 == 1023)
+                {
+                    co_await pool.schedule();
+                }
+            }
+        };
+
+        std::vector<cppcoro::task<>> workers;
+        for (std::uint32_t i = 0; i < threads; ++i)
+        {
+            workers.push_back(worker());
+        }
+
+        const auto start = clock::now();
+        cppcoro::sync_wait(cppcoro::when_all(std::move(workers)));
+        return nanoseconds_each(clock::now() - start, std::size_t{ threads } * iterations);
+    }
+
+    // Cost of handing an event to a coroutine by value for each event type.
+    // local_event copies may only be made on one thread.
+    void event_copy(const options& opts, cppcoro::static_thread_pool& pool)
+    {
+        const std::uint32_t iterations = opts.waiters * 10;
+        const std::uint32_t threads = opts.poolThreads;
+
+        tfcoro::awaitable_event shared;
+        shared.set();
+        tfcoro::unique_event unique;
+        unique.set();
+        tfcoro::local_event local;
+        local.set();
+
+        const double sharedTime = pass_by_value(shared, threads, iterations, pool);
+        const double refTime = pass_by_value(tfcoro::event_ref{ unique }, threads, iterations, pool);
+        const double localTime = pass_by_value(local, 1, iterations, pool);
+
+        std::printf(
+            "event_copy: %u threads, awaitable_event %.1f ns, event_ref %.1f ns, "
+            "local_event %.1f ns (1 thread) per coroutine\n",
+            threads,
+            sharedTime,
+            refTime,
+            localTime);
+    }
+
+    struct config
+    {
+        std::uint64_t generation;
+        std::uint32_t limits[6];
+    };
+
+    // Each of threads readers reads the value for duration while a writer
+    // publishes a new one every interval. Returns total reads/s.
+    template <typename Read, typename Publish>
+    double read_throughput(std::uint32_t threads, Read read, Publish publish)
+    {
+        constexpr auto duration = 200ms;
+        constexpr auto interval = 100us;
+
+        std::atomic<bool> stop = false;
+        std::atomic<std::uint64_t> reads = 0;
+        std::atomic<std::uint64_t> sink = 0;
+        std::vector<std::thread> readers;
+        for (std::uint32_t i = 0; i < threads; ++i)
+        {
+            readers.emplace_back([&]
+            {
+                std::uint64_t count = 0;
+                std::uint64_t checksum = 0;
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    checksum += read();
+                    ++count;
+                }
+                reads.fetch_add(count, std::memory_order_relaxed);
+                sink.store(checksum, std::memory_order_relaxed);
+            });
+        }
+
+        const auto start = clock::now();
+        for (std::uint64_t generation = 1; clock::now() - start < duration; ++generation)
+        {
+            publish(generation);
+            std::this_thread::sleep_for(interval);
+        }
+        stop = true;
+        for (auto& t : readers)
+        {
+            t.join();
+        }
+
+        return static_cast<double>(reads.load()) / std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    // Reading the latest value from a watch compared with the mutex-protected
+    // value it replaces.
+    void watch_read(const options& opts, cppcoro::static_thread_pool&)
+    {
+        const std::uint32_t threads = opts.poolThreads;
+
+        tfcoro::watch<config> watched;
+        const double watchRate = read_throughput(
+            threads,
+            [&] { return watched.load()->generation; },
+            [&](std::uint64_t generation) { watched.publish(config{ generation, {} }); });
+
+        std::mutex mutex;
+        config locked{};
+        const double mutexRate = read_throughput(
+            threads,
+            [&]
+            {
+                std::lock_guard guard{ mutex };
+                return locked.generation;
+            },
+            [&](std::uint64_t generation)
+            {
+                std::lock_guard guard{ mutex };
+                locked = config{ generation, {} };
+            });
+
+        std::printf(
+            "watch_read: %u threads, watch %.1f M reads/s, mutex %.1f M reads/s\n",
+            threads,
+            watchRate / 1e6,
+            mutexRate / 1e6);
+    }
+
+    // Cost of publishing to many coroutines waiting for a change.
+    void watch_wake(const options& opts, cppcoro::static_thread_pool&)
+    {
+        tfcoro::watch<config> watched;
+        std::atomic<std::uint32_t> woken = 0;
+
+        auto waiter = [&]() -> cppcoro::task<>
+        {
+            auto snapshot = co_await watched.changed(0);
+            if (snapshot->generation == 1)
+            {
+                woken.fetch_add(1, std::memory_order_relaxed);
+            }
+        };
+
+        std::vector<cppcoro::task<>> tasks;
+        tasks.reserve(opts.waiters + 1);
+        for (std::uint32_t i = 0; i < opts.waiters; ++i)
+        {
+            tasks.push_back(waiter());
+        }
+
+        clock::duration publishTime{};
+        auto publisher = [&]() -> cppcoro::task<>
+        {
+            const auto start = clock::now();
+            watched.publish(config{ 1, {} });
+            publishTime = clock::now() - start;
+            co_return;
+        };
+        tasks.push_back(publisher());
+
+        cppcoro::sync_wait(cppcoro::when_all(std::move(tasks)));
+
+        std::printf(
+            "watch_wake: %u waiters, %.0f ns/wake, %u woken\n",
+            opts.waiters,
+            nanoseconds_each(publishTime, opts.waiters),
+            woken.load());
+    }
+
+    struct multi_wait_result
+    {
+        clock::time_point resumedAt;
+        std::uint64_t allocations = 0;
+    };
+
+    struct multi_wait_total
+    {
+        clock::duration latency{};
+        std::uint64_t allocations = 0;
+    };
+
+    // Runs iterations of waiter(a, b, result) against a setter that sets b, the
+    // event whose set() should resume the waiter, and then a. The waiter
+    // records the time and allocation count from just before it waits until
+    // it resumes; the setter records the time just before setting b.
+    template <typename Waiter>
+    multi_wait_total run_multi_wait(std::uint32_t iterations, Waiter waiter)
+    {
+        multi_wait_total total;
+        for (std::uint32_t i = 0; i < iterations; ++i)
+        {
+            tfcoro::unique_event a;
+            tfcoro::unique_event b;
+            multi_wait_result result;
+            clock::time_point setAt;
+
+            auto setter = [&]() -> cppcoro::task<>
+            {
+                setAt = clock::now();
+                b.set();
+                a.set();
+                co_return;
+            };
+
+            cppcoro::sync_wait(cppcoro::when_all_ready(waiter(a, b, result), setter()));
+            total.latency += result.resumedAt - setAt;
+            total.allocations += result.allocations;
+        }
+        return total;
+    }
+
+    // Called by the waiters once they resume.
+    void record(multi_wait_result& result, std::uint64_t allocationsBefore)
+    {
+        result.resumedAt = clock::now();
+        result.allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+    }
+
+    cppcoro::task<> branch(tfcoro::event_ref event, tfcoro::event_ref done)
+    {
+        co_await event;
+        done.set();
+    }
+
+    // wait_any() and wait_all() compared with spawning a coroutine per event
+    // and joining them. Reports the latency from the deciding set() to the
+    // waiter resuming, and allocations per wait.
+    void multi_wait(const options& opts, cppcoro::static_thread_pool&)
+    {
+        const std::uint32_t iterations = opts.waiters;
+
+        const auto waitAny = run_multi_wait(iterations,
+            [](tfcoro::unique_event& a, tfcoro::unique_event& b, multi_wait_result& result) -> cppcoro::task<>
+            {
+                const auto before = allocationCount.load(std::memory_order_relaxed);
+                co_await tfcoro::wait_any(a, b);
+                record(result, before);
+            });
+
+        const auto spawnAny = run_multi_wait(iterations,
+            [](tfcoro::unique_event& a, tfcoro::unique_event& b, multi_wait_result& result) -> cppcoro::task<>
+            {
+                const auto before = allocationCount.load(std::memory_order_relaxed);
+                cppcoro::async_scope scope;
+                tfcoro::unique_event doneA;
+                tfcoro::unique_event doneB;
+                scope.spawn(branch(a, doneA));
+                scope.spawn(branch(b, doneB));
+                co_await tfcoro::wait_any(doneA, doneB);
+                record(result, before);
+                co_await scope.join();
+            });
+
+        // For the wait_all() variants b is the last event to be set, so a is
+        // set first by the waiter itself.
+        const auto waitAll = run_multi_wait(iterations,
+            [](tfcoro::unique_event& a, tfcoro::unique_event& b, multi_wait_result& result) -> cppcoro::task<>
+            {
+                a.set();
+                const auto before = allocationCount.load(std::memory_order_relaxed);
+                co_await tfcoro::wait_all(a, b);
+                record(result, before);
+            });
+
+        const auto joinAll = run_multi_wait(iterations,
+            [](tfcoro::unique_event& a, tfcoro::unique_event& b, multi_wait_result& result) -> cppcoro::task<>
+            {
+                a.set();
+                const auto before = allocationCount.load(std::memory_order_relaxed);
+                co_await cppcoro::when_all(wait_on(tfcoro::event_ref{ a }), wait_on(tfcoro::event_ref{ b }));
+                record(result, before);
+            });
+
+        auto report = [&](const char* name, const multi_wait_total& r)
+        {
+            std::printf(
+                "multi_wait: %-22s %6.0f ns latency, %5.2f allocations/wait\n",
+                name,
+                nanoseconds_each(r.latency, iterations),
+                static_cast<double>(r.allocations) / iterations);
+        };
+        report("wait_any", waitAny);
+        report("spawn per event (any)", spawnAny);
+        report("wait_all", waitAll);
+        report("when_all per event", joinAll);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const options opts = parse_options(argc, argv);
+    cppcoro::static_thread_pool pool{ opts.poolThreads };
+
+    struct benchmark
+    {
+        std::string_view name;
+        void (*run)(const options&, cppcoro::static_thread_pool&);
+    };
+
+    const benchmark benchmarks[] = {
+        { "timed_wait_timeout", &timed_wait_timeout },
+        { "timed_wait_signal", &timed_wait_signal },
+        { "event_copy", &event_copy },
+        { "watch_read", &watch_read },
+        { "watch_wake", &watch_wake },
+        { "multi_wait", &multi_wait },
+    };
+
+    for (const auto& b : benchmarks)
+    {
+        if (opts.only.empty() || opts.only == b.name)
+        {
+            b.run(opts, pool);
+        }
+    }
+}
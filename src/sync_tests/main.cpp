@@ -0,0 +1,408 @@
+// Behaviour tests for the tfcoro synchronisation primitives.
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+
+#include "sync.h"
+#include "watch.h"
+
+#include <cppcoro/sync_wait.hpp>
+#include <cppcoro/task.hpp>
+#include <cppcoro/when_all.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using clock = std::chrono::steady_clock;
+    using namespace std::chrono_literals;
+}
+
+TEST_SUITE_BEGIN("timed waits");
+
+TEST_CASE("wait_for times out if the event is never set")
+{
+    tfcoro::timer_queue timers;
+    tfcoro::unique_event event;
+
+    const auto start = clock::now();
+    auto status = cppcoro::sync_wait([&]() -> cppcoro::task<tfcoro::wait_status>
+    {
+        co_return co_await event.wait_for(20ms, timers);
+    }());
+
+    CHECK(status == tfcoro::wait_status::timed_out);
+    CHECK(clock::now() - start >= 20ms);
+    CHECK(timers.size() == 0);
+}
+
+TEST_CASE("wait_for is signalled if the event is set before the deadline")
+{
+    tfcoro::timer_queue timers;
+    tfcoro::unique_event event;
+
+    std::thread setter([&]
+    {
+        std::this_thread::sleep_for(10ms);
+        event.set();
+    });
+
+    const auto start = clock::now();
+    auto status = cppcoro::sync_wait([&]() -> cppcoro::task<tfcoro::wait_status>
+    {
+        co_return co_await event.wait_for(10s, timers);
+    }());
+    setter.join();
+
+    CHECK(status == tfcoro::wait_status::signalled);
+    CHECK(clock::now() - start < 5s);
+
+    // set() took the waiter's timer back out of the queue.
+    CHECK(timers.size() == 0);
+
+    // Already set, so doesn't wait at all.
+    status = cppcoro::sync_wait([&]() -> cppcoro::task<tfcoro::wait_status>
+    {
+        co_return co_await event.wait_for(10s, timers);
+    }());
+    CHECK(status == tfcoro::wait_status::signalled);
+    CHECK(timers.size() == 0);
+}
+
+TEST_CASE("set() racing the deadline resumes each waiter exactly once")
+{
+    tfcoro::timer_queue timers;
+
+    constexpr int rounds = 50;
+    constexpr int waiterCount = 200;
+    int signalledTotal = 0;
+    int timedOutTotal = 0;
+    for (int round = 0; round < rounds; ++round)
+    {
+        tfcoro::unique_event event;
+        std::atomic<int> signalled = 0;
+        std::atomic<int> timedOut = 0;
+        const auto deadline = clock::now() + 2ms;
+
+        auto waiter = [&]() -> cppcoro::task<>
+        {
+            if (co_await event.wait_until(deadline, timers) == tfcoro::wait_status::signalled)
+                signalled.fetch_add(1, std::memory_order_relaxed);
+            else
+                timedOut.fetch_add(1, std::memory_order_relaxed);
+        };
+
+        std::vector<cppcoro::task<>> waiters;
+        for (int i = 0; i < waiterCount; ++i)
+            waiters.push_back(waiter());
+
+        std::thread setter([&]
+        {
+            std::this_thread::sleep_until(deadline);
+            event.set();
+        });
+        cppcoro::sync_wait(cppcoro::when_all(std::move(waiters)));
+        setter.join();
+
+        CHECK(signalled + timedOut == waiterCount);
+        signalledTotal += signalled;
+        timedOutTotal += timedOut;
+    }
+
+    MESSAGE(signalledTotal << " waiters signalled and " << timedOutTotal << " timed out");
+    CHECK(timers.size() == 0);
+}
+
+TEST_CASE("a timed out waiter is unlinked so a later set() doesn't touch it")
+{
+    tfcoro::timer_queue timers;
+    tfcoro::unique_event event;
+    std::thread setter;
+
+    std::vector<tfcoro::wait_status> statuses;
+    cppcoro::sync_wait([&]() -> cppcoro::task<>
+    {
+        // Each wait reuses the same awaiter in this frame, so a timed out
+        // waiter left in the list would be linked to itself by the next one
+        // and set() would never finish walking the list.
+        for (int i = 0; i < 4; ++i)
+        {
+            const std::chrono::milliseconds timeout = i < 3 ? 1ms : 10000ms;
+            if (i == 3)
+            {
+                setter = std::thread([&]
+                {
+                    std::this_thread::sleep_for(10ms);
+                    event.set();
+                });
+            }
+            statuses.push_back(co_await event.wait_for(timeout, timers));
+        }
+    }());
+    setter.join();
+
+    CHECK(statuses == std::vector<tfcoro::wait_status>{
+        tfcoro::wait_status::timed_out,
+        tfcoro::wait_status::timed_out,
+        tfcoro::wait_status::timed_out,
+        tfcoro::wait_status::signalled,
+    });
+    CHECK(timers.size() == 0);
+}
+
+TEST_SUITE_END();
+
+TEST_SUITE_BEGIN("wait_any and wait_all");
+
+TEST_CASE("wait_any resumes with the index of the event that was set")
+{
+    tfcoro::unique_event first;
+    tfcoro::unique_event second;
+    tfcoro::unique_event third;
+    std::size_t index = 0;
+    bool resumed = false;
+
+    auto waiter = [&]() -> cppcoro::task<>
+    {
+        index = co_await tfcoro::wait_any(first, second, third);
+        resumed = true;
+    };
+
+    auto driver = [&]() -> cppcoro::task<>
+    {
+        // set() resumes the winner on this thread before returning.
+        CHECK(!resumed);
+        second.set();
+        CHECK(resumed);
+        co_return;
+    };
+
+    cppcoro::sync_wait(cppcoro::when_all(waiter(), driver()));
+    CHECK(index == 1);
+}
+
+TEST_CASE("wait_any unlinks the events that didn't win")
+{
+    tfcoro::unique_event shared;
+    tfcoro::unique_event other;
+    tfcoro::unique_event winners[2];
+    tfcoro::unique_event proceed;
+    int resumptions = 0;
+    std::vector<std::size_t> indices;
+
+    auto waiter = [&]() -> cppcoro::task<>
+    {
+        // Both waits use the same awaiter in this frame, so a node left on
+        // shared by the first would be linked to itself by the second, and
+        // shared.set() would never finish walking the list.
+        for (auto &winner : winners)
+        {
+            indices.push_back(co_await tfcoro::wait_any(shared, other, winner));
+            ++resumptions;
+        }
+
+        co_await proceed;
+        ++resumptions;
+    };
+
+    auto driver = [&]() -> cppcoro::task<>
+    {
+        winners[0].set();
+        winners[1].set();
+        CHECK(resumptions == 2);
+
+        // The losing nodes are gone, so these resume nothing.
+        shared.set();
+        other.set();
+        CHECK(resumptions == 2);
+
+        proceed.set();
+        CHECK(resumptions == 3);
+        co_return;
+    };
+
+    cppcoro::sync_wait(cppcoro::when_all(waiter(), driver()));
+    CHECK(indices == std::vector<std::size_t>{2, 2});
+}
+
+TEST_CASE("wait_any completes immediately if an event is already set")
+{
+    tfcoro::unique_event first;
+    tfcoro::unique_event second;
+    second.set();
+
+    auto index = cppcoro::sync_wait([&]() -> cppcoro::task<std::size_t>
+    {
+        co_return co_await tfcoro::wait_any(first, second);
+    }());
+    CHECK(index == 1);
+}
+
+TEST_CASE("wait_any racing set() with registration resumes exactly once")
+{
+    constexpr int rounds = 2000;
+    int wrongIndex = 0;
+    for (int round = 0; round < rounds; ++round)
+    {
+        tfcoro::unique_event first;
+        tfcoro::unique_event second;
+        std::atomic<int> resumptions = 0;
+
+        std::thread setter([&] { second.set(); });
+        auto index = cppcoro::sync_wait([&]() -> cppcoro::task<std::size_t>
+        {
+            auto index = co_await tfcoro::wait_any(first, second);
+            resumptions.fetch_add(1, std::memory_order_relaxed);
+            co_return index;
+        }());
+        setter.join();
+
+        // Nothing else may resume the finished wait once first is set too.
+        first.set();
+        CHECK(resumptions == 1);
+        if (index != 1)
+            ++wrongIndex;
+    }
+    CHECK(wrongIndex == 0);
+}
+
+TEST_CASE("wait_all resumes once the last event is set")
+{
+    tfcoro::unique_event first;
+    tfcoro::unique_event second;
+    tfcoro::unique_event third;
+    bool resumed = false;
+
+    auto waiter = [&]() -> cppcoro::task<>
+    {
+        co_await tfcoro::wait_all(first, second, third);
+        resumed = true;
+    };
+
+    auto driver = [&]() -> cppcoro::task<>
+    {
+        third.set();
+        first.set();
+        CHECK(!resumed);
+        second.set();
+        CHECK(resumed);
+        co_return;
+    };
+
+    cppcoro::sync_wait(cppcoro::when_all(waiter(), driver()));
+
+    // Every event already set, so it doesn't wait at all.
+    cppcoro::sync_wait([&]() -> cppcoro::task<>
+    {
+        co_await tfcoro::wait_all(first, second, third);
+    }());
+}
+
+TEST_SUITE_END();
+
+TEST_SUITE_BEGIN("watch");
+
+TEST_CASE("watch copies trivially copyable values")
+{
+    struct point
+    {
+        int x;
+        int y;
+    };
+
+    tfcoro::watch<point> watched{point{1, 2}};
+    CHECK(watched.version() == 0);
+    CHECK(watched.load()->x == 1);
+
+    watched.publish(point{3, 4});
+    const auto snapshot = watched.load();
+    CHECK(snapshot.version() == 1);
+    CHECK(snapshot->x == 3);
+    CHECK(snapshot->y == 4);
+}
+
+TEST_CASE("watch shares values that aren't trivially copyable")
+{
+    struct config
+    {
+        std::string name;
+        std::map<std::string, int> limits;
+    };
+
+    tfcoro::watch<config> watched{config{"initial", {}}};
+    const auto first = watched.load();
+    CHECK(first.version() == 0);
+    CHECK(first->name == "initial");
+
+    watched.publish(config{"second", {{"connections", 10}}});
+    watched.publish(config{"third", {{"connections", 20}}});
+
+    // An older snapshot keeps its value alive and unchanged.
+    CHECK(first->name == "initial");
+    CHECK(first->limits.empty());
+
+    const auto latest = watched.load();
+    CHECK(latest.version() == 2);
+    CHECK(latest->name == "third");
+    CHECK(latest->limits.at("connections") == 20);
+}
+
+TEST_CASE("changed() resumes with a newer value that isn't trivially copyable")
+{
+    tfcoro::watch<std::string> watched{"initial"};
+
+    std::thread publisher([&]
+    {
+        std::this_thread::sleep_for(10ms);
+        watched.publish(std::string(100, 'x'));
+    });
+
+    auto snapshot = cppcoro::sync_wait([&]() -> cppcoro::task<tfcoro::watch_snapshot<std::string>>
+    {
+        co_return co_await watched.changed(0);
+    }());
+    publisher.join();
+
+    CHECK(snapshot.version() == 1);
+    CHECK(snapshot.value() == std::string(100, 'x'));
+}
+
+TEST_CASE("readers racing publishers always see a whole value")
+{
+    tfcoro::watch<std::string> watched{std::string(64, 'a')};
+    std::atomic<bool> stop = false;
+    std::atomic<int> torn = 0;
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 3; ++i)
+    {
+        readers.emplace_back([&]
+        {
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                const auto snapshot = watched.load();
+                const auto &value = snapshot.value();
+                const char expected = static_cast<char>('a' + snapshot.version() % 26);
+                if (value.size() != 64 || value.find_first_not_of(expected) != std::string::npos)
+                    torn.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    for (std::uint64_t v = 1; v <= 10000; ++v)
+        watched.publish(std::string(64, static_cast<char>('a' + v % 26)));
+
+    stop = true;
+    for (auto &reader : readers)
+        reader.join();
+
+    CHECK(torn == 0);
+    CHECK(watched.version() == 10000);
+}
+
+TEST_SUITE_END();